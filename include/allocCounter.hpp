@@ -0,0 +1,42 @@
+//
+// Heap allocation accounting. When the project is built with ENABLE_ALLOC_COUNTING,
+// allocCounter.cpp replaces the global operator new/delete with versions that count
+// every allocation; otherwise snapshot() always returns zeros and enabled() is false.
+//
+
+#ifndef SUMMARIZE_ALLOCCOUNTER_HPP
+#define SUMMARIZE_ALLOCCOUNTER_HPP
+
+#include <cstddef>
+
+namespace summarize {
+    namespace alloc {
+        //! Cumulative heap traffic since program start (or a difference of two snapshots).
+        struct Counts {
+            size_t allocations = 0;
+            size_t deallocations = 0;
+            size_t bytes = 0;
+
+            Counts operator - (const Counts& rhs) const {
+                Counts ret;
+                ret.allocations = allocations - rhs.allocations;
+                ret.deallocations = deallocations - rhs.deallocations;
+                ret.bytes = bytes - rhs.bytes;
+                return ret;
+            }
+            Counts& operator += (const Counts& rhs) {
+                allocations += rhs.allocations;
+                deallocations += rhs.deallocations;
+                bytes += rhs.bytes;
+                return *this;
+            }
+        };
+
+        //! True if the counting operator new/delete hooks were compiled in.
+        bool enabled();
+        //! Current cumulative counts. Counting is process wide (all threads).
+        Counts snapshot();
+    }
+}
+
+#endif //SUMMARIZE_ALLOCCOUNTER_HPP
@@ -0,0 +1,193 @@
+//
+// Block buffered input. A BlockReader hands its consumer whole blocks of input (64 KiB by
+// default) rather than bytes, so parsers work on pointers into a contiguous buffer with one
+// call per block. It reads either a std::streambuf, with one sgetn() per block, or a file
+// opened by path, with read(2), posix_fadvise() read ahead hints and optionally O_DIRECT to
+// bypass the page cache for cold files read once.
+//
+// With a queue depth of K, up to K blocks are read ahead of the one being parsed: through
+// io_uring for regular files where the kernel supports it, and by a reader thread
+// otherwise (including streams, e.g. a decompressor piped to stdin), so I/O overlaps with
+// parsing. The time the consumer still waits for input is reported as the read stall.
+//
+// Bytes given back with unread() and a prefix set with setPrefix() (e.g. a sniffed sample,
+// stripped of a BOM) are returned before any more input is read, so a sample can be
+// re-parsed followed by the rest of a non-seekable input without a wrapping streambuf.
+//
+
+#ifndef SUMMARIZE_BLOCKREADER_HPP
+#define SUMMARIZE_BLOCKREADER_HPP
+
+#include <streambuf>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstddef>
+
+#include <progress.hpp>
+
+namespace summarize {
+
+    //! Default size of the blocks a BlockReader reads.
+    const size_t DEFAULT_BLOCK_SIZE = 1u << 16;
+
+    //! How a BlockReader reads its input.
+    struct BlockReaderOptions {
+        size_t blockSize = DEFAULT_BLOCK_SIZE;
+        //! Blocks read ahead of the one being parsed (0 reads each block when it is needed).
+        size_t queueDepth = 0;
+        //! Read files ahead with io_uring when the kernel supports it, rather than a thread.
+        bool uring = true;
+        //! Hint sequential access to the kernel, and ask for the next readAheadBlocks blocks
+        //! to be read ahead while the current one is parsed (0 for no hints). Only used
+        //! without a queue.
+        size_t readAheadBlocks = 4;
+        //! Open files with O_DIRECT, reading straight into the block buffers without
+        //! filling the page cache. Falls back to buffered reads where it is not supported.
+        bool direct = false;
+    };
+
+    namespace detail {
+        class Uring;
+    }
+
+    class BlockReader {
+    public:
+        //! How blocks are read ahead.
+        enum class ReadAhead {
+            NONE, URING, THREAD
+        };
+    private:
+        //! One buffer of the read ahead queue.
+        struct Slot {
+            char* data = nullptr;
+            size_t size = 0;
+            //! File offset io_uring reads the slot from.
+            size_t offset = 0;
+            enum State { FREE, PENDING, READY } state = FREE;
+        };
+
+        std::streambuf* _sb;
+        int _fd;
+        std::string _path;
+        BlockReaderOptions _options;
+        //! Memory of the slot buffers, aligned for O_DIRECT.
+        char* _buffers;
+        size_t _bufferSize;
+        //! A ring of queueDepth + 1 slots (one while not reading ahead). Blocks are read into
+        //! the slots in order, and _current is the slot the last block returned is in.
+        std::vector<Slot> _slots;
+        size_t _current;
+        ReadAhead _readAhead;
+        //! Set once a read hit the end of the input (or failed), and once next() returned
+        //! the last block.
+        bool _sourceDone;
+        bool _atEnd;
+        //! File offset of the next read io_uring is asked for, and the reads in flight.
+        size_t _submitOffset;
+        size_t _inFlight;
+        std::unique_ptr<detail::Uring> _uring;
+        //! Reader thread, the slot it fills next and the state the consumer shares with it.
+        std::thread _thread;
+        size_t _fillSlot;
+        bool _stopThread;
+        std::mutex _mutex;
+        std::condition_variable _slotReady;
+        std::condition_variable _slotFree;
+
+        //! Bytes at the front of the input not yet returned (see setPrefix), and the prefix
+        //! returned last, which its block points into.
+        std::string _prefix;
+        std::string _returnedPrefix;
+        //! The last block returned.
+        const char* _block;
+        size_t _blockSize;
+        //! Bytes given back with unread(), returned after the prefix.
+        const char* _pending;
+        size_t _pendingSize;
+        //! Bytes of the source returned so far.
+        size_t _bytesRead;
+        //! Seconds next() waited for the source.
+        double _stallSeconds;
+        ProgressReporter* _progress;
+
+        //! Allocate the slots and start reading ahead.
+        void _start();
+        //! Read up to \p size bytes of the source into \p buffer. \return the bytes read,
+        //! 0 at EOF or on error.
+        size_t _readInto(char* buffer, size_t size);
+        //! Ask io_uring to read into the slot \p slot.
+        void _submit(size_t slot);
+        //! Wait for io_uring to complete the read into the slot \p slot.
+        void _awaitUring(size_t slot);
+        void _readThread();
+        //! The next block of the source, in _slots[_current]. \return its size, 0 at EOF.
+        size_t _readSource();
+        //! Stop reading ahead, waiting for reads in flight, so the buffers can be released.
+        void _stop();
+    public:
+        //! A reader of \p sb, which may be nullptr for a reader of its prefix only.
+        explicit BlockReader(std::streambuf* sb = nullptr, size_t blockSize = DEFAULT_BLOCK_SIZE);
+        //! A reader of \p sb with \p options (those for files only are ignored). With a queue,
+        //! \p sb is read by another thread and must not be used until the reader is destroyed.
+        BlockReader(std::streambuf* sb, const BlockReaderOptions& options);
+        ~BlockReader();
+        BlockReader(const BlockReader&) = delete;
+        BlockReader& operator = (const BlockReader&) = delete;
+
+        //! Read the file at \p path instead of a streambuf.
+        //! \return false (with an error printed) if it can not be opened.
+        bool open(const std::string& path, const BlockReaderOptions& options = BlockReaderOptions());
+
+        //! Return the bytes of \p prefix before the rest of the input, including any given
+        //! back with unread().
+        void setPrefix(std::string prefix) {
+            _prefix = std::move(prefix);
+        }
+        //! Return the last \p n bytes of the last block again from the next call to next().
+        void unread(size_t n) {
+            _pending = _block + _blockSize - n;
+            _pendingSize = n;
+        }
+        //! Return the \p size bytes at \p data, which are not copied and must stay valid
+        //! while they are read, before any more input (as if given back with unread()).
+        void setSpan(const char* data, size_t size) {
+            _pending = data;
+            _pendingSize = size;
+        }
+        //! Set \p data and \p size to the next block of input, valid until the next call.
+        //! \return false at end of input.
+        bool next(const char*& data, size_t& size);
+
+        //! Bytes of input after the ones returned so far if the source is seekable (or a
+        //! regular file), 0 if unknown.
+        size_t getRemaining();
+        //! Bytes read from the source so far (the prefix excluded).
+        size_t getBytesRead() const {
+            return _bytesRead;
+        }
+        //! Seconds next() spent waiting for the source: the whole time of each read without a
+        //! queue, and only the time the queue ran dry with one.
+        double getStallSeconds() const {
+            return _stallSeconds;
+        }
+        //! How blocks are read ahead, known once the first block was read.
+        ReadAhead getReadAhead() const {
+            return _readAhead;
+        }
+        size_t getQueueDepth() const {
+            return _options.queueDepth;
+        }
+        //! Report each block read from the source to \p progress (not owned; may be nullptr).
+        void setProgress(ProgressReporter* progress) {
+            _progress = progress;
+        }
+    };
+
+    const char* readAheadName(BlockReader::ReadAhead readAhead);
+}
+
+#endif //SUMMARIZE_BLOCKREADER_HPP
@@ -0,0 +1,86 @@
+//
+// Column names of a table, laid out for tables with hundreds of thousands of columns: the
+// names are packed into a few large chunks of memory rather than one heap allocation each,
+// synthesized names ("COLUMN_12") are formatted straight into those chunks, and names are
+// looked up through a flat open addressing hash index instead of a tree of strings. A
+// column costs its name's bytes, a view of them and a slot or two of the index.
+//
+
+#ifndef SUMMARIZE_COLUMNNAMES_HPP
+#define SUMMARIZE_COLUMNNAMES_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+
+namespace summarize {
+
+    class ColumnNames {
+    public:
+        static const size_t npos = SIZE_MAX;
+    private:
+        //! Size of the chunks names are packed into; longer names get a chunk of their own.
+        static const size_t CHUNK_BYTES = 1u << 16;
+
+        std::vector<std::unique_ptr<char[]> > _chunks;
+        //! Bytes used and held by the last chunk.
+        size_t _chunkUsed;
+        size_t _chunkSize;
+        //! Bytes held by every chunk.
+        size_t _chunkBytes;
+        //! Each name, NUL terminated in a chunk.
+        std::vector<std::string_view> _names;
+        //! Open addressing (linear probing) index, a power of 2 of slots at most half full.
+        //! A slot holds a column + 1 (0 is empty): the first column with its name.
+        std::vector<uint32_t> _slots;
+        size_t _maxLength;
+
+        //! \p n bytes of chunk memory.
+        char* _allocate(size_t n);
+        //! Append the name of \p length bytes at \p text, in a chunk.
+        void _add(const char* text, size_t length);
+        //! Add column \p col to the index unless a column of the same name is there already.
+        void _index(size_t col);
+        void _rebuildIndex(size_t nSlots);
+    public:
+        ColumnNames();
+        ColumnNames(const ColumnNames& rhs);
+        ColumnNames& operator = (const ColumnNames& rhs);
+        ColumnNames(ColumnNames&&) = default;
+        ColumnNames& operator = (ColumnNames&&) = default;
+
+        size_t size() const {
+            return _names.size();
+        }
+        bool empty() const {
+            return _names.empty();
+        }
+        //! Name of column \p col, NUL terminated. Valid as long as the column is.
+        std::string_view operator [] (size_t col) const {
+            return _names[col];
+        }
+        std::string_view at(size_t col) const {
+            return _names.at(col);
+        }
+        void push_back(std::string_view name);
+        //! Append the name \p prefix followed by the decimal \p number.
+        void pushNumbered(std::string_view prefix, size_t number);
+        //! Keep only the first \p n columns (no effect if there are fewer).
+        void truncate(size_t n);
+        void clear();
+
+        //! First column named \p name, or npos.
+        size_t find(std::string_view name) const;
+        //! Length of the longest name.
+        size_t getMaxLength() const {
+            return _maxLength;
+        }
+        //! Bytes of memory held by the names, their views and the index.
+        size_t getMemoryBytes() const;
+    };
+}
+
+#endif //SUMMARIZE_COLUMNNAMES_HPP
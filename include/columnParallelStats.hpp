@@ -0,0 +1,61 @@
+//
+// Column parallel statistics for wide tables. With thousands of fields per record the
+// statistics, not the parsing, dominate a scan, and a pipeline of row batches would hold a
+// full set of per column statistics for every batch in flight. Instead records are
+// buffered until they hold a few hundred thousand fields, then the columns are split into
+// ranges and each worker updates the statistics of its range over every buffered record.
+// Each column still sees its values in input order, so the results are those of a serial
+// scan.
+//
+
+#ifndef SUMMARIZE_COLUMNPARALLELSTATS_HPP
+#define SUMMARIZE_COLUMNPARALLELSTATS_HPP
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include <columnStats.hpp>
+
+namespace summarize {
+
+    class Scheduler;
+
+    class ColumnParallelStats {
+    private:
+        //! Buffered fields that trigger an update.
+        static const size_t BATCH_FIELDS = 1u << 18;
+        //! Fewest columns a task updates, and ranges made per worker (to even out uneven
+        //! columns).
+        static const size_t MIN_RANGE_COLUMNS = 256;
+        static const size_t RANGES_PER_WORKER = 4;
+
+        Scheduler& _scheduler;
+        std::vector<ColumnStats>& _stats;
+        //! Buffered records; those past _nRecords are spare buffers.
+        std::vector<std::vector<std::string> > _records;
+        size_t _nRecords;
+        size_t _nFields;
+
+        //! Count the record in _records[_nRecords - 1], updating the statistics if the
+        //! buffer is full.
+        void _added();
+    public:
+        //! Update \p stats (not owned) with the tasks of \p scheduler (not owned).
+        ColumnParallelStats(Scheduler& scheduler, std::vector<ColumnStats>& stats);
+        ~ColumnParallelStats();
+        ColumnParallelStats(const ColumnParallelStats&) = delete;
+        ColumnParallelStats& operator = (const ColumnParallelStats&) = delete;
+
+        //! Add a copy of \p record.
+        void add(const std::vector<std::string>& record);
+        //! Add \p record by swapping it with a spare buffer: \p record is left with the
+        //! fields of an earlier record, ready to be parsed into again.
+        void take(std::vector<std::string>& record);
+        //! Update the statistics with every buffered record. Called before the statistics
+        //! are read.
+        void flush();
+    };
+}
+
+#endif //SUMMARIZE_COLUMNPARALLELSTATS_HPP
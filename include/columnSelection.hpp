@@ -0,0 +1,86 @@
+//
+// Column projection (--columns). A selection is a comma separated list of items, each
+// a column name, a 1 based index range ("3", "5-8" or "10-" for the rest) or a /regex/
+// searched for in the names. It is resolved against the names of an input into the input
+// columns to read, in the order asked for; the parser then only copies those fields and
+// skips the others.
+//
+
+#ifndef SUMMARIZE_COLUMNSELECTION_HPP
+#define SUMMARIZE_COLUMNSELECTION_HPP
+
+#include <string>
+#include <vector>
+#include <regex>
+#include <cstddef>
+#include <cstdint>
+
+#include <columnNames.hpp>
+
+namespace summarize {
+
+    class ColumnSelection {
+    private:
+        struct Item {
+            //! As given, to match a column name or to report it.
+            std::string text;
+            bool isRange = false;
+            //! 0 based and inclusive; SIZE_MAX for an open end.
+            size_t first = 0;
+            size_t last = 0;
+            bool isRegex = false;
+            std::regex regex;
+        };
+        //! Option the items were given by, for error messages.
+        std::string _option;
+        std::vector<Item> _items;
+        //! Input columns, in output order.
+        std::vector<size_t> _columns;
+        //! Output position + 1 of each input column up to the last selected one, 0 for the
+        //! columns skipped.
+        std::vector<uint32_t> _slots;
+
+        //! Parse the range "N", "N-M" or "N-" into \p item. \return false if \p text is not one.
+        static bool _parseRange(const std::string& text, Item& item);
+        void _select(size_t col);
+    public:
+        //! Parse \p spec, printing an error for an invalid regex or range.
+        bool parse(const std::string& spec, const std::string& option = "--columns");
+        //! True unless parse was given items: every column is read.
+        bool empty() const {
+            return _items.empty();
+        }
+        //! Resolve the items against \p names, the names of the first record (or made up
+        //! ones for input without a header). A name that is not a column can still be a
+        //! range. Columns selected twice are read once, at the first position. Ranges stop
+        //! at the last of \p names. Prints an error and returns false if an item
+        //! names no column or nothing is selected.
+        bool resolve(const ColumnNames& names);
+        bool isResolved() const {
+            return !_columns.empty();
+        }
+        //! Number of columns read.
+        size_t size() const {
+            return _columns.size();
+        }
+        const std::vector<size_t>& getColumns() const {
+            return _columns;
+        }
+        //! Output position + 1 of input column \p col, or 0 if it is skipped.
+        size_t slot(size_t col) const {
+            return col < _slots.size() ? _slots[col] : 0;
+        }
+        //! Also read input column \p col, after the columns selected if it is not one.
+        //! \return its position in a parsed record.
+        size_t add(size_t col) {
+            _select(col);
+            return _slots[col] - 1;
+        }
+        //! The last input column read: every field after it is skipped.
+        size_t getLastColumn() const {
+            return _slots.size() - 1;
+        }
+    };
+}
+
+#endif //SUMMARIZE_COLUMNSELECTION_HPP
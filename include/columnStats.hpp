@@ -0,0 +1,89 @@
+//
+// Streaming per-column statistics and type inference. One ColumnStats accumulates
+// every value of a column without retaining it; partial accumulators can be merged.
+//
+
+#ifndef SUMMARIZE_COLUMNSTATS_HPP
+#define SUMMARIZE_COLUMNSTATS_HPP
+
+#include <string>
+#include <string_view>
+#include <limits>
+
+namespace summarize {
+
+    class ColumnStats {
+    public:
+        //! Inferred column data types.
+        enum TYPE {
+            STRING, INT, BOOL, FLOAT, Last, First = STRING
+        };
+        static std::string typeToString(TYPE type);
+        //! True if \p value is a missing value: empty, "NA", "null" or "NULL".
+        static bool isMissing(std::string_view value);
+        //! Most specific type \p value parses as (BOOL, INT, FLOAT or STRING).
+        //! \p number is set to the numeric value for INT and FLOAT.
+        static TYPE classify(std::string_view value, double& number);
+    private:
+        size_t _count;
+        size_t _missing;
+        //! Number of non-missing values that parsed as each TYPE.
+        size_t _typeCounts[Last];
+        size_t _maxLength;
+
+        // numeric values (INT and FLOAT), Welford's running mean and sum of squares
+        size_t _nNumeric;
+        double _min;
+        double _max;
+        double _mean;
+        double _m2;
+    public:
+        ColumnStats() {
+            clear();
+        }
+        void clear();
+
+        void add(std::string_view value);
+        //! Count \p n values absent from short (ragged) records.
+        void addMissing(size_t n = 1) {
+            _count += n;
+            _missing += n;
+        }
+        //! Combine the values accumulated by \p rhs into this.
+        void merge(const ColumnStats& rhs);
+
+        //! Total values seen, including missing ones.
+        size_t getCount() const {
+            return _count;
+        }
+        size_t getMissing() const {
+            return _missing;
+        }
+        size_t getMaxLength() const {
+            return _maxLength;
+        }
+        size_t getNNumeric() const {
+            return _nNumeric;
+        }
+        double getMin() const {
+            return _nNumeric ? _min : std::numeric_limits<double>::quiet_NaN();
+        }
+        double getMax() const {
+            return _nNumeric ? _max : std::numeric_limits<double>::quiet_NaN();
+        }
+        double getMean() const {
+            return _nNumeric ? _mean : std::numeric_limits<double>::quiet_NaN();
+        }
+        //! Sample standard deviation of the numeric values.
+        double getSd() const;
+        //! Most specific type every non-missing value parses as.
+        TYPE getType() const;
+
+        //! Space separated representation of the full accumulator state (see ScanCache).
+        std::string serialize() const;
+        //! Restore the state written by serialize(). \return false if \p str is malformed.
+        bool deserialize(const std::string& str);
+    };
+}
+
+#endif //SUMMARIZE_COLUMNSTATS_HPP
@@ -0,0 +1,83 @@
+//
+// Follow mode: keep the summaries of files that are still being appended to up to date,
+// like tail -f. Each file is parsed once in full, then only the bytes appended since the
+// last line terminated record are parsed (see TsvFile::readMore). Waits on inotify where
+// available and falls back to polling file sizes every refresh interval.
+//
+
+#ifndef SUMMARIZE_FOLLOW_HPP
+#define SUMMARIZE_FOLLOW_HPP
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+#include <tsvFile.hpp>
+
+namespace summarize {
+
+    class Follower {
+    public:
+        //! Configure a fresh TsvFile for \p path before it is first read.
+        typedef std::function<void(const std::string& path, TsvFile& file)> SetupFunction;
+        //! Print the current state of \p file.
+        typedef std::function<void(const std::string& path, const TsvFile& file)> PrintFunction;
+    private:
+        struct Entry {
+            std::string path;
+            TsvFile file;
+            //! True once the file has been read successfully.
+            bool read = false;
+            uint64_t device = 0;
+            uint64_t inode = 0;
+            //! File size when last read.
+            uint64_t size = 0;
+            //! inotify watch descriptor, or -1.
+            int wd = -1;
+        };
+        std::vector<Entry> _entries;
+        SetupFunction _setup;
+        bool _hasHeader;
+        //! inotify instance, or -1 when polling.
+        int _inotifyFd;
+        //! Refresh interval in milliseconds.
+        int _intervalMs;
+
+        void _watch(Entry& entry);
+        //! Bring \p entry up to date with its file. \return true if anything was parsed.
+        bool _update(Entry& entry);
+        //! Block until a watched file changes or \p timeoutMs elapses.
+        void _wait(int timeoutMs);
+    public:
+        //! Files are read with \p hasHeader after being configured by \p setup. Printing
+        //! happens at most every \p intervalMs milliseconds.
+        Follower(SetupFunction setup, bool hasHeader = true, int intervalMs = 1000, bool useInotify = true);
+        ~Follower();
+        Follower(const Follower&) = delete;
+        Follower& operator = (const Follower&) = delete;
+
+        void addFile(const std::string& path);
+        //! True if changes are detected with inotify rather than by polling.
+        bool usesInotify() const {
+            return _inotifyFd >= 0;
+        }
+        size_t getNFiles() const {
+            return _entries.size();
+        }
+        const TsvFile& getFile(size_t i) const {
+            return _entries.at(i).file;
+        }
+
+        //! Parse whatever was appended to each file since the last call. A file that was
+        //! truncated or replaced (e.g. by log rotation) is read again from the start.
+        //! \return true if any file changed.
+        bool update();
+        //! Update and print the files that changed, once per refresh interval, until
+        //! \p stop is set (e.g. from a SIGINT handler).
+        void run(const std::atomic<bool>& stop, const PrintFunction& print);
+    };
+}
+
+#endif //SUMMARIZE_FOLLOW_HPP
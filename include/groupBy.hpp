@@ -0,0 +1,196 @@
+//
+// Hash aggregation by key columns (--groupBy). Every data row is added to the group of
+// its key fields in a GroupTable: an open addressing table whose keys are kept in one
+// arena and whose groups each hold a row count and a ColumnStats per other column.
+// Pipelined reads aggregate each batch into a table of its own, merged in input order.
+// Once the groups exceed a memory limit they are written to PARTITIONS spill files by
+// hash, and the table is emptied; the partitions are then merged one at a time, so each
+// group is whole in exactly one of them.
+//
+
+#ifndef SUMMARIZE_GROUPBY_HPP
+#define SUMMARIZE_GROUPBY_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <ostream>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+
+#include <columnStats.hpp>
+#include <columnNames.hpp>
+#include <columnSelection.hpp>
+
+namespace summarize {
+
+    //! Groups of rows by key, in the order their keys were first seen.
+    class GroupTable {
+    private:
+        struct Slot {
+            uint64_t hash;
+            uint32_t group;
+        };
+        static const uint32_t EMPTY = UINT32_MAX;
+
+        //! Statistics per group.
+        size_t _nValues;
+        //! Power of two, at most half full.
+        std::vector<Slot> _slots;
+        //! Keys of every group back to back, the key of group g ending at _keyEnds[g].
+        std::string _keys;
+        std::vector<size_t> _keyEnds;
+        std::vector<uint64_t> _hashes;
+        std::vector<size_t> _counts;
+        //! _nValues statistics per group.
+        std::vector<ColumnStats> _stats;
+        //! Reused by add and read.
+        std::string _key;
+        std::vector<ColumnStats> _spilled;
+
+        //! The group of \p key, added if it is new.
+        size_t _find(std::string_view key, uint64_t hash);
+        void _grow();
+        void _mergeGroup(std::string_view key, uint64_t hash, size_t count, const ColumnStats* stats);
+    public:
+        explicit GroupTable(size_t nValues = 0) {
+            _nValues = nValues;
+        }
+
+        //! Remove every group, and hold \p nValues statistics per group from now on.
+        void reset(size_t nValues);
+        //! Remove every group, keeping the memory.
+        void clear();
+        //! Number of groups.
+        size_t size() const {
+            return _counts.size();
+        }
+        size_t getNValues() const {
+            return _nValues;
+        }
+        //! Approximate bytes held by the groups.
+        size_t getBytes() const {
+            return size() * (2 * sizeof(Slot) + sizeof(size_t) * 3 + _nValues * sizeof(ColumnStats)) + _keys.size();
+        }
+
+        //! Add \p record to the group of its fields \p keys, and its fields \p values (one
+        //! per statistic; fields past the end of \p record are missing) to the statistics
+        //! of the group.
+        void add(const std::vector<std::string>& record, const std::vector<size_t>& keys,
+                 const std::vector<size_t>& values);
+        //! Add every group of \p other, which holds as many statistics per group.
+        void merge(const GroupTable& other);
+
+        //! The key of \p group: each key field as a 32 bit length and its bytes (see splitKey).
+        std::string_view getKey(size_t group) const {
+            size_t begin = group ? _keyEnds[group - 1] : 0;
+            return std::string_view(_keys).substr(begin, _keyEnds[group] - begin);
+        }
+        uint64_t getHash(size_t group) const {
+            return _hashes[group];
+        }
+        //! Rows of \p group.
+        size_t getCount(size_t group) const {
+            return _counts[group];
+        }
+        //! The getNValues() statistics of \p group.
+        const ColumnStats* getStats(size_t group) const {
+            return _stats.data() + group * _nValues;
+        }
+        //! Split \p key into its fields.
+        static void splitKey(std::string_view key, std::vector<std::string_view>& fields);
+
+        //! Append \p group to \p file. \return false if it could not be written.
+        bool write(size_t group, std::FILE* file) const;
+        //! Add the next group written to \p file. \return false at its end or on an error.
+        bool read(std::FILE* file);
+    };
+
+    class GroupBy {
+    public:
+        //! Spill files, and the default memory limit of the groups.
+        static const size_t PARTITIONS = 16;
+        static const size_t DEFAULT_MEMORY_LIMIT = size_t(1) << 30;
+    private:
+        ColumnSelection _keys;
+        size_t _memoryLimit;
+        //! Fields of a record read as key and as statistics (see setFields).
+        std::vector<size_t> _keyFields;
+        std::vector<size_t> _valueFields;
+        GroupTable _table;
+        //! Spill files, created by the first spill.
+        std::vector<std::FILE*> _partitions;
+        size_t _nSpills;
+        //! A spill file could not be written: groups were lost.
+        bool _failed;
+
+        //! Write the groups of _table to the partitions and empty it.
+        void _spill();
+        void _closePartitions();
+        //! Write a line per group of \p table, with the means of the statistics \p means.
+        void _writeGroups(std::ostream& out, const GroupTable& table, const std::vector<size_t>& means) const;
+    public:
+        GroupBy() {
+            _memoryLimit = DEFAULT_MEMORY_LIMIT;
+            _nSpills = 0;
+            _failed = false;
+        }
+        ~GroupBy() {
+            _closePartitions();
+        }
+        GroupBy(const GroupBy&) = delete;
+        GroupBy& operator=(const GroupBy&) = delete;
+
+        //! Parse the key columns \p spec, a column selection (see ColumnSelection).
+        bool parse(const std::string& spec);
+        //! Spill the groups once they hold about \p bytes.
+        void setMemoryLimit(size_t bytes) {
+            _memoryLimit = bytes;
+        }
+        //! Resolve the key columns against \p names. Prints an error and returns false if
+        //! one is unknown.
+        bool resolve(const ColumnNames& names);
+        //! Input columns of the keys, after resolve.
+        const std::vector<size_t>& getKeyColumns() const {
+            return _keys.getColumns();
+        }
+        //! Group records by their fields \p keyFields, with statistics of \p valueFields,
+        //! dropping any groups so far.
+        void setFields(const std::vector<size_t>& keyFields, const std::vector<size_t>& valueFields);
+        const std::vector<size_t>& getKeyFields() const {
+            return _keyFields;
+        }
+        const std::vector<size_t>& getValueFields() const {
+            return _valueFields;
+        }
+
+        //! Add a data row.
+        void add(const std::vector<std::string>& record) {
+            _table.add(record, _keyFields, _valueFields);
+            if(_table.getBytes() > _memoryLimit) _spill();
+        }
+        //! Add a data row to the partial groups \p table, for a parse task (see merge).
+        void addTo(GroupTable& table, const std::vector<std::string>& record) const {
+            table.add(record, _keyFields, _valueFields);
+        }
+        //! Empty \p table to hold partial groups.
+        void resetPartial(GroupTable& table) const {
+            table.reset(_valueFields.size());
+        }
+        //! Add the partial groups \p table of the rows after those added so far.
+        void merge(const GroupTable& table);
+        //! Times the groups were spilled.
+        size_t getNSpills() const {
+            return _nSpills;
+        }
+
+        //! Write the groups as tab separated lines: the key fields, the row count and the
+        //! mean of each value field whose type in \p types is numeric, after a line of
+        //! column names from \p names. In order of first appearance unless the groups were
+        //! spilled, which are then consumed. \return false if groups were lost.
+        bool write(std::ostream& out, const ColumnNames& names, const std::vector<ColumnStats::TYPE>& types);
+    };
+}
+
+#endif //SUMMARIZE_GROUPBY_HPP
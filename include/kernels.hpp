@@ -0,0 +1,84 @@
+//
+// Byte scanning kernels with runtime CPU dispatch. Each kernel has a scalar version and
+// SSE4.2, AVX2 and AVX-512BW versions compiled with function target attributes, so one
+// binary built without -march flags uses the widest instruction set the host supports.
+// The level is picked from cpuid on first use and can be forced lower for testing, with
+// setSimdLevel or the SUMMARIZE_SIMD environment variable (scalar, sse4.2, avx2, avx512bw).
+//
+
+#ifndef SUMMARIZE_KERNELS_HPP
+#define SUMMARIZE_KERNELS_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace summarize {
+
+    enum class SimdLevel {
+        SCALAR, SSE42, AVX2, AVX512BW
+    };
+
+    //! Most candidate bytes histogramRecords counts.
+    const size_t MAX_HISTOGRAM_CANDIDATES = 16;
+
+    //! Candidate byte counts per record, as built by histogramRecords.
+    struct RecordHistogram {
+        //! The candidate counts of each record, one after the other.
+        std::vector<uint32_t> counts;
+        //! Offset of the first byte of each record, and of its line terminator (or the end
+        //! of the input).
+        std::vector<size_t> starts;
+        std::vector<size_t> ends;
+    };
+
+    //! Kernels of one SimdLevel.
+    struct Kernels {
+        //! First byte in [p, end) equal to \p a, \p b or \p c, or \p end.
+        const char* (*findAny)(const char* p, const char* end, char a, char b, char c);
+        //! Number of bytes in [p, end) equal to \p c.
+        size_t (*countByte)(const char* p, const char* end, char c);
+        //! Number of leading ASCII digits in [p, end).
+        size_t (*digitSpan)(const char* p, const char* end);
+        //! Append to \p out the counts of the \p n bytes of \p candidates outside of \p quote
+        //! quoted fields in each record of [p, p + len). Records end at \n or \r outside
+        //! quotes and blank ones are skipped; a last record without a line terminator is only
+        //! added if \p complete.
+        void (*histogramRecords)(const char* p, size_t len, const char* candidates, size_t n, char quote,
+                                 bool complete, RecordHistogram& out);
+    };
+
+    namespace detail {
+        //! Kernels in use. Starts as a table that resolves the level on its first call.
+        extern std::atomic<const Kernels*> activeKernels;
+    }
+
+    //! Best level supported by both the build and the CPU.
+    SimdLevel detectSimdLevel();
+    //! Use the kernels of \p level, or of detectSimdLevel() if the CPU lacks \p level.
+    //! \return the level now in use.
+    SimdLevel setSimdLevel(SimdLevel level);
+    SimdLevel getSimdLevel();
+    const char* simdLevelName(SimdLevel level);
+    //! Parse a name returned by simdLevelName. \return false if \p name is not one.
+    bool parseSimdLevel(const std::string& name, SimdLevel& level);
+
+    inline const char* findAny(const char* p, const char* end, char a, char b, char c) {
+        return detail::activeKernels.load(std::memory_order_relaxed)->findAny(p, end, a, b, c);
+    }
+    inline size_t countByte(const char* p, const char* end, char c) {
+        return detail::activeKernels.load(std::memory_order_relaxed)->countByte(p, end, c);
+    }
+    inline size_t digitSpan(const char* p, const char* end) {
+        return detail::activeKernels.load(std::memory_order_relaxed)->digitSpan(p, end);
+    }
+    inline void histogramRecords(const char* p, size_t len, const char* candidates, size_t n, char quote,
+                                 bool complete, RecordHistogram& out) {
+        detail::activeKernels.load(std::memory_order_relaxed)->histogramRecords(p, len, candidates, n, quote,
+                                                                                 complete, out);
+    }
+}
+
+#endif //SUMMARIZE_KERNELS_HPP
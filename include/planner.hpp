@@ -0,0 +1,162 @@
+//
+// Execution planner. Before an input is read, the planner looks at what is known about it
+// (whether it is a file or a stream, its size, how much of it is in the page cache, whether
+// it is compressed or Parquet, and what output was asked for) and picks how to read it:
+// the read ahead of the BlockReader and, for Parquet, whether only the footer is needed.
+// Once the sample is sniffed it picks how to parse: serially or as a pipeline (see
+// TsvFile::setScheduler), with column parallel statistics for wide tables, and on how many
+// workers, from the record width, field count and quote density of the sample.
+//
+// The choices minimize the time estimated by a cost model whose constants were fitted to
+// timed scans (see CostModel). Options given explicitly on the command line always win
+// over the plan. --explain prints the plan and its estimates.
+//
+
+#ifndef SUMMARIZE_PLANNER_HPP
+#define SUMMARIZE_PLANNER_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include <blockReader.hpp>
+
+namespace summarize {
+
+    //! What is known about an input before it is read.
+    struct InputFacts {
+        //! Empty for stdin.
+        std::string path;
+        //! A regular file, so its size is known and it can be seeked.
+        bool regularFile = false;
+        //! Bytes in the input, 0 if unknown.
+        size_t size = 0;
+        //! Fraction of the file's pages in the page cache, negative if unknown.
+        double cachedFraction = -1;
+        //! Compression format recognized from the first bytes ("gzip", "zstd", ...), empty
+        //! for none.
+        std::string compression;
+        bool parquet = false;
+        //! Statistics over every row were asked for (-m summary), not just the structure.
+        bool stats = false;
+        //! How the records are read when not all of them are needed in order (e.g. "first
+        //! 100 records", "tail"), empty for a full scan.
+        std::string partial;
+    };
+
+    //! What the sniffed sample of an input looks like.
+    struct SampleFacts {
+        size_t bytes = 0;
+        size_t records = 0;
+        size_t fields = 0;
+        size_t quotes = 0;
+        //! The dialect reads quotes (Quoting::RFC4180).
+        bool quoting = true;
+
+        double bytesPerRecord() const;
+        double fieldsPerRecord() const;
+        double quotesPerKiB() const;
+    };
+
+    //! Count the records, fields and quotes in \p sample, parsed with \p delim and \p quote.
+    SampleFacts describeSample(const std::string& sample, char delim, char quote, bool quoting);
+
+    //! Find the facts about \p path that can be had without reading it (stat, the first
+    //! bytes and the page cache residency). \return false if it can not be opened.
+    bool probeInput(const std::string& path, InputFacts& facts);
+
+    //! Costs of the steps of a scan. The defaults were fitted to timed Release builds
+    //! reading 90 MB of numeric TSV and 57 MB of quoted CSV, with and without statistics,
+    //! from the page cache.
+    struct CostModel {
+        //! Splitting records into fields and counting them, per byte.
+        double parseNsPerByte = 3.0;
+        //! Extra cost of each quote character (state changes the fast path cannot skip).
+        double parseNsPerQuote = 7.0;
+        //! Updating the statistics of one field.
+        double statsNsPerField = 45.0;
+        //! Finding record boundaries for the pipeline, per byte, and merging a record's
+        //! results (preview, index, progress) in input order.
+        double splitNsPerByte = 0.4;
+        double mergeNsPerRecord = 2.0;
+        //! Handing a batch to a worker and waiting for it.
+        double batchSeconds = 10e-6;
+        //! Starting one worker thread.
+        double threadStartSeconds = 50e-6;
+        //! Reading from the page cache and from the device, per byte.
+        double cachedReadNsPerByte = 0.15;
+        double coldReadNsPerByte = 2.0;
+    };
+
+    //! How one input is read and parsed.
+    struct ExecutionPlan {
+        enum class Engine {
+            //! Rows read one at a time on the calling thread.
+            SERIAL,
+            //! Records split into batches parsed by several workers (TsvFile::_scanPipeline).
+            PIPELINE,
+            //! Rows parsed on the calling thread, the statistics of ranges of columns updated
+            //! by several workers (ColumnParallelStats), for wide tables.
+            COLUMN_PARALLEL,
+            //! Parquet footer and first batch only (row count and schema from metadata).
+            PARQUET_METADATA,
+            //! Parquet, every batch read for statistics.
+            PARQUET_SCAN
+        };
+
+        InputFacts input;
+        //! Sniffed sample, once known.
+        SampleFacts sample;
+        bool sampled = false;
+        Engine engine = Engine::SERIAL;
+        //! Workers of a pipeline.
+        size_t threads = 1;
+        BlockReaderOptions io;
+        //! Estimated seconds of a serial scan and of the best parallel one, a pipeline or
+        //! column parallel statistics (negative if not considered).
+        double serialSeconds = -1;
+        double parallelSeconds = -1;
+        //! Why the input is read this way, and why the engine was chosen.
+        std::vector<std::string> notes;
+        std::string engineReason;
+
+        void print(std::ostream& out = std::cerr) const;
+    };
+
+    const char* engineName(ExecutionPlan::Engine engine);
+
+    class Planner {
+    private:
+        CostModel _model;
+        //! Cores the process may use.
+        size_t _cores;
+
+        //! Seconds to parse \p bytes shaped like \p sample, with statistics if \p stats.
+        double _parseSeconds(double bytes, const SampleFacts& sample, bool stats) const;
+        double _readSeconds(double bytes, const InputFacts& input) const;
+        //! Estimate a serial scan and the best pipeline on at most \p threads workers and
+        //! _cores cores.
+        void _estimate(ExecutionPlan& plan, const SampleFacts& sample, size_t threads) const;
+    public:
+        explicit Planner(size_t cores, const CostModel& model = CostModel());
+
+        const CostModel& getModel() const {
+            return _model;
+        }
+        size_t getCores() const {
+            return _cores;
+        }
+
+        //! Number of worker threads worth starting for \p inputs, given there are \p inputs
+        //! to read in parallel and each may run as a pipeline. 1 means none.
+        size_t planThreads(const std::vector<InputFacts>& inputs) const;
+        //! Plan the reading of \p input before anything of it is read, on at most \p threads
+        //! workers. Assumes a typical sample until refine() is given the real one.
+        ExecutionPlan plan(const InputFacts& input, size_t threads) const;
+        //! Revise the engine of \p plan once the sample was sniffed.
+        void refine(ExecutionPlan& plan, const SampleFacts& sample, size_t threads) const;
+    };
+}
+
+#endif //SUMMARIZE_PLANNER_HPP
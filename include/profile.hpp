@@ -0,0 +1,83 @@
+//
+// Lightweight per-phase profiling of a scan: wall time and heap traffic (when the
+// allocation counting hooks are compiled in) for each named phase. Reported by --profile.
+//
+
+#ifndef SUMMARIZE_PROFILE_HPP
+#define SUMMARIZE_PROFILE_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <allocCounter.hpp>
+
+namespace summarize {
+
+    class Profile {
+    public:
+        struct Phase {
+            std::string name;
+            double seconds;
+            alloc::Counts allocs;
+        };
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        std::vector<Phase> _phases;
+        //! Number of records parsed, used to report per record costs.
+        size_t _records;
+        //! Seconds the scan waited for input (negative if not measured), and how the input
+        //! was read ahead.
+        double _stallSeconds;
+        std::string _readAhead;
+        //! How the scan ran as a pipeline (see TsvFile::setScheduler), empty if it did not.
+        std::string _pipeline;
+        bool _running;
+        std::string _current;
+        Clock::time_point _start;
+        alloc::Counts _startAllocs;
+    public:
+        Profile() {
+            _records = 0;
+            _stallSeconds = -1;
+            _running = false;
+        }
+
+        //! Begin timing phase \p name, ending the running phase (if any) first.
+        void start(const std::string& name);
+        //! End the running phase and record it.
+        void stop();
+        void setRecords(size_t records) {
+            _records = records;
+        }
+        size_t getRecords() const {
+            return _records;
+        }
+        //! Record the time reads stalled the scan, with a description of the read ahead.
+        void setReadStall(double seconds, const std::string& readAhead) {
+            _stallSeconds = seconds;
+            _readAhead = readAhead;
+        }
+        double getStallSeconds() const {
+            return _stallSeconds;
+        }
+        //! Describe how a pipelined scan ran: its workers and batches.
+        void setPipeline(const std::string& pipeline) {
+            _pipeline = pipeline;
+        }
+        const std::string& getPipeline() const {
+            return _pipeline;
+        }
+        const std::vector<Phase>& getPhases() const {
+            return _phases;
+        }
+        //! The first recorded phase named \p name, or nullptr.
+        const Phase* getPhase(const std::string& name) const;
+
+        void print(std::ostream& out = std::cerr) const;
+    };
+}
+
+#endif //SUMMARIZE_PROFILE_HPP
@@ -0,0 +1,97 @@
+//
+// Progress reporting for long scans. Readers bump relaxed atomic counters once per
+// input buffer (and once per batch of records); a timer thread samples them and
+// redraws a status line on stderr, or prints periodic log lines when stderr is not a TTY.
+//
+
+#ifndef SUMMARIZE_PROGRESS_HPP
+#define SUMMARIZE_PROGRESS_HPP
+
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace summarize {
+
+    class ProgressReporter {
+    public:
+        enum STYLE {
+            AUTO, //! TTY if stderr is a terminal, LOG otherwise.
+            TTY,  //! Redraw a single status line in place.
+            LOG   //! Print a new line every log interval.
+        };
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        std::atomic<size_t> _bytes;
+        std::atomic<size_t> _records;
+        //! Sum of the sizes of all inputs, 0 if unknown (e.g. stdin).
+        size_t _totalBytes;
+        size_t _nInputs;
+        size_t _inputIndex;
+        std::string _label;
+
+        std::ostream& _out;
+        STYLE _style;
+        std::chrono::milliseconds _interval;
+        Clock::time_point _start;
+
+        std::thread _thread;
+        std::mutex _mutex;
+        std::condition_variable _wake;
+        bool _running;
+        bool _stopRequested;
+
+        void _run();
+        void _print(bool final);
+    public:
+        explicit ProgressReporter(std::ostream& out = std::cerr, STYLE style = AUTO);
+        ~ProgressReporter() {
+            stop();
+        }
+        ProgressReporter(const ProgressReporter&) = delete;
+        ProgressReporter& operator = (const ProgressReporter&) = delete;
+
+        //! Called by readers once per buffer.
+        void addBytes(size_t n) {
+            _bytes.fetch_add(n, std::memory_order_relaxed);
+        }
+        //! Called by readers once per batch of records.
+        void addRecords(size_t n) {
+            _records.fetch_add(n, std::memory_order_relaxed);
+        }
+        void setTotalBytes(size_t total) {
+            _totalBytes = total;
+        }
+        void setNInputs(size_t n) {
+            _nInputs = n;
+        }
+        //! Name the input currently being read (shown as "[i/n] label" in multi-file mode).
+        void setInput(const std::string& label);
+        size_t getBytes() const {
+            return _bytes.load(std::memory_order_relaxed);
+        }
+        size_t getRecords() const {
+            return _records.load(std::memory_order_relaxed);
+        }
+        STYLE getStyle() const {
+            return _style;
+        }
+
+        //! Start the timer thread.
+        void start();
+        //! Stop the timer thread and print a final status line.
+        void stop();
+
+        //! Format a status line, e.g. "1.5 GiB / 3.0 GiB (50.0%), 2000000 records, 1.2M rec/s, ETA 12s".
+        static std::string formatLine(size_t bytes, size_t totalBytes, size_t records, double seconds);
+        static std::string formatBytes(double bytes);
+        static std::string formatDuration(double seconds);
+    };
+}
+
+#endif //SUMMARIZE_PROGRESS_HPP
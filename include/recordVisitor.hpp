@@ -0,0 +1,180 @@
+//
+// Push style record parsing: visitRecords drives a sink with the fields of every record as
+// std::string_view, with the same dialect rules as CsvParser (RFC 4180 quoting, \n, \r and
+// \r\n line endings, blank lines skipped) but without building a std::vector<std::string>
+// per record. The sink is a template parameter, so its callbacks can be inlined into the
+// parse loop.
+//
+// Unquoted fields that lie within one input block are passed as views into the block. Only
+// quoted fields (which need "" and \r\n unescaped) and fields cut by a block boundary are
+// copied, into a single reused buffer.
+//
+
+#ifndef SUMMARIZE_RECORDVISITOR_HPP
+#define SUMMARIZE_RECORDVISITOR_HPP
+
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <blockReader.hpp>
+#include <kernels.hpp>
+
+namespace summarize {
+
+    //! Size of the blocks visitRecords reads from a streambuf.
+    const size_t VISIT_BLOCK_SIZE = 1u << 16;
+
+    //! Parse the records of the blocks of \p reader, calling for each record that is not
+    //! blank:
+    //!
+    //!     void sink.onRecordBegin();
+    //!     void sink.onField(std::string_view value);    // once per field, in order
+    //!     bool sink.onRecordEnd(bool terminated);       // false stops parsing
+    //!
+    //! \p value is only valid during the call. \p terminated is false for a final record
+    //! ended by EOF rather than a line terminator. After an early stop, the rest of the
+    //! block is given back to \p reader.
+    //! \return the number of records visited.
+    template <typename Sink>
+    size_t visitRecords(BlockReader& reader, char delim, Sink& sink) {
+        enum State { START_FIELD, UNQUOTED, QUOTED, QUOTE_IN_QUOTED } state = START_FIELD;
+        std::string pending;          // field text that could not be passed as a view
+        bool usePending = false;      // the current field is in pending, not the block
+        bool inRecord = false;
+        bool skipLf = false;          // the last character was a \r
+        size_t nRecords = 0;
+
+        const char* data;
+        size_t size;
+        while(reader.next(data, size)) {
+            size_t fieldStart = 0;
+            size_t i = 0;
+            // Fields, records and the end of a block, with the character at i consumed.
+            auto endField = [&](size_t end) {
+                if(usePending) sink.onField(std::string_view(pending));
+                else if(state == UNQUOTED) sink.onField(std::string_view(data + fieldStart, end - fieldStart));
+                else sink.onField(std::string_view());
+                pending.clear();
+                usePending = false;
+                state = START_FIELD;
+            };
+            auto beginRecord = [&]() {
+                if(!inRecord) {
+                    inRecord = true;
+                    sink.onRecordBegin();
+                }
+            };
+            bool stop = false;
+            while(i < size && !stop) {
+                char c = data[i];
+                if(skipLf) {
+                    skipLf = false;
+                    if(c == '\n') {
+                        i++;
+                        continue;
+                    }
+                }
+                switch(state) {
+                    case QUOTED: {
+                        // Everything is literal up to the next quote or \r.
+                        size_t j = static_cast<size_t>(findAny(data + i, data + size, '"', '\r', '\r') - data);
+                        pending.append(data + i, j - i);
+                        i = j;
+                        if(i == size) break;
+                        if(data[i] == '"') {
+                            state = QUOTE_IN_QUOTED;
+                        } else {
+                            pending += '\n';
+                            skipLf = true;
+                        }
+                        i++;
+                        break;
+                    }
+                    case QUOTE_IN_QUOTED:
+                        i++;
+                        if(c == '"') {
+                            pending += '"';       // doubled "" -> literal "
+                            state = QUOTED;
+                        } else if(c == delim) {
+                            endField(i);
+                        } else if(c == '\n' || c == '\r') {
+                            endField(i);
+                            skipLf = c == '\r';
+                            inRecord = false;
+                            nRecords++;
+                            stop = !sink.onRecordEnd(true);
+                        } else {
+                            pending += c;         // lenient: text after the closing quote
+                            state = UNQUOTED;
+                        }
+                        break;
+                    default: {
+                        if(state == START_FIELD && c == '"') {
+                            beginRecord();
+                            usePending = true;
+                            state = QUOTED;
+                            i++;
+                            break;
+                        }
+                        if(c == delim || c == '\n' || c == '\r') {
+                            i++;
+                            if(c != delim) {
+                                skipLf = c == '\r';
+                                if(!inRecord) break;      // blank line
+                                endField(i - 1);
+                                inRecord = false;
+                                nRecords++;
+                                stop = !sink.onRecordEnd(true);
+                                break;
+                            }
+                            beginRecord();
+                            endField(i - 1);
+                            break;
+                        }
+                        beginRecord();
+                        if(state == START_FIELD) {
+                            fieldStart = i;
+                            state = UNQUOTED;
+                        }
+                        // Scan to the end of the field.
+                        size_t j = static_cast<size_t>(findAny(data + i + 1, data + size, delim, '\n', '\r') - data);
+                        if(usePending) pending.append(data + i, j - i);
+                        i = j;
+                        break;
+                    }
+                }
+            }
+            if(stop) {
+                reader.unread(size - i);
+                return nRecords;
+            }
+            // Carry a field cut by the end of the block.
+            if(state == UNQUOTED && !usePending) {
+                pending.assign(data + fieldStart, size - fieldStart);
+                usePending = true;
+            }
+        }
+        if(inRecord) {
+            // A final record without a line terminator.
+            if(usePending) sink.onField(std::string_view(pending));
+            else sink.onField(std::string_view());
+            nRecords++;
+            sink.onRecordEnd(false);
+        }
+        return nRecords;
+    }
+
+    //! visitRecords over the records of \p prefix followed by the rest of \p sb (which may
+    //! be null). Blocks are read ahead of the record being visited, so after an early stop
+    //! \p sb is positioned past it.
+    template <typename Sink>
+    size_t visitRecords(std::string_view prefix, std::streambuf* sb, char delim, Sink& sink) {
+        BlockReader reader(sb, VISIT_BLOCK_SIZE);
+        reader.setPrefix(std::string(prefix));
+        return visitRecords(reader, delim, sink);
+    }
+}
+
+#endif //SUMMARIZE_RECORDVISITOR_HPP
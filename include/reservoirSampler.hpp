@@ -0,0 +1,49 @@
+//
+// Uniform reservoir sampling of a stream of unknown length with Li's Algorithm L: instead
+// of drawing a random number per item, it draws the number of items to skip before the
+// next one that enters the reservoir, so the expected number of draws is O(k log(n / k)).
+//
+
+#ifndef SUMMARIZE_RESERVOIRSAMPLER_HPP
+#define SUMMARIZE_RESERVOIRSAMPLER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+
+namespace summarize {
+
+    class ReservoirSampler {
+    private:
+        size_t _k;
+        //! Running maximum of the k smallest random keys drawn so far (Algorithm L's W).
+        double _w;
+        //! Index of the next item to enter the reservoir.
+        size_t _next;
+        std::mt19937_64 _rng;
+
+        //! Uniform in (0, 1].
+        double _random();
+        //! Draw the gap to the next item to enter the reservoir after item \p i.
+        void _skipFrom(size_t i);
+    public:
+        explicit ReservoirSampler(size_t k = 0, uint64_t seed = 0) {
+            reset(k, seed);
+        }
+        //! Start over with a reservoir of \p k items.
+        void reset(size_t k, uint64_t seed = 0);
+
+        size_t getK() const {
+            return _k;
+        }
+        //! True if item \p i (0 based) replaces an item of the full reservoir. Items
+        //! 0 .. k-1 fill the reservoir and are not reported here.
+        bool takes(size_t i) const {
+            return i == _next;
+        }
+        //! Reservoir slot for the item takes() accepted, and draw the next one.
+        size_t replace();
+    };
+}
+
+#endif //SUMMARIZE_RESERVOIRSAMPLER_HPP
@@ -0,0 +1,125 @@
+//
+// Row filter predicates (--where). An expression such as
+//
+//     status = FAILED AND latency > 500 AND NOT (host ^= 'test' OR region IS NULL)
+//
+// is parsed once into a flat program: one instruction per test of a field and a jump for
+// each AND and OR, so evaluation short circuits without recursion or a stack. A field is
+// converted to a number only by the first numeric test that reads it in a row, and the
+// evaluation allocates nothing.
+//
+// Grammar (keywords are case insensitive):
+//
+//     or         := and (("OR" | "||") and)*
+//     and        := not (("AND" | "&&") not)*
+//     not        := ("NOT" | "!") not | "(" or ")" | test
+//     test       := column op value | column "BETWEEN" value "AND" value
+//                 | column "IS" ["NOT"] "NULL"
+//     op         := "=" | "==" | "!=" | "<>" | "<" | "<=" | ">" | ">=" | "^=" (starts with)
+//     column     := name | `any name`
+//     value      := number | 'string' ('' for a quote) | bare word
+//
+// A value that parses as a number compares numerically, with fields that are not numbers
+// never matching; any other value compares as a string. Missing fields (see
+// ColumnStats::isMissing) only match IS NULL.
+//
+
+#ifndef SUMMARIZE_ROWFILTER_HPP
+#define SUMMARIZE_ROWFILTER_HPP
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+#include <columnNames.hpp>
+
+namespace summarize {
+
+    class RowFilter {
+    public:
+        //! Most columns an expression may read, and deepest nesting of NOT and parentheses.
+        static const size_t MAX_COLUMNS = 64;
+        static const size_t MAX_DEPTH = 64;
+    private:
+        enum class Compare : uint8_t { EQ, NE, LT, LE, GT, GE, PREFIX, BETWEEN, IS_NULL, NOT_NULL };
+        struct Test {
+            //! Index in _names of the column read.
+            size_t column = 0;
+            Compare compare = Compare::EQ;
+            bool numeric = false;
+            std::string text;
+            double number = 0;
+            //! Upper bound of BETWEEN, as text and number.
+            std::string highText;
+            double high = 0;
+        };
+        struct Op {
+            enum Code : uint8_t { TEST, NOT, JUMP_IF_FALSE, JUMP_IF_TRUE } code;
+            //! Test index, or jump target.
+            uint32_t arg;
+        };
+        std::string _expression;
+        std::vector<Test> _tests;
+        std::vector<Op> _program;
+        //! Columns read, as named in the expression, the input column of each once
+        //! resolved, and the index of each in a parsed record.
+        std::vector<std::string> _names;
+        std::vector<size_t> _columns;
+        std::vector<size_t> _fields;
+
+        // Parser state.
+        size_t _pos;
+        size_t _depth;
+        std::string _error;
+
+        void _skipSpace();
+        //! Consume \p word if it is next, as a whole word for a keyword.
+        bool _accept(std::string_view word);
+        bool _fail(const std::string& message);
+        bool _parseOr();
+        bool _parseAnd();
+        bool _parseNot();
+        bool _parseTest();
+        bool _parseColumn(size_t& column);
+        bool _parseValue(std::string& text, bool& numeric, double& number);
+        size_t _emit(Op::Code code, size_t arg = 0);
+        bool _test(const Test& test, const std::vector<std::string>& record,
+                   double* numbers, uint8_t* converted) const;
+    public:
+        RowFilter() {
+            _pos = 0;
+            _depth = 0;
+        }
+
+        //! Parse \p expression, printing an error with its position if it is invalid.
+        bool parse(const std::string& expression);
+        //! True once parse was given an expression.
+        bool isSet() const {
+            return !_program.empty();
+        }
+        const std::string& getExpression() const {
+            return _expression;
+        }
+        //! Resolve the columns read against \p names. Records are then read by column
+        //! index (see setFields). Prints an error and returns false for an unknown column.
+        bool resolve(const ColumnNames& names);
+        //! Input columns read, in the order of getNames (after resolve).
+        const std::vector<size_t>& getColumns() const {
+            return _columns;
+        }
+        const std::vector<std::string>& getNames() const {
+            return _names;
+        }
+        //! Read getColumns()[i] from field \p fields[i] of a record, as when the record is
+        //! projected. resolve reads them from their input column.
+        void setFields(const std::vector<size_t>& fields) {
+            _fields = fields;
+        }
+        //! Whether \p record matches. Fields past the end of \p record are missing.
+        bool matches(const std::vector<std::string>& record) const;
+    };
+}
+
+#endif //SUMMARIZE_ROWFILTER_HPP
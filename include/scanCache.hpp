@@ -0,0 +1,104 @@
+//
+// Persistent on-disk cache of scan results. Each input file gets one entry in the
+// cache directory holding everything a full scan produces (delimiter, header, row count,
+// preview, column statistics and record index), keyed by a fingerprint of the file so a
+// repeat invocation on an unchanged file answers without reading it.
+//
+
+#ifndef SUMMARIZE_SCANCACHE_HPP
+#define SUMMARIZE_SCANCACHE_HPP
+
+#include <string>
+#include <cstdint>
+
+#include <tsvFile.hpp>
+
+namespace summarize {
+
+    //! Identity of a file's contents: (device, inode, size, mtime) plus a hash of its
+    //! first and last few KiB, which catches rewrites that preserve size and mtime.
+    struct FileFingerprint {
+        uint64_t device = 0;
+        uint64_t inode = 0;
+        uint64_t size = 0;
+        int64_t mtimeNs = 0;
+        uint64_t contentHash = 0;
+
+        bool operator == (const FileFingerprint& rhs) const {
+            return device == rhs.device && inode == rhs.inode && size == rhs.size &&
+                   mtimeNs == rhs.mtimeNs && contentHash == rhs.contentHash;
+        }
+        bool operator != (const FileFingerprint& rhs) const {
+            return !(*this == rhs);
+        }
+        //! \return false if \p path can not be stat'ed or read.
+        static bool compute(const std::string& path, FileFingerprint& fp);
+        //! Hash of the first and last few KiB of the first \p size bytes of \p path. Equal to
+        //! the contentHash of an earlier fingerprint of size \p size if an append only file
+        //! has only grown since.
+        static uint64_t hashContent(const std::string& path, uint64_t size);
+    };
+
+    //! 64 bit FNV-1a hash of \p len bytes at \p data, continuing from \p hash.
+    uint64_t fnv1a(const char* data, size_t len, uint64_t hash = 14695981039346656037ull);
+
+    class ScanCache {
+    public:
+        //! Bumped whenever the entry layout changes; entries of other versions are ignored.
+        static const int FORMAT_VERSION;
+
+        //! The options of a read that change its result. Captured before reading, since
+        //! reading replaces a sniffed delimiter with the detected one.
+        struct Request {
+            bool hasHeader;
+            bool detectHeader;
+            bool sniff;
+            char delim;
+            Quoting quoting;
+            bool collectStats;
+            size_t previewRows;
+            size_t indexInterval;
+        };
+    private:
+        std::string _dir;
+        //! Allow entries of files that have grown since to be resumed.
+        bool _incremental;
+        bool _lastHit;
+        bool _lastGrown;
+
+        bool _load(const std::string& path, const FileFingerprint& fp, const Request& request,
+                   TsvFile& file);
+        bool _store(const std::string& path, const FileFingerprint& fp, const Request& request,
+                    const TsvFile& file) const;
+    public:
+        explicit ScanCache(std::string dir) : _dir(std::move(dir)) {
+            _incremental = false;
+            _lastHit = false;
+            _lastGrown = false;
+        }
+
+        //! When set, an entry for a file that has only been appended to since is resumed:
+        //! only the bytes after the last complete record it covers are parsed.
+        void setIncremental(bool incremental) {
+            _incremental = incremental;
+        }
+
+        //! Path of the entry for input \p path.
+        std::string entryPath(const std::string& path) const;
+
+        //! Fill \p file from the cache entry for \p path if it is valid for the file's current
+        //! contents and options; otherwise read the file and store a new entry.
+        //! \return false if the file could not be read.
+        bool read(const std::string& path, TsvFile& file, bool hasHeader = true);
+        //! True if the last call to read() was answered from the cache.
+        bool lastWasHit() const {
+            return _lastHit;
+        }
+        //! True if the last hit resumed an entry of a file that has grown since.
+        bool lastWasGrown() const {
+            return _lastGrown;
+        }
+    };
+}
+
+#endif //SUMMARIZE_SCANCACHE_HPP
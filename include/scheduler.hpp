@@ -0,0 +1,157 @@
+//
+// Work-stealing task scheduler shared by every parallel path (--threads). A fixed set of
+// worker threads each owns a deque of tasks: a worker runs the newest task of its own
+// deque first (so nested tasks run depth first, while their data is in cache) and, when
+// that is empty, steals the oldest task of another worker's deque. Tasks submitted from
+// outside the workers are dealt out in turn.
+//
+// A task may submit more tasks and wait for them. A worker that waits runs other tasks
+// meanwhile instead of blocking, so nested parallelism (e.g. the batches of one large
+// file among the tasks reading many small ones) shares the same workers and never needs
+// more threads than were asked for. Other threads block while they wait.
+//
+// Each worker counts the tasks it ran, how many of those it stole and the time it was
+// busy, reported by --profile.
+//
+
+#ifndef SUMMARIZE_SCHEDULER_HPP
+#define SUMMARIZE_SCHEDULER_HPP
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstddef>
+
+namespace summarize {
+
+    //! Waits of a thread polling for a condition: spins, then yields, then sleeps, so a
+    //! waiting thread costs little even when there are more threads than cores.
+    class SpinWait {
+    private:
+        size_t _rounds;
+    public:
+        SpinWait() {
+            _rounds = 0;
+        }
+        void wait() {
+            if(_rounds < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#endif
+            } else if(_rounds < 256) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+            _rounds++;
+        }
+    };
+
+    class Scheduler {
+    public:
+        typedef std::function<void()> Task;
+
+        //! Counters of one worker.
+        struct WorkerStats {
+            size_t tasks = 0;
+            //! Tasks taken from another worker's deque.
+            size_t stolen = 0;
+            //! Seconds spent running tasks (those run while waiting within a task included).
+            double busySeconds = 0;
+        };
+    private:
+        typedef std::chrono::steady_clock Clock;
+
+        struct Worker {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+            std::thread thread;
+            std::atomic<size_t> nTasks{0};
+            std::atomic<size_t> nStolen{0};
+            std::atomic<int64_t> busyNanoseconds{0};
+            //! Tasks running on the worker's stack; only the outermost one counts as busy time.
+            size_t depth = 0;
+        };
+
+        std::vector<std::unique_ptr<Worker> > _workers;
+        //! Tasks queued and not yet started, to let idle workers sleep.
+        std::atomic<size_t> _queued;
+        //! Next worker a task from outside the workers goes to.
+        std::atomic<size_t> _nextWorker;
+        //! Threads other than the workers blocked in waitUntil.
+        std::atomic<size_t> _externalWaiters;
+        bool _stop;
+        std::mutex _sleepMutex;
+        std::condition_variable _wake;
+        //! Notified when a task finishes while another thread waits.
+        std::condition_variable _taskDone;
+        Clock::time_point _start;
+
+        //! The worker the calling thread is, or -1.
+        int _self() const;
+        //! Take a task for the worker \p self (-1 for another thread): its newest own task,
+        //! or else the oldest task of another worker. \return false if there are none.
+        bool _take(int self, Task& task);
+        void _run(int self, Task& task);
+        void _workerLoop(int self);
+    public:
+        //! Start \p threads workers (at least one).
+        explicit Scheduler(size_t threads);
+        //! Runs every queued task before stopping the workers.
+        ~Scheduler();
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator = (const Scheduler&) = delete;
+
+        size_t getThreads() const {
+            return _workers.size();
+        }
+        //! Queue \p task: on the calling worker's own deque, or dealt to a worker.
+        void submit(Task task);
+        //! Run one queued task on the calling thread. \return false if there was none.
+        bool runPending();
+        //! Return once \p done() is true, running other tasks meanwhile if the calling thread
+        //! is a worker and blocking otherwise. \p done must become true through tasks.
+        void waitUntil(const std::function<bool()>& done);
+
+        std::vector<WorkerStats> getWorkerStats() const;
+        //! Print the utilization of each worker since the scheduler started.
+        void print(std::ostream& out = std::cerr) const;
+    };
+
+    //! Tasks that can be waited for together.
+    class TaskGroup {
+    private:
+        Scheduler& _scheduler;
+        std::atomic<size_t> _pending;
+    public:
+        explicit TaskGroup(Scheduler& scheduler) : _scheduler(scheduler) {
+            _pending = 0;
+        }
+        ~TaskGroup() {
+            wait();
+        }
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator = (const TaskGroup&) = delete;
+
+        void run(Scheduler::Task task) {
+            _pending.fetch_add(1, std::memory_order_relaxed);
+            _scheduler.submit([this, task = std::move(task)]() {
+                task();
+                _pending.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        //! Return once every task run so far has finished.
+        void wait() {
+            _scheduler.waitUntil([this]() { return _pending.load(std::memory_order_acquire) == 0; });
+        }
+    };
+}
+
+#endif //SUMMARIZE_SCHEDULER_HPP
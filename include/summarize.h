@@ -0,0 +1,115 @@
+/*
+ * C API of libsummarize: summarize a delimited text or parquet file, or a text buffer
+ * in memory, into a result object instead of printed output. Meant for programs that
+ * would otherwise run the summarize executable once per file and parse its output.
+ *
+ * Calls share no state, so any number of them may run concurrently on different
+ * threads. A result is immutable once returned and may be read from any thread.
+ * Warnings about malformed input are still written to stderr.
+ *
+ * Compatibility: functions and enum values are only ever added. New fields of
+ * summarize_options are appended at its end; the library reads only the first
+ * options->struct_size bytes, so programs built against an older header keep working.
+ */
+
+#ifndef SUMMARIZE_H
+#define SUMMARIZE_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SUMMARIZE_API_VERSION 1
+
+/* Return codes. */
+typedef enum {
+    SUMMARIZE_OK = 0,
+    SUMMARIZE_ERROR_ARGUMENT = 1,       /* a NULL or otherwise invalid argument */
+    SUMMARIZE_ERROR_OPEN = 2,           /* the file could not be opened */
+    SUMMARIZE_ERROR_READ = 3,           /* the input is empty or could not be parsed */
+    SUMMARIZE_ERROR_UNSUPPORTED = 4,    /* parquet input in a build without parquet support */
+    SUMMARIZE_ERROR_INTERNAL = 5        /* out of memory or another unexpected failure */
+} summarize_status;
+
+/* Inferred column types; the same order as summarize::ColumnStats::TYPE. */
+typedef enum {
+    SUMMARIZE_STRING = 0,
+    SUMMARIZE_INT = 1,
+    SUMMARIZE_BOOL = 2,
+    SUMMARIZE_FLOAT = 3
+} summarize_type;
+
+typedef struct {
+    /* sizeof(summarize_options) of the caller; set by summarize_options_init. */
+    size_t struct_size;
+    /* Treat the first record as the header. Default 1. */
+    int has_header;
+    /* Field delimiter, or 0 to infer it from the content (the default). */
+    char delim;
+    /* Number of leading data rows kept for summarize_preview_value. Default 1. */
+    size_t preview_rows;
+    /* Accumulate per column statistics over every row. Default 1. */
+    int collect_stats;
+    /* Stop reading after this many milliseconds and return partial results, or 0 for no
+     * limit (the default). See summarize_is_partial. */
+    double time_budget_ms;
+} summarize_options;
+
+/* Opaque result of a successful call. */
+typedef struct summarize_result summarize_result;
+
+typedef struct {
+    size_t count;           /* values, including missing ones */
+    size_t missing;
+    size_t max_length;
+    size_t n_numeric;       /* values that parsed as numbers */
+    double min;             /* NaN if n_numeric is 0, like mean and sd */
+    double max;
+    double mean;
+    double sd;
+} summarize_column_stats;
+
+/* Library version, SUMMARIZE_API_VERSION of the build. */
+int summarize_api_version(void);
+/* Static description of a summarize_status. */
+const char* summarize_status_string(int status);
+
+void summarize_options_init(summarize_options* options);
+
+/* Summarize the file at path. Files with a .parquet or .pq extension are read as parquet.
+ * options may be NULL for the defaults. On success *result must be released with
+ * summarize_result_free; on failure it is set to NULL. */
+int summarize_path(const char* path, const summarize_options* options, summarize_result** result);
+/* Summarize size bytes of delimited text at data. The buffer is not copied and only needs
+ * to stay valid during the call. */
+int summarize_buffer(const void* data, size_t size, const summarize_options* options,
+                     summarize_result** result);
+void summarize_result_free(summarize_result* result);
+
+size_t summarize_n_rows(const summarize_result* result);
+/* 0 if summarize_n_rows is an estimate (a partial read). */
+int summarize_n_rows_exact(const summarize_result* result);
+/* 1 if the time budget ran out, so the statistics cover only part of the rows. */
+int summarize_is_partial(const summarize_result* result);
+size_t summarize_n_cols(const summarize_result* result);
+/* The delimiter used, or 0 for parquet input. */
+char summarize_delim(const summarize_result* result);
+
+/* Column names are valid until the result is freed, as are preview values. Out of range
+ * indices return NULL. */
+const char* summarize_header(const summarize_result* result, size_t col);
+summarize_type summarize_column_type(const summarize_result* result, size_t col);
+/* Fill stats for column col. Returns SUMMARIZE_ERROR_ARGUMENT for an out of range column or
+ * when statistics were not collected. */
+int summarize_get_column_stats(const summarize_result* result, size_t col, summarize_column_stats* stats);
+
+size_t summarize_n_preview_rows(const summarize_result* result);
+const char* summarize_preview_value(const summarize_result* result, size_t col, size_t row);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SUMMARIZE_H */
@@ -7,11 +7,30 @@
 
 #include <iostream>
 #include <vector>
-#include <map>
+#include <stdexcept>
+#include <cstdint>
+#include <chrono>
+
+#include <profile.hpp>
+#include <progress.hpp>
+#include <columnStats.hpp>
+#include <reservoirSampler.hpp>
+#include <blockReader.hpp>
+#include <recordVisitor.hpp>
+#include <kernels.hpp>
+#include <columnNames.hpp>
+#include <columnSelection.hpp>
+#include <rowFilter.hpp>
+#include <groupBy.hpp>
+#include <planner.hpp>
 
 namespace summarize {
 
-    size_t maxLength(std::vector<std::string>);
+    class ScanCache;
+    class Scheduler;
+    struct PipelineBatch;
+
+    size_t maxLength(const std::vector<std::string>&);
 
     //! Default delimiter inferred from a file extension: ',' for .csv, '\t' otherwise.
     char delimFromExtension(const std::string& path);
@@ -23,10 +42,48 @@ namespace summarize {
     //! quoted). On success sets \p delim to the directive's character and \p bytesToStrip
     //! to the number of leading bytes (including the line terminator) to drop.
     bool detectSepDirective(const std::string& sample, char& delim, size_t& bytesToStrip);
-    //! Infer the field delimiter from \p sample by frequency analysis, counting only
-    //! candidate delimiters outside of quoted fields. \p sampleComplete is true when
-    //! \p sample is the entire input (so its last record is complete). Returns \p fallback
-    //! when no delimiter appears consistently.
+    //! Append \p value to \p out as a field of a \p delim separated record: quoted with
+    //! \p quote (doubling any \p quote in it) if it holds \p delim, \p quote or a line
+    //! terminator.
+    void appendField(std::string& out, std::string_view value, char delim, char quote = '"');
+
+    //! Dialect of a delimited text input, as inferred by sniffDialect.
+    struct Dialect {
+        char delim = '\t';
+        //! Quote character of quoted fields: '"', or '\'' for single quoted input.
+        char quote = '"';
+        //! Prefix of the comment lines before the first record, 0 if there are none.
+        char commentPrefix = 0;
+        //! Leading bytes taken by those comment lines.
+        size_t commentBytes = 0;
+        //! Whether the first record looks like a header. True unless the first record has
+        //! the types of the rows below it.
+        bool hasHeader = true;
+        //! Typed columns whose first value is a string (votes for a header) minus those
+        //! whose first value has the column's type (votes against). 0 when no value of the
+        //! first record is typed, as then nothing can vote against a header.
+        int headerVotes = 0;
+        //! Fraction of records with the most common number of delimiters, 0 if the
+        //! delimiter is the fallback.
+        double consistency = 0;
+        //! Offsets at which the fields of a fixed-width record start, the first at 0; empty
+        //! for delimited input. The delimiter is then the fallback, used for output only.
+        std::vector<size_t> columnStarts;
+
+        bool isFixedWidth() const {
+            return !columnStarts.empty();
+        }
+    };
+
+    //! Infer the dialect of \p sample: the delimiter (by how consistently each candidate
+    //! occurs per record, outside of quoted fields), the quote character, leading '#'
+    //! comment lines and whether the first record is a header. \p sampleComplete is true
+    //! when \p sample is the entire input (so its last record is complete). The delimiter
+    //! is \p fallback when none appears consistently, or \p delim if it is not 0. When
+    //! none appears consistently and \p delim is 0, records whose characters line up in
+    //! columns, separated by positions that are a space in every record, are fixed-width.
+    Dialect sniffDialect(const std::string& sample, bool sampleComplete, char fallback, char delim = 0);
+    //! The delimiter of sniffDialect(\p sample, \p sampleComplete, \p fallback).
     char sniffDelimiter(const std::string& sample, bool sampleComplete, char fallback);
 
     template <typename T> size_t numDigits(T unsignedInteger) {
@@ -38,6 +95,36 @@ namespace summarize {
         return digits;
     }
 
+    //! A read only std::streambuf over a range of memory, to parse it without a copy.
+    class SpanStreamBuf : public std::streambuf {
+    public:
+        SpanStreamBuf(const char* data, size_t size) {
+            char* p = const_cast<char*>(data);
+            setg(p, p, p + size);
+        }
+    protected:
+        pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) override {
+            off_type base = dir == std::ios_base::beg ? 0 : (dir == std::ios_base::end ? egptr() - eback() : gptr() - eback());
+            return seekpos(pos_type(base + off), std::ios_base::in);
+        }
+        pos_type seekpos(pos_type pos, std::ios_base::openmode) override {
+            off_type off = pos;
+            if(off < 0 || off > egptr() - eback()) return pos_type(off_type(-1));
+            setg(eback(), eback() + off, egptr());
+            return pos;
+        }
+    };
+
+    //! Quoting rules of a dialect.
+    enum class Quoting {
+        //! RFC 4180: fields may be quoted, with "" for a literal quote.
+        RFC4180,
+        //! No quoting at all (IANA text/tab-separated-values): '"' is an ordinary character.
+        NONE
+    };
+
+    template <char DELIM, Quoting QUOTING> class DialectParser;
+
     //! Streaming RFC 4180 CSV/TSV record parser.
     //!
     //! Handles quoted fields, doubled "" quotes inside quoted fields, embedded
@@ -48,47 +135,469 @@ namespace summarize {
     private:
         std::streambuf* _sb;
         char _delim;
+        //! Bytes consumed from _sb so far.
+        size_t _pos;
+        //! Whether the last record read ended with a line terminator (rather than EOF).
+        bool _terminated;
 
-        int _get() { return _sb->sbumpc(); }
+        int _get() {
+            int c = _sb->sbumpc();
+            if(c != EOF) _pos++;
+            return c;
+        }
         int _peek() { return _sb->sgetc(); }
+        //! Element \p i of \p fields, cleared, appending it if needed. Existing elements
+        //! keep their capacity so steady state parsing does not allocate.
+        static std::string& _field(std::vector<std::string>& fields, size_t i) {
+            if(i == fields.size()) fields.emplace_back();
+            std::string& ret = fields[i];
+            ret.clear();
+            return ret;
+        }
+        template <char DELIM, Quoting QUOTING> friend class DialectParser;
     public:
-        CsvParser(std::istream& is, char delim) : _sb(is.rdbuf()), _delim(delim) {}
+        CsvParser(std::istream& is, char delim) : _sb(is.rdbuf()), _delim(delim) {
+            _pos = 0;
+            _terminated = true;
+        }
 
-        //! Read the next record into \p fields (cleared first).
+        //! Read the next record into \p fields (resized to the number of fields read).
+        //! Reuse the same vector across calls to avoid per record allocations.
         //! \return true if a record was read, false at end of input.
         bool nextRecord(std::vector<std::string>& fields);
+        //! Number of bytes consumed from the stream so far.
+        size_t getPosition() const {
+            return _pos;
+        }
+        //! False if the last record was ended by EOF rather than a line terminator, in
+        //! which case it may be incomplete (e.g. a file that is still being written).
+        bool lastTerminated() const {
+            return _terminated;
+        }
+    };
+
+    //! Size of the blocks DialectParser reads from a std::istream.
+    const size_t PARSE_BLOCK_SIZE = 1u << 16;
+
+    //! CsvParser specialized at compile time for the delimiter \p DELIM (0 for the one
+    //! passed to the constructor) and the quoting rules \p QUOTING; the records it reads are
+    //! the same as those of a CsvParser of that dialect. Unquoted text is scanned for the
+    //! next delimiter or line terminator and appended in runs rather than per character.
+    //!
+    //! Unlike CsvParser, it parses the blocks of a BlockReader in place, so the input is
+    //! left past the last record read; getPosition() is still the end of that record.
+    //! Given a ColumnSelection, it only copies the selected fields: the others are scanned
+    //! past, and the rest of a record after the last selected field only for quotes and
+    //! line terminators.
+    //! Instantiated in tsvFile.cpp for tab, comma, semicolon and pipe, and 0, with either
+    //! quoting.
+    template <char DELIM, Quoting QUOTING>
+    class DialectParser {
+    private:
+        //! Reader of a std::istream the parser was constructed with.
+        BlockReader _streamReader;
+        BlockReader& _reader;
+        char _delim;
+        char _quote;
+        //! The current block.
+        const char* _begin;
+        const char* _cur;
+        const char* _end;
+        //! Bytes consumed from _reader before the current block.
+        size_t _base;
+        bool _terminated;
+        //! Columns to read (see setSelection); nullptr for all of them.
+        const ColumnSelection* _selection;
+
+        //! Move to the next block, as the current one is exhausted. \return false at end
+        //! of input.
+        bool _fill();
+        //! Read the rest of a quoted field after its opening quote, up to and including the
+        //! closing quote (or the end of input).
+        void _readQuoted(std::string& field);
+        //! _readQuoted, without keeping the field.
+        void _skipQuoted();
+        //! Skip the rest of a record after a delimiter. \return false if it was ended by EOF.
+        bool _skipRecord();
+        //! nextRecord with _selection.
+        bool _nextSelected(std::vector<std::string>& fields);
+    public:
+        //! \p quote replaces '"' as the quote character (single quoted input uses '\'').
+        DialectParser(BlockReader& reader, char delim, char quote = '"')
+            : _reader(reader), _delim(DELIM ? DELIM : delim), _quote(quote) {
+            _begin = nullptr;
+            _cur = nullptr;
+            _end = nullptr;
+            _base = 0;
+            _terminated = true;
+            _selection = nullptr;
+        }
+        DialectParser(std::istream& is, char delim, char quote = '"')
+            : _streamReader(is.rdbuf(), PARSE_BLOCK_SIZE), _reader(_streamReader),
+              _delim(DELIM ? DELIM : delim), _quote(quote) {
+            _begin = nullptr;
+            _cur = nullptr;
+            _end = nullptr;
+            _base = 0;
+            _terminated = true;
+            _selection = nullptr;
+        }
+
+        //! Read only the columns of \p selection (not owned; nullptr for all), which must be
+        //! resolved: fields[i] is input column selection->getColumns()[i]. A record has
+        //! every selected field, those it is too short for empty, so it is only empty if
+        //! blank.
+        void setSelection(const ColumnSelection* selection) {
+            _selection = selection;
+        }
+        //! See CsvParser::nextRecord.
+        bool nextRecord(std::vector<std::string>& fields);
+        size_t getPosition() const {
+            return _base + static_cast<size_t>(_cur - _begin);
+        }
+        bool lastTerminated() const {
+            return _terminated;
+        }
+    };
+
+    //! Parser of fixed-width records (see Dialect::columnStarts): each line is cut into
+    //! fields at the column offsets and the spaces around each field are trimmed. Only line
+    //! terminators are searched for; the fields are sliced by offset. Every record has a
+    //! field per column, those past the end of its line empty, and a line of only spaces is
+    //! blank. There is no quoting. Reads the blocks of a BlockReader in place and takes a
+    //! ColumnSelection as DialectParser does.
+    class FixedWidthParser {
+    private:
+        BlockReader _streamReader;
+        BlockReader& _reader;
+        std::vector<size_t> _starts;
+        const char* _begin;
+        const char* _cur;
+        const char* _end;
+        size_t _base;
+        bool _terminated;
+        const ColumnSelection* _selection;
+        //! A line split across blocks, gathered to be sliced.
+        std::string _line;
+
+        bool _fill();
+        //! Slice the fields of the \p length bytes of \p line, without its terminator.
+        void _slice(const char* line, size_t length, std::vector<std::string>& fields) const;
+    public:
+        FixedWidthParser(BlockReader& reader, const std::vector<size_t>& columnStarts)
+            : _reader(reader), _starts(columnStarts) {
+            _begin = nullptr;
+            _cur = nullptr;
+            _end = nullptr;
+            _base = 0;
+            _terminated = true;
+            _selection = nullptr;
+        }
+        FixedWidthParser(std::istream& is, const std::vector<size_t>& columnStarts)
+            : _streamReader(is.rdbuf(), PARSE_BLOCK_SIZE), _reader(_streamReader), _starts(columnStarts) {
+            _begin = nullptr;
+            _cur = nullptr;
+            _end = nullptr;
+            _base = 0;
+            _terminated = true;
+            _selection = nullptr;
+        }
+
+        //! See DialectParser::setSelection.
+        void setSelection(const ColumnSelection* selection) {
+            _selection = selection;
+        }
+        //! See CsvParser::nextRecord.
+        bool nextRecord(std::vector<std::string>& fields);
+        size_t getPosition() const {
+            return _base + static_cast<size_t>(_cur - _begin);
+        }
+        bool lastTerminated() const {
+            return _terminated;
+        }
+    };
+
+    //! Input bytes a pipelined read (see TsvFile::setScheduler) hands to a parse task.
+    const size_t PIPELINE_BATCH_BYTES = 1u << 18;
+    //! Records with at least this many fields make a wide table, whose statistics are
+    //! updated column parallel (see ColumnParallelStats) rather than by a pipeline.
+    const size_t WIDE_TABLE_COLUMNS = 1024;
+
+    //! Limits of TsvFile::readApprox. Reading stops at whichever is reached first.
+    struct ApproxOptions {
+        //! Number of random blocks to read.
+        size_t maxBlocks = 64;
+        size_t blockSize = 1u << 16;
+        //! Wall time budget in seconds, checked after each block.
+        double maxSeconds = 1.0;
+        uint64_t seed = 0;
+    };
+
+    //! How the result of TsvFile::readApprox was estimated.
+    struct ApproxInfo {
+        bool valid = false;
+        //! Blocks read, and how many of those a record boundary was found in.
+        size_t blocks = 0;
+        size_t usableBlocks = 0;
+        size_t bytesRead = 0;
+        //! Complete records parsed from the blocks; the statistics are over these.
+        size_t sampledRows = 0;
+        //! 95% confidence interval of the row count.
+        double nRowsLow = 0;
+        double nRowsHigh = 0;
+    };
+
+    //! What a read stopped by its time budget (TsvFile::setTimeBudget) covered.
+    struct PartialInfo {
+        bool valid = false;
+        //! Data rows parsed before the deadline; the statistics cover only these.
+        size_t rows = 0;
+        //! Input bytes parsed, and the input size if known (0 otherwise).
+        size_t bytes = 0;
+        size_t totalBytes = 0;
     };
 
     class TsvFile {
     public:
-        enum TYPE {
-            STRING, INT, BOOL, FLOAT, Last, First = STRING
-        };
+        typedef ColumnStats::TYPE TYPE;
         std::string typeToString;
     private:
-        std::vector<std::string> _headers;
-        std::map<std::string, size_t> _headerMap;
-        std::vector<std::vector<std::string> > _data;
+        //! Per column state is held in parallel arrays (names, types, statistics), so a
+        //! table with hundreds of thousands of columns costs little per column.
+        ColumnNames _headers;
+        //! Preview values, row major: value \p col of preview row \p row is at
+        //! row * _headers.size() + col.
+        std::vector<std::string> _preview;
         std::vector<TYPE> _dataTypes;
-        //! Total number of data rows seen in the input (not the number retained in _data).
+        //! Total number of data rows seen in the input (not the number retained in _preview).
         size_t _nRows;
+        //! Fewest fields in any data row. Less than getNCols() when the input is ragged.
+        size_t _minFields;
+        //! True when _nRows is extrapolated from part of the input rather than counted.
+        bool _nRowsEstimated;
         //! Number of leading data rows to retain for the preview; the rest are only counted.
         size_t _previewRows;
         char _delim;
         //! When true, _read infers the delimiter from the content (using _delim as a fallback).
         bool _sniff;
+        //! Whether the first record of the last read was treated as the header.
+        bool _hasHeader;
+        //! Number of leading bytes (UTF-8 BOM and "sep=" directive) skipped before the first record.
+        size_t _dataOffset;
+        //! When true, _read accumulates _stats over every data row, not just the preview.
+        bool _collectStats;
+        //! Per column statistics over all data rows (only populated when _collectStats is set).
+        std::vector<ColumnStats> _stats;
+        //! Record the input offset of every _indexInterval'th data row (0 disables the index).
+        size_t _indexInterval;
+        //! Input offset of data rows 0, _indexInterval, 2 * _indexInterval, ... Each offset
+        //! is the start of a record, so parsing from there never begins inside quotes.
+        std::vector<size_t> _recordIndex;
+        //! Data row number of the first preview row (see seekPreview).
+        size_t _previewStart;
+        //! When true the preview is a uniform sample of all data rows instead of the first ones.
+        bool _sample;
+        uint64_t _sampleSeed;
+        //! Chooses the data rows that replace preview rows when _sample is set.
+        ReservoirSampler _sampler;
+        //! Set by readApprox.
+        ApproxInfo _approx;
+        //! Seconds a read may take, 0 for no limit.
+        double _timeBudget;
+        //! End of the time budget of the running read. Checked once per batch of records.
+        std::chrono::steady_clock::time_point _deadline;
+        //! Set when the last read stopped at _deadline.
+        PartialInfo _partial;
+        //! Quoting rules of the input (see setQuoting).
+        Quoting _quoting;
+        //! Dialect sniffed from the sample of the last read. Its quote character is used
+        //! by _scan.
+        Dialect _dialect;
+        //! When true, the first record is only a header if the sniffed dialect says so.
+        bool _detectHeader;
+        //! Scheduler full reads are parsed by; with more than one worker they run as a
+        //! pipeline (_scanPipeline). Not owned; may be nullptr.
+        Scheduler* _scheduler;
+        //! Bytes of whole records per batch of the pipeline.
+        size_t _batchBytes;
+        //! Planner that revises _plan once the sample is sniffed (see setPlanner). Not
+        //! owned; may be nullptr.
+        const Planner* _planner;
+        ExecutionPlan _plan;
+        //! Columns to read (see setSelection), resolved by each read.
+        ColumnSelection _selection;
+        //! Rows to keep (see setFilter), resolved by each read.
+        RowFilter _filter;
+        //! Fields of a parsed record the TsvFile keeps: fewer than the selection when it was
+        //! extended by columns only _filter reads. SIZE_MAX to keep them all.
+        size_t _keptColumns;
+        //! Data rows _filter rejected.
+        size_t _nFiltered;
+        //! Groups every data row is added to (see setGroupBy). Not owned; may be nullptr.
+        GroupBy* _groups;
 
-        bool _read(std::istream&, size_t, bool, bool = true);
-        //! Read a leading sample from \p is, strip a UTF-8 BOM and any Excel "sep="
-        //! directive, and (when _sniff is set) determine _delim from the content.
+        //! Input offset at which the parser of the current scan started.
+        size_t _scanBase;
+        //! Input offset just past the last line terminated record. A later scan of the same,
+        //! grown, input can resume here (see ScanCache).
+        size_t _resumeOffset;
+        //! State before an unterminated final record, which a resumed scan parses again.
+        struct TailState {
+            bool valid = false;
+            size_t nRows = 0;
+            size_t nCols = 0;
+            size_t nPreviewRows = 0;
+            size_t minFields = SIZE_MAX;
+            std::vector<ColumnStats> stats;
+            ReservoirSampler sampler;
+            //! Preview row the unterminated record replaced, and the row it replaced.
+            size_t sampleSlot = SIZE_MAX;
+            std::vector<std::string> sampleEvicted;
+        } _tail;
+        //! Time and heap traffic of each phase of the last read.
+        Profile _profile;
+        //! Optional progress counters, updated once per input buffer.
+        ProgressReporter* _progress;
+
+        bool _read(BlockReader&, size_t, bool, bool = true);
+        //! Parse up to \p maxRecords records from \p reader, adding data rows to _nRows and _stats.
+        //! If \p headerPending the first record is stored in \p header. Data rows are appended
+        //! to \p preview until it holds _previewRows rows. \return the number of records parsed.
+        size_t _scan(BlockReader& reader, size_t maxRecords, bool headerPending, std::vector<std::string>& header,
+                     std::vector<std::vector<std::string> >& preview, size_t& largestRow);
+        //! _scan with a parser specialized for the delimiter \p DELIM (see DialectParser).
+        template <char DELIM>
+        size_t _scanDialect(BlockReader& reader, size_t maxRecords, bool headerPending, std::vector<std::string>& header,
+                            std::vector<std::vector<std::string> >& preview, size_t& largestRow);
+        template <typename Parser>
+        size_t _scanRecords(Parser& parser, size_t maxRecords, bool headerPending, std::vector<std::string>& header,
+                            std::vector<std::vector<std::string> >& preview, size_t& largestRow);
+        //! _scan of every record as a pipeline: the calling thread splits the input into
+        //! batches, parsed by tasks of _scheduler, and merges their results in input order
+        //! (see pipeline.cpp).
+        size_t _scanPipeline(BlockReader& reader, bool headerPending, std::vector<std::string>& header,
+                             std::vector<std::vector<std::string> >& preview, size_t& largestRow);
+        //! Parse the records of \p batch into its preview rows, index entries and statistics.
+        //! Called by the parse tasks, so it only reads the TsvFile.
+        void _parseBatch(PipelineBatch& batch) const;
+        template <char DELIM>
+        void _parseBatchDialect(PipelineBatch& batch) const;
+        template <typename Parser>
+        void _parseBatchRecords(Parser& parser, PipelineBatch& batch) const;
+        //! Add the statistics \p partial of \p rows data rows after those in _stats.
+        void _mergeStats(const std::vector<ColumnStats>& partial, size_t rows);
+        //! Populate _headers (extending any existing ones), _headerMap, _data and _dataTypes.
+        void _build(const std::vector<std::string>& header,
+                    const std::vector<std::vector<std::string> >& preview, size_t largestRow);
+        //! Continue a scan from \p is, positioned at input offset \p offset. The state of an
+        //! unterminated final record of the previous scan is rolled back first.
+        bool _resume(std::istream& is, size_t offset);
+        //! Parse every record of \p reader, keeping the last \p n data rows in \p last
+        //! (oldest first). \return the number of data rows parsed.
+        size_t _scanLast(BlockReader& reader, size_t n, bool headerPending, std::vector<std::string>& header,
+                         std::vector<std::vector<std::string> >& last, size_t& largestRow);
+        template <typename Parser>
+        size_t _scanLastRecords(Parser& parser, size_t n, bool headerPending, std::vector<std::string>& header,
+                                std::vector<std::vector<std::string> >& last, size_t& largestRow);
+        //! Append up to _previewRows data rows from \p firstRow on to _preview, \p parser being
+        //! at data row \p row (or at the header if \p headerPending).
+        template <typename Parser>
+        void _previewRecords(Parser& parser, size_t row, size_t firstRow, bool headerPending);
+        //! Restore the state saved in _tail, dropping the unterminated record it precedes.
+        void _rollbackTail();
+        //! Take the options of \p other (those set by its setters), not the results of its reads.
+        void _copySettings(const TsvFile& other);
+        //! Print the "<rows> obs. of <cols> variables" line shared by the print functions.
+        void _printDimensions() const;
+        //! The columns [begin, end) of the page of at most \p maxColumns (0 for all) from
+        //! \p firstColumn on.
+        void _columnPage(size_t firstColumn, size_t maxColumns, size_t& begin, size_t& end) const;
+        //! Print "<col + 1>) <name>: <type>", aligned to the widest number and name of the page.
+        void _printColumnName(size_t col, size_t indexWidth, size_t nameWidth) const;
+        //! Say which columns a page that does not show all of them showed.
+        void _printPageEnd(size_t begin, size_t end) const;
+        //! Start the time budget of a read.
+        void _startDeadline() {
+            _partial = PartialInfo();
+            _deadline = _timeBudget > 0 ?
+                        std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                std::chrono::duration<double>(_timeBudget)) :
+                        std::chrono::steady_clock::time_point::max();
+        }
+        //! Read a leading sample from \p reader, strip a UTF-8 BOM, any Excel "sep="
+        //! directive and leading comment lines, sniff _dialect and (when _sniff is set)
+        //! take _delim from it. Bytes read past the sample are given back to \p reader.
         //! \p sample returns the leading bytes still to be parsed.
-        void _prepareInput(std::istream& is, std::string& sample);
+        void _prepareInput(BlockReader& reader, std::string& sample);
+        //! Apply setDetectHeader to the \p hasHeader of a read, after _prepareInput, and
+        //! store the result in _hasHeader.
+        bool _resolveHeader(bool hasHeader) {
+            _hasHeader = hasHeader && !(_detectHeader && !_dialect.hasHeader);
+            return _hasHeader;
+        }
+        //! Add a data record to \p stats, growing it for records wider than any seen so far.
+        static void _addToStats(std::vector<ColumnStats>& stats, const std::vector<std::string>& record);
+        //! Whether a serial scan whose first data row has \p width fields updates its
+        //! statistics column parallel: for wide tables, when there are workers and the plan
+        //! (if any) says so.
+        bool _columnParallel(size_t width) const;
+        //! Set _dataTypes from _stats, or from the preview rows when stats were not collected.
+        void _inferTypes();
+        //! Parse the first record of \p sample (which holds it whole) into \p record, in the
+        //! dialect of the input. \return the bytes it took, with its line terminator.
+        size_t _firstRecord(const std::string& sample, std::vector<std::string>& record) const;
+        //! Resolve _selection, the keys of _groups and _filter against the first record of
+        //! \p sample, after _resolveHeader. \return false (with an error printed) if the
+        //! selection selects nothing or any of them names an unknown column.
+        bool _resolveColumns(const std::string& sample);
+        //! Whether the non blank \p record is kept: the header, or a data row _filter
+        //! matches. A kept record is cut to _keptColumns fields.
+        bool _keepRecord(std::vector<std::string>& record, bool isHeader) const {
+            if(record.empty()) return false;
+            if(!_filter.isSet()) return true;
+            if(!isHeader && !_filter.matches(record)) return false;
+            if(record.size() > _keptColumns) record.resize(_keptColumns);
+            return true;
+        }
+        //! The selection parsers are given: nullptr to read every column.
+        const ColumnSelection* _selected() const {
+            return _selection.isResolved() ? &_selection : nullptr;
+        }
+        //! extract with a parser specialized for the delimiter \p DELIM.
+        template <char DELIM>
+        bool _extractDialect(BlockReader& reader, std::ostream& out);
+        template <typename Parser>
+        bool _extractRecords(Parser& parser, std::ostream& out);
+
+        friend class ScanCache;
     public:
         explicit TsvFile(char delim = '\t') {
             _delim = delim;
             _sniff = false;
+            _hasHeader = true;
+            _dataOffset = 0;
+            _collectStats = false;
+            _scanBase = 0;
+            _resumeOffset = 0;
             _nRows = 0;
+            _minFields = SIZE_MAX;
+            _nRowsEstimated = false;
+            _indexInterval = 0;
+            _previewStart = 0;
+            _sample = false;
+            _sampleSeed = 0;
+            _timeBudget = 0;
+            _quoting = Quoting::RFC4180;
+            _detectHeader = false;
+            _scheduler = nullptr;
+            _batchBytes = PIPELINE_BATCH_BYTES;
+            _planner = nullptr;
+            _keptColumns = SIZE_MAX;
+            _nFiltered = 0;
+            _groups = nullptr;
+            _deadline = std::chrono::steady_clock::time_point::max();
             _previewRows = 1;
+            _progress = nullptr;
         }
 
         //! Set the number of leading data rows to retain in memory for the preview.
@@ -96,10 +605,131 @@ namespace summarize {
             _previewRows = n;
         }
 
+        //! Keep a uniform random sample of setPreviewRows() rows from the whole input as the
+        //! preview (and for type inference without statistics), instead of the first rows.
+        //! The same \p seed gives the same sample.
+        void setSample(bool sample, uint64_t seed = 0) {
+            _sample = sample;
+            _sampleSeed = seed;
+        }
+        bool getSample() const {
+            return _sample;
+        }
+
+        //! Stop reading after \p seconds (checked between batches of records) and keep what
+        //! was read so far; see getPartialInfo. 0 (the default) means no limit.
+        void setTimeBudget(double seconds) {
+            _timeBudget = seconds;
+        }
+        //! Quoting rules of the input, RFC4180 by default. NONE (e.g. for IANA TSV) reads
+        //! quote characters as data and parses faster.
+        void setQuoting(Quoting quoting) {
+            _quoting = quoting;
+        }
+        Quoting getQuoting() const {
+            return _quoting;
+        }
+        //! Treat the first record as data, even when a read is asked for a header, if it
+        //! has the types of the rows below it (see sniffDialect).
+        void setDetectHeader(bool detect) {
+            _detectHeader = detect;
+        }
+        //! Parse full reads with the tasks of \p scheduler (not owned; nullptr for none). With
+        //! more than one worker, a read of every record (not a sampled or time limited one)
+        //! runs as a pipeline: the input is cut into batches of about \p batchBytes bytes of
+        //! whole records, parsed in parallel and merged in input order, so even a stream uses
+        //! several cores. Other reads of wide tables (see WIDE_TABLE_COLUMNS) update their
+        //! statistics column parallel. The results are those of a serial read.
+        void setScheduler(Scheduler* scheduler, size_t batchBytes = PIPELINE_BATCH_BYTES) {
+            _scheduler = scheduler;
+            _batchBytes = batchBytes < 1 ? 1 : batchBytes;
+        }
+        //! Follow \p plan, which \p planner (not owned; nullptr to always pipeline full reads
+        //! with more than one worker) revises from the sniffed sample: a full read runs as a
+        //! pipeline only if the plan says so, on at most the planned number of workers.
+        void setPlanner(const Planner* planner, const ExecutionPlan& plan) {
+            _planner = planner;
+            _plan = plan;
+        }
+        //! Read only the columns \p selection selects, resolved against the first record of
+        //! each read. The parser copies only their fields, and the TsvFile holds only those
+        //! columns, in the order selected. Applies to read, readMore, seekPreview and
+        //! extract, not to readTail, readApprox or readParquet.
+        void setSelection(const ColumnSelection& selection) {
+            _selection = selection;
+        }
+        const ColumnSelection& getSelection() const {
+            return _selection;
+        }
+        //! Count, preview and summarize only the data rows \p filter matches, its columns
+        //! resolved against the first record of each read. Applies to what setSelection
+        //! applies to; the filter may read columns the selection does not keep.
+        void setFilter(const RowFilter& filter) {
+            _filter = filter;
+        }
+        const RowFilter& getFilter() const {
+            return _filter;
+        }
+        //! Add every data row of read and readMore (those the filter matches) to \p groups,
+        //! its keys resolved against the first record of each read. Key columns are read
+        //! and kept even if the selection does not select them. Not owned; may be nullptr.
+        void setGroupBy(GroupBy* groups) {
+            _groups = groups;
+        }
+        //! Print the dimensions line and the groups of setGroupBy (see GroupBy::write).
+        //! \return false if groups were lost.
+        bool printGroups() const;
+        //! Data rows the filter rejected (getNRows() counts those it matched).
+        size_t getNFiltered() const {
+            return _nFiltered;
+        }
+        //! The plan of the last read, as revised from its sample.
+        const ExecutionPlan& getPlan() const {
+            return _plan;
+        }
+        //! Dialect sniffed by the last read.
+        const Dialect& getDialect() const {
+            return _dialect;
+        }
+        //! Whether the last read treated the first record as the header.
+        bool getHasHeader() const {
+            return _hasHeader;
+        }
+        //! Valid if the last read ran out of time.
+        const PartialInfo& getPartialInfo() const {
+            return _partial;
+        }
+
+        //! Accumulate statistics over every data row (needed by printSummary).
+        void setCollectStats(bool collect) {
+            _collectStats = collect;
+        }
+        bool getCollectStats() const {
+            return _collectStats;
+        }
+
+        //! Build a sparse index of the offset of every \p n'th data row while reading, so
+        //! seekPreview can start close to any row. 0 (the default) disables the index.
+        void setIndexInterval(size_t n) {
+            _indexInterval = n;
+        }
+        size_t getIndexInterval() const {
+            return _indexInterval;
+        }
+        const std::vector<size_t>& getRecordIndex() const {
+            return _recordIndex;
+        }
+
+        //! Report bytes and records read to \p progress (not owned; may be nullptr).
+        void setProgress(ProgressReporter* progress) {
+            _progress = progress;
+        }
+
         //! Set an explicit delimiter; disables content sniffing.
         void setDelim(char delim) {
             _delim = delim;
             _sniff = false;
+            _dialect.columnStarts.clear();
         }
         //! Infer the delimiter from the content when reading, falling back to \p fallback.
         void sniffDelim(char fallback) {
@@ -111,22 +741,114 @@ namespace summarize {
         }
         bool read(std::istream&, size_t, bool = true);
         bool read(std::istream&, bool = true);
+        //! Read from \p reader, e.g. a file opened with read(2) (see BlockReader::open).
+        bool read(BlockReader& reader, size_t, bool = true);
+        bool read(BlockReader& reader, bool = true);
+        //! Read the header and the last \p n data rows as the preview. A seekable \p is is
+        //! read backwards from the end in growing windows, so the cost does not depend on the
+        //! input size, and the row count is estimated unless the window reached the first
+        //! row. Other input is parsed in full, keeping a ring of the last \p n rows.
+        //! Statistics are not collected.
+        bool readTail(std::istream& is, size_t n, bool hasHeader = true);
+        //! Continue a complete read() of an input that has grown since. \p is must be
+        //! positioned at getResumeOffset(). Only the bytes from there on are parsed.
+        bool readMore(std::istream& is);
+        //! Push every record of \p is, the header included, to \p sink (see visitRecords)
+        //! after the same BOM, "sep=" and delimiter handling as read. Nothing is retained.
+        //! \return the number of records visited.
+        template <typename Sink>
+        size_t visit(std::istream& is, Sink& sink) {
+            BlockReader reader(is.rdbuf(), VISIT_BLOCK_SIZE);
+            std::string sample;
+            _prepareInput(reader, sample);
+            reader.setPrefix(std::move(sample));
+            return visitRecords(reader, _delim, sink);
+        }
+        //! Write the selected columns (see setSelection; all of them if none were) of every
+        //! record of \p reader, the header included, to \p out: delimited and quoted as the
+        //! input (fixed-width input delimited by getDelim()), after the same BOM, "sep=" and
+        //! delimiter handling as read. Nothing is retained but the count of data rows
+        //! (getNRows). \return false if the selection selects nothing or \p out fails.
+        bool extract(BlockReader& reader, std::ostream& out, bool hasHeader = true);
+        //! Replace the preview with up to setPreviewRows() data rows starting at row
+        //! \p firstRow (0 based), read from the same input as the last read(). Parsing starts
+        //! at the closest indexed row at or before \p firstRow, or at the first row without an
+        //! index. \p is must be seekable. \return false if \p firstRow is past the last row.
+        bool seekPreview(std::istream& is, size_t firstRow);
+        //! Data row number of the first preview row.
+        size_t getPreviewStart() const {
+            return _previewStart;
+        }
+        //! Input offset just past the last line terminated record read.
+        size_t getResumeOffset() const {
+            return _resumeOffset;
+        }
         //! Read column names, row count and a preview of the first getNPreviewRows()
         //! rows from the parquet file at \p path. Defined in parquetFile.cpp and only
         //! linked when the project is built with ENABLE_PARQUET.
         bool readParquet(const std::string& path);
+        //! Estimate the row count and column statistics of a large seekable input from
+        //! randomly placed blocks, within the limits of \p options. Defined in approx.cpp.
+        //! Falls back to a full read() for small or non-seekable input, and for input that is
+        //! not RFC 4180 with '"' quotes (unquoted, single quoted or fixed-width).
+        bool readApprox(std::istream& is, const ApproxOptions& options, bool hasHeader = true);
+        const ApproxInfo& getApproxInfo() const {
+            return _approx;
+        }
+
+        const Profile& getProfile() const {
+            return _profile;
+        }
 
-        void printSummary() const;
-        void printStructure(size_t nRows = 1) const;
+        //! Print the type and statistics of each column, or of the \p maxColumns (0 for
+        //! all) columns from \p firstColumn on, so very wide tables can be paged through.
+        void printSummary(size_t firstColumn = 0, size_t maxColumns = 0) const;
+        //! Print the type and \p nRows preview values of each column, or of a page of
+        //! columns as printSummary.
+        void printStructure(size_t nRows = 1, size_t firstColumn = 0, size_t maxColumns = 0) const;
         size_t getNRows() const {
             return _nRows;
         }
+        //! False if getNRows() is an estimate (see readTail).
+        bool isNRowsExact() const {
+            return !_nRowsEstimated;
+        }
         size_t getNCols() const {
             return _headers.size();
         }
+        //! Fewest fields in any data row, or SIZE_MAX if there are none.
+        size_t getMinFields() const {
+            return _minFields;
+        }
+        const ColumnNames& getHeaders() const {
+            return _headers;
+        }
+        //! First column named \p name, or ColumnNames::npos.
+        size_t getColumnIndex(std::string_view name) const {
+            return _headers.find(name);
+        }
+        //! Inferred type of column \p col.
+        TYPE getType(size_t col) const {
+            return _dataTypes.at(col);
+        }
+        //! Statistics of column \p col; empty unless collected with setCollectStats.
+        const ColumnStats& getStats(size_t col) const {
+            return _stats.at(col);
+        }
+        bool hasStats() const {
+            return !_stats.empty();
+        }
+        size_t getDataOffset() const {
+            return _dataOffset;
+        }
+        //! Preview value of column \p col in preview row \p row.
+        const std::string& getPreviewValue(size_t col, size_t row) const {
+            if(col >= _headers.size()) throw std::out_of_range("TsvFile::getPreviewValue");
+            return _preview.at(row * _headers.size() + col);
+        }
         //! Number of data rows actually retained in memory for the preview.
         size_t getNPreviewRows() const {
-            return _data.empty() ? 0 : _data.front().size();
+            return _headers.empty() ? 0 : _preview.size() / _headers.size();
         }
     };
 }
@@ -0,0 +1,98 @@
+//
+// Counting replacements for the global allocation functions. Only compiled in when
+// ENABLE_ALLOC_COUNTING is defined; the counters use relaxed atomics so the hooks are
+// safe (and cheap) to call from any thread.
+//
+
+#include <allocCounter.hpp>
+
+#ifdef ENABLE_ALLOC_COUNTING
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<size_t> allocationCount(0);
+    std::atomic<size_t> deallocationCount(0);
+    std::atomic<size_t> allocatedBytes(0);
+
+    void* countedAlloc(size_t size) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void* countedAlignedAlloc(size_t size, std::align_val_t align) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        size_t a = static_cast<size_t>(align);
+        // aligned_alloc requires the size to be a multiple of the alignment.
+        size_t rounded = ((size == 0 ? 1 : size) + a - 1) / a * a;
+        return std::aligned_alloc(a, rounded);
+    }
+
+    void countedFree(void* ptr) {
+        if(!ptr) return;
+        deallocationCount.fetch_add(1, std::memory_order_relaxed);
+        std::free(ptr);
+    }
+}
+
+void* operator new(size_t size) {
+    void* ptr = countedAlloc(size);
+    if(!ptr) throw std::bad_alloc();
+    return ptr;
+}
+void* operator new[](size_t size) {
+    void* ptr = countedAlloc(size);
+    if(!ptr) throw std::bad_alloc();
+    return ptr;
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return countedAlloc(size); }
+void* operator new(size_t size, std::align_val_t align) {
+    void* ptr = countedAlignedAlloc(size, align);
+    if(!ptr) throw std::bad_alloc();
+    return ptr;
+}
+void* operator new[](size_t size, std::align_val_t align) {
+    void* ptr = countedAlignedAlloc(size, align);
+    if(!ptr) throw std::bad_alloc();
+    return ptr;
+}
+
+void operator delete(void* ptr) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, const std::nothrow_t&) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, std::align_val_t) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, std::align_val_t) noexcept { countedFree(ptr); }
+void operator delete(void* ptr, size_t, std::align_val_t) noexcept { countedFree(ptr); }
+void operator delete[](void* ptr, size_t, std::align_val_t) noexcept { countedFree(ptr); }
+
+bool summarize::alloc::enabled() {
+    return true;
+}
+
+summarize::alloc::Counts summarize::alloc::snapshot() {
+    Counts ret;
+    ret.allocations = allocationCount.load(std::memory_order_relaxed);
+    ret.deallocations = deallocationCount.load(std::memory_order_relaxed);
+    ret.bytes = allocatedBytes.load(std::memory_order_relaxed);
+    return ret;
+}
+
+#else
+
+bool summarize::alloc::enabled() {
+    return false;
+}
+
+summarize::alloc::Counts summarize::alloc::snapshot() {
+    return Counts();
+}
+
+#endif
@@ -0,0 +1,226 @@
+//
+// Approximate summaries of large seekable inputs from randomly placed blocks
+// (TsvFile::readApprox).
+//
+// Each block is resynchronized to a record boundary: the first line terminator after the
+// block start for blocks without quote characters, otherwise the first terminator from
+// which the next few records parse with a plausible number of fields. A terminator inside
+// a quoted field almost never passes that check, since parsing it as unquoted text flips
+// the quote state of the rest of the field. The complete records after the boundary feed
+// the column statistics, and their count and length the row count estimate.
+//
+// The row count uses the ratio estimator of rows per byte over the blocks, with the usual
+// linearized standard error, scaled by the size of the data. Blocks are read in random
+// order, not file order, so stopping early at the time budget keeps the sample uniform.
+//
+
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+#include <tsvFile.hpp>
+
+namespace {
+    using summarize::SpanStreamBuf;
+
+    //! Line terminators tried per block before it is given up on.
+    const size_t RESYNC_CANDIDATES = 64;
+    //! Records that must parse with a plausible width to accept a boundary.
+    const size_t RESYNC_RECORDS = 4;
+    //! Inputs smaller than this many times the blocks to read are read in full instead.
+    const size_t FULL_READ_FACTOR = 2;
+    //! Normal quantile of the reported 95% confidence intervals.
+    const double Z_95 = 1.96;
+
+    //! True if the records of \p block from \p start have between \p minFields and
+    //! \p maxFields fields, for RESYNC_RECORDS records or up to the end of the block.
+    bool plausibleStart(const std::string& block, size_t start, char delim,
+                        size_t minFields, size_t maxFields) {
+        SpanStreamBuf buf(block.data() + start, block.size() - start);
+        std::istream in(&buf);
+        summarize::CsvParser parser(in, delim);
+        std::vector<std::string> record;
+        size_t checked = 0;
+        while(checked < RESYNC_RECORDS && parser.nextRecord(record)) {
+            if(record.empty()) continue;
+            if(!parser.lastTerminated()) break;       // cut by the end of the block
+            if(record.size() < minFields || record.size() > maxFields) return false;
+            checked++;
+        }
+        return checked > 0;
+    }
+
+    //! Offset of the first record start in \p block, which begins at an arbitrary byte of
+    //! the input. \return std::string::npos if none was found.
+    size_t resync(const std::string& block, char delim, size_t minFields, size_t maxFields) {
+        bool quoted = block.find('"') != std::string::npos;
+        size_t pos = 0;
+        for(size_t candidate = 0; candidate < RESYNC_CANDIDATES; candidate++) {
+            size_t nl = block.find_first_of("\n\r", pos);
+            if(nl == std::string::npos) return std::string::npos;
+            size_t start = nl + 1;
+            if(block[nl] == '\r' && start < block.size() && block[start] == '\n') start++;
+            // Without quotes in the block, no terminator in it can be inside a field.
+            if(!quoted || plausibleStart(block, start, delim, minFields, maxFields)) return start;
+            pos = start;
+        }
+        return std::string::npos;
+    }
+}
+
+bool summarize::TsvFile::readApprox(std::istream& is, const ApproxOptions& options, bool hasHeader) {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point begin = Clock::now();
+    _approx = ApproxInfo();
+
+    std::streambuf* sb = is.rdbuf();
+    std::streamoff end = sb->pubseekoff(0, std::ios::end, std::ios::in);
+    if(end < 0 || sb->pubseekpos(0, std::ios::in) != 0) {
+        std::cerr << "WARN: Approximate mode needs a seekable input; reading all of it." << std::endl;
+        return read(is, hasHeader);
+    }
+    size_t size = static_cast<size_t>(end);
+    size_t blockSize = std::max<size_t>(options.blockSize, 1);
+    if(options.maxBlocks < 2 || size <= FULL_READ_FACTOR * options.maxBlocks * blockSize)
+        return read(is, hasHeader);       // about as fast as sampling, and exact
+
+    _hasHeader = hasHeader;
+    _previewStart = 0;
+    bool collectStats = _collectStats;
+    _collectStats = true;
+    _tail = TailState();
+    BlockReader reader(sb);
+    std::string sample;
+    _profile.start("sniff");
+    _prepareInput(reader, sample);
+    if(_dialect.isFixedWidth() || _quoting == Quoting::NONE || _dialect.quote != '"') {
+        // Blocks are resynchronized and parsed as RFC 4180 records with '"' quotes: other
+        // dialects are read in full.
+        _profile.stop();
+        _collectStats = collectStats;
+        is.clear();
+        is.seekg(0);
+        return read(is, hasHeader);
+    }
+    hasHeader = _resolveHeader(hasHeader);
+
+    // The header and preview come from the head sample, which ends with a complete record.
+    std::vector<std::string> header;
+    std::vector<std::vector<std::string> > preview;
+    size_t dataStart = _dataOffset;
+    size_t headMin = SIZE_MAX, headMax = 0;
+    {
+        SpanStreamBuf buf(sample.data(), sample.size());
+        std::istream in(&buf);
+        CsvParser parser(in, _delim);
+        std::vector<std::string> record;
+        bool headerPending = hasHeader;
+        while(parser.nextRecord(record)) {
+            if(record.empty()) continue;
+            if(headerPending) {
+                header = record;
+                headerPending = false;
+                dataStart += parser.getPosition();
+                continue;
+            }
+            headMin = std::min(headMin, record.size());
+            headMax = std::max(headMax, record.size());
+            if(preview.size() < _previewRows) preview.push_back(record);
+        }
+    }
+    if(headMax == 0) {
+        headMin = header.size();
+        headMax = header.size();
+    }
+    size_t largestRow = std::max(headMax, header.size());
+    if(dataStart + blockSize >= size) {
+        // The head sample leaves no room to place a block after it.
+        _profile.stop();
+        _collectStats = collectStats;
+        is.clear();
+        is.seekg(0);
+        return read(is, hasHeader);
+    }
+
+    _profile.start("parse");
+    std::mt19937_64 rng(options.seed);
+    std::uniform_int_distribution<size_t> offsetDist(dataStart, size - blockSize);
+    std::vector<double> blockRows, blockBytes;
+    std::string block;
+    std::vector<std::string> record;
+    for(size_t b = 0; b < options.maxBlocks; b++) {
+        if(blockRows.size() >= 2 &&
+           std::chrono::duration<double>(Clock::now() - begin).count() >= options.maxSeconds)
+            break;
+        block.resize(blockSize);
+        sb->pubseekpos(static_cast<std::streamoff>(offsetDist(rng)), std::ios::in);
+        block.resize(static_cast<size_t>(sb->sgetn(&block[0], static_cast<std::streamsize>(blockSize))));
+        _approx.blocks++;
+        _approx.bytesRead += block.size();
+        if(_progress) _progress->addBytes(block.size());
+
+        size_t anchor = resync(block, _delim, headMin, headMax);
+        if(anchor == std::string::npos) continue;
+        SpanStreamBuf buf(block.data() + anchor, block.size() - anchor);
+        std::istream in(&buf);
+        CsvParser parser(in, _delim);
+        size_t rows = 0, bytes = 0;
+        while(parser.nextRecord(record)) {
+            if(!parser.lastTerminated()) break;       // continues past the block
+            bytes = parser.getPosition();
+            if(record.empty()) continue;              // blank lines are bytes but not rows
+            rows++;
+            largestRow = std::max(largestRow, record.size());
+            _minFields = std::min(_minFields, record.size());
+            _addToStats(_stats, record);
+        }
+        if(rows == 0) continue;
+        blockRows.push_back(static_cast<double>(rows));
+        blockBytes.push_back(static_cast<double>(bytes));
+        _approx.sampledRows += rows;
+    }
+    _approx.usableBlocks = blockRows.size();
+    if(blockRows.size() < 2) {
+        std::cerr << "WARN: Could not find record boundaries in the sampled blocks; reading all of the input."
+                  << std::endl;
+        _profile.stop();
+        _stats.clear();
+        _minFields = SIZE_MAX;
+        _collectStats = collectStats;
+        _approx = ApproxInfo();
+        is.clear();
+        is.seekg(0);
+        return read(is, hasHeader);
+    }
+
+    // Ratio estimate of rows per byte and its linearized standard error.
+    double m = static_cast<double>(blockRows.size());
+    double sumRows = 0, sumBytes = 0;
+    for(size_t i = 0; i < blockRows.size(); i++) {
+        sumRows += blockRows[i];
+        sumBytes += blockBytes[i];
+    }
+    double ratio = sumRows / sumBytes;
+    double ss = 0;
+    for(size_t i = 0; i < blockRows.size(); i++) {
+        double residual = blockRows[i] - ratio * blockBytes[i];
+        ss += residual * residual;
+    }
+    double meanBytes = sumBytes / m;
+    double seRatio = std::sqrt(ss / (m - 1) / m) / meanBytes;
+    double span = static_cast<double>(size - dataStart);
+    double nRows = span * ratio;
+    _nRows = static_cast<size_t>(std::llround(nRows));
+    _nRowsEstimated = true;
+    _approx.nRowsLow = std::max(0.0, nRows - Z_95 * span * seRatio);
+    _approx.nRowsHigh = nRows + Z_95 * span * seRatio;
+    _approx.valid = true;
+    _profile.setRecords(_approx.sampledRows);
+
+    _profile.start("build");
+    _build(header, preview, largestRow);
+    _profile.stop();
+    _collectStats = collectStats;
+    return true;
+}
@@ -0,0 +1,449 @@
+//
+// Block buffered input with read(2), posix_fadvise() and optional O_DIRECT, read ahead by
+// io_uring or a reader thread.
+//
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#endif
+
+#include <blockReader.hpp>
+
+namespace {
+    //! Alignment of the buffer, file offsets and read sizes O_DIRECT needs on common
+    //! filesystems.
+    const size_t DIRECT_ALIGNMENT = 4096;
+}
+
+namespace summarize {
+    namespace detail {
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+        //! A minimal io_uring over the raw system calls, so liburing is not a dependency:
+        //! one readv submission per block and a blocking wait for completions.
+        class Uring {
+        private:
+            int _fd = -1;
+            void* _sqRing = MAP_FAILED;
+            void* _cqRing = MAP_FAILED;
+            void* _sqes = MAP_FAILED;
+            size_t _sqRingSize = 0, _cqRingSize = 0, _sqesSize = 0;
+            unsigned* _sqTail = nullptr;
+            unsigned* _sqMask = nullptr;
+            unsigned* _sqArray = nullptr;
+            unsigned* _cqHead = nullptr;
+            unsigned* _cqTail = nullptr;
+            unsigned* _cqMask = nullptr;
+            io_uring_cqe* _cqes = nullptr;
+            //! The iovec of each request, which must live until it completes.
+            std::vector<iovec> _iovecs;
+        public:
+            ~Uring() {
+                if(_sqes != MAP_FAILED) munmap(_sqes, _sqesSize);
+                if(_cqRing != MAP_FAILED && _cqRing != _sqRing) munmap(_cqRing, _cqRingSize);
+                if(_sqRing != MAP_FAILED) munmap(_sqRing, _sqRingSize);
+                if(_fd >= 0) ::close(_fd);
+            }
+
+            //! Set up a ring of \p entries requests. \return false if the kernel has no io_uring
+            //! (or it is not allowed).
+            bool init(unsigned entries) {
+                io_uring_params params;
+                std::memset(&params, 0, sizeof(params));
+                _fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+                if(_fd < 0) return false;
+                _sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+                _cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+                bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+                if(singleMap) _sqRingSize = _cqRingSize = std::max(_sqRingSize, _cqRingSize);
+                _sqRing = mmap(nullptr, _sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                               _fd, IORING_OFF_SQ_RING);
+                if(_sqRing == MAP_FAILED) return false;
+                _cqRing = singleMap ? _sqRing : mmap(nullptr, _cqRingSize, PROT_READ | PROT_WRITE,
+                                                     MAP_SHARED | MAP_POPULATE, _fd, IORING_OFF_CQ_RING);
+                if(_cqRing == MAP_FAILED) return false;
+                _sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+                _sqes = mmap(nullptr, _sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                             _fd, IORING_OFF_SQES);
+                if(_sqes == MAP_FAILED) return false;
+
+                char* sq = static_cast<char*>(_sqRing);
+                _sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+                _sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+                _sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+                char* cq = static_cast<char*>(_cqRing);
+                _cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+                _cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+                _cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+                _cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+                _iovecs.resize(entries);
+                return true;
+            }
+
+            //! Read \p size bytes at \p offset of \p fd into \p buffer, completing with
+            //! \p request (< the number of entries). \return false if it was not submitted.
+            bool submitRead(int fd, char* buffer, size_t size, size_t offset, unsigned request) {
+                unsigned tail = *_sqTail;
+                unsigned index = tail & *_sqMask;
+                _iovecs[request].iov_base = buffer;
+                _iovecs[request].iov_len = size;
+                io_uring_sqe& sqe = static_cast<io_uring_sqe*>(_sqes)[index];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.opcode = IORING_OP_READV;
+                sqe.fd = fd;
+                sqe.addr = reinterpret_cast<uint64_t>(&_iovecs[request]);
+                sqe.len = 1;
+                sqe.off = offset;
+                sqe.user_data = request;
+                _sqArray[index] = index;
+                __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+                long ret;
+                do {
+                    ret = syscall(__NR_io_uring_enter, _fd, 1, 0, 0, nullptr, 0);
+                } while(ret < 0 && errno == EINTR);
+                return ret == 1;
+            }
+
+            //! Wait for a request to complete. \return false if waiting failed.
+            bool wait(unsigned& request, int& result) {
+                while(true) {
+                    unsigned head = *_cqHead;
+                    if(head != __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE)) {
+                        const io_uring_cqe& cqe = _cqes[head & *_cqMask];
+                        request = static_cast<unsigned>(cqe.user_data);
+                        result = cqe.res;
+                        __atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+                        return true;
+                    }
+                    long ret = syscall(__NR_io_uring_enter, _fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                    if(ret < 0 && errno != EINTR) return false;
+                }
+            }
+        };
+#else
+        //! Without io_uring, readers always fall back to a thread.
+        class Uring {
+        public:
+            bool init(unsigned) { return false; }
+            bool submitRead(int, char*, size_t, size_t, unsigned) { return false; }
+            bool wait(unsigned&, int&) { return false; }
+        };
+#endif
+    }
+}
+
+const char* summarize::readAheadName(BlockReader::ReadAhead readAhead) {
+    switch(readAhead) {
+        case BlockReader::ReadAhead::URING: return "io_uring";
+        case BlockReader::ReadAhead::THREAD: return "thread";
+        default: return "none";
+    }
+}
+
+summarize::BlockReader::BlockReader(std::streambuf* sb, size_t blockSize)
+    : BlockReader(sb, BlockReaderOptions()) {
+    _options.blockSize = blockSize;
+}
+
+summarize::BlockReader::BlockReader(std::streambuf* sb, const BlockReaderOptions& options) {
+    _sb = sb;
+    _fd = -1;
+    _options = options;
+    _buffers = nullptr;
+    _bufferSize = 0;
+    _current = 0;
+    _readAhead = ReadAhead::NONE;
+    _sourceDone = false;
+    _atEnd = false;
+    _submitOffset = 0;
+    _inFlight = 0;
+    _fillSlot = 0;
+    _stopThread = false;
+    _block = nullptr;
+    _blockSize = 0;
+    _pending = nullptr;
+    _pendingSize = 0;
+    _bytesRead = 0;
+    _stallSeconds = 0;
+    _progress = nullptr;
+}
+
+summarize::BlockReader::~BlockReader() {
+    _stop();
+    if(_fd >= 0) ::close(_fd);
+    std::free(_buffers);
+}
+
+bool summarize::BlockReader::open(const std::string& path, const BlockReaderOptions& options) {
+    if(_fd >= 0) ::close(_fd);
+    _sb = nullptr;
+    _path = path;
+    _options = options;
+    _fd = -1;
+#ifdef O_DIRECT
+    if(options.direct) {
+        _fd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+        if(_fd < 0 && errno == EINVAL) {
+            std::cerr << "WARN: O_DIRECT is not supported for " << path << "; using buffered reads." << std::endl;
+            _options.direct = false;
+        }
+    }
+#else
+    _options.direct = false;
+#endif
+    if(_fd < 0) _fd = ::open(path.c_str(), O_RDONLY);
+    if(_fd < 0) {
+        std::cerr << "ERROR: Could not open " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    if(!_options.direct && (_options.readAheadBlocks || _options.queueDepth))
+        ::posix_fadvise(_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    return true;
+}
+
+size_t summarize::BlockReader::_readInto(char* buffer, size_t size) {
+    if(_sb) {
+        std::streamsize got = _sb->sgetn(buffer, static_cast<std::streamsize>(size));
+        return got > 0 ? static_cast<size_t>(got) : 0;
+    }
+    while(true) {
+        ssize_t n = ::read(_fd, buffer, size);
+        if(n >= 0) return static_cast<size_t>(n);
+        if(errno == EINTR) continue;
+#ifdef O_DIRECT
+        if(errno == EINVAL && _options.direct) {
+            // The filesystem (or an unaligned final offset) refuses direct reads.
+            ::fcntl(_fd, F_SETFL, ::fcntl(_fd, F_GETFL) & ~O_DIRECT);
+            _options.direct = false;
+            continue;
+        }
+#endif
+        std::cerr << "ERROR: Could not read " << _path << ": " << std::strerror(errno) << std::endl;
+        return 0;
+    }
+}
+
+void summarize::BlockReader::_start() {
+    const size_t nSlots = _options.queueDepth + 1;
+    _bufferSize = std::max<size_t>(_options.blockSize, 1);
+    if(_fd >= 0) _bufferSize = (_bufferSize + DIRECT_ALIGNMENT - 1) / DIRECT_ALIGNMENT * DIRECT_ALIGNMENT;
+    if(posix_memalign(reinterpret_cast<void**>(&_buffers), DIRECT_ALIGNMENT, nSlots * _bufferSize) != 0) {
+        std::cerr << "ERROR: Could not allocate " << nSlots << " read buffers of " << _bufferSize << " bytes" << std::endl;
+        _buffers = nullptr;
+        return;
+    }
+    _slots.resize(nSlots);
+    for(size_t i = 0; i < nSlots; i++) _slots[i].data = _buffers + i * _bufferSize;
+    // The last slot stands for the block the consumer holds; the others are filled first.
+    _current = nSlots - 1;
+    _slots[_current].state = Slot::READY;
+    if(!_options.queueDepth) return;
+
+    struct stat st;
+    if(_fd >= 0 && _options.uring && ::fstat(_fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        _uring = std::make_unique<detail::Uring>();
+        off_t offset = ::lseek(_fd, 0, SEEK_CUR);
+        if(offset >= 0 && _uring->init(static_cast<unsigned>(nSlots))) {
+            _readAhead = ReadAhead::URING;
+            _submitOffset = static_cast<size_t>(offset);
+            for(size_t i = 0; i + 1 < nSlots; i++) _submit(i);
+            return;
+        }
+        _uring.reset();
+    }
+    _readAhead = ReadAhead::THREAD;
+    _thread = std::thread(&BlockReader::_readThread, this);
+}
+
+void summarize::BlockReader::_submit(size_t slot) {
+    Slot& s = _slots[slot];
+    s.size = 0;
+    s.offset = _submitOffset;
+    if(_sourceDone) {
+        s.state = Slot::READY;
+        return;
+    }
+    if(!_uring->submitRead(_fd, s.data, _bufferSize, s.offset, static_cast<unsigned>(slot))) {
+        std::cerr << "ERROR: Could not queue a read of " << _path << std::endl;
+        _sourceDone = true;
+        s.state = Slot::READY;
+        return;
+    }
+    _submitOffset += _bufferSize;
+    s.state = Slot::PENDING;
+    _inFlight++;
+}
+
+void summarize::BlockReader::_awaitUring(size_t slot) {
+    while(_slots[slot].state == Slot::PENDING) {
+        unsigned request;
+        int result;
+        if(!_uring->wait(request, result)) {
+            std::cerr << "ERROR: Could not wait for reads of " << _path << std::endl;
+            _sourceDone = true;
+            _inFlight = 0;
+            for(auto& s: _slots) {
+                if(s.state == Slot::PENDING) s.state = Slot::READY;
+            }
+            return;
+        }
+        Slot& s = _slots[request];
+        _inFlight--;
+        if(result == -EINTR || result == -EAGAIN) {
+            _uring->submitRead(_fd, s.data, _bufferSize, s.offset, request);
+            _inFlight++;
+            continue;
+        }
+#ifdef O_DIRECT
+        if(result == -EINVAL && _options.direct) {
+            // As for read(2): use the page cache where direct reads are refused.
+            ::fcntl(_fd, F_SETFL, ::fcntl(_fd, F_GETFL) & ~O_DIRECT);
+            _options.direct = false;
+            _uring->submitRead(_fd, s.data, _bufferSize, s.offset, request);
+            _inFlight++;
+            continue;
+        }
+#endif
+        if(result < 0) {
+            std::cerr << "ERROR: Could not read " << _path << ": " << std::strerror(-result) << std::endl;
+            result = 0;
+        }
+        s.size = static_cast<size_t>(result);
+        s.state = Slot::READY;
+        if(s.size < _bufferSize) _sourceDone = true;    // end of the file
+    }
+}
+
+void summarize::BlockReader::_readThread() {
+    while(true) {
+        size_t slot;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _slotFree.wait(lock, [this]() { return _stopThread || _slots[_fillSlot].state == Slot::FREE; });
+            if(_stopThread) return;
+            slot = _fillSlot;
+            _slots[slot].state = Slot::PENDING;
+        }
+        size_t n = _readInto(_slots[slot].data, _bufferSize);
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _slots[slot].size = n;
+            _slots[slot].state = Slot::READY;
+            _fillSlot = (slot + 1) % _slots.size();
+        }
+        _slotReady.notify_one();
+        if(n == 0) return;
+    }
+}
+
+size_t summarize::BlockReader::_readSource() {
+    if(!_sb && _fd < 0) return 0;
+    if(_slots.empty()) {
+        _start();
+        if(_slots.empty()) return 0;
+    }
+    if(_atEnd) return 0;
+    auto begin = std::chrono::steady_clock::now();
+    size_t n;
+    if(_readAhead == ReadAhead::NONE) {
+        _current = 0;
+        n = _readInto(_slots[0].data, _bufferSize);
+#ifdef POSIX_FADV_WILLNEED
+        // Start reading the next blocks while this one is parsed.
+        if(n && _fd >= 0 && !_options.direct && _options.readAheadBlocks) {
+            ::posix_fadvise(_fd, static_cast<off_t>(_bytesRead + n),
+                            static_cast<off_t>(_options.readAheadBlocks * _bufferSize), POSIX_FADV_WILLNEED);
+        }
+#endif
+    } else {
+        // Hand the block the consumer is done with back to the queue, and take the next.
+        size_t next = (_current + 1) % _slots.size();
+        if(_readAhead == ReadAhead::URING) {
+            _submit(_current);
+            _awaitUring(next);
+        } else {
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _slots[_current].state = Slot::FREE;
+            }
+            _slotFree.notify_one();
+            std::unique_lock<std::mutex> lock(_mutex);
+            _slotReady.wait(lock, [this, next]() { return _slots[next].state == Slot::READY; });
+        }
+        _current = next;
+        n = _slots[next].size;
+        // A short read is the end of the file; reads queued past it are not used.
+        if(_readAhead == ReadAhead::URING && n < _bufferSize) _atEnd = true;
+    }
+    if(n == 0) _atEnd = true;
+    _stallSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    _bytesRead += n;
+    if(_progress && n) _progress->addBytes(n);
+    return n;
+}
+
+void summarize::BlockReader::_stop() {
+    if(_thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopThread = true;
+        }
+        _slotFree.notify_all();
+        _thread.join();     // after a read in progress returns
+    }
+    if(_uring) {
+        for(size_t i = 0; i < _slots.size(); i++) _awaitUring(i);
+        _uring.reset();
+    }
+}
+
+bool summarize::BlockReader::next(const char*& data, size_t& size) {
+    if(!_prefix.empty()) {
+        _returnedPrefix.swap(_prefix);
+        _prefix.clear();
+        _block = _returnedPrefix.data();
+        _blockSize = _returnedPrefix.size();
+    } else if(_pendingSize) {
+        _block = _pending;
+        _blockSize = _pendingSize;
+        _pendingSize = 0;
+    } else {
+        _blockSize = _readSource();
+        _block = _slots.empty() ? nullptr : _slots[_current].data;
+    }
+    data = _block;
+    size = _blockSize;
+    return _blockSize > 0;
+}
+
+size_t summarize::BlockReader::getRemaining() {
+    size_t buffered = _prefix.size() + _pendingSize;
+    if(_sb) {
+        if(_readAhead == ReadAhead::THREAD) return 0;      // the stream is the thread's
+        std::streamoff cur = _sb->pubseekoff(0, std::ios::cur, std::ios::in);
+        if(cur < 0) return 0;
+        std::streamoff end = _sb->pubseekoff(0, std::ios::end, std::ios::in);
+        _sb->pubseekpos(cur, std::ios::in);
+        return end >= cur ? static_cast<size_t>(end - cur) + buffered : 0;
+    }
+    struct stat st;
+    if(_fd < 0 || ::fstat(_fd, &st) != 0 || !S_ISREG(st.st_mode)) return 0;
+    if(static_cast<size_t>(st.st_size) < _bytesRead) return 0;
+    return static_cast<size_t>(st.st_size) - _bytesRead + buffered;
+}
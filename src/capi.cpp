@@ -0,0 +1,181 @@
+//
+// C API of libsummarize (see summarize.h): thin wrappers around TsvFile that catch every
+// exception at the boundary and turn it into a status code.
+//
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#include <summarize.h>
+#include <tsvFile.hpp>
+
+struct summarize_result {
+    summarize::TsvFile file;
+    bool parquet = false;
+};
+
+namespace {
+    //! The first options->struct_size bytes of \p options over the defaults.
+    summarize_options effectiveOptions(const summarize_options* options) {
+        summarize_options ret;
+        summarize_options_init(&ret);
+        if(options) {
+            size_t n = std::min(options->struct_size, sizeof(summarize_options));
+            std::memcpy(&ret, options, n);
+            ret.struct_size = sizeof(summarize_options);
+        }
+        return ret;
+    }
+
+    void configure(summarize::TsvFile& file, const summarize_options& options) {
+        file.setPreviewRows(options.preview_rows);
+        file.setCollectStats(options.collect_stats != 0);
+        file.setTimeBudget(options.time_budget_ms > 0 ? options.time_budget_ms / 1000 : 0);
+        // Indexes serve --skip, which has no counterpart here.
+        file.setIndexInterval(0);
+    }
+
+    //! Read \p is into a new result with the delimiter \p fallback if none is set.
+    int readText(std::istream& is, const summarize_options& options, char fallback,
+                 summarize_result** result) {
+        summarize_result* ret = new summarize_result();
+        configure(ret->file, options);
+        if(options.delim) ret->file.setDelim(options.delim);
+        else ret->file.sniffDelim(fallback);
+        if(!ret->file.read(is, options.has_header != 0)) {
+            delete ret;
+            return SUMMARIZE_ERROR_READ;
+        }
+        *result = ret;
+        return SUMMARIZE_OK;
+    }
+}
+
+int summarize_api_version(void) {
+    return SUMMARIZE_API_VERSION;
+}
+
+const char* summarize_status_string(int status) {
+    switch(status) {
+        case SUMMARIZE_OK: return "success";
+        case SUMMARIZE_ERROR_ARGUMENT: return "invalid argument";
+        case SUMMARIZE_ERROR_OPEN: return "could not open file";
+        case SUMMARIZE_ERROR_READ: return "could not read table";
+        case SUMMARIZE_ERROR_UNSUPPORTED: return "parquet support was not enabled in this build";
+        case SUMMARIZE_ERROR_INTERNAL: return "internal error";
+        default: return "unknown status";
+    }
+}
+
+void summarize_options_init(summarize_options* options) {
+    if(!options) return;
+    options->struct_size = sizeof(summarize_options);
+    options->has_header = 1;
+    options->delim = 0;
+    options->preview_rows = 1;
+    options->collect_stats = 1;
+    options->time_budget_ms = 0;
+}
+
+int summarize_path(const char* path, const summarize_options* options, summarize_result** result) {
+    if(!result) return SUMMARIZE_ERROR_ARGUMENT;
+    *result = nullptr;
+    if(!path) return SUMMARIZE_ERROR_ARGUMENT;
+    try {
+        summarize_options opts = effectiveOptions(options);
+        if(summarize::hasParquetExtension(path)) {
+#ifdef ENABLE_PARQUET
+            summarize_result* ret = new summarize_result();
+            ret->parquet = true;
+            configure(ret->file, opts);
+            if(!ret->file.readParquet(path)) {
+                delete ret;
+                return SUMMARIZE_ERROR_READ;
+            }
+            *result = ret;
+            return SUMMARIZE_OK;
+#else
+            return SUMMARIZE_ERROR_UNSUPPORTED;
+#endif
+        }
+        std::ifstream inF(path, std::ios::binary);
+        if(!inF) return SUMMARIZE_ERROR_OPEN;
+        return readText(inF, opts, summarize::delimFromExtension(path), result);
+    } catch(const std::exception&) {
+        return SUMMARIZE_ERROR_INTERNAL;
+    }
+}
+
+int summarize_buffer(const void* data, size_t size, const summarize_options* options,
+                     summarize_result** result) {
+    if(!result) return SUMMARIZE_ERROR_ARGUMENT;
+    *result = nullptr;
+    if(!data && size > 0) return SUMMARIZE_ERROR_ARGUMENT;
+    try {
+        summarize::SpanStreamBuf buf(static_cast<const char*>(data), size);
+        std::istream in(&buf);
+        return readText(in, effectiveOptions(options), '\t', result);
+    } catch(const std::exception&) {
+        return SUMMARIZE_ERROR_INTERNAL;
+    }
+}
+
+void summarize_result_free(summarize_result* result) {
+    delete result;
+}
+
+size_t summarize_n_rows(const summarize_result* result) {
+    return result ? result->file.getNRows() : 0;
+}
+
+int summarize_n_rows_exact(const summarize_result* result) {
+    return result && result->file.isNRowsExact();
+}
+
+int summarize_is_partial(const summarize_result* result) {
+    return result && result->file.getPartialInfo().valid;
+}
+
+size_t summarize_n_cols(const summarize_result* result) {
+    return result ? result->file.getNCols() : 0;
+}
+
+char summarize_delim(const summarize_result* result) {
+    return result && !result->parquet ? result->file.getDelim() : 0;
+}
+
+const char* summarize_header(const summarize_result* result, size_t col) {
+    if(!result || col >= result->file.getNCols()) return nullptr;
+    return result->file.getHeaders()[col].data();     // NUL terminated
+}
+
+summarize_type summarize_column_type(const summarize_result* result, size_t col) {
+    if(!result || col >= result->file.getNCols()) return SUMMARIZE_STRING;
+    return static_cast<summarize_type>(result->file.getType(col));
+}
+
+int summarize_get_column_stats(const summarize_result* result, size_t col, summarize_column_stats* stats) {
+    if(!result || !stats || !result->file.hasStats() || col >= result->file.getNCols())
+        return SUMMARIZE_ERROR_ARGUMENT;
+    const summarize::ColumnStats& s = result->file.getStats(col);
+    stats->count = s.getCount();
+    stats->missing = s.getMissing();
+    stats->max_length = s.getMaxLength();
+    stats->n_numeric = s.getNNumeric();
+    stats->min = s.getMin();
+    stats->max = s.getMax();
+    stats->mean = s.getMean();
+    stats->sd = s.getSd();
+    return SUMMARIZE_OK;
+}
+
+size_t summarize_n_preview_rows(const summarize_result* result) {
+    return result ? result->file.getNPreviewRows() : 0;
+}
+
+const char* summarize_preview_value(const summarize_result* result, size_t col, size_t row) {
+    if(!result || col >= result->file.getNCols() || row >= result->file.getNPreviewRows())
+        return nullptr;
+    return result->file.getPreviewValue(col, row).c_str();
+}
@@ -0,0 +1,118 @@
+//
+// Arena packed column names with a flat hash index (see columnNames.hpp).
+//
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <functional>
+
+#include <columnNames.hpp>
+
+const size_t summarize::ColumnNames::npos;
+const size_t summarize::ColumnNames::CHUNK_BYTES;
+
+summarize::ColumnNames::ColumnNames() {
+    _chunkUsed = 0;
+    _chunkSize = 0;
+    _chunkBytes = 0;
+    _maxLength = 0;
+}
+
+summarize::ColumnNames::ColumnNames(const ColumnNames& rhs) : ColumnNames() {
+    *this = rhs;
+}
+
+summarize::ColumnNames& summarize::ColumnNames::operator = (const ColumnNames& rhs) {
+    if(this == &rhs) return *this;
+    clear();
+    _names.reserve(rhs.size());
+    for(std::string_view name: rhs._names) push_back(name);
+    return *this;
+}
+
+char* summarize::ColumnNames::_allocate(size_t n) {
+    if(_chunks.empty() || _chunkSize - _chunkUsed < n) {
+        _chunkSize = std::max(n, CHUNK_BYTES);
+        _chunks.push_back(std::make_unique<char[]>(_chunkSize));
+        _chunkBytes += _chunkSize;
+        _chunkUsed = 0;
+    }
+    char* ret = _chunks.back().get() + _chunkUsed;
+    _chunkUsed += n;
+    return ret;
+}
+
+void summarize::ColumnNames::_index(size_t col) {
+    size_t mask = _slots.size() - 1;
+    std::string_view name = _names[col];
+    for(size_t slot = std::hash<std::string_view>()(name) & mask;; slot = (slot + 1) & mask) {
+        if(_slots[slot] == 0) {
+            _slots[slot] = static_cast<uint32_t>(col + 1);
+            return;
+        }
+        if(_names[_slots[slot] - 1] == name) return;     // duplicate names find the first
+    }
+}
+
+void summarize::ColumnNames::_rebuildIndex(size_t nSlots) {
+    _slots.assign(nSlots, 0);
+    for(size_t col = 0; col < _names.size(); col++) _index(col);
+}
+
+void summarize::ColumnNames::_add(const char* text, size_t length) {
+    _names.emplace_back(text, length);
+    _maxLength = std::max(_maxLength, length);
+    if(_names.size() * 2 > _slots.size()) _rebuildIndex(std::max<size_t>(16, _slots.size() * 2));
+    else _index(_names.size() - 1);
+}
+
+void summarize::ColumnNames::push_back(std::string_view name) {
+    char* text = _allocate(name.size() + 1);
+    std::memcpy(text, name.data(), name.size());
+    text[name.size()] = '\0';
+    _add(text, name.size());
+}
+
+void summarize::ColumnNames::pushNumbered(std::string_view prefix, size_t number) {
+    char digits[24];
+    size_t nDigits = static_cast<size_t>(std::to_chars(digits, digits + sizeof(digits), number).ptr - digits);
+    size_t length = prefix.size() + nDigits;
+    char* text = _allocate(length + 1);
+    std::memcpy(text, prefix.data(), prefix.size());
+    std::memcpy(text + prefix.size(), digits, nDigits);
+    text[length] = '\0';
+    _add(text, length);
+}
+
+void summarize::ColumnNames::truncate(size_t n) {
+    if(n >= _names.size()) return;
+    // The bytes of the dropped names stay in their chunks until clear().
+    _names.resize(n);
+    _maxLength = 0;
+    for(std::string_view name: _names) _maxLength = std::max(_maxLength, name.size());
+    _rebuildIndex(_slots.size());
+}
+
+void summarize::ColumnNames::clear() {
+    _chunks.clear();
+    _chunkUsed = 0;
+    _chunkSize = 0;
+    _chunkBytes = 0;
+    _names.clear();
+    _slots.clear();
+    _maxLength = 0;
+}
+
+size_t summarize::ColumnNames::find(std::string_view name) const {
+    if(_slots.empty()) return npos;
+    size_t mask = _slots.size() - 1;
+    for(size_t slot = std::hash<std::string_view>()(name) & mask;; slot = (slot + 1) & mask) {
+        if(_slots[slot] == 0) return npos;
+        if(_names[_slots[slot] - 1] == name) return _slots[slot] - 1;
+    }
+}
+
+size_t summarize::ColumnNames::getMemoryBytes() const {
+    return _chunkBytes + _names.capacity() * sizeof(std::string_view) + _slots.capacity() * sizeof(uint32_t);
+}
@@ -0,0 +1,71 @@
+//
+// Column parallel statistics for wide tables (see columnParallelStats.hpp).
+//
+
+#include <algorithm>
+
+#include <columnParallelStats.hpp>
+#include <scheduler.hpp>
+
+summarize::ColumnParallelStats::ColumnParallelStats(Scheduler& scheduler, std::vector<ColumnStats>& stats)
+    : _scheduler(scheduler), _stats(stats) {
+    _nRecords = 0;
+    _nFields = 0;
+}
+
+summarize::ColumnParallelStats::~ColumnParallelStats() {
+    flush();
+}
+
+void summarize::ColumnParallelStats::_added() {
+    _nFields += _records[_nRecords - 1].size();
+    if(_nFields >= BATCH_FIELDS) flush();
+}
+
+void summarize::ColumnParallelStats::add(const std::vector<std::string>& record) {
+    if(_nRecords == _records.size()) _records.emplace_back();
+    _records[_nRecords++] = record;
+    _added();
+}
+
+void summarize::ColumnParallelStats::take(std::vector<std::string>& record) {
+    if(_nRecords == _records.size()) _records.emplace_back();
+    std::swap(_records[_nRecords++], record);
+    _added();
+}
+
+void summarize::ColumnParallelStats::flush() {
+    if(_nRecords == 0) return;
+    size_t width = 0;
+    for(size_t r = 0; r < _nRecords; r++) width = std::max(width, _records[r].size());
+    if(width > _stats.size()) {
+        // As TsvFile::_addToStats: a column first seen in this batch was missing from every
+        // row before it. Rows of the batch without it are counted as missing below.
+        size_t rowsSoFar = _stats.empty() ? 0 : _stats.front().getCount();
+        size_t oldSize = _stats.size();
+        _stats.resize(width);
+        for(size_t col = oldSize; col < width; col++) _stats[col].addMissing(rowsSoFar);
+    }
+
+    size_t nCols = _stats.size();
+    size_t nRanges = std::min(_scheduler.getThreads() * RANGES_PER_WORKER,
+                              (nCols + MIN_RANGE_COLUMNS - 1) / MIN_RANGE_COLUMNS);
+    TaskGroup group(_scheduler);
+    for(size_t range = 0; range < nRanges; range++) {
+        size_t from = nCols * range / nRanges;
+        size_t to = nCols * (range + 1) / nRanges;
+        group.run([this, from, to]() {
+            for(size_t col = from; col < to; col++) {
+                ColumnStats& stats = _stats[col];
+                for(size_t r = 0; r < _nRecords; r++) {
+                    const std::vector<std::string>& record = _records[r];
+                    if(col < record.size()) stats.add(record[col]);
+                    else stats.addMissing();
+                }
+            }
+        });
+    }
+    group.wait();
+    _nRecords = 0;
+    _nFields = 0;
+}
@@ -0,0 +1,101 @@
+//
+// Column projection (see columnSelection.hpp).
+//
+
+#include <iostream>
+#include <algorithm>
+
+#include <columnSelection.hpp>
+
+bool summarize::ColumnSelection::_parseRange(const std::string& text, Item& item) {
+    size_t dash = text.find('-');
+    std::string from = text.substr(0, dash);
+    std::string to = dash == std::string::npos ? from : text.substr(dash + 1);
+    auto isNumber = [](const std::string& s) {
+        return !s.empty() && s.size() < 10 && std::all_of(s.begin(), s.end(), [](char c) { return c >= '0' && c <= '9'; });
+    };
+    if(!isNumber(from) || (!to.empty() && !isNumber(to))) return false;
+    size_t first = std::stoul(from);
+    size_t last = to.empty() ? SIZE_MAX : std::stoul(to);
+    if(first == 0 || last < first) return false;
+    item.isRange = true;
+    item.first = first - 1;
+    item.last = last == SIZE_MAX ? SIZE_MAX : last - 1;
+    return true;
+}
+
+bool summarize::ColumnSelection::parse(const std::string& spec, const std::string& option) {
+    _option = option;
+    _items.clear();
+    _columns.clear();
+    _slots.clear();
+    size_t pos = 0;
+    while(pos <= spec.size()) {
+        Item item;
+        size_t end;
+        if(pos < spec.size() && spec[pos] == '/') {
+            // A regex may hold commas: it ends at a '/' before a comma or the end.
+            end = pos + 1;
+            while(end < spec.size() && !(spec[end] == '/' && (end + 1 == spec.size() || spec[end + 1] == ',')))
+                end++;
+            if(end == spec.size()) {
+                std::cerr << "ERROR: unterminated regex in " << _option << ": " << spec.substr(pos) << std::endl;
+                return false;
+            }
+            item.text = spec.substr(pos + 1, end - pos - 1);
+            item.isRegex = true;
+            try {
+                item.regex = std::regex(item.text);
+            } catch(const std::regex_error& e) {
+                std::cerr << "ERROR: invalid regex /" << item.text << "/ in " << _option << ": " << e.what() << std::endl;
+                return false;
+            }
+            end++;
+        } else {
+            end = std::min(spec.find(',', pos), spec.size());
+            item.text = spec.substr(pos, end - pos);
+            if(item.text.empty()) {
+                std::cerr << "ERROR: empty item in " << _option << ": '" << spec << "'" << std::endl;
+                return false;
+            }
+            _parseRange(item.text, item);
+        }
+        _items.push_back(std::move(item));
+        pos = end + 1;
+    }
+    return true;
+}
+
+void summarize::ColumnSelection::_select(size_t col) {
+    if(col >= _slots.size()) _slots.resize(col + 1, 0);
+    if(_slots[col] != 0) return;
+    _columns.push_back(col);
+    _slots[col] = static_cast<uint32_t>(_columns.size());
+}
+
+bool summarize::ColumnSelection::resolve(const ColumnNames& names) {
+    _columns.clear();
+    _slots.clear();
+    for(const Item& item: _items) {
+        if(item.isRegex) {
+            for(size_t col = 0; col < names.size(); col++) {
+                if(std::regex_search(names[col].begin(), names[col].end(), item.regex)) _select(col);
+            }
+            continue;
+        }
+        size_t col = names.find(item.text);
+        if(col != ColumnNames::npos) {
+            _select(col);
+        } else if(item.isRange) {
+            for(col = item.first; col <= item.last && col < names.size(); col++) _select(col);
+        } else {
+            std::cerr << "ERROR: no column named '" << item.text << "'" << std::endl;
+            return false;
+        }
+    }
+    if(_columns.empty()) {
+        std::cerr << "ERROR: " << _option << " selects no column" << std::endl;
+        return false;
+    }
+    return true;
+}
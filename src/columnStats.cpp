@@ -0,0 +1,151 @@
+//
+// Streaming per-column statistics (see columnStats.hpp).
+//
+
+#include <cmath>
+#include <charconv>
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+
+#include <columnStats.hpp>
+#include <kernels.hpp>
+
+std::string summarize::ColumnStats::typeToString(TYPE type) {
+    switch(type) {
+        case INT: return "int";
+        case BOOL: return "bool";
+        case FLOAT: return "float";
+        default: return "str";
+    }
+}
+
+bool summarize::ColumnStats::isMissing(std::string_view value) {
+    return value.empty() || value == "NA" || value == "null" || value == "NULL";
+}
+
+summarize::ColumnStats::TYPE summarize::ColumnStats::classify(std::string_view value, double& number) {
+    // Only a digit, a sign, '.', the i or n of inf and nan, or the t or f of a boolean can
+    // start a value that is not a string; other values need no parsing.
+    char lower = value.empty() ? 0 : static_cast<char>(value[0] | 0x20);
+    if(!(lower >= '0' && lower <= '9') && lower != '+' && lower != '-' && lower != '.' &&
+       lower != 't' && lower != 'f' && lower != 'i' && lower != 'n')
+        return STRING;
+    if(value == "true" || value == "TRUE" || value == "True" ||
+       value == "false" || value == "FALSE" || value == "False")
+        return BOOL;
+
+    // std::from_chars does not accept a leading '+'.
+    std::string_view digits = value;
+    if(!digits.empty() && digits[0] == '+') {
+        digits.remove_prefix(1);
+        if(!digits.empty() && digits[0] == '-') return STRING;
+    }
+    if(digits.empty()) return STRING;
+
+    const char* end = digits.data() + digits.size();
+    size_t sign = digits[0] == '-' && digits.size() > 1 ? 1 : 0;
+    bool isInt = sign + digitSpan(digits.data() + sign, end) == digits.size();
+
+    std::from_chars_result result = std::from_chars(digits.data(), end, number);
+    if(result.ec != std::errc() || result.ptr != end) {
+        // Out of range integers are still integers; anything else is a string.
+        if(isInt && result.ec == std::errc::result_out_of_range) return INT;
+        return STRING;
+    }
+    return isInt ? INT : FLOAT;
+}
+
+void summarize::ColumnStats::clear() {
+    _count = 0;
+    _missing = 0;
+    std::fill(_typeCounts, _typeCounts + Last, 0);
+    _maxLength = 0;
+    _nNumeric = 0;
+    _min = 0;
+    _max = 0;
+    _mean = 0;
+    _m2 = 0;
+}
+
+void summarize::ColumnStats::add(std::string_view value) {
+    _count++;
+    _maxLength = std::max(_maxLength, value.size());
+    if(isMissing(value)) {
+        _missing++;
+        return;
+    }
+    double number = 0;
+    TYPE type = classify(value, number);
+    _typeCounts[type]++;
+    // Non-finite values ("nan", "inf") type the column but are kept out of the moments.
+    if((type != INT && type != FLOAT) || !std::isfinite(number)) return;
+
+    if(_nNumeric == 0) {
+        _min = number;
+        _max = number;
+    } else {
+        _min = std::min(_min, number);
+        _max = std::max(_max, number);
+    }
+    _nNumeric++;
+    double delta = number - _mean;
+    _mean += delta / _nNumeric;
+    _m2 += delta * (number - _mean);
+}
+
+void summarize::ColumnStats::merge(const ColumnStats& rhs) {
+    if(rhs._nNumeric > 0) {
+        if(_nNumeric == 0) {
+            _min = rhs._min;
+            _max = rhs._max;
+        } else {
+            _min = std::min(_min, rhs._min);
+            _max = std::max(_max, rhs._max);
+        }
+        // Chan et al. pairwise combination of mean and sum of squares.
+        size_t n = _nNumeric + rhs._nNumeric;
+        double delta = rhs._mean - _mean;
+        _mean += delta * rhs._nNumeric / n;
+        _m2 += rhs._m2 + delta * delta * static_cast<double>(_nNumeric) * rhs._nNumeric / n;
+        _nNumeric = n;
+    }
+    _count += rhs._count;
+    _missing += rhs._missing;
+    _maxLength = std::max(_maxLength, rhs._maxLength);
+    for(int i = 0; i < Last; i++) _typeCounts[i] += rhs._typeCounts[i];
+}
+
+double summarize::ColumnStats::getSd() const {
+    if(_nNumeric < 2) return std::numeric_limits<double>::quiet_NaN();
+    return std::sqrt(_m2 / (_nNumeric - 1));
+}
+
+summarize::ColumnStats::TYPE summarize::ColumnStats::getType() const {
+    size_t nonMissing = _count - _missing;
+    if(nonMissing == 0 || _typeCounts[STRING] > 0) return STRING;
+    if(_typeCounts[BOOL] == nonMissing) return BOOL;
+    if(_typeCounts[INT] == nonMissing) return INT;
+    if(_typeCounts[INT] + _typeCounts[FLOAT] == nonMissing) return FLOAT;
+    return STRING;      // a mix of booleans and numbers
+}
+
+std::string summarize::ColumnStats::serialize() const {
+    std::ostringstream ss;
+    ss << std::setprecision(17) << _count << ' ' << _missing << ' ' << _maxLength << ' ' << _nNumeric;
+    for(int i = 0; i < Last; i++) ss << ' ' << _typeCounts[i];
+    ss << ' ' << _min << ' ' << _max << ' ' << _mean << ' ' << _m2;
+    return ss.str();
+}
+
+bool summarize::ColumnStats::deserialize(const std::string& str) {
+    std::istringstream ss(str);
+    ss >> _count >> _missing >> _maxLength >> _nNumeric;
+    for(int i = 0; i < Last; i++) ss >> _typeCounts[i];
+    ss >> _min >> _max >> _mean >> _m2;
+    if(ss.fail()) {
+        clear();
+        return false;
+    }
+    return true;
+}
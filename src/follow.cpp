@@ -0,0 +1,128 @@
+//
+// Follow mode (see follow.hpp).
+//
+// inotify only serves to wake up early. Every wake up, and at least once per refresh
+// interval, each file is stat'ed: a size change means new bytes to parse, a smaller size
+// or a different inode means the file was truncated or replaced and is read again. Polling
+// the path this way also picks up a file created after a rotation, which a watch on the
+// old inode would never report.
+//
+
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include <follow.hpp>
+
+namespace {
+    const uint32_t WATCH_MASK = IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+}
+
+summarize::Follower::Follower(SetupFunction setup, bool hasHeader, int intervalMs, bool useInotify)
+    : _setup(std::move(setup)) {
+    _hasHeader = hasHeader;
+    _intervalMs = intervalMs > 0 ? intervalMs : 1;
+    _inotifyFd = -1;
+    if(useInotify) {
+        _inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(_inotifyFd < 0)
+            std::cerr << "WARN: inotify is not available (" << std::strerror(errno)
+                      << "), polling every " << _intervalMs << " ms instead." << std::endl;
+    }
+}
+
+summarize::Follower::~Follower() {
+    if(_inotifyFd >= 0) close(_inotifyFd);
+}
+
+void summarize::Follower::addFile(const std::string& path) {
+    _entries.emplace_back();
+    _entries.back().path = path;
+}
+
+void summarize::Follower::_watch(Entry& entry) {
+    if(_inotifyFd < 0) return;
+    if(entry.wd >= 0) inotify_rm_watch(_inotifyFd, entry.wd);
+    entry.wd = inotify_add_watch(_inotifyFd, entry.path.c_str(), WATCH_MASK);
+}
+
+bool summarize::Follower::_update(Entry& entry) {
+    struct stat st;
+    if(stat(entry.path.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+        return false;       // not there (yet), e.g. in the middle of a rotation
+    uint64_t size = static_cast<uint64_t>(st.st_size);
+    bool replaced = static_cast<uint64_t>(st.st_dev) != entry.device ||
+                    static_cast<uint64_t>(st.st_ino) != entry.inode;
+    if(replaced || size < entry.size) {
+        // A new file, or the old one was truncated: start over.
+        entry.read = false;
+        entry.size = 0;
+        entry.device = static_cast<uint64_t>(st.st_dev);
+        entry.inode = static_cast<uint64_t>(st.st_ino);
+        if(replaced || entry.wd < 0) _watch(entry);
+    }
+    if(size == entry.size) return false;
+    entry.size = size;
+
+    std::ifstream in(entry.path, std::ios::binary);
+    if(!in) return false;
+    if(!entry.read) {
+        entry.file = TsvFile();
+        _setup(entry.path, entry.file);
+        entry.read = entry.file.read(in, _hasHeader);
+        return entry.read;
+    }
+    // Parse from the first byte after the last complete record; an unterminated record
+    // left at the end of the previous update is rolled back and parsed again in full.
+    in.seekg(static_cast<std::streamoff>(entry.file.getResumeOffset()));
+    return entry.file.readMore(in);
+}
+
+bool summarize::Follower::update() {
+    bool changed = false;
+    for(auto& entry: _entries)
+        if(_update(entry)) changed = true;
+    return changed;
+}
+
+void summarize::Follower::_wait(int timeoutMs) {
+    if(_inotifyFd < 0) {
+        poll(nullptr, 0, timeoutMs);       // unlike sleep, returns early on a signal
+        return;
+    }
+    struct pollfd pfd = {_inotifyFd, POLLIN, 0};
+    if(poll(&pfd, 1, timeoutMs) <= 0) return;
+    // Drain the queued events; which file changed is found by stat'ing them all.
+    char buffer[4096];
+    while(read(_inotifyFd, buffer, sizeof(buffer)) > 0) {}
+}
+
+void summarize::Follower::run(const std::atomic<bool>& stop, const PrintFunction& print) {
+    typedef std::chrono::steady_clock Clock;
+    const Clock::duration interval = std::chrono::milliseconds(_intervalMs);
+    std::vector<bool> changed(_entries.size(), false);
+    Clock::time_point lastPrint = Clock::now() - interval;
+    while(!stop) {
+        for(size_t i = 0; i < _entries.size(); i++)
+            if(_update(_entries[i])) changed[i] = true;
+
+        Clock::time_point now = Clock::now();
+        if(now - lastPrint >= interval) {
+            for(size_t i = 0; i < _entries.size(); i++) {
+                if(!changed[i]) continue;
+                print(_entries[i].path, _entries[i].file);
+                changed[i] = false;
+            }
+            lastPrint = now;
+        }
+        if(stop) break;
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(lastPrint + interval - Clock::now());
+        _wait(static_cast<int>(std::max<int64_t>(remaining.count(), 1)));
+    }
+}
@@ -0,0 +1,239 @@
+//
+// Hash aggregation by key columns (see groupBy.hpp).
+//
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+#include <groupBy.hpp>
+#include <tsvFile.hpp>
+
+const uint32_t summarize::GroupTable::EMPTY;
+const size_t summarize::GroupBy::PARTITIONS;
+const size_t summarize::GroupBy::DEFAULT_MEMORY_LIMIT;
+
+// Spilled groups are written as they are held.
+static_assert(std::is_trivially_copyable<summarize::ColumnStats>::value, "ColumnStats is spilled as bytes");
+
+void summarize::GroupTable::reset(size_t nValues) {
+    clear();
+    _nValues = nValues;
+}
+
+void summarize::GroupTable::clear() {
+    std::fill(_slots.begin(), _slots.end(), Slot{0, EMPTY});
+    _keys.clear();
+    _keyEnds.clear();
+    _hashes.clear();
+    _counts.clear();
+    _stats.clear();
+}
+
+void summarize::GroupTable::_grow() {
+    _slots.assign(std::max<size_t>(16, _slots.size() * 2), Slot{0, EMPTY});
+    size_t mask = _slots.size() - 1;
+    for(size_t group = 0; group < size(); group++) {
+        size_t i = _hashes[group] & mask;
+        while(_slots[i].group != EMPTY) i = (i + 1) & mask;
+        _slots[i] = Slot{_hashes[group], static_cast<uint32_t>(group)};
+    }
+}
+
+size_t summarize::GroupTable::_find(std::string_view key, uint64_t hash) {
+    if((size() + 1) * 2 > _slots.size()) _grow();
+    size_t mask = _slots.size() - 1;
+    for(size_t i = hash & mask;; i = (i + 1) & mask) {
+        Slot& slot = _slots[i];
+        if(slot.group == EMPTY) {
+            slot = Slot{hash, static_cast<uint32_t>(size())};
+            _keys.append(key);
+            _keyEnds.push_back(_keys.size());
+            _hashes.push_back(hash);
+            _counts.push_back(0);
+            _stats.resize(_stats.size() + _nValues);
+            return slot.group;
+        }
+        if(slot.hash == hash && getKey(slot.group) == key) return slot.group;
+    }
+}
+
+void summarize::GroupTable::add(const std::vector<std::string>& record, const std::vector<size_t>& keys,
+                                const std::vector<size_t>& values) {
+    _key.clear();
+    for(size_t field: keys) {
+        std::string_view value = field < record.size() ? std::string_view(record[field]) : std::string_view();
+        uint32_t length = static_cast<uint32_t>(value.size());
+        _key.append(reinterpret_cast<const char*>(&length), sizeof(length));
+        _key.append(value);
+    }
+    size_t group = _find(_key, std::hash<std::string_view>()(_key));
+    _counts[group]++;
+    ColumnStats* stats = _stats.data() + group * _nValues;
+    for(size_t i = 0; i < values.size(); i++) {
+        if(values[i] < record.size()) stats[i].add(record[values[i]]);
+        else stats[i].addMissing();
+    }
+}
+
+void summarize::GroupTable::_mergeGroup(std::string_view key, uint64_t hash, size_t count, const ColumnStats* stats) {
+    size_t group = _find(key, hash);
+    _counts[group] += count;
+    ColumnStats* into = _stats.data() + group * _nValues;
+    for(size_t i = 0; i < _nValues; i++) into[i].merge(stats[i]);
+}
+
+void summarize::GroupTable::merge(const GroupTable& other) {
+    for(size_t group = 0; group < other.size(); group++)
+        _mergeGroup(other.getKey(group), other.getHash(group), other.getCount(group), other.getStats(group));
+}
+
+void summarize::GroupTable::splitKey(std::string_view key, std::vector<std::string_view>& fields) {
+    fields.clear();
+    while(key.size() >= sizeof(uint32_t)) {
+        uint32_t length;
+        std::memcpy(&length, key.data(), sizeof(length));
+        fields.push_back(key.substr(sizeof(length), length));
+        key.remove_prefix(std::min(key.size(), sizeof(length) + length));
+    }
+}
+
+bool summarize::GroupTable::write(size_t group, std::FILE* file) const {
+    uint64_t hash = _hashes[group];
+    std::string_view key = getKey(group);
+    uint64_t keySize = key.size();
+    uint64_t count = _counts[group];
+    return std::fwrite(&hash, sizeof(hash), 1, file) == 1 &&
+           std::fwrite(&keySize, sizeof(keySize), 1, file) == 1 &&
+           std::fwrite(key.data(), 1, key.size(), file) == key.size() &&
+           std::fwrite(&count, sizeof(count), 1, file) == 1 &&
+           std::fwrite(getStats(group), sizeof(ColumnStats), _nValues, file) == _nValues;
+}
+
+bool summarize::GroupTable::read(std::FILE* file) {
+    uint64_t hash, keySize, count;
+    if(std::fread(&hash, sizeof(hash), 1, file) != 1 || std::fread(&keySize, sizeof(keySize), 1, file) != 1)
+        return false;
+    _key.resize(keySize);
+    _spilled.resize(_nValues);
+    if(std::fread(&_key[0], 1, keySize, file) != keySize || std::fread(&count, sizeof(count), 1, file) != 1 ||
+       std::fread(_spilled.data(), sizeof(ColumnStats), _nValues, file) != _nValues)
+        return false;
+    _mergeGroup(_key, hash, count, _spilled.data());
+    return true;
+}
+
+bool summarize::GroupBy::parse(const std::string& spec) {
+    return _keys.parse(spec, "--groupBy");
+}
+
+bool summarize::GroupBy::resolve(const ColumnNames& names) {
+    return _keys.resolve(names);
+}
+
+void summarize::GroupBy::setFields(const std::vector<size_t>& keyFields, const std::vector<size_t>& valueFields) {
+    _keyFields = keyFields;
+    _valueFields = valueFields;
+    _table.reset(valueFields.size());
+    _closePartitions();
+    _nSpills = 0;
+    _failed = false;
+}
+
+void summarize::GroupBy::merge(const GroupTable& table) {
+    _table.merge(table);
+    if(_table.getBytes() > _memoryLimit) _spill();
+}
+
+void summarize::GroupBy::_spill() {
+    if(_partitions.empty()) {
+        for(size_t i = 0; i < PARTITIONS; i++) {
+            std::FILE* file = std::tmpfile();
+            if(!file) {
+                std::cerr << "WARN: could not create a spill file; keeping every group in memory." << std::endl;
+                _closePartitions();
+                _memoryLimit = SIZE_MAX;
+                return;
+            }
+            _partitions.push_back(file);
+        }
+    }
+    // Partitioned by the high bits of the hash, as the table slots use the low ones.
+    for(size_t group = 0; group < _table.size() && !_failed; group++) {
+        if(!_table.write(group, _partitions[(_table.getHash(group) >> 32) % PARTITIONS])) {
+            std::cerr << "ERROR: could not write a spill file!" << std::endl;
+            _failed = true;
+        }
+    }
+    _table.clear();
+    _nSpills++;
+}
+
+void summarize::GroupBy::_closePartitions() {
+    for(std::FILE* file: _partitions) std::fclose(file);
+    _partitions.clear();
+}
+
+void summarize::GroupBy::_writeGroups(std::ostream& out, const GroupTable& table, const std::vector<size_t>& means) const {
+    std::string line;
+    std::vector<std::string_view> fields;
+    for(size_t group = 0; group < table.size(); group++) {
+        line.clear();
+        GroupTable::splitKey(table.getKey(group), fields);
+        for(std::string_view field: fields) {
+            appendField(line, field, '\t');
+            line += '\t';
+        }
+        out << line << table.getCount(group);
+        const ColumnStats* stats = table.getStats(group);
+        for(size_t value: means) {
+            if(stats[value].getNNumeric() == 0) out << "\tNA";
+            else out << '\t' << stats[value].getMean();
+        }
+        out << '\n';
+    }
+}
+
+bool summarize::GroupBy::write(std::ostream& out, const ColumnNames& names, const std::vector<ColumnStats::TYPE>& types) {
+    std::vector<size_t> means;
+    for(size_t value = 0; value < _valueFields.size(); value++) {
+        size_t field = _valueFields[value];
+        if(field < types.size() && (types[field] == ColumnStats::INT || types[field] == ColumnStats::FLOAT))
+            means.push_back(value);
+    }
+    std::string line;
+    for(size_t field: _keyFields) {
+        appendField(line, field < names.size() ? names[field] : std::string_view(), '\t');
+        line += '\t';
+    }
+    line += "count";
+    for(size_t value: means) {
+        line += '\t';
+        line += names[_valueFields[value]];
+        line += "_mean";
+    }
+    out << line << '\n';
+
+    if(_partitions.empty()) {
+        _writeGroups(out, _table, means);
+    } else {
+        // Every group is whole in one partition: merge and write them one at a time.
+        _spill();
+        GroupTable merged(_valueFields.size());
+        for(std::FILE* file: _partitions) {
+            std::rewind(file);
+            while(!_failed && merged.read(file)) {}
+            if(std::ferror(file)) {
+                std::cerr << "ERROR: could not read a spill file!" << std::endl;
+                _failed = true;
+            }
+            _writeGroups(out, merged, means);
+            merged.clear();
+        }
+        _closePartitions();
+    }
+    out.flush();
+    return !_failed && out;
+}
@@ -0,0 +1,439 @@
+//
+// Scalar and x86 SIMD versions of the kernels in kernels.hpp, and the dispatch between
+// them. The SIMD versions are compiled with target attributes rather than -m flags, so
+// they may only be called after the CPU has been checked for the instruction set.
+//
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <kernels.hpp>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SUMMARIZE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace {
+    using summarize::Kernels;
+    using summarize::SimdLevel;
+
+    const char* findAnyScalar(const char* p, const char* end, char a, char b, char c) {
+        while(p != end && *p != a && *p != b && *p != c) p++;
+        return p;
+    }
+
+    size_t countByteScalar(const char* p, const char* end, char c) {
+        size_t ret = 0;
+        for(; p != end; p++) ret += *p == c;
+        return ret;
+    }
+
+    size_t digitSpanScalar(const char* p, const char* end) {
+        const char* begin = p;
+        while(p != end && *p >= '0' && *p <= '9') p++;
+        return static_cast<size_t>(p - begin);
+    }
+
+
+    //! Masks of up to MAX_HISTOGRAM_CANDIDATES + 3 needles over a block of 64 bytes.
+    typedef uint64_t NeedleMasks[summarize::MAX_HISTOGRAM_CANDIDATES + 3];
+
+    //! The body of histogramRecords, inlined into the version of each level so that its
+    //! popcounts compile to the instruction where the level has it. \p blockMasks(p, len,
+    //! needles, n, masks) sets the mask of each needle over the len <= 64 bytes at p.
+    //!
+    //! The quoted bytes of a block follow from a prefix XOR of its quote mask, and each
+    //! record's candidates are counted with popcounts of its range of the masks.
+    template <typename BlockMasks>
+    __attribute__((always_inline))
+    inline void histogramRecordsImpl(const char* data, size_t size, const char* candidates, size_t n, char quote,
+                                     bool complete, summarize::RecordHistogram& out, BlockMasks blockMasks) {
+        const size_t QUOTE = n, LF = n + 1, CR = n + 2;
+        char needles[summarize::MAX_HISTOGRAM_CANDIDATES + 3];
+        std::copy(candidates, candidates + n, needles);
+        needles[QUOTE] = quote;
+        needles[LF] = '\n';
+        needles[CR] = '\r';
+        NeedleMasks masks;
+        uint32_t cur[summarize::MAX_HISTOGRAM_CANDIDATES] = {0};
+        size_t active[summarize::MAX_HISTOGRAM_CANDIDATES];
+        bool recordHasChars = false;
+        size_t recordStart = 0;
+        uint64_t inQuotes = 0;      // all ones if a quoted field continues into the next block
+
+        // The counts are written through a pointer into out.counts, which is grown ahead
+        // and cut to size at the end: appending them with insert costs more than the rest
+        // of a short record.
+        size_t used = out.counts.size();
+        auto flushRecord = [&](size_t at) {
+            if(recordHasChars) {
+                if(used + n > out.counts.size()) out.counts.resize(std::max(2 * out.counts.size(), used + n));
+                uint32_t* counts = out.counts.data() + used;
+                for(size_t k = 0; k < n; k++) counts[k] = cur[k];
+                used += n;
+                out.starts.push_back(recordStart);
+                out.ends.push_back(at);
+            }
+            for(size_t k = 0; k < n; k++) cur[k] = 0;
+            recordHasChars = false;
+        };
+        for(size_t base = 0; base < size; base += 64) {
+            size_t len = std::min<size_t>(64, size - base);
+            blockMasks(data + base, len, needles, n + 3, masks);
+            const uint64_t valid = len == 64 ? ~uint64_t(0) : (uint64_t(1) << len) - 1;
+            // Bit i of quoted is set if byte i is inside quotes (an opening quote is, a
+            // closing one is not). Doubled "" quotes toggle it twice.
+            uint64_t quoted = masks[QUOTE];
+            if(quoted) {
+                quoted ^= quoted << 1;
+                quoted ^= quoted << 2;
+                quoted ^= quoted << 4;
+                quoted ^= quoted << 8;
+                quoted ^= quoted << 16;
+                quoted ^= quoted << 32;
+            }
+            quoted ^= inQuotes;
+            inQuotes = 0 - (quoted >> 63);
+            const uint64_t outside = ~quoted & valid;
+            const uint64_t terminators = (masks[LF] | masks[CR]) & outside;
+            const uint64_t chars = valid & ~terminators;
+            if(!terminators) {
+                // Inside one record, as most blocks of wide records are.
+                if(chars && !recordHasChars) {
+                    recordStart = base + static_cast<size_t>(__builtin_ctzll(chars));
+                    recordHasChars = true;
+                }
+                for(size_t k = 0; k < n; k++) cur[k] += static_cast<uint32_t>(__builtin_popcountll(masks[k] & outside));
+                continue;
+            }
+            size_t nActive = 0;
+            for(size_t k = 0; k < n; k++) {
+                masks[k] &= outside;
+                if(masks[k]) active[nActive++] = k;
+            }
+            // The records, or parts of records, between the terminators of the block.
+            uint64_t rest = valid;
+            while(rest) {
+                uint64_t next = terminators & rest;
+                uint64_t lowest = next & (0 - next);
+                uint64_t range = next ? rest & (lowest - 1) : rest;
+                if((chars & range) && !recordHasChars) {
+                    recordStart = base + static_cast<size_t>(__builtin_ctzll(chars & range));
+                    recordHasChars = true;
+                }
+                for(size_t a = 0; a < nActive; a++)
+                    cur[active[a]] += static_cast<uint32_t>(__builtin_popcountll(masks[active[a]] & range));
+                if(!next) break;
+                flushRecord(base + static_cast<size_t>(__builtin_ctzll(next)));
+                rest &= ~((lowest << 1) - 1);
+            }
+        }
+        if(complete) flushRecord(size);
+        out.counts.resize(used);
+    }
+
+    void blockMasksScalar(const char* p, size_t len, const char* needles, size_t n, uint64_t* masks) {
+        for(size_t j = 0; j < n; j++) {
+            uint64_t mask = 0;
+            for(size_t i = 0; i < len; i++) mask |= static_cast<uint64_t>(p[i] == needles[j]) << i;
+            masks[j] = mask;
+        }
+    }
+
+    void histogramRecordsScalar(const char* p, size_t len, const char* candidates, size_t n, char quote,
+                                bool complete, summarize::RecordHistogram& out) {
+        histogramRecordsImpl(p, len, candidates, n, quote, complete, out, blockMasksScalar);
+    }
+
+    const Kernels SCALAR_KERNELS = {findAnyScalar, countByteScalar, digitSpanScalar, histogramRecordsScalar};
+
+#ifdef SUMMARIZE_X86_KERNELS
+    // SSE4.2: the string compare instruction tests 16 bytes against all three needles.
+    __attribute__((target("sse4.2")))
+    const char* findAnySse42(const char* p, const char* end, char a, char b, char c) {
+        const __m128i needles = _mm_setr_epi8(a, b, c, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+        const int mode = _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT;
+        for(; end - p >= 16; p += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            int i = _mm_cmpestri(needles, 3, block, 16, mode);
+            if(i < 16) return p + i;
+        }
+        return findAnyScalar(p, end, a, b, c);
+    }
+
+    __attribute__((target("sse4.2,popcnt")))
+    size_t countByteSse42(const char* p, const char* end, char c) {
+        const __m128i needle = _mm_set1_epi8(c);
+        size_t ret = 0;
+        for(; end - p >= 16; p += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            ret += static_cast<size_t>(__builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle))));
+        }
+        return ret + countByteScalar(p, end, c);
+    }
+
+    __attribute__((target("sse4.2")))
+    size_t digitSpanSse42(const char* p, const char* end) {
+        // Signed compares: bytes >= 0x80 are negative, so never between '0' and '9'.
+        const __m128i below = _mm_set1_epi8('0' - 1), above = _mm_set1_epi8('9' + 1);
+        const char* begin = p;
+        for(; end - p >= 16; p += 16) {
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i digits = _mm_and_si128(_mm_cmpgt_epi8(block, below), _mm_cmplt_epi8(block, above));
+            unsigned other = ~static_cast<unsigned>(_mm_movemask_epi8(digits)) & 0xFFFFu;
+            if(other) return static_cast<size_t>(p - begin) + static_cast<size_t>(__builtin_ctz(other));
+        }
+        return static_cast<size_t>(p - begin) + digitSpanScalar(p, end);
+    }
+
+    //! The block of \p len <= 64 bytes at \p p, copied into \p buffer if shorter, so that
+    //! full width loads stay in bounds, and the mask of its valid bytes.
+    inline const char* padBlock(const char* p, size_t len, char* buffer, uint64_t& valid) {
+        if(len == 64) {
+            valid = ~uint64_t(0);
+            return p;
+        }
+        std::memcpy(buffer, p, len);
+        valid = (uint64_t(1) << len) - 1;
+        return buffer;
+    }
+
+    __attribute__((target("sse4.2")))
+    inline void blockMasksSse42(const char* p, size_t len, const char* needles, size_t n, uint64_t* masks) {
+        alignas(16) char buffer[64];
+        uint64_t valid;
+        p = padBlock(p, len, buffer, valid);
+        __m128i parts[4];
+        for(int b = 0; b < 4; b++) parts[b] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * b));
+        for(size_t j = 0; j < n; j++) {
+            const __m128i needle = _mm_set1_epi8(needles[j]);
+            uint64_t mask = 0;
+            for(int b = 0; b < 4; b++) {
+                unsigned bits = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(parts[b], needle)));
+                mask |= static_cast<uint64_t>(bits) << (16 * b);
+            }
+            masks[j] = mask & valid;
+        }
+    }
+
+    __attribute__((target("sse4.2,popcnt")))
+    void histogramRecordsSse42(const char* p, size_t len, const char* candidates, size_t n, char quote,
+                               bool complete, summarize::RecordHistogram& out) {
+        histogramRecordsImpl(p, len, candidates, n, quote, complete, out, blockMasksSse42);
+    }
+
+    const Kernels SSE42_KERNELS = {findAnySse42, countByteSse42, digitSpanSse42, histogramRecordsSse42};
+
+    __attribute__((target("avx2")))
+    const char* findAnyAvx2(const char* p, const char* end, char a, char b, char c) {
+        const __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b), vc = _mm256_set1_epi8(c);
+        for(; end - p >= 32; p += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, va), _mm256_cmpeq_epi8(block, vb)),
+                                           _mm256_cmpeq_epi8(block, vc));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(hits));
+            if(mask) return p + __builtin_ctz(mask);
+        }
+        return findAnySse42(p, end, a, b, c);
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    size_t countByteAvx2(const char* p, const char* end, char c) {
+        const __m256i needle = _mm256_set1_epi8(c);
+        size_t ret = 0;
+        for(; end - p >= 32; p += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+            ret += static_cast<size_t>(__builtin_popcount(mask));
+        }
+        return ret + countByteSse42(p, end, c);
+    }
+
+    __attribute__((target("avx2")))
+    size_t digitSpanAvx2(const char* p, const char* end) {
+        const __m256i below = _mm256_set1_epi8('0' - 1), above = _mm256_set1_epi8('9' + 1);
+        const char* begin = p;
+        for(; end - p >= 32; p += 32) {
+            __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i digits = _mm256_and_si256(_mm256_cmpgt_epi8(block, below), _mm256_cmpgt_epi8(above, block));
+            unsigned other = ~static_cast<unsigned>(_mm256_movemask_epi8(digits));
+            if(other) return static_cast<size_t>(p - begin) + static_cast<size_t>(__builtin_ctz(other));
+        }
+        return static_cast<size_t>(p - begin) + digitSpanSse42(p, end);
+    }
+
+    __attribute__((target("avx2")))
+    inline void blockMasksAvx2(const char* p, size_t len, const char* needles, size_t n, uint64_t* masks) {
+        alignas(32) char buffer[64];
+        uint64_t valid;
+        p = padBlock(p, len, buffer, valid);
+        const __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32));
+        for(size_t j = 0; j < n; j++) {
+            const __m256i needle = _mm256_set1_epi8(needles[j]);
+            uint64_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle))) |
+                            static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)))) << 32;
+            masks[j] = mask & valid;
+        }
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    void histogramRecordsAvx2(const char* p, size_t len, const char* candidates, size_t n, char quote,
+                              bool complete, summarize::RecordHistogram& out) {
+        histogramRecordsImpl(p, len, candidates, n, quote, complete, out, blockMasksAvx2);
+    }
+
+    const Kernels AVX2_KERNELS = {findAnyAvx2, countByteAvx2, digitSpanAvx2, histogramRecordsAvx2};
+
+    // AVX-512BW: masked loads cover the tail too, so short inputs need no scalar loop.
+    __attribute__((target("avx512bw")))
+    inline __mmask64 tailMask(const char* p, const char* end) {
+        size_t n = static_cast<size_t>(end - p);
+        return n >= 64 ? ~__mmask64(0) : (__mmask64(1) << n) - 1;
+    }
+
+    __attribute__((target("avx512bw")))
+    const char* findAnyAvx512(const char* p, const char* end, char a, char b, char c) {
+        const __m512i va = _mm512_set1_epi8(a), vb = _mm512_set1_epi8(b), vc = _mm512_set1_epi8(c);
+        for(; p < end; p += 64) {
+            __mmask64 valid = tailMask(p, end);
+            __m512i block = _mm512_maskz_loadu_epi8(valid, p);
+            __mmask64 hits = (_mm512_cmpeq_epi8_mask(block, va) | _mm512_cmpeq_epi8_mask(block, vb) |
+                              _mm512_cmpeq_epi8_mask(block, vc)) & valid;
+            if(hits) return p + __builtin_ctzll(hits);
+        }
+        return end;
+    }
+
+    __attribute__((target("avx512bw,popcnt")))
+    size_t countByteAvx512(const char* p, const char* end, char c) {
+        const __m512i needle = _mm512_set1_epi8(c);
+        size_t ret = 0;
+        for(; p < end; p += 64) {
+            __mmask64 valid = tailMask(p, end);
+            __m512i block = _mm512_maskz_loadu_epi8(valid, p);
+            ret += static_cast<size_t>(__builtin_popcountll(_mm512_cmpeq_epi8_mask(block, needle) & valid));
+        }
+        return ret;
+    }
+
+    __attribute__((target("avx512bw")))
+    size_t digitSpanAvx512(const char* p, const char* end) {
+        const __m512i zero = _mm512_set1_epi8('0'), nine = _mm512_set1_epi8('9');
+        const char* begin = p;
+        for(; p < end; p += 64) {
+            __mmask64 valid = tailMask(p, end);
+            __m512i block = _mm512_maskz_loadu_epi8(valid, p);
+            __mmask64 digits = _mm512_cmpge_epu8_mask(block, zero) & _mm512_cmple_epu8_mask(block, nine);
+            __mmask64 other = ~digits & valid;
+            if(other) return static_cast<size_t>(p - begin) + static_cast<size_t>(__builtin_ctzll(other));
+        }
+        return static_cast<size_t>(end - begin);
+    }
+
+    __attribute__((target("avx512bw")))
+    inline void blockMasksAvx512(const char* p, size_t len, const char* needles, size_t n, uint64_t* masks) {
+        __mmask64 valid = tailMask(p, p + len);
+        __m512i block = _mm512_maskz_loadu_epi8(valid, p);
+        for(size_t j = 0; j < n; j++) masks[j] = _mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8(needles[j])) & valid;
+    }
+
+    __attribute__((target("avx512bw,popcnt")))
+    void histogramRecordsAvx512(const char* p, size_t len, const char* candidates, size_t n, char quote,
+                                bool complete, summarize::RecordHistogram& out) {
+        histogramRecordsImpl(p, len, candidates, n, quote, complete, out, blockMasksAvx512);
+    }
+
+    const Kernels AVX512_KERNELS = {findAnyAvx512, countByteAvx512, digitSpanAvx512, histogramRecordsAvx512};
+#endif
+
+    const Kernels& kernelsOf(SimdLevel level) {
+#ifdef SUMMARIZE_X86_KERNELS
+        switch(level) {
+            case SimdLevel::AVX512BW: return AVX512_KERNELS;
+            case SimdLevel::AVX2: return AVX2_KERNELS;
+            case SimdLevel::SSE42: return SSE42_KERNELS;
+            default: break;
+        }
+#endif
+        return SCALAR_KERNELS;
+    }
+
+    std::atomic<SimdLevel> activeLevel(SimdLevel::SCALAR);
+
+    //! Pick the level on first use: the detected one, lowered by SUMMARIZE_SIMD if set.
+    const Kernels* resolve() {
+        SimdLevel level = summarize::detectSimdLevel();
+        if(const char* env = std::getenv("SUMMARIZE_SIMD")) {
+            SimdLevel forced;
+            if(summarize::parseSimdLevel(env, forced)) level = forced;
+            else std::cerr << "WARN: Unknown SUMMARIZE_SIMD level '" << env << "', ignoring it." << std::endl;
+        }
+        summarize::setSimdLevel(level);
+        return summarize::detail::activeKernels.load();
+    }
+
+    const char* findAnyResolve(const char* p, const char* end, char a, char b, char c) {
+        return resolve()->findAny(p, end, a, b, c);
+    }
+    size_t countByteResolve(const char* p, const char* end, char c) {
+        return resolve()->countByte(p, end, c);
+    }
+    size_t digitSpanResolve(const char* p, const char* end) {
+        return resolve()->digitSpan(p, end);
+    }
+
+    void histogramRecordsResolve(const char* p, size_t len, const char* candidates, size_t n, char quote,
+                                 bool complete, summarize::RecordHistogram& out) {
+        resolve()->histogramRecords(p, len, candidates, n, quote, complete, out);
+    }
+
+    const Kernels RESOLVE_KERNELS = {findAnyResolve, countByteResolve, digitSpanResolve, histogramRecordsResolve};
+}
+
+std::atomic<const summarize::Kernels*> summarize::detail::activeKernels(&RESOLVE_KERNELS);
+
+summarize::SimdLevel summarize::detectSimdLevel() {
+#ifdef SUMMARIZE_X86_KERNELS
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512bw")) return SimdLevel::AVX512BW;
+    if(__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if(__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) return SimdLevel::SSE42;
+#endif
+    return SimdLevel::SCALAR;
+}
+
+summarize::SimdLevel summarize::setSimdLevel(SimdLevel level) {
+    SimdLevel detected = detectSimdLevel();
+    if(level > detected) level = detected;
+    activeLevel.store(level);
+    detail::activeKernels.store(&kernelsOf(level));
+    return level;
+}
+
+summarize::SimdLevel summarize::getSimdLevel() {
+    if(detail::activeKernels.load() == &RESOLVE_KERNELS) resolve();
+    return activeLevel.load();
+}
+
+const char* summarize::simdLevelName(SimdLevel level) {
+    switch(level) {
+        case SimdLevel::AVX512BW: return "avx512bw";
+        case SimdLevel::AVX2: return "avx2";
+        case SimdLevel::SSE42: return "sse4.2";
+        default: return "scalar";
+    }
+}
+
+bool summarize::parseSimdLevel(const std::string& name, SimdLevel& level) {
+    for(SimdLevel l: {SimdLevel::SCALAR, SimdLevel::SSE42, SimdLevel::AVX2, SimdLevel::AVX512BW}) {
+        if(name == simdLevelName(l)) {
+            level = l;
+            return true;
+        }
+    }
+    return false;
+}
@@ -1,80 +1,497 @@
 
 #include <iostream>
 #include <fstream>
+#include <memory>
+#include <filesystem>
 
 #include <argparse.hpp>
 #include <tsvFile.hpp>
+#include <progress.hpp>
+#include <scanCache.hpp>
+#include <follow.hpp>
+#include <scheduler.hpp>
+#include <planner.hpp>
 
-int main(int argc, char** argv)
-{
-    // Parse command line arguments
-    argparse::ArgumentParser args("Summarize information in tsv/csv files.");
-    args.setSingleDashBehavior(argparse::ArgumentParser::START_POSITIONAL);
-    args.addOption<int>('n', "", "Number of lines to look for data types. If reading from stdin, this option is ignored.");
-    args.addOption<int>('p', "rows", "Number of rows to print.", 1);
-    args.addOption<bool>("noHeader", "Don't treat first line as header.", false, argparse::Option::STORE_TRUE);
-    args.addOption<char>('F', "sep", "Field separator.", '\t');
-    args.addOption<std::string>('m', "mode", "Program output mode.", "str", {"str", "summary"});
-    args.addArgument("file", "File to look at. If no file is given, read from stdin.", 0, 1);
-    if(!args.parseArgs(argc, argv))
-        return 1;
-
-    // read data
-    summarize::TsvFile tsvFile;
-    bool fileGiven = args.getArgument("file").getArgCount() > 0;
-    std::string filePath = fileGiven ? args.getArgumentValue("file") : "";
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <csignal>
 
+//! Apply the preview, statistics and delimiter options to \p tsvFile, which parses with the
+//! tasks of \p scheduler (may be nullptr).
+static void configureTsvFile(argparse::ArgumentParser& args, const std::string& filePath,
+                             summarize::Scheduler* scheduler, summarize::TsvFile& tsvFile) {
     // Only the rows that will be printed need to be held in memory; the rest of the
     // file is streamed through just to count it.
-    int previewRows = args.getOptionValue<int>("rows");
+    int previewRows = args.getOptionValue<int>(args.optionIsSet("sample") ? "sample" : "rows");
     tsvFile.setPreviewRows(previewRows < 0 ? 0 : static_cast<size_t>(previewRows));
+    tsvFile.setSample(args.optionIsSet("sample"));
+    if(args.optionIsSet("timeBudget"))
+        tsvFile.setTimeBudget(args.getOptionValue<double>("timeBudget") / 1000);
+    tsvFile.setCollectStats(args.getOptionValue("mode") == "summary" || args.getOptionValue<bool>("follow"));
+    int indexInterval = args.getOptionValue<int>("indexInterval");
+    tsvFile.setIndexInterval(indexInterval < 0 ? 0 : static_cast<size_t>(indexInterval));
+
+    tsvFile.setQuoting(args.getOptionValue("quoting") == "none" ? summarize::Quoting::NONE : summarize::Quoting::RFC4180);
+    tsvFile.setDetectHeader(args.getOptionValue("header") == "auto");
+    tsvFile.setScheduler(scheduler);
+    if(args.optionIsSet("columns")) {
+        summarize::ColumnSelection selection;
+        selection.parse(args.getOptionValue("columns"));        // checked by main
+        tsvFile.setSelection(selection);
+    }
+    if(args.optionIsSet("where")) {
+        summarize::RowFilter filter;
+        filter.parse(args.getOptionValue("where"));        // checked by main
+        tsvFile.setFilter(filter);
+    }
+
+    if(args.optionIsSet("sep")) {
+        // Explicit separator always wins.
+        tsvFile.setDelim(args.getOptionValue<char>("sep"));
+    } else {
+        // Otherwise infer the separator from the content, falling back to the file
+        // extension (.csv -> ',') or a tab for stdin.
+        char fallback = filePath.empty() ? '\t' : summarize::delimFromExtension(filePath);
+        tsvFile.sniffDelim(fallback);
+    }
+}
+
+//! Whether the first record may be a header: --noHeader and --header no rule it out.
+static bool headerRequested(argparse::ArgumentParser& args) {
+    return !args.getOptionValue<bool>("noHeader") && args.getOptionValue("header") != "no";
+}
+
+//! How input is read: \p planned, overridden by --blockSize and by --queueDepth,
+//! --readAhead and --directIo where they were given.
+static summarize::BlockReaderOptions readerOptions(argparse::ArgumentParser& args,
+                                                   const summarize::BlockReaderOptions& planned) {
+    summarize::BlockReaderOptions options = planned;
+    int blockSize = args.getOptionValue<int>("blockSize");
+    options.blockSize = blockSize < 1 ? summarize::DEFAULT_BLOCK_SIZE : static_cast<size_t>(blockSize) * 1024;
+    if(args.optionIsSet("queueDepth")) {
+        int queueDepth = args.getOptionValue<int>("queueDepth");
+        options.queueDepth = queueDepth < 0 ? 0 : static_cast<size_t>(queueDepth);
+    }
+    if(args.optionIsSet("readAhead")) options.uring = args.getOptionValue("readAhead") != "thread";
+    if(args.optionIsSet("directIo")) options.direct = args.getOptionValue<bool>("directIo");
+    return options;
+}
+
+//! What the planner needs to know about \p filePath (empty for stdin) and the output asked for.
+static summarize::InputFacts inputFacts(argparse::ArgumentParser& args, const std::string& filePath) {
+    summarize::InputFacts facts;
+    summarize::probeInput(filePath, facts);     // a file that can not be opened fails when read
+    facts.stats = args.getOptionValue("mode") == "summary";
+    if(args.optionIsSet("tail")) facts.partial = "tail";
+    else if(args.getOptionValue<bool>("approx")) facts.partial = "approximate read";
+    else if(args.optionIsSet("n") && !filePath.empty()) facts.partial = "first " + args.getOptionValue("n") + " records";
+    else if(args.optionIsSet("sample")) facts.partial = "sampled read";
+    else if(args.optionIsSet("timeBudget")) facts.partial = "time limited read";
+    return facts;
+}
+
+//! Print \p tsvFile in the selected output mode. \return false if its groups were lost or
+//! --columnOffset is past its last column.
+static bool printTsvFile(argparse::ArgumentParser& args, const std::string& label,
+                         const summarize::TsvFile& tsvFile) {
+    if(args.optionIsSet("groupBy")) {
+        std::cout << label << ": ";
+        return tsvFile.printGroups();
+    }
+    int columnOffset = args.getOptionValue<int>("columnOffset");
+    int maxColumns = args.getOptionValue<int>("maxColumns");
+    size_t firstColumn = columnOffset < 0 ? 0 : static_cast<size_t>(columnOffset);
+    size_t nColumns = maxColumns < 0 ? 0 : static_cast<size_t>(maxColumns);
+    if(firstColumn > 0 && firstColumn >= tsvFile.getNCols()) {
+        std::cerr << "ERROR: --columnOffset " << firstColumn << " is past the last column of " << label
+                  << " (" << tsvFile.getNCols() << " columns)." << std::endl;
+        return false;
+    }
+    if(args.getOptionValue("mode") == "summary") {
+        tsvFile.printSummary(firstColumn, nColumns);
+    } else {
+        std::cout << label << ": ";
+        const char* rowsOption = args.optionIsSet("tail") ? "tail" : (args.optionIsSet("sample") ? "sample" : "rows");
+        tsvFile.printStructure(args.getOptionValue<int>(rowsOption), firstColumn, nColumns);
+    }
+    return true;
+}
+
+//! Tell the user when --header auto read the first record of \p label as data, although
+//! \p hasHeader asked for a header.
+static void warnHeaderDemoted(const std::string& label, bool hasHeader, const summarize::TsvFile& tsvFile) {
+    if(!hasHeader || tsvFile.getHasHeader()) return;
+    std::cerr << "WARN: The first line of " << label << " looks like data, so it was read as a row; "
+              << "pass --header yes to read it as the header." << std::endl;
+}
+
+//! Read one input into \p tsvFile, grouping its rows into \p groups with --groupBy. An
+//! empty \p filePath means stdin.
+static bool readInput(argparse::ArgumentParser& args, const std::string& filePath,
+                      summarize::ProgressReporter* progress, summarize::Scheduler* scheduler,
+                      const summarize::Planner& planner, summarize::TsvFile& tsvFile, summarize::GroupBy& groups) {
+    bool fileGiven = !filePath.empty();
+    tsvFile.setProgress(progress);
+    if(progress) progress->setInput(fileGiven ? filePath : "stdin");
+    configureTsvFile(args, filePath, scheduler, tsvFile);
+    if(args.optionIsSet("groupBy")) {
+        groups.parse(args.getOptionValue("groupBy"));        // checked by main
+        int memory = args.getOptionValue<int>("groupMemory");
+        groups.setMemoryLimit(memory < 1 ? 1 : static_cast<size_t>(memory) << 20);
+        tsvFile.setGroupBy(&groups);
+    }
+
+    summarize::ExecutionPlan plan = planner.plan(inputFacts(args, filePath), scheduler ? scheduler->getThreads() : 1);
+    plan.io = readerOptions(args, plan.io);
+    plan.sample.quoting = tsvFile.getQuoting() == summarize::Quoting::RFC4180;
+    tsvFile.setPlanner(&planner, plan);
+    if(!plan.input.compression.empty()) {
+        std::cerr << "WARN: " << (fileGiven ? filePath : "stdin") << " looks " << plan.input.compression
+                  << " compressed; decompress it first (e.g. zcat file | summarize)." << std::endl;
+    }
 
     if(fileGiven && summarize::hasParquetExtension(filePath)) {
         // Parquet is columnar and self-describing, so the delimiter / header options
         // do not apply; read it directly through Arrow.
+        if(args.optionIsSet("columns"))
+            std::cerr << "WARN: --columns does not apply to parquet input; reading every column." << std::endl;
+        if(args.optionIsSet("where"))
+            std::cerr << "WARN: --where does not apply to parquet input; reading every row." << std::endl;
+        if(args.optionIsSet("groupBy")) {
+            std::cerr << "ERROR: --groupBy does not apply to parquet input." << std::endl;
+            return false;
+        }
 #ifdef ENABLE_PARQUET
         if(!tsvFile.readParquet(filePath)) {
             std::cerr << "Could not read parquet file!\n";
-            return 1;
+            return false;
         }
+        // Only the footer is read; count the whole file as consumed.
+        std::error_code ec;
+        size_t size = std::filesystem::file_size(filePath, ec);
+        if(progress && !ec) progress->addBytes(size);
 #else
         std::cerr << "Parquet support was not enabled in this build.\n";
-        return 1;
+        return false;
 #endif
     } else {
-        if(args.optionIsSet("sep")) {
-            // Explicit separator always wins.
-            tsvFile.setDelim(args.getOptionValue<char>("sep"));
-        } else {
-            // Otherwise infer the separator from the content, falling back to the file
-            // extension (.csv -> ',') or a tab for stdin.
-            char fallback = fileGiven ? summarize::delimFromExtension(filePath) : '\t';
-            tsvFile.sniffDelim(fallback);
-        }
-        bool hasHeader = !args.getOptionValue<bool>("noHeader");
-        if(!fileGiven) {
-            if(!tsvFile.read(std::cin, hasHeader)) {
+        bool hasHeader = headerRequested(args);
+        if(args.optionIsSet("tail")) {
+            int tail = args.getOptionValue<int>("tail");
+            std::ifstream inF;
+            if(fileGiven) inF.open(filePath, std::ios::binary);
+            if(!tsvFile.readTail(fileGiven ? inF : std::cin, tail < 0 ? 0 : static_cast<size_t>(tail), hasHeader)) {
+                std::cerr << "Could not read table from " << (fileGiven ? "file" : "stdin") << "!\n";
+                return false;
+            }
+        } else if(args.getOptionValue<bool>("approx")) {
+            summarize::ApproxOptions options;
+            int blocks = args.getOptionValue<int>("approxBlocks");
+            options.maxBlocks = blocks < 0 ? 0 : static_cast<size_t>(blocks);
+            options.maxSeconds = args.getOptionValue<double>("approxSeconds");
+            std::ifstream inF;
+            if(fileGiven) inF.open(filePath, std::ios::binary);
+            if(!tsvFile.readApprox(fileGiven ? inF : std::cin, options, hasHeader)) {
+                std::cerr << "Could not read table from " << (fileGiven ? "file" : "stdin") << "!\n";
+                return false;
+            }
+        } else if(!fileGiven) {
+            summarize::BlockReader reader(std::cin.rdbuf(), plan.io);
+            if(!tsvFile.read(reader, hasHeader)) {
                 std::cerr << "Could not read table from stdin!\n";
-                return 1;
+                return false;
             }
         } else {
-            std::ifstream inF(filePath);
-            bool success = args.optionIsSet("n") ? tsvFile.read(inF, args.getOptionValue<int>("n"), hasHeader)
-                                                 : tsvFile.read(inF, hasHeader);
+            bool success;
+            summarize::BlockReader reader;
+            if(args.optionIsSet("n")) {
+                success = reader.open(filePath, plan.io) &&
+                          tsvFile.read(reader, args.getOptionValue<int>("n"), hasHeader);
+            } else if(args.optionIsSet("cacheDir")) {
+                // Only complete scans are cached.
+                summarize::ScanCache cache(args.getOptionValue("cacheDir"));
+                cache.setIncremental(args.getOptionValue<bool>("incremental"));
+                success = cache.read(filePath, tsvFile, hasHeader);
+            } else {
+                success = reader.open(filePath, plan.io) && tsvFile.read(reader, hasHeader);
+            }
             if(!success) {
                 std::cerr << "Could not read table from file!\n";
+                return false;
+            }
+        }
+        warnHeaderDemoted(fileGiven ? filePath : "stdin", hasHeader, tsvFile);
+        int skip = args.getOptionValue<int>("skip");
+        if(skip > 0 && !args.optionIsSet("tail")) {
+            // The scan only kept the first rows; fetch the requested ones from the file.
+            std::ifstream inF(filePath, std::ios::binary);
+            if(!fileGiven) {
+                std::cerr << "WARN: --skip needs a file argument; showing the first rows." << std::endl;
+            } else if(!tsvFile.seekPreview(inF, static_cast<size_t>(skip))) {
+                std::cerr << "WARN: Only " << tsvFile.getNRows() << " rows, nothing left after skipping "
+                          << skip << "." << std::endl;
+            }
+        }
+    }
+
+    return true;
+}
+
+//! An input of summarizeInputs, read by a task.
+struct Input {
+    summarize::TsvFile tsvFile;
+    summarize::GroupBy groups;
+    bool ok = false;
+    std::atomic<bool> done{false};
+};
+
+//! Read and print every input, in order. With a scheduler the inputs are read by its tasks,
+//! each printed once it and those before it were read. \return false if any failed.
+static bool summarizeInputs(argparse::ArgumentParser& args, const std::vector<std::string>& filePaths,
+                            summarize::ProgressReporter* progress, summarize::Scheduler* scheduler,
+                            const summarize::Planner& planner) {
+    std::vector<Input> inputs(filePaths.size());
+    for(size_t i = 0; i < inputs.size() && scheduler; i++) {
+        scheduler->submit([&args, &filePaths, &inputs, &planner, progress, scheduler, i]() {
+            inputs[i].ok = readInput(args, filePaths[i], progress, scheduler, planner, inputs[i].tsvFile,
+                                     inputs[i].groups);
+            inputs[i].done.store(true, std::memory_order_release);
+        });
+    }
+    bool ret = true;
+    for(size_t i = 0; i < inputs.size(); i++) {
+        Input& input = inputs[i];
+        if(scheduler) scheduler->waitUntil([&input]() { return input.done.load(std::memory_order_acquire); });
+        else input.ok = readInput(args, filePaths[i], progress, scheduler, planner, input.tsvFile, input.groups);
+        if(args.getOptionValue<bool>("explain"))
+            input.tsvFile.getPlan().print(std::cerr);
+        if(!input.ok) {
+            ret = false;
+            continue;
+        }
+        if(args.getOptionValue<bool>("profile"))
+            input.tsvFile.getProfile().print(std::cerr);
+        if(!printTsvFile(args, filePaths[i].empty() ? "stdin" : filePaths[i], input.tsvFile)) ret = false;
+    }
+    return ret;
+}
+
+//! Write the selected columns of every input to stdout (--cut). \return false if any failed.
+static bool cutInputs(argparse::ArgumentParser& args, const std::vector<std::string>& filePaths,
+                      const summarize::Planner& planner) {
+    bool ret = true;
+    for(const auto& path: filePaths) {
+        summarize::TsvFile tsvFile;
+        configureTsvFile(args, path, nullptr, tsvFile);
+        summarize::BlockReaderOptions options = readerOptions(args, planner.plan(inputFacts(args, path), 1).io);
+        bool success;
+        if(path.empty()) {
+            summarize::BlockReader reader(std::cin.rdbuf(), options);
+            success = tsvFile.extract(reader, std::cout, headerRequested(args));
+        } else {
+            summarize::BlockReader reader;
+            success = reader.open(path, options) && tsvFile.extract(reader, std::cout, headerRequested(args));
+        }
+        if(!success) {
+            std::cerr << "Could not extract columns from " << (path.empty() ? "stdin" : path) << "!\n";
+            ret = false;
+        } else {
+            warnHeaderDemoted(path.empty() ? "stdin" : path, headerRequested(args), tsvFile);
+        }
+    }
+    return ret;
+}
+
+static std::atomic<bool> stopFollowing(false);
+
+static void onInterrupt(int) {
+    stopFollowing = true;
+}
+
+//! Print each file, then keep printing it as it grows until interrupted.
+static int followInputs(argparse::ArgumentParser& args, const std::vector<std::string>& filePaths,
+                        summarize::Scheduler* scheduler) {
+    for(const auto& path: filePaths) {
+        if(path.empty() || summarize::hasParquetExtension(path)) {
+            std::cerr << "ERROR: --follow needs delimited text files, not stdin or parquet." << std::endl;
+            return 1;
+        }
+    }
+    double interval = args.getOptionValue<double>("interval");
+    summarize::Follower follower(
+        [&args, scheduler](const std::string& path, summarize::TsvFile& file) {
+            configureTsvFile(args, path, scheduler, file);
+        },
+        headerRequested(args), static_cast<int>(interval * 1000));
+    for(const auto& path: filePaths) follower.addFile(path);
+
+    std::signal(SIGINT, onInterrupt);
+    std::signal(SIGTERM, onInterrupt);
+    follower.run(stopFollowing, [&args](const std::string& path, const summarize::TsvFile& file) {
+        std::cout << "==> " << path << " <==\n";
+        printTsvFile(args, path, file);
+        std::cout << std::endl;
+    });
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    // Parse command line arguments
+    argparse::ArgumentParser args("Summarize information in tsv/csv files.");
+    args.setSingleDashBehavior(argparse::ArgumentParser::START_POSITIONAL);
+    args.addOption<int>('n', "", "Number of lines to look for data types. If reading from stdin, this option is ignored.");
+    args.addOption<int>('p', "rows", "Number of rows to print.", 1);
+    args.addOption<int>("skip", "Number of data rows to skip before the rows printed.", 0);
+    args.addOption<int>("indexInterval", "Record the offset of every N'th row while scanning so --skip "
+                        "can seek close to any row. 0 disables the index.", 65536);
+    args.addOption<int>('\0', "sample", "Print a uniform random sample of N rows from the whole file "
+                        "instead of the first rows.");
+    args.addOption<int>('\0', "tail", "Print the last N rows. Seekable files are read backwards from the end, "
+                        "so the row count is estimated for large files.");
+    args.addOption<bool>("approx", "Estimate the row count and statistics of large files from random blocks "
+                         "instead of reading all of them.", false, argparse::Option::STORE_TRUE);
+    args.addOption<int>("approxBlocks", "Maximum number of 64 KiB blocks read by --approx.", 64);
+    args.addOption<double>("approxSeconds", "Time budget of --approx in seconds.", 1.0);
+    args.addOption<double>('\0', "timeBudget", "Stop reading after this many milliseconds and print "
+                           "partial results, with the row count extrapolated from the bytes read.");
+    args.addOption<bool>("noHeader", "Don't treat first line as header. Same as --header no.",
+                         false, argparse::Option::STORE_TRUE);
+    args.addOption<std::string>("header", "Whether the first line is a header: 'auto' treats it as data "
+                                "when it has the types of the rows below it.", "auto", {"auto", "yes", "no"});
+    args.addOption<char>('F', "sep", "Field separator.", '\t');
+    args.addOption<std::string>("quoting", "Quoting rules of the input: 'rfc4180' quoted fields, or 'none' "
+                                "to read quote characters as data (IANA TSV), which parses faster.",
+                                "rfc4180", {"rfc4180", "none"});
+    args.addOption<int>("blockSize", "Size in KiB of the blocks input is read in.", 64);
+    args.addOption<int>('\0', "queueDepth", "Number of blocks read ahead while the current one is parsed. "
+                        "0 reads each block when it is needed. By default chosen for each input from its size, "
+                        "and for files from how much of them is in the page cache.");
+    args.addOption<std::string>("readAhead", "How blocks are read ahead: 'auto' uses io_uring for files where "
+                                "the kernel supports it and a reader thread otherwise.", "auto", {"auto", "thread"});
+    args.addOption<bool>("directIo", "Read files with O_DIRECT, bypassing the page cache (for large files "
+                         "read once). By default used for files larger than half the memory and mostly not "
+                         "cached.", false, argparse::Option::STORE_TRUE);
+    args.addOption<int>("threads", "Number of worker threads. Above 1 inputs are read in parallel, and each "
+                        "full read, even of stdin, is parsed in batches of whole records by the same workers "
+                        "where the planner estimates it is faster. 0 starts as many as the inputs are worth, "
+                        "up to one per core.", 0);
+    args.addOption<std::string>('m', "mode", "Program output mode.", "str", {"str", "summary"});
+    args.addOption<std::string>('\0', "columns", "Only read these columns, in this order: a comma separated "
+                                "list of names, 1 based index ranges (3, 5-8, 10-) and /regex/ searched for in "
+                                "the names. The fields of the other columns are skipped while parsing.");
+    args.addOption<std::string>('\0', "where", "Only count, preview and summarize the rows matching this "
+                                "filter, e.g. \"status = FAILED AND latency > 500\". Tests are =, !=, <, <=, >, "
+                                ">=, ^= (starts with), BETWEEN a AND b and IS [NOT] NULL, combined with AND, OR, "
+                                "NOT and parentheses. Numbers compare numerically, 'quoted' values as strings.");
+    args.addOption<std::string>('\0', "groupBy", "Print the row count and the mean of every numeric column "
+                                "per distinct value of these key columns (a list like --columns), instead of "
+                                "the columns.");
+    args.addOption<int>("groupMemory", "MiB the --groupBy groups may hold before they are spilled to "
+                        "temporary files.", 1024);
+    args.addOption<bool>("cut", "Write the --columns (or all columns) of every record, or of those matching "
+                         "--where, to stdout, delimited and quoted as the input, instead of summarizing it.",
+                         false, argparse::Option::STORE_TRUE);
+    args.addOption<int>("maxColumns", "Print at most this many columns per input, for very wide tables. "
+                        "0 prints all of them.", 1000);
+    args.addOption<int>("columnOffset", "Number of columns to skip before the ones printed, to page "
+                        "through wide tables with --maxColumns.", 0);
+    args.addOption<bool>("profile", "Print time and heap allocations per scan phase to stderr.",
+                         false, argparse::Option::STORE_TRUE);
+    args.addOption<bool>("explain", "Print how each input is read and parsed, and the estimates the plan "
+                         "was chosen by, to stderr.", false, argparse::Option::STORE_TRUE);
+    args.addOption<bool>("progress", "Report bytes read, records/s and ETA on stderr. "
+                         "Periodic log lines are printed instead when stderr is not a terminal.",
+                         false, argparse::Option::STORE_TRUE);
+    args.addOption<std::string>('\0', "cacheDir", "Directory for cached scan results. Unchanged files are "
+                                "answered from the cache instead of being rescanned.");
+    args.addOption<bool>("incremental", "With --cacheDir, only parse the bytes appended to a file since "
+                         "its cache entry was written.", false, argparse::Option::STORE_TRUE);
+    args.addOption<bool>("follow", "Keep watching the files and print their statistics again as they grow, "
+                         "like tail -f. Stop with Ctrl-C.", false, argparse::Option::STORE_TRUE);
+    args.addOption<double>("interval", "Seconds between refreshes in --follow mode.", 1.0);
+    args.addArgument("file", "File(s) to look at. If no file is given, read from stdin.", 0, std::string::npos);
+    if(!args.parseArgs(argc, argv))
+        return 1;
+
+    std::vector<std::string> filePaths;
+    for(const auto& value: args.getArgument("file"))
+        filePaths.push_back(value.getValue());
+    if(filePaths.empty()) filePaths.emplace_back();     // stdin
+
+    if(args.optionIsSet("columns")) {
+        summarize::ColumnSelection selection;
+        if(!selection.parse(args.getOptionValue("columns"))) return 1;
+    }
+    if(args.optionIsSet("where")) {
+        summarize::RowFilter filter;
+        if(!filter.parse(args.getOptionValue("where"))) return 1;
+    }
+    if(args.optionIsSet("groupBy")) {
+        summarize::GroupBy groups;
+        if(!groups.parse(args.getOptionValue("groupBy"))) return 1;
+        if(args.getOptionValue<bool>("cut")) {
+            std::cerr << "ERROR: --groupBy can not be combined with --cut." << std::endl;
+            return 1;
+        }
+    }
+    if(args.getOptionValue("quoting") == "none" && args.getOptionValue<bool>("approx")) {
+        std::cerr << "ERROR: --approx can not be combined with --quoting none." << std::endl;
+        return 1;
+    }
+    for(const char* projection: {"columns", "where", "groupBy"}) {
+        if(!args.optionIsSet(projection)) continue;
+        for(const char* option: {"tail", "approx", "cacheDir", "follow"}) {
+            if(args.optionIsSet(option)) {
+                std::cerr << "ERROR: --" << projection << " can not be combined with --" << option << "." << std::endl;
                 return 1;
             }
         }
     }
 
-    // print summary data
-    if(args.getOptionValue("mode") == "summary") {
-        tsvFile.printSummary();
+    // One scheduler runs every parallel task: the inputs, and the batches of each. Unless
+    // --threads says otherwise, it has as many workers as the planner estimates the inputs
+    // are worth: none for a few small files.
+    summarize::Planner planner(std::max(1u, std::thread::hardware_concurrency()));
+    if(args.getOptionValue<bool>("cut"))
+        return cutInputs(args, filePaths, planner) ? 0 : 1;
+    int threads = args.getOptionValue<int>("threads");
+    size_t nThreads;
+    if(threads > 0) {
+        nThreads = static_cast<size_t>(threads);
     } else {
-        std::cout << (fileGiven ? filePath : "stdin") << ": ";
-        tsvFile.printStructure(args.getOptionValue<int>("rows"));
+        std::vector<summarize::InputFacts> facts;
+        for(const auto& path: filePaths) facts.push_back(inputFacts(args, path));
+        nThreads = planner.planThreads(facts);
     }
+    if(args.getOptionValue<bool>("explain"))
+        std::cerr << "Plan: " << nThreads << " worker thread" << (nThreads == 1 ? "" : "s") << " of "
+                  << planner.getCores() << " cores" << (threads > 0 ? " (--threads)" : "") << std::endl;
+    std::unique_ptr<summarize::Scheduler> scheduler;
+    if(nThreads > 1) scheduler = std::make_unique<summarize::Scheduler>(nThreads);
 
-    return 0;
+    if(args.getOptionValue<bool>("follow"))
+        return followInputs(args, filePaths, scheduler.get());
+
+    std::unique_ptr<summarize::ProgressReporter> progress;
+    if(args.getOptionValue<bool>("progress")) {
+        progress = std::make_unique<summarize::ProgressReporter>();
+        size_t totalBytes = 0;
+        for(const auto& path: filePaths) {
+            std::error_code ec;
+            size_t size = path.empty() ? 0 : std::filesystem::file_size(path, ec);
+            if(ec || path.empty()) { totalBytes = 0; break; }   // unknown size: no ETA
+            totalBytes += size;
+        }
+        progress->setTotalBytes(totalBytes);
+        progress->setNInputs(filePaths.size());
+        progress->start();
+    }
+
+    int ret = summarizeInputs(args, filePaths, progress.get(), scheduler.get(), planner) ? 0 : 1;
+    if(progress) progress->stop();
+    if(scheduler && args.getOptionValue<bool>("profile")) scheduler->print(std::cerr);
+
+    return ret;
 }
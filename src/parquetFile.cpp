@@ -13,6 +13,39 @@
 
 #include <tsvFile.hpp>
 
+namespace {
+    //! Rows per Arrow batch when scanning the whole file for column statistics.
+    const int64_t STATS_BATCH_SIZE = 1 << 16;
+
+    //! Map an Arrow type to the closest summarize column type.
+    summarize::ColumnStats::TYPE arrowToType(arrow::Type::type id) {
+        switch(id) {
+            case arrow::Type::BOOL:
+                return summarize::ColumnStats::BOOL;
+            case arrow::Type::INT8: case arrow::Type::INT16: case arrow::Type::INT32: case arrow::Type::INT64:
+            case arrow::Type::UINT8: case arrow::Type::UINT16: case arrow::Type::UINT32: case arrow::Type::UINT64:
+                return summarize::ColumnStats::INT;
+            case arrow::Type::HALF_FLOAT: case arrow::Type::FLOAT: case arrow::Type::DOUBLE:
+                return summarize::ColumnStats::FLOAT;
+            default:
+                return summarize::ColumnStats::STRING;
+        }
+    }
+
+    //! Add every value of \p column to \p stats.
+    void addColumn(const arrow::Array& column, summarize::ColumnStats& stats) {
+        for(int64_t row = 0; row < column.length(); row++) {
+            if(column.IsNull(row)) {
+                stats.addMissing();
+                continue;
+            }
+            arrow::Result<std::shared_ptr<arrow::Scalar> > scalar = column.GetScalar(row);
+            if(scalar.ok()) stats.add((*scalar)->ToString());
+            else stats.addMissing();
+        }
+    }
+}
+
 bool summarize::TsvFile::readParquet(const std::string& path) {
     arrow::Result<std::shared_ptr<arrow::io::ReadableFile> > infile =
         arrow::io::ReadableFile::Open(path);
@@ -21,9 +54,12 @@ bool summarize::TsvFile::readParquet(const std::string& path) {
         return false;
     }
 
-    // Cap the Arrow batch size so only the preview rows are ever materialized.
+    // Cap the Arrow batch size so only the preview rows are ever materialized, unless
+    // statistics are requested, in which case every batch is scanned.
     parquet::ArrowReaderProperties props;
-    props.set_batch_size(_previewRows < 1 ? 1 : static_cast<int64_t>(_previewRows));
+    int64_t batchSize = _previewRows < 1 ? 1 : static_cast<int64_t>(_previewRows);
+    if(_collectStats) batchSize = std::max(batchSize, STATS_BATCH_SIZE);
+    props.set_batch_size(batchSize);
 
     parquet::arrow::FileReaderBuilder builder;
     arrow::Status status = builder.Open(*infile);
@@ -50,10 +86,10 @@ bool summarize::TsvFile::readParquet(const std::string& path) {
         std::cerr << "ERROR: " << status.ToString() << std::endl;
         return false;
     }
-    for(int i = 0; i < schema->num_fields(); i++)
+    for(int i = 0; i < schema->num_fields(); i++) {
         _headers.push_back(schema->field(i)->name());
-    for(size_t i = 0; i < _headers.size(); i++)
-        _headerMap[_headers[i]] = i;
+        _dataTypes.push_back(arrowToType(schema->field(i)->type()->id()));
+    }
 
     // Read a single (capped) batch for the preview values.
     arrow::Result<std::shared_ptr<arrow::RecordBatchReader> > batchReader =
@@ -71,16 +107,38 @@ bool summarize::TsvFile::readParquet(const std::string& path) {
 
     size_t previewN = batch ? std::min(_previewRows, static_cast<size_t>(batch->num_rows())) : 0;
 
-    // Populate _data column-wise, stringifying each retained cell.
-    for(int col = 0; col < schema->num_fields(); col++) {
-        _data.emplace_back();
-        if(!batch) continue;
+    // Populate _preview (row major) column by column, stringifying each retained cell.
+    size_t nCols = _headers.size();
+    _preview.assign(batch ? previewN * nCols : 0, std::string());
+    for(int col = 0; col < schema->num_fields() && batch; col++) {
         std::shared_ptr<arrow::Array> column = batch->column(col);
         for(size_t row = 0; row < previewN; row++) {
             arrow::Result<std::shared_ptr<arrow::Scalar> > scalar = column->GetScalar(row);
-            if(scalar.ok()) _data[col].push_back((*scalar)->ToString());
-            else _data[col].emplace_back();
+            if(scalar.ok()) _preview[row * nCols + static_cast<size_t>(col)] = (*scalar)->ToString();
+        }
+    }
+
+    if(_collectStats) {
+        _stats.resize(_headers.size());
+        _startDeadline();
+        size_t rowsScanned = 0;
+        while(batch) {
+            if(std::chrono::steady_clock::now() >= _deadline) {
+                // _nRows is exact (from the footer); only the statistics are partial.
+                _partial.valid = true;
+                _partial.rows = rowsScanned;
+                break;
+            }
+            for(int col = 0; col < batch->num_columns(); col++)
+                addColumn(*batch->column(col), _stats[col]);
+            rowsScanned += static_cast<size_t>(batch->num_rows());
+            status = (*batchReader)->ReadNext(&batch);
+            if(!status.ok()) {
+                std::cerr << "ERROR: " << status.ToString() << std::endl;
+                return false;
+            }
         }
+        _deadline = std::chrono::steady_clock::time_point::max();
     }
 
     return true;
@@ -0,0 +1,410 @@
+//
+// Pipelined full reads (TsvFile::setScheduler). A single input, even one that can not be
+// seeked or split ahead of time such as a decompressor piped to stdin, is read in stages:
+//
+//   reader -> splitter -> parse tasks -> merge
+//
+// The BlockReader reads ahead as usual. The splitter copies its blocks into batches of
+// whole records, finding record boundaries with the quoting rules of the parser but
+// without splitting fields, and counts the data rows of each batch so every batch knows
+// the number of its first row. Each batch is parsed by a task of the Scheduler into
+// partial column statistics, preview rows and record index entries, and the merge folds
+// those into the TsvFile in input order.
+//
+// The splitter and the merge run on the calling thread (a worker itself when the read is
+// a task, which then parses batches while it waits). Batches are parsed in a ring of
+// slots: once the ring is full the oldest batch is merged before another is split, so a
+// slow stage stalls the ones before it rather than buffering the input.
+//
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include <tsvFile.hpp>
+#include <scheduler.hpp>
+
+namespace summarize {
+
+    //! Records of the input handed through the pipeline, and what parsing them found.
+    struct PipelineBatch {
+        //! Whole records, starting \p offset bytes into the scan.
+        std::string text;
+        size_t offset = 0;
+        //! Data row number of the first data row, and the number of data rows.
+        size_t firstRow = 0;
+        size_t rows = 0;
+        //! The first record of the batch is the header.
+        bool header = false;
+        //! The batch holds only a final record without a line terminator.
+        bool unterminated = false;
+
+        //! Records parsed (with the header), and the widest and narrowest data row.
+        size_t records = 0;
+        //! Data rows the filter (if any) matched and rejected; matched is rows without one.
+        size_t matched = 0;
+        size_t filtered = 0;
+        size_t largestRow = 0;
+        size_t minFields = SIZE_MAX;
+        std::vector<std::string> headerRecord;
+        //! Rows of the preview, which start the batch as the preview is the first rows.
+        //! With a filter, the first matches of the batch, as many as the preview holds.
+        std::vector<std::vector<std::string> > preview;
+        //! Scan offsets of the indexed rows.
+        std::vector<size_t> index;
+        std::vector<ColumnStats> stats;
+        //! Groups of the data rows (see TsvFile::setGroupBy).
+        GroupTable groups;
+        std::vector<std::string> scratch;
+        //! Set by the task parsing the batch once it is done.
+        std::atomic<bool> parsed{false};
+    };
+}
+
+namespace {
+    using summarize::PipelineBatch;
+
+    //! Batches in flight per worker. Two keep each worker busy while the merge works
+    //! through the batch before.
+    const size_t BATCHES_PER_WORKER = 2;
+
+    //! Cuts the blocks of a BlockReader into batches of whole records. It follows the
+    //! quote state of the parser (a quote opens a quoted field only at the start of a
+    //! field, and "" inside one is literal) by looking only at quotes and line terminators.
+    class RecordSplitter {
+    private:
+        summarize::BlockReader& _reader;
+        char _delim;
+        char _quote;
+        bool _quoting;
+        size_t _batchBytes;
+
+        //! Inside a quoted field, and the last block ended on a quote inside one (either
+        //! a closing quote or the first of "").
+        bool _inQuotes;
+        bool _afterQuote;
+        //! The last block ended on a \r ending a record, which a leading \n still belongs to.
+        bool _afterCr;
+        //! The current record has content (blank lines are not records), and its last byte.
+        bool _inRecord;
+        char _prev;
+        bool _headerPending;
+
+        //! The rest of the last block read, and whether the input is exhausted.
+        const char* _p;
+        const char* _end;
+        bool _atEnd;
+        //! A final record without a line terminator, split off to a batch of its own.
+        std::string _unterminated;
+        bool _unterminatedPending;
+
+        PipelineBatch* _batch;
+        //! Bytes of the scan and data rows before the batch being filled.
+        size_t _offset;
+        size_t _rows;
+        //! Offset in _batch->text of the current record.
+        size_t _recordStart;
+
+        //! The current record ended just before \p p.
+        void _endRecord(const char* p, const char* from) {
+            if(_inRecord) {
+                if(_headerPending) {
+                    _batch->header = true;
+                    _headerPending = false;
+                } else _batch->rows++;
+            }
+            _inRecord = false;
+            _prev = '\n';
+            _recordStart = _batch->text.size() + static_cast<size_t>(p - from);
+            boundary = _offset + _recordStart;
+        }
+        //! Scan the rest of the block for records. \return true if the batch was cut.
+        bool _scanBlock() {
+            const char* p = _p;
+            const char* end = _end;
+            const char* from = p;
+            while(p != end) {
+                if(_afterQuote) {
+                    _afterQuote = false;
+                    if(*p == _quote) {
+                        p++;                    // "" is a literal quote
+                        continue;
+                    }
+                    _inQuotes = false;
+                    _prev = _quote;
+                }
+                if(_inQuotes) {
+                    const char* q = static_cast<const char*>(std::memchr(p, _quote, static_cast<size_t>(end - p)));
+                    if(!q) {
+                        p = end;
+                        break;
+                    }
+                    p = q + 1;
+                    _afterQuote = true;
+                    continue;
+                }
+                const char* q = _quoting ? summarize::findAny(p, end, _quote, '\n', '\r') :
+                                summarize::findAny(p, end, '\n', '\r', '\r');
+                if(q != p) {
+                    _inRecord = true;
+                    _prev = q[-1];
+                }
+                p = q;
+                if(p == end) break;
+                char c = *p++;
+                if(c == _quote && _quoting) {
+                    // Only a quote at the start of a field opens a quoted one.
+                    if(!_inRecord || _prev == _delim) _inQuotes = true;
+                    _inRecord = true;
+                    _prev = c;
+                    continue;
+                }
+                if(c == '\r') {
+                    if(p == end) _afterCr = true;
+                    else if(*p == '\n') p++;
+                }
+                bool blank = !_inRecord;
+                _endRecord(p, from);
+                // A batch is cut after a record, unless a \n of its \r\n may still follow.
+                // Blank lines stay with the record after them, which the parser's record
+                // offsets (and so the index) start at.
+                size_t batchSize = _batch->text.size() + static_cast<size_t>(p - from);
+                if(!blank && !_afterCr && batchSize >= _batchBytes) {
+                    _batch->text.append(from, p);
+                    _p = p;
+                    return true;
+                }
+            }
+            _batch->text.append(from, end);
+            _p = end;
+            return false;
+        }
+    public:
+        //! Scan offset just past the last line terminated record.
+        size_t boundary;
+
+        //! A splitter of \p reader whose data rows are numbered from \p firstRow, and
+        //! whose first record is the header if \p headerPending.
+        RecordSplitter(summarize::BlockReader& reader, char delim, char quote, bool quoting, size_t batchBytes,
+                       bool headerPending, size_t firstRow) : _reader(reader) {
+            _delim = delim;
+            _quote = quote;
+            _quoting = quoting;
+            _batchBytes = batchBytes;
+            _inQuotes = false;
+            _afterQuote = false;
+            _afterCr = false;
+            _inRecord = false;
+            _prev = '\n';
+            _headerPending = headerPending;
+            _p = nullptr;
+            _end = nullptr;
+            _atEnd = false;
+            _unterminatedPending = false;
+            _batch = nullptr;
+            _offset = 0;
+            _rows = firstRow;
+            _recordStart = 0;
+            boundary = 0;
+        }
+
+        //! Fill \p batch with the next records. \return false at the end of the input.
+        bool next(PipelineBatch& batch) {
+            _batch = &batch;
+            batch.text.clear();
+            batch.offset = _offset;
+            batch.firstRow = _rows;
+            batch.rows = 0;
+            batch.header = false;
+            batch.unterminated = false;
+            _recordStart = 0;
+            if(_unterminatedPending) {
+                _unterminatedPending = false;
+                batch.text.swap(_unterminated);
+                batch.unterminated = true;
+                if(_headerPending) batch.header = true;
+                else batch.rows = 1;
+            } else {
+                while(!_atEnd && !_scanBlock()) {
+                    size_t size;
+                    if(!_reader.next(_p, size)) {
+                        _atEnd = true;
+                        break;
+                    }
+                    _end = _p + size;
+                    if(_afterCr) {
+                        _afterCr = false;
+                        if(*_p == '\n') {
+                            batch.text += '\n';
+                            _p++;
+                            _endRecord(_p, _p);
+                        }
+                    }
+                }
+                if(_atEnd && _inRecord) {
+                    // A final record without a line terminator goes in a batch of its own,
+                    // so the merge can keep the state before it (see TsvFile::TailState).
+                    _inRecord = false;
+                    _unterminated.assign(batch.text, _recordStart, std::string::npos);
+                    batch.text.resize(_recordStart);
+                    _unterminatedPending = true;
+                    if(batch.text.empty()) return next(batch);
+                }
+            }
+            _offset += batch.text.size();
+            _rows += batch.rows;
+            return !batch.text.empty();
+        }
+    };
+}
+
+void summarize::TsvFile::_mergeStats(const std::vector<ColumnStats>& partial, size_t rows) {
+    if(partial.size() > _stats.size()) {
+        // Columns first seen in this batch were missing from every earlier data row.
+        size_t rowsSoFar = _stats.empty() ? 0 : _stats.front().getCount();
+        size_t oldSize = _stats.size();
+        _stats.resize(partial.size());
+        for(size_t col = oldSize; col < _stats.size(); col++) _stats[col].addMissing(rowsSoFar);
+    }
+    for(size_t col = 0; col < partial.size(); col++) _stats[col].merge(partial[col]);
+    for(size_t col = partial.size(); col < _stats.size(); col++) _stats[col].addMissing(rows);
+}
+
+template <typename Parser>
+void summarize::TsvFile::_parseBatchRecords(Parser& parser, PipelineBatch& batch) const {
+    batch.records = 0;
+    batch.matched = 0;
+    batch.filtered = 0;
+    batch.largestRow = 0;
+    batch.minFields = SIZE_MAX;
+    batch.preview.clear();
+    batch.index.clear();
+    batch.stats.clear();
+    if(_groups) _groups->resetPartial(batch.groups);
+    bool headerPending = batch.header;
+    size_t row = batch.firstRow;
+    while(true) {
+        size_t start = parser.getPosition();
+        bool keep = !headerPending && (_filter.isSet() ? batch.preview.size() < _previewRows : row < _previewRows);
+        if(keep) batch.preview.emplace_back();
+        std::vector<std::string>& record = headerPending ? batch.headerRecord :
+                                           (keep ? batch.preview.back() : batch.scratch);
+        bool got;
+        while((got = parser.nextRecord(record)) && !_keepRecord(record, headerPending)) {
+            // An unterminated final row is parsed again by a resumed scan (see _scanRecords).
+            if(parser.lastTerminated() && !record.empty()) batch.filtered++;
+        }
+        if(!got) {
+            if(keep) batch.preview.pop_back();
+            break;
+        }
+        batch.records++;
+        batch.largestRow = std::max(batch.largestRow, record.size());
+        if(headerPending) {
+            headerPending = false;
+            continue;
+        }
+        if(_indexInterval && !_filter.isSet() && row % _indexInterval == 0) batch.index.push_back(batch.offset + start);
+        row++;
+        batch.matched++;
+        batch.minFields = std::min(batch.minFields, record.size());
+        if(_groups) _groups->addTo(batch.groups, record);
+        if(_collectStats) _addToStats(batch.stats, record);
+    }
+}
+
+template <char DELIM>
+void summarize::TsvFile::_parseBatchDialect(PipelineBatch& batch) const {
+    BlockReader reader;
+    reader.setSpan(batch.text.data(), batch.text.size());
+    if(_quoting == Quoting::NONE) {
+        DialectParser<DELIM, Quoting::NONE> parser(reader, _delim);
+        parser.setSelection(_selected());
+        _parseBatchRecords(parser, batch);
+        return;
+    }
+    DialectParser<DELIM, Quoting::RFC4180> parser(reader, _delim, _dialect.quote);
+    parser.setSelection(_selected());
+    _parseBatchRecords(parser, batch);
+}
+
+void summarize::TsvFile::_parseBatch(PipelineBatch& batch) const {
+    if(_dialect.isFixedWidth()) {
+        BlockReader reader;
+        reader.setSpan(batch.text.data(), batch.text.size());
+        FixedWidthParser parser(reader, _dialect.columnStarts);
+        parser.setSelection(_selected());
+        _parseBatchRecords(parser, batch);
+        return;
+    }
+    switch(_delim) {
+        case '\t': _parseBatchDialect<'\t'>(batch); break;
+        case ',': _parseBatchDialect<','>(batch); break;
+        case ';': _parseBatchDialect<';'>(batch); break;
+        case '|': _parseBatchDialect<'|'>(batch); break;
+        default: _parseBatchDialect<0>(batch);
+    }
+}
+
+size_t summarize::TsvFile::_scanPipeline(BlockReader& reader, bool headerPending, std::vector<std::string>& header,
+                                         std::vector<std::vector<std::string> >& preview, size_t& largestRow) {
+    Scheduler& scheduler = *_scheduler;
+    // A plan may use fewer workers than the scheduler has, by keeping fewer batches in flight.
+    size_t workers = _planner ? std::max<size_t>(1, std::min(_plan.threads, scheduler.getThreads())) :
+                     scheduler.getThreads();
+    // A ring of batches: batch i is parsed in slot i % size, so the oldest batch is merged
+    // (and its slot freed) before the splitter may run further ahead.
+    std::vector<PipelineBatch> batches(workers * BATCHES_PER_WORKER + 1);
+    // Fixed-width records are lines: a quote does not hold a line terminator.
+    bool quoting = _quoting == Quoting::RFC4180 && !_dialect.isFixedWidth();
+    RecordSplitter splitter(reader, _delim, _dialect.quote, quoting, _batchBytes, headerPending, _nRows);
+    _tail = TailState();
+    size_t nRecords = 0;
+    size_t nSplit = 0;
+    size_t nMerged = 0;
+    bool more = true;
+    while(more || nMerged < nSplit) {
+        if(more && nSplit - nMerged < batches.size()) {
+            PipelineBatch& batch = batches[nSplit % batches.size()];
+            more = splitter.next(batch);
+            if(!more) continue;
+            batch.parsed.store(false, std::memory_order_relaxed);
+            scheduler.submit([this, &batch]() {
+                _parseBatch(batch);
+                batch.parsed.store(true, std::memory_order_release);
+            });
+            nSplit++;
+            continue;
+        }
+        // The ring is full or the input exhausted: merge the oldest batch, in input order.
+        PipelineBatch& batch = batches[nMerged++ % batches.size()];
+        scheduler.waitUntil([&batch]() { return batch.parsed.load(std::memory_order_acquire); });
+        if(batch.unterminated) {
+            // See _scanRecords: the state before a final record that may still be being written.
+            _tail.valid = true;
+            _tail.nRows = _nRows;
+            _tail.nCols = largestRow;
+            _tail.nPreviewRows = preview.size();
+            _tail.minFields = _minFields;
+            _tail.stats = _stats;
+            _tail.sampler = _sampler;
+        }
+        if(batch.header) header.swap(batch.headerRecord);
+        for(auto& row: batch.preview) {
+            if(preview.size() == _previewRows) break;
+            preview.push_back(std::move(row));
+        }
+        for(size_t offset: batch.index) _recordIndex.push_back(_scanBase + offset);
+        _nRows += batch.matched;
+        _nFiltered += batch.filtered;
+        _minFields = std::min(_minFields, batch.minFields);
+        largestRow = std::max(largestRow, batch.largestRow);
+        if(_collectStats) _mergeStats(batch.stats, batch.matched);
+        if(_groups) _groups->merge(batch.groups);
+        nRecords += batch.records;
+        if(_progress) _progress->addRecords(batch.records);
+    }
+    _resumeOffset = _scanBase + splitter.boundary;
+    _profile.setPipeline(std::to_string(workers) + " workers, " + std::to_string(nSplit) + " batches");
+    return nRecords;
+}
@@ -0,0 +1,341 @@
+//
+// Execution planner and its cost model (see planner.hpp).
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <planner.hpp>
+#include <kernels.hpp>
+#include <tsvFile.hpp>
+
+namespace {
+    //! Sample assumed before the real one is sniffed: a narrow table without quotes.
+    summarize::SampleFacts typicalSample() {
+        summarize::SampleFacts ret;
+        ret.bytes = 64 * 1024;
+        ret.records = 1024;
+        ret.fields = 8 * 1024;
+        return ret;
+    }
+
+    //! Bytes an input of unknown size (a stream) is planned for; its estimates are per GiB.
+    const double STREAM_PLAN_BYTES = 1024.0 * 1024 * 1024;
+
+    //! Inputs of at most this many blocks are read without read ahead: the reader thread
+    //! or ring would cost more than it hides.
+    const size_t SMALL_INPUT_BLOCKS = 2;
+    //! Files with less of them in the page cache are read from the device.
+    const double COLD_CACHED_FRACTION = 0.5;
+    //! Pages of each of the windows probed for page cache residency, and the most windows.
+    const size_t RESIDENCY_WINDOW_PAGES = 16;
+    const size_t RESIDENCY_WINDOWS = 64;
+
+    //! Compression format with the magic number that starts \p bytes, or nullptr.
+    const char* compressionFromMagic(const unsigned char* bytes, size_t n) {
+        if(n >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b) return "gzip";
+        if(n >= 4 && bytes[0] == 0x28 && bytes[1] == 0xb5 && bytes[2] == 0x2f && bytes[3] == 0xfd) return "zstd";
+        if(n >= 3 && bytes[0] == 'B' && bytes[1] == 'Z' && bytes[2] == 'h') return "bzip2";
+        if(n >= 6 && std::memcmp(bytes, "\xfd" "7zXZ\0", 6) == 0) return "xz";
+        return nullptr;
+    }
+
+    //! Fraction of the pages of the \p size byte file \p fd in the page cache, from up to
+    //! RESIDENCY_WINDOWS windows spread over it. Negative if it can not be found.
+    double cachedFraction(int fd, size_t size) {
+        if(size == 0) return -1;
+        void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if(map == MAP_FAILED) return -1;
+        size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t pages = (size + pageSize - 1) / pageSize;
+        size_t windows = std::min(RESIDENCY_WINDOWS, (pages + RESIDENCY_WINDOW_PAGES - 1) / RESIDENCY_WINDOW_PAGES);
+        std::vector<unsigned char> resident(RESIDENCY_WINDOW_PAGES);
+        size_t probed = 0;
+        size_t cached = 0;
+        for(size_t i = 0; i < windows; i++) {
+            size_t first = pages * i / windows;
+            size_t n = std::min(RESIDENCY_WINDOW_PAGES, pages - first);
+            if(mincore(static_cast<char*>(map) + first * pageSize, n * pageSize, resident.data()) != 0) continue;
+            for(size_t page = 0; page < n; page++) cached += resident[page] & 1;
+            probed += n;
+        }
+        munmap(map, size);
+        return probed == 0 ? -1 : static_cast<double>(cached) / static_cast<double>(probed);
+    }
+
+    //! Bytes of physical memory, 0 if unknown.
+    size_t physicalMemory() {
+        long pages = sysconf(_SC_PHYS_PAGES);
+        long pageSize = sysconf(_SC_PAGESIZE);
+        return pages > 0 && pageSize > 0 ? static_cast<size_t>(pages) * static_cast<size_t>(pageSize) : 0;
+    }
+
+    std::string formatBytes(double bytes) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(1);
+        if(bytes >= 1024.0 * 1024 * 1024) out << bytes / (1024.0 * 1024 * 1024) << " GiB";
+        else if(bytes >= 1024.0 * 1024) out << bytes / (1024.0 * 1024) << " MiB";
+        else if(bytes >= 1024) out << bytes / 1024 << " KiB";
+        else out << std::setprecision(0) << bytes << " bytes";
+        return out.str();
+    }
+}
+
+double summarize::SampleFacts::bytesPerRecord() const {
+    return records == 0 ? 0 : static_cast<double>(bytes) / static_cast<double>(records);
+}
+
+double summarize::SampleFacts::fieldsPerRecord() const {
+    return records == 0 ? 0 : static_cast<double>(fields) / static_cast<double>(records);
+}
+
+double summarize::SampleFacts::quotesPerKiB() const {
+    return bytes == 0 ? 0 : 1024.0 * static_cast<double>(quotes) / static_cast<double>(bytes);
+}
+
+summarize::SampleFacts summarize::describeSample(const std::string& sample, char delim, char quote, bool quoting) {
+    SampleFacts ret;
+    const char* begin = sample.data();
+    const char* end = begin + sample.size();
+    ret.bytes = sample.size();
+    ret.quoting = quoting;
+    // Delimiters and line feeds inside quotes are counted too: close enough for a cost.
+    ret.records = countByte(begin, end, '\n');
+    if(!sample.empty() && sample.back() != '\n') ret.records++;
+    ret.fields = ret.records + (delim ? countByte(begin, end, delim) : 0);
+    ret.quotes = quoting && quote ? countByte(begin, end, quote) : 0;
+    return ret;
+}
+
+bool summarize::probeInput(const std::string& path, InputFacts& facts) {
+    facts.path = path;
+    facts.parquet = !path.empty() && hasParquetExtension(path);
+    int fd = path.empty() ? STDIN_FILENO : open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0) return false;
+    struct stat st;
+    if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        facts.regularFile = true;
+        facts.size = static_cast<size_t>(st.st_size);
+        // pread leaves the offset alone, so even a redirected stdin is read from the start.
+        unsigned char magic[6];
+        ssize_t n = pread(fd, magic, sizeof(magic), 0);
+        const char* compression = n > 0 ? compressionFromMagic(magic, static_cast<size_t>(n)) : nullptr;
+        if(compression) facts.compression = compression;
+        facts.cachedFraction = cachedFraction(fd, facts.size);
+    }
+    if(!path.empty()) close(fd);
+    return true;
+}
+
+const char* summarize::engineName(ExecutionPlan::Engine engine) {
+    switch(engine) {
+        case ExecutionPlan::Engine::SERIAL: return "serial";
+        case ExecutionPlan::Engine::PIPELINE: return "pipeline";
+        case ExecutionPlan::Engine::COLUMN_PARALLEL: return "column parallel statistics";
+        case ExecutionPlan::Engine::PARQUET_METADATA: return "parquet metadata";
+        case ExecutionPlan::Engine::PARQUET_SCAN: return "parquet scan";
+    }
+    return "";
+}
+
+void summarize::ExecutionPlan::print(std::ostream& out) const {
+    out << "Plan for " << (input.path.empty() ? "stdin" : input.path) << ":\n";
+    out << "  input: ";
+    if(input.regularFile) {
+        out << "file, " << formatBytes(static_cast<double>(input.size));
+        if(input.cachedFraction >= 0)
+            out << ", " << std::fixed << std::setprecision(0) << 100 * input.cachedFraction << "% cached";
+    } else {
+        out << "stream of unknown size";
+    }
+    if(!input.compression.empty()) out << ", " << input.compression << " compressed";
+    out << '\n';
+    if(sampled) {
+        out << "  sample: " << std::fixed << std::setprecision(1) << sample.bytesPerRecord() << " bytes/record, "
+            << sample.fieldsPerRecord() << " fields/record, " << sample.quotesPerKiB() << " quotes/KiB\n";
+    }
+    if(engine != Engine::PARQUET_METADATA && engine != Engine::PARQUET_SCAN) {
+        out << "  read: ";
+        if(io.queueDepth == 0) out << "blocks read when needed";
+        else out << io.queueDepth << " blocks ahead by " << (io.uring && input.regularFile ? "io_uring" : "a thread");
+        if(io.direct) out << ", O_DIRECT";
+        out << '\n';
+    }
+    out << "  engine: " << engineName(engine);
+    if(engine == Engine::PIPELINE || engine == Engine::COLUMN_PARALLEL) out << " on " << threads << " workers";
+    if(engine != Engine::PARQUET_METADATA && engine != Engine::PARQUET_SCAN)
+        out << ", " << (sample.quoting ? "quote-aware" : "quote-free") << " parser";
+    out << '\n';
+    if(serialSeconds >= 0) {
+        out << "  estimate: serial " << std::fixed << std::setprecision(3) << serialSeconds << " s";
+        if(parallelSeconds >= 0)
+            out << ", " << (engine == Engine::COLUMN_PARALLEL ? "column parallel " : "pipeline ") << parallelSeconds << " s";
+        if(input.size == 0) out << " per GiB";
+        out << '\n';
+    }
+    if(!engineReason.empty()) out << "  why: " << engineReason << '\n';
+    for(const auto& note: notes) out << "  note: " << note << '\n';
+    out.unsetf(std::ios_base::floatfield);
+}
+
+summarize::Planner::Planner(size_t cores, const CostModel& model) {
+    _cores = cores < 1 ? 1 : cores;
+    _model = model;
+}
+
+double summarize::Planner::_parseSeconds(double bytes, const SampleFacts& sample, bool stats) const {
+    double records = sample.records == 0 ? 0 : bytes / sample.bytesPerRecord();
+    double ns = bytes * _model.parseNsPerByte + bytes * sample.quotesPerKiB() / 1024 * _model.parseNsPerQuote;
+    if(stats) ns += records * sample.fieldsPerRecord() * _model.statsNsPerField;
+    return ns / 1e9;
+}
+
+double summarize::Planner::_readSeconds(double bytes, const InputFacts& input) const {
+    // A stream is assumed to keep up; only files not in the page cache are read from the device.
+    double cached = input.cachedFraction < 0 ? 1 : input.cachedFraction;
+    return bytes * (cached * _model.cachedReadNsPerByte + (1 - cached) * _model.coldReadNsPerByte) / 1e9;
+}
+
+void summarize::Planner::_estimate(ExecutionPlan& plan, const SampleFacts& sample, size_t threads) const {
+    double bytes = plan.input.size > 0 ? static_cast<double>(plan.input.size) : STREAM_PLAN_BYTES;
+    double parse = _parseSeconds(bytes, sample, plan.input.stats);
+    double read = _readSeconds(bytes, plan.input);
+    // With read ahead the reads overlap the parse; without it they add up.
+    plan.serialSeconds = plan.io.queueDepth > 0 ? std::max(parse, read) : parse + read;
+    plan.parallelSeconds = -1;
+    plan.engine = ExecutionPlan::Engine::SERIAL;
+    plan.threads = 1;
+    // Workers beyond the cores only take turns.
+    threads = std::min(threads, _cores);
+    if(threads < 2) {
+        plan.engineReason = "one worker or core: nothing to run a pipeline on";
+        return;
+    }
+
+    if(sample.fieldsPerRecord() >= WIDE_TABLE_COLUMNS) {
+        // Each batch of a pipeline would hold statistics for every column: update ranges of
+        // columns in parallel instead, while one thread parses.
+        if(!plan.input.stats) {
+            plan.engineReason = "wide table without statistics: parsing is all there is to do";
+            return;
+        }
+        double parseOnly = _parseSeconds(bytes, sample, false);
+        double stats = parse - parseOnly;
+        plan.engine = ExecutionPlan::Engine::COLUMN_PARALLEL;
+        plan.threads = threads;
+        plan.parallelSeconds = std::max(parseOnly + stats / static_cast<double>(threads), read);
+        std::ostringstream reason;
+        reason << std::fixed << std::setprecision(1) << "wide table (" << sample.fieldsPerRecord()
+               << " fields/record): per column statistics are shared by the workers";
+        plan.engineReason = reason.str();
+        return;
+    }
+
+    // The splitter (which also merges the batches in order) runs alone; the parse is
+    // shared by every worker, the splitter's included. Nothing is parsed before the first
+    // batch is cut.
+    double batches = std::ceil(bytes / static_cast<double>(PIPELINE_BATCH_BYTES));
+    double records = sample.records == 0 ? 0 : bytes / sample.bytesPerRecord();
+    double split = (bytes * _model.splitNsPerByte + records * _model.mergeNsPerRecord) / 1e9 +
+                   batches * _model.batchSeconds;
+    double fill = parse / batches;
+    for(size_t k = 2; k <= threads; k++) {
+        double seconds = std::max({split, (split + parse) / static_cast<double>(k), read}) + fill;
+        if(plan.parallelSeconds < 0 || seconds < plan.parallelSeconds) {
+            plan.parallelSeconds = seconds;
+            plan.threads = k;
+        }
+    }
+    std::ostringstream reason;
+    reason << std::fixed << std::setprecision(1);
+    if(plan.parallelSeconds < plan.serialSeconds) {
+        plan.engine = ExecutionPlan::Engine::PIPELINE;
+        reason << "a pipeline is estimated " << plan.serialSeconds / plan.parallelSeconds << "x faster";
+        if(plan.threads < threads) reason << "; more workers than " << plan.threads << " would wait on the splitter";
+    } else {
+        plan.threads = 1;
+        reason << "too little to parse for batches to pay off";
+    }
+    plan.engineReason = reason.str();
+}
+
+size_t summarize::Planner::planThreads(const std::vector<InputFacts>& inputs) const {
+    // The parse of every input, shared by k workers each of which had to be started. Full
+    // scans of streams may be long: use every core.
+    double work = 0;
+    for(const auto& input: inputs) {
+        if(input.parquet) continue;
+        if(input.size == 0 && input.partial.empty()) return _cores;
+        double bytes = static_cast<double>(input.size);
+        if(!input.partial.empty()) bytes = std::min(bytes, static_cast<double>(SMALL_INPUT_BLOCKS * DEFAULT_BLOCK_SIZE));
+        work += _parseSeconds(bytes, typicalSample(), input.stats) + _readSeconds(bytes, input);
+    }
+    size_t ret = 1;
+    double best = work;
+    for(size_t k = 2; k <= _cores; k++) {
+        double seconds = work / static_cast<double>(k) + static_cast<double>(k) * _model.threadStartSeconds;
+        if(seconds < best) {
+            best = seconds;
+            ret = k;
+        }
+    }
+    return ret;
+}
+
+summarize::ExecutionPlan summarize::Planner::plan(const InputFacts& input, size_t threads) const {
+    ExecutionPlan ret;
+    ret.input = input;
+    if(!input.compression.empty())
+        ret.notes.push_back("looks " + input.compression + " compressed: decompress it first (e.g. zcat file | summarize)");
+    if(input.parquet) {
+        ret.engine = input.stats ? ExecutionPlan::Engine::PARQUET_SCAN : ExecutionPlan::Engine::PARQUET_METADATA;
+        ret.engineReason = input.stats ? "statistics need every row group" :
+                           "the row count and schema are in the footer";
+        return ret;
+    }
+
+    if(!input.regularFile) {
+        ret.io.queueDepth = 4;
+        ret.io.uring = false;
+        ret.notes.push_back("stream: a reader thread keeps blocks coming while the parser works");
+    } else if(input.size <= SMALL_INPUT_BLOCKS * ret.io.blockSize) {
+        ret.io.queueDepth = 0;
+        ret.notes.push_back("small file: read ahead would cost more than it hides");
+    } else if(input.cachedFraction >= 0 && input.cachedFraction < COLD_CACHED_FRACTION) {
+        ret.io.queueDepth = 8;
+        ret.notes.push_back("mostly not in the page cache: deep read ahead overlaps the device with the parse");
+        size_t memory = physicalMemory();
+        if(memory > 0 && input.size > memory / 2) {
+            ret.io.direct = true;
+            ret.notes.push_back("larger than half the memory: O_DIRECT keeps it from evicting the page cache");
+        }
+    } else {
+        ret.io.queueDepth = 2;
+        ret.notes.push_back("in the page cache: a short read ahead is enough");
+    }
+
+    if(!input.partial.empty()) {
+        ret.engine = ExecutionPlan::Engine::SERIAL;
+        ret.engineReason = input.partial + ": not every record is parsed in order";
+        return ret;
+    }
+    _estimate(ret, typicalSample(), threads);
+    return ret;
+}
+
+void summarize::Planner::refine(ExecutionPlan& plan, const SampleFacts& sample, size_t threads) const {
+    plan.sample = sample;
+    plan.sampled = true;
+    bool text = plan.engine != ExecutionPlan::Engine::PARQUET_METADATA &&
+                plan.engine != ExecutionPlan::Engine::PARQUET_SCAN;
+    if(!text || !plan.input.partial.empty() || sample.records == 0) return;
+    _estimate(plan, sample, threads);
+}
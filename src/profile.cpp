@@ -0,0 +1,67 @@
+//
+// Per-phase scan profiling (see profile.hpp).
+//
+
+#include <iomanip>
+
+#include <profile.hpp>
+#include <kernels.hpp>
+
+void summarize::Profile::start(const std::string& name) {
+    if(_running) stop();
+    _current = name;
+    _running = true;
+    _start = Clock::now();
+    _startAllocs = alloc::snapshot();
+}
+
+void summarize::Profile::stop() {
+    if(!_running) return;
+    // Take the measurements before touching _phases so its growth is not attributed
+    // to the phase being closed.
+    alloc::Counts allocs = alloc::snapshot() - _startAllocs;
+    double seconds = std::chrono::duration<double>(Clock::now() - _start).count();
+    _running = false;
+    _phases.push_back({_current, seconds, allocs});
+}
+
+const summarize::Profile::Phase* summarize::Profile::getPhase(const std::string& name) const {
+    for(const auto& phase: _phases)
+        if(phase.name == name) return &phase;
+    return nullptr;
+}
+
+void summarize::Profile::print(std::ostream& out) const {
+    out << "Profile:\n";
+    out << std::left << std::setw(10) << "  phase" << std::right
+        << std::setw(12) << "time(ms)"
+        << std::setw(12) << "allocs"
+        << std::setw(14) << "bytes" << '\n';
+    alloc::Counts total;
+    for(const auto& phase: _phases) {
+        out << "  " << std::left << std::setw(8) << phase.name << std::right
+            << std::setw(12) << std::fixed << std::setprecision(2) << phase.seconds * 1000
+            << std::setw(12) << phase.allocs.allocations
+            << std::setw(14) << phase.allocs.bytes << '\n';
+        total += phase.allocs;
+    }
+    out << "  records: " << _records << '\n';
+    if(_stallSeconds >= 0) {
+        out << "  read stall(ms): " << std::setprecision(2) << _stallSeconds * 1000
+            << " (read ahead: " << _readAhead << ")\n";
+    }
+    if(!_pipeline.empty()) out << "  pipeline: " << _pipeline << '\n';
+    out << "  kernels: " << simdLevelName(getSimdLevel()) << '\n';
+    if(!alloc::enabled()) {
+        out << "  allocation counts unavailable (rebuild with -DENABLE_ALLOC_COUNTING=ON)\n";
+        return;
+    }
+    const Phase* parse = getPhase("parse");
+    if(parse && _records > 0) {
+        out << "  parse allocs/record: " << std::setprecision(4)
+            << static_cast<double>(parse->allocs.allocations) / _records
+            << ", bytes/record: " << static_cast<double>(parse->allocs.bytes) / _records << '\n';
+    }
+    out << "  total allocs: " << total.allocations << ", bytes: " << total.bytes << '\n';
+    out.unsetf(std::ios_base::floatfield);
+}
@@ -0,0 +1,118 @@
+//
+// Progress reporter timer thread and formatting (see progress.hpp).
+//
+
+#include <cstdio>
+#include <sstream>
+#include <iomanip>
+#include <unistd.h>
+
+#include <progress.hpp>
+
+namespace {
+    //! Refresh interval of the in-place status line.
+    const std::chrono::milliseconds TTY_INTERVAL(250);
+    //! Interval between log lines when stderr is redirected.
+    const std::chrono::milliseconds LOG_INTERVAL(10000);
+}
+
+summarize::ProgressReporter::ProgressReporter(std::ostream& out, STYLE style)
+    : _bytes(0), _records(0), _out(out) {
+    _totalBytes = 0;
+    _nInputs = 1;
+    _inputIndex = 0;
+    _style = style;
+    if(_style == AUTO) _style = isatty(STDERR_FILENO) ? TTY : LOG;
+    _interval = _style == TTY ? TTY_INTERVAL : LOG_INTERVAL;
+    _running = false;
+    _stopRequested = false;
+}
+
+void summarize::ProgressReporter::setInput(const std::string& label) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _label = label;
+    _inputIndex++;
+}
+
+void summarize::ProgressReporter::start() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if(_running) return;
+    _start = Clock::now();
+    _running = true;
+    _stopRequested = false;
+    _thread = std::thread(&ProgressReporter::_run, this);
+}
+
+void summarize::ProgressReporter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if(!_running) return;
+        _stopRequested = true;
+    }
+    _wake.notify_all();
+    _thread.join();
+    std::lock_guard<std::mutex> lock(_mutex);
+    _running = false;
+    _print(true);
+}
+
+void summarize::ProgressReporter::_run() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while(!_wake.wait_for(lock, _interval, [this]{ return _stopRequested; }))
+        _print(false);
+}
+
+//! Must be called with _mutex held.
+void summarize::ProgressReporter::_print(bool final) {
+    double seconds = std::chrono::duration<double>(Clock::now() - _start).count();
+    std::string line = formatLine(getBytes(), _totalBytes, getRecords(), seconds);
+    if(_nInputs > 1)
+        line = "[" + std::to_string(_inputIndex) + "/" + std::to_string(_nInputs) + "] " + _label + ": " + line;
+    if(_style == TTY) {
+        _out << '\r' << line << "\033[K";
+        if(final) _out << '\n';
+    } else {
+        _out << "progress: " << line << '\n';
+    }
+    _out.flush();
+}
+
+std::string summarize::ProgressReporter::formatBytes(double bytes) {
+    static const char* units[] = {"B", "KiB", "MiB", "GiB", "TiB"};
+    size_t unit = 0;
+    while(bytes >= 1024 && unit < 4) { bytes /= 1024; unit++; }
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(unit == 0 ? 0 : 1) << bytes << ' ' << units[unit];
+    return ss.str();
+}
+
+std::string summarize::ProgressReporter::formatDuration(double seconds) {
+    size_t s = static_cast<size_t>(seconds + 0.5);
+    std::string ret;
+    if(s >= 3600) { ret += std::to_string(s / 3600) + "h"; s %= 3600; }
+    if(s >= 60 || !ret.empty()) { ret += std::to_string(s / 60) + "m"; s %= 60; }
+    return ret + std::to_string(s) + "s";
+}
+
+std::string summarize::ProgressReporter::formatLine(size_t bytes, size_t totalBytes, size_t records, double seconds) {
+    std::ostringstream ss;
+    ss << formatBytes(static_cast<double>(bytes));
+    if(totalBytes > 0) {
+        ss << " / " << formatBytes(static_cast<double>(totalBytes)) << " ("
+           << std::fixed << std::setprecision(1) << 100.0 * bytes / totalBytes << "%)";
+    }
+    ss << ", " << records << " records";
+    if(seconds > 0) {
+        double rate = records / seconds;
+        ss << ", ";
+        if(rate >= 1e6) ss << std::fixed << std::setprecision(1) << rate / 1e6 << "M";
+        else if(rate >= 1e3) ss << std::fixed << std::setprecision(1) << rate / 1e3 << "k";
+        else ss << std::fixed << std::setprecision(0) << rate;
+        ss << " rec/s";
+        if(totalBytes > 0 && bytes > 0 && bytes < totalBytes) {
+            double remaining = seconds * (totalBytes - bytes) / bytes;
+            ss << ", ETA " << formatDuration(remaining);
+        }
+    }
+    return ss.str();
+}
@@ -0,0 +1,40 @@
+//
+// Reservoir sampling with Algorithm L (see reservoirSampler.hpp).
+//
+// Li, K.-H. (1994). Reservoir-sampling algorithms of time complexity O(n(1 + log(N/n))).
+// ACM Transactions on Mathematical Software 20(4), 481-493.
+//
+
+#include <cmath>
+
+#include <reservoirSampler.hpp>
+
+double summarize::ReservoirSampler::_random() {
+    // generate_canonical is in [0, 1); its complement avoids log(0).
+    return 1.0 - std::generate_canonical<double, 53>(_rng);
+}
+
+void summarize::ReservoirSampler::_skipFrom(size_t i) {
+    double gap = std::floor(std::log(_random()) / std::log(1.0 - _w));
+    // Past any realistic input: never take another item.
+    const double MAX_GAP = 1e18;
+    _next = !(gap < MAX_GAP) ? SIZE_MAX : i + static_cast<size_t>(gap) + 1;
+}
+
+void summarize::ReservoirSampler::reset(size_t k, uint64_t seed) {
+    _k = k;
+    _rng.seed(seed);
+    if(_k == 0) {
+        _next = SIZE_MAX;
+        return;
+    }
+    _w = std::exp(std::log(_random()) / static_cast<double>(_k));
+    _skipFrom(_k - 1);
+}
+
+size_t summarize::ReservoirSampler::replace() {
+    size_t slot = std::uniform_int_distribution<size_t>(0, _k - 1)(_rng);
+    _w *= std::exp(std::log(_random()) / static_cast<double>(_k));
+    _skipFrom(_next);
+    return slot;
+}
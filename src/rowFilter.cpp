@@ -0,0 +1,282 @@
+//
+// Row filter predicates (see rowFilter.hpp).
+//
+
+#include <iostream>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <charconv>
+#include <utility>
+
+#include <rowFilter.hpp>
+#include <columnStats.hpp>
+
+const size_t summarize::RowFilter::MAX_COLUMNS;
+const size_t summarize::RowFilter::MAX_DEPTH;
+
+namespace {
+    bool isNameChar(char c) {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+    }
+
+    //! Characters that end a bare word value.
+    bool endsBareWord(char c) {
+        return std::isspace(static_cast<unsigned char>(c)) || std::strchr("()'`!=<>&|^", c) != nullptr;
+    }
+
+    //! Parse all of \p value into \p number, accepting what ColumnStats::classify types as
+    //! a number but for integers out of the range of a double. Skips the rest of classify.
+    bool toNumber(std::string_view value, double& number) {
+        // std::from_chars does not accept a leading '+'.
+        if(!value.empty() && value[0] == '+') {
+            value.remove_prefix(1);
+            if(!value.empty() && value[0] == '-') return false;
+        }
+        const char* end = value.data() + value.size();
+        std::from_chars_result result = std::from_chars(value.data(), end, number);
+        return !value.empty() && result.ec == std::errc() && result.ptr == end;
+    }
+}
+
+bool summarize::RowFilter::parse(const std::string& expression) {
+    _expression = expression;
+    _tests.clear();
+    _program.clear();
+    _names.clear();
+    _columns.clear();
+    _fields.clear();
+    _pos = 0;
+    _depth = 0;
+    _error.clear();
+    bool ok = _parseOr();
+    _skipSpace();
+    if(ok && _pos != _expression.size()) ok = _fail("unexpected '" + _expression.substr(_pos) + "'");
+    if(!ok) {
+        std::cerr << "ERROR: invalid --where expression: " << _error << "\n  " << _expression << "\n  "
+                  << std::string(std::min(_pos, _expression.size()), ' ') << "^" << std::endl;
+        _program.clear();
+        return false;
+    }
+    return true;
+}
+
+void summarize::RowFilter::_skipSpace() {
+    while(_pos < _expression.size() && std::isspace(static_cast<unsigned char>(_expression[_pos]))) _pos++;
+}
+
+bool summarize::RowFilter::_accept(std::string_view word) {
+    _skipSpace();
+    if(_expression.size() - _pos < word.size()) return false;
+    for(size_t i = 0; i < word.size(); i++) {
+        if(std::toupper(static_cast<unsigned char>(_expression[_pos + i])) != word[i]) return false;
+    }
+    // A keyword must be a whole word: "ORDER" is a column, not OR.
+    size_t end = _pos + word.size();
+    if(isNameChar(word[0]) && end < _expression.size() && isNameChar(_expression[end])) return false;
+    _pos = end;
+    return true;
+}
+
+bool summarize::RowFilter::_fail(const std::string& message) {
+    if(_error.empty()) _error = message;
+    return false;
+}
+
+size_t summarize::RowFilter::_emit(Op::Code code, size_t arg) {
+    _program.push_back({code, static_cast<uint32_t>(arg)});
+    return _program.size() - 1;
+}
+
+bool summarize::RowFilter::_parseOr() {
+    if(!_parseAnd()) return false;
+    // Each true operand jumps past the rest of the chain.
+    std::vector<size_t> jumps;
+    while(_accept("OR") || _accept("||")) {
+        jumps.push_back(_emit(Op::JUMP_IF_TRUE));
+        if(!_parseAnd()) return false;
+    }
+    for(size_t jump: jumps) _program[jump].arg = static_cast<uint32_t>(_program.size());
+    return true;
+}
+
+bool summarize::RowFilter::_parseAnd() {
+    if(!_parseNot()) return false;
+    std::vector<size_t> jumps;
+    while(_accept("AND") || _accept("&&")) {
+        jumps.push_back(_emit(Op::JUMP_IF_FALSE));
+        if(!_parseNot()) return false;
+    }
+    for(size_t jump: jumps) _program[jump].arg = static_cast<uint32_t>(_program.size());
+    return true;
+}
+
+bool summarize::RowFilter::_parseNot() {
+    if(++_depth > MAX_DEPTH) return _fail("nested too deeply");
+    bool ok;
+    _skipSpace();
+    bool bang = _expression.compare(_pos, 1, "!") == 0 && _expression.compare(_pos, 2, "!=") != 0;
+    if(bang || _accept("NOT")) {
+        if(bang) _pos++;
+        ok = _parseNot();
+        if(ok) _emit(Op::NOT);
+    } else if(_accept("(")) {
+        ok = _parseOr() && (_accept(")") || _fail("expected ')'"));
+    } else {
+        ok = _parseTest();
+    }
+    _depth--;
+    return ok;
+}
+
+bool summarize::RowFilter::_parseTest() {
+    Test test;
+    if(!_parseColumn(test.column)) return false;
+    if(_accept("IS")) {
+        test.compare = _accept("NOT") ? Compare::NOT_NULL : Compare::IS_NULL;
+        if(!_accept("NULL")) return _fail("expected NULL");
+    } else if(_accept("BETWEEN")) {
+        test.compare = Compare::BETWEEN;
+        bool highNumeric = false;
+        if(!_parseValue(test.text, test.numeric, test.number)) return false;
+        if(!_accept("AND")) return _fail("expected AND");
+        if(!_parseValue(test.highText, highNumeric, test.high)) return false;
+        test.numeric = test.numeric && highNumeric;
+    } else {
+        // Longer operators first, so "<=" is not read as "<".
+        static const std::pair<const char*, Compare> OPERATORS[] = {
+                {"==", Compare::EQ}, {"!=", Compare::NE}, {"<>", Compare::NE}, {"<=", Compare::LE},
+                {">=", Compare::GE}, {"^=", Compare::PREFIX}, {"=", Compare::EQ}, {"<", Compare::LT},
+                {">", Compare::GT}};
+        bool found = false;
+        for(const auto& op: OPERATORS) {
+            if(_accept(op.first)) {
+                test.compare = op.second;
+                found = true;
+                break;
+            }
+        }
+        if(!found) return _fail("expected a comparison, BETWEEN or IS [NOT] NULL");
+        if(!_parseValue(test.text, test.numeric, test.number)) return false;
+        if(test.compare == Compare::PREFIX) test.numeric = false;
+    }
+    _emit(Op::TEST, _tests.size());
+    _tests.push_back(std::move(test));
+    return true;
+}
+
+bool summarize::RowFilter::_parseColumn(size_t& column) {
+    _skipSpace();
+    std::string name;
+    if(_expression.compare(_pos, 1, "`") == 0) {
+        size_t end = _expression.find('`', _pos + 1);
+        if(end == std::string::npos) return _fail("unterminated `");
+        name = _expression.substr(_pos + 1, end - _pos - 1);
+        _pos = end + 1;
+    } else {
+        size_t start = _pos;
+        while(_pos < _expression.size() && isNameChar(_expression[_pos])) _pos++;
+        if(_pos == start) return _fail("expected a column name");
+        name = _expression.substr(start, _pos - start);
+    }
+    column = static_cast<size_t>(std::find(_names.begin(), _names.end(), name) - _names.begin());
+    if(column == _names.size()) {
+        if(_names.size() == MAX_COLUMNS) return _fail("more than " + std::to_string(MAX_COLUMNS) + " columns");
+        _names.push_back(name);
+    }
+    return true;
+}
+
+bool summarize::RowFilter::_parseValue(std::string& text, bool& numeric, double& number) {
+    _skipSpace();
+    text.clear();
+    numeric = false;
+    if(_expression.compare(_pos, 1, "'") == 0) {
+        // A quoted value is always a string.
+        for(_pos++;; _pos++) {
+            if(_pos == _expression.size()) return _fail("unterminated string");
+            if(_expression[_pos] == '\'') {
+                if(_expression.compare(_pos + 1, 1, "'") != 0) break;
+                _pos++;                            // '' is a literal quote
+            }
+            text += _expression[_pos];
+        }
+        _pos++;
+        return true;
+    }
+    size_t start = _pos;
+    while(_pos < _expression.size() && !endsBareWord(_expression[_pos])) _pos++;
+    if(_pos == start) return _fail("expected a value");
+    text = _expression.substr(start, _pos - start);
+    numeric = toNumber(text, number);
+    return true;
+}
+
+bool summarize::RowFilter::resolve(const ColumnNames& names) {
+    _columns.clear();
+    for(const auto& name: _names) {
+        size_t col = names.find(name);
+        if(col == ColumnNames::npos) {
+            std::cerr << "ERROR: no column named '" << name << "' in --where" << std::endl;
+            return false;
+        }
+        _columns.push_back(col);
+    }
+    _fields = _columns;
+    return true;
+}
+
+bool summarize::RowFilter::_test(const Test& test, const std::vector<std::string>& record,
+                                 double* numbers, uint8_t* converted) const {
+    size_t field = _fields[test.column];
+    std::string_view value = field < record.size() ? std::string_view(record[field]) : std::string_view();
+    bool missing = ColumnStats::isMissing(value);
+    if(test.compare == Compare::IS_NULL) return missing;
+    if(test.compare == Compare::NOT_NULL) return !missing;
+    if(missing) return false;
+
+    if(test.numeric) {
+        // Converted by the first numeric test of the field: 1 if it is a number, 2 if not.
+        if(converted[test.column] == 0) converted[test.column] = toNumber(value, numbers[test.column]) ? 1 : 2;
+        if(converted[test.column] == 2) return false;
+        double x = numbers[test.column];
+        switch(test.compare) {
+            case Compare::EQ: return x == test.number;
+            case Compare::NE: return x != test.number;
+            case Compare::LT: return x < test.number;
+            case Compare::LE: return x <= test.number;
+            case Compare::GT: return x > test.number;
+            case Compare::GE: return x >= test.number;
+            case Compare::BETWEEN: return x >= test.number && x <= test.high;
+            default: return false;
+        }
+    }
+    switch(test.compare) {
+        case Compare::EQ: return value == test.text;
+        case Compare::NE: return value != test.text;
+        case Compare::LT: return value < test.text;
+        case Compare::LE: return value <= test.text;
+        case Compare::GT: return value > test.text;
+        case Compare::GE: return value >= test.text;
+        case Compare::PREFIX: return value.compare(0, test.text.size(), test.text) == 0;
+        case Compare::BETWEEN: return value >= test.text && value <= test.highText;
+        default: return false;
+    }
+}
+
+bool summarize::RowFilter::matches(const std::vector<std::string>& record) const {
+    double numbers[MAX_COLUMNS];
+    uint8_t converted[MAX_COLUMNS];
+    std::memset(converted, 0, _names.size());
+    bool result = true;
+    for(size_t pc = 0; pc < _program.size(); pc++) {
+        const Op& op = _program[pc];
+        switch(op.code) {
+            case Op::TEST: result = _test(_tests[op.arg], record, numbers, converted); break;
+            case Op::NOT: result = !result; break;
+            case Op::JUMP_IF_FALSE: if(!result) pc = op.arg - 1; break;
+            case Op::JUMP_IF_TRUE: if(result) pc = op.arg - 1; break;
+        }
+    }
+    return result;
+}
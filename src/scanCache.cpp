@@ -0,0 +1,352 @@
+//
+// On-disk scan result cache (see scanCache.hpp).
+//
+// Entries are line oriented text. The first line names the format and its version, the
+// last line is "end" so a truncated entry is never accepted. Entries are written to a
+// temporary file and renamed into place, so concurrent readers see either the old or
+// the new entry, never a partial one.
+//
+
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <scanCache.hpp>
+
+const int summarize::ScanCache::FORMAT_VERSION = 7;
+
+namespace {
+    const char* const MAGIC = "summarize-scan-cache";
+    //! Bytes hashed from each end of the file for the fingerprint.
+    const size_t FINGERPRINT_HASH_BYTES = 4096;
+
+    //! Escape tabs, newlines, carriage returns and backslashes so \p s fits on one line.
+    std::string escape(const std::string& s) {
+        std::string ret;
+        ret.reserve(s.size());
+        for(char c: s) {
+            switch(c) {
+                case '\\': ret += "\\\\"; break;
+                case '\t': ret += "\\t"; break;
+                case '\n': ret += "\\n"; break;
+                case '\r': ret += "\\r"; break;
+                default: ret += c;
+            }
+        }
+        return ret;
+    }
+
+    std::string unescape(const std::string& s) {
+        std::string ret;
+        ret.reserve(s.size());
+        for(size_t i = 0; i < s.size(); i++) {
+            if(s[i] != '\\' || i + 1 == s.size()) { ret += s[i]; continue; }
+            switch(s[++i]) {
+                case 't': ret += '\t'; break;
+                case 'n': ret += '\n'; break;
+                case 'r': ret += '\r'; break;
+                default: ret += s[i];
+            }
+        }
+        return ret;
+    }
+
+    //! Read a "<key> <value>" line. \return false if the key does not match.
+    template <typename T>
+    bool readField(std::istream& in, const std::string& key, T& value) {
+        std::string line;
+        if(!std::getline(in, line)) return false;
+        std::istringstream ss(line);
+        std::string k;
+        ss >> k >> value;
+        return !ss.fail() && k == key;
+    }
+}
+
+uint64_t summarize::fnv1a(const char* data, size_t len, uint64_t hash) {
+    for(size_t i = 0; i < len; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+uint64_t summarize::FileFingerprint::hashContent(const std::string& path, uint64_t size) {
+    std::ifstream in(path, std::ios::binary);
+    std::string buffer(FINGERPRINT_HASH_BYTES, '\0');
+    in.read(&buffer[0], static_cast<std::streamsize>(std::min<uint64_t>(size, buffer.size())));
+    uint64_t hash = fnv1a(buffer.data(), static_cast<size_t>(in.gcount()));
+    if(size > FINGERPRINT_HASH_BYTES) {
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(size - FINGERPRINT_HASH_BYTES));
+        in.read(&buffer[0], static_cast<std::streamsize>(buffer.size()));
+        hash = fnv1a(buffer.data(), static_cast<size_t>(in.gcount()), hash);
+    }
+    return hash;
+}
+
+bool summarize::FileFingerprint::compute(const std::string& path, FileFingerprint& fp) {
+    struct stat st;
+    if(stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    if(access(path.c_str(), R_OK) != 0) return false;
+    fp.device = static_cast<uint64_t>(st.st_dev);
+    fp.inode = static_cast<uint64_t>(st.st_ino);
+    fp.size = static_cast<uint64_t>(st.st_size);
+    fp.mtimeNs = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    fp.contentHash = hashContent(path, fp.size);
+    return true;
+}
+
+std::string summarize::ScanCache::entryPath(const std::string& path) const {
+    std::error_code ec;
+    std::string absPath = std::filesystem::absolute(path, ec).lexically_normal().string();
+    if(ec) absPath = path;
+    std::ostringstream ss;
+    ss << std::hex << fnv1a(absPath.data(), absPath.size());
+    return (std::filesystem::path(_dir) / (ss.str() + ".sumcache")).string();
+}
+
+bool summarize::ScanCache::read(const std::string& path, TsvFile& file, bool hasHeader) {
+    _lastHit = false;
+    _lastGrown = false;
+    Request request = {hasHeader, file._detectHeader, file._sniff, file._delim, file._quoting, file._collectStats,
+                       file._previewRows, file._indexInterval};
+
+    FileFingerprint before;
+    if(file._sample || !FileFingerprint::compute(path, before)) {
+        // Not a regular file (e.g. a named pipe), or a sampled preview whose sampler state
+        // an entry does not hold; read it without caching.
+        std::ifstream inF(path);
+        return file.read(inF, hasHeader);
+    }
+    if(_load(path, before, request, file)) {
+        _lastHit = true;
+        // The file grew; save the new end state so the next run starts from here.
+        FileFingerprint after;
+        if(_lastGrown && FileFingerprint::compute(path, after) && after == before)
+            _store(path, before, request, file);
+        return true;
+    }
+
+    // _load may have partially restored file; start over with the caller's options.
+    TsvFile fresh;
+    fresh._copySettings(file);
+    if(request.sniff) fresh.sniffDelim(request.delim);
+    else fresh.setDelim(request.delim);
+    file = std::move(fresh);
+
+    std::ifstream inF(path);
+    if(!file.read(inF, hasHeader)) return false;
+    if(file._partial.valid) return true;        // stopped by its time budget
+
+    // Only store the result if the file did not change while it was being read.
+    FileFingerprint after;
+    if(FileFingerprint::compute(path, after) && after == before)
+        _store(path, before, request, file);
+    return true;
+}
+
+bool summarize::ScanCache::_load(const std::string& path, const FileFingerprint& fp,
+                                 const Request& request, TsvFile& file) {
+    std::ifstream in(entryPath(path));
+    if(!in) return false;
+
+    int version = 0;
+    if(!readField(in, MAGIC, version) || version != FORMAT_VERSION) return false;
+
+    std::string line;
+    if(!std::getline(in, line) || line != "path " + escape(path)) return false;
+
+    FileFingerprint entryFp;
+    if(!std::getline(in, line)) return false;
+    {
+        std::istringstream ss(line);
+        std::string key;
+        ss >> key >> entryFp.device >> entryFp.inode >> entryFp.size >> entryFp.mtimeNs >> entryFp.contentHash;
+        if(ss.fail() || key != "fingerprint") return false;
+    }
+    if(entryFp != fp) {
+        // An append only file may resume from the entry if the bytes it covered are
+        // unchanged: same inode, not smaller, and the same head and tail hashes as before.
+        if(!_incremental || entryFp.device != fp.device || entryFp.inode != fp.inode ||
+           fp.size < entryFp.size || FileFingerprint::hashContent(path, entryFp.size) != entryFp.contentHash)
+            return false;
+        _lastGrown = true;
+    }
+
+    int hasHeader, detectHeader, sniff, delim, quoting, hasStats, detectedDelim, quote, headerRead;
+    size_t indexInterval;
+    if(!std::getline(in, line)) return false;
+    {
+        std::istringstream ss(line);
+        std::string key;
+        ss >> key >> hasHeader >> detectHeader >> sniff >> delim >> quoting >> hasStats >> indexInterval;
+        if(ss.fail() || key != "request") return false;
+    }
+    if(static_cast<bool>(hasHeader) != request.hasHeader || static_cast<bool>(detectHeader) != request.detectHeader ||
+       static_cast<bool>(sniff) != request.sniff ||
+       static_cast<char>(delim) != request.delim || static_cast<Quoting>(quoting) != request.quoting ||
+       (request.collectStats && !hasStats) ||
+       indexInterval != request.indexInterval)
+        return false;
+
+    size_t dataOffset, resumeOffset, nRows, minFields, previewRows, nCols, nStats;
+    if(!readField(in, "delim", detectedDelim) || !readField(in, "quote", quote)) return false;
+    std::vector<size_t> columnStarts;
+    if(!std::getline(in, line)) return false;
+    {   // "columnStarts <n> <offset>..."
+        std::istringstream ss(line);
+        std::string key;
+        size_t n;
+        ss >> key >> n;
+        if(ss.fail() || key != "columnStarts") return false;
+        columnStarts.resize(n);
+        for(size_t& start: columnStarts) ss >> start;
+        if(ss.fail()) return false;
+    }
+    if(!readField(in, "header", headerRead) || !readField(in, "dataOffset", dataOffset) ||
+       !readField(in, "resume", resumeOffset) || !readField(in, "nRows", nRows) ||
+       !readField(in, "minFields", minFields) || !readField(in, "previewRows", previewRows))
+        return false;
+    // The entry must hold at least as many preview rows as requested (or every row).
+    if(previewRows < request.previewRows && previewRows < nRows) return false;
+    if(resumeOffset > fp.size) return false;
+
+    if(!readField(in, "columns", nCols)) return false;
+    std::vector<std::string> headers(nCols);
+    std::vector<std::vector<std::string> > data(nCols);
+    for(size_t col = 0; col < nCols; col++) {
+        // one line per column: header, then the preview cells, tab separated
+        if(!std::getline(in, line)) return false;
+        std::istringstream ss(line);
+        std::string cell;
+        if(!std::getline(ss, cell, '\t')) cell.clear();           // empty header
+        headers[col] = unescape(cell);
+        for(size_t row = 0; row < previewRows; row++) {
+            if(!std::getline(ss, cell, '\t')) cell.clear();       // trailing empty cell
+            if(row < request.previewRows) data[col].push_back(unescape(cell));
+        }
+    }
+    if(!readField(in, "stats", nStats) || nStats > nCols) return false;
+    std::vector<ColumnStats> stats(nStats);
+    for(size_t col = 0; col < nStats; col++) {
+        if(!std::getline(in, line) || !stats[col].deserialize(line)) return false;
+    }
+    std::vector<size_t> recordIndex;
+    if(!std::getline(in, line)) return false;
+    {   // "index <n> <offset>..."
+        std::istringstream ss(line);
+        std::string key;
+        size_t n;
+        ss >> key >> n;
+        if(ss.fail() || key != "index") return false;
+        recordIndex.resize(n);
+        for(size_t& offset: recordIndex) ss >> offset;
+        if(ss.fail()) return false;
+    }
+    if(!std::getline(in, line) || line != "end") return false;
+
+    std::ifstream input(path, std::ios::binary);
+    if(!input.seekg(static_cast<std::streamoff>(resumeOffset))) return false;
+
+    file._delim = static_cast<char>(detectedDelim);
+    file._sniff = false;
+    file._dialect.delim = file._delim;
+    file._dialect.quote = static_cast<char>(quote);
+    file._dialect.columnStarts = std::move(columnStarts);
+    file._dialect.hasHeader = headerRead;
+    file._hasHeader = headerRead;
+    file._dataOffset = dataOffset;
+    file._nRows = nRows;
+    file._minFields = minFields;
+    file._headers.clear();
+    for(const auto& name: headers) file._headers.push_back(name);
+    file._preview.clear();
+    size_t nPreviewRows = data.empty() ? 0 : data.front().size();
+    for(size_t row = 0; row < nPreviewRows; row++)
+        for(auto& column: data) file._preview.push_back(std::move(column[row]));
+    if(request.collectStats) file._stats = std::move(stats);
+    else file._stats.clear();
+    file._recordIndex = std::move(recordIndex);
+
+    // Parse whatever follows the last complete record the entry covers: nothing for an
+    // unchanged file, the unterminated last record if it had one, or the appended bytes.
+    return file._resume(input, resumeOffset);
+}
+
+bool summarize::ScanCache::_store(const std::string& path, const FileFingerprint& fp,
+                                  const Request& request, const TsvFile& file) const {
+    std::error_code ec;
+    std::filesystem::create_directories(_dir, ec);
+    if(ec) {
+        std::cerr << "WARN: Could not create cache directory '" << _dir << "': " << ec.message() << std::endl;
+        return false;
+    }
+
+    // The entry describes the input up to the last line terminated record, so a later
+    // run can resume there. An unterminated last record is left out and parsed again.
+    const TsvFile::TailState& tail = file._tail;
+    size_t nRows = tail.valid ? tail.nRows : file._nRows;
+    size_t nCols = tail.valid ? tail.nCols : file._headers.size();
+    size_t nPreview = tail.valid ? tail.nPreviewRows : file.getNPreviewRows();
+    size_t minFields = tail.valid ? tail.minFields : file._minFields;
+    // Only the indexed rows before the unterminated record.
+    size_t nIndexed = request.indexInterval == 0 ? 0 :
+                      std::min(file._recordIndex.size(), (nRows + request.indexInterval - 1) / request.indexInterval);
+    const std::vector<ColumnStats>& stats = tail.valid ? tail.stats : file._stats;
+    bool hasStats = request.collectStats;
+
+    std::string entry = entryPath(path);
+    std::string tmpPath = entry + ".tmp." + std::to_string(getpid());
+    {
+        std::ofstream out(tmpPath);
+        if(!out) return false;
+        out << MAGIC << ' ' << FORMAT_VERSION << '\n'
+            << "path " << escape(path) << '\n'
+            << "fingerprint " << fp.device << ' ' << fp.inode << ' ' << fp.size << ' '
+                              << fp.mtimeNs << ' ' << fp.contentHash << '\n'
+            << "request " << request.hasHeader << ' ' << request.detectHeader << ' ' << request.sniff << ' '
+                          << static_cast<int>(request.delim) << ' ' << static_cast<int>(request.quoting) << ' '
+                          << hasStats << ' '
+                          << request.indexInterval << '\n'
+            << "delim " << static_cast<int>(file._delim) << '\n'
+            << "quote " << static_cast<int>(file._dialect.quote) << '\n'
+            << "columnStarts " << file._dialect.columnStarts.size();
+        for(size_t start: file._dialect.columnStarts) out << ' ' << start;
+        out << '\n'
+            << "header " << file._hasHeader << '\n'
+            << "dataOffset " << file._dataOffset << '\n'
+            << "resume " << file._resumeOffset << '\n'
+            << "nRows " << nRows << '\n'
+            << "minFields " << minFields << '\n'
+            << "previewRows " << nPreview << '\n'
+            << "columns " << nCols << '\n';
+        for(size_t col = 0; col < nCols; col++) {
+            out << escape(std::string(file._headers[col]));
+            for(size_t row = 0; row < nPreview; row++)
+                out << '\t' << escape(file._preview[row * file._headers.size() + col]);
+            out << '\n';
+        }
+        out << "stats " << (hasStats ? stats.size() : 0) << '\n';
+        if(hasStats)
+            for(const auto& columnStats: stats) out << columnStats.serialize() << '\n';
+        out << "index " << nIndexed;
+        for(size_t i = 0; i < nIndexed; i++) out << ' ' << file._recordIndex[i];
+        out << '\n';
+        out << "end\n";
+        if(!out) {
+            out.close();
+            std::filesystem::remove(tmpPath, ec);
+            return false;
+        }
+    }
+    std::filesystem::rename(tmpPath, entry, ec);
+    if(ec) {
+        std::filesystem::remove(tmpPath, ec);
+        return false;
+    }
+    return true;
+}
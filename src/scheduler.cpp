@@ -0,0 +1,172 @@
+//
+// Work-stealing task scheduler (see scheduler.hpp).
+//
+
+#include <iomanip>
+
+#include <scheduler.hpp>
+
+namespace {
+    //! The scheduler and worker index of the calling thread, if it is a worker.
+    thread_local const summarize::Scheduler* currentScheduler = nullptr;
+    thread_local int currentWorker = -1;
+}
+
+summarize::Scheduler::Scheduler(size_t threads) {
+    _queued = 0;
+    _nextWorker = 0;
+    _externalWaiters = 0;
+    _stop = false;
+    _start = Clock::now();
+    if(threads < 1) threads = 1;
+    for(size_t i = 0; i < threads; i++) _workers.push_back(std::make_unique<Worker>());
+    for(size_t i = 0; i < threads; i++)
+        _workers[i]->thread = std::thread(&Scheduler::_workerLoop, this, static_cast<int>(i));
+}
+
+summarize::Scheduler::~Scheduler() {
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for(auto& worker: _workers) worker->thread.join();
+}
+
+int summarize::Scheduler::_self() const {
+    return currentScheduler == this ? currentWorker : -1;
+}
+
+bool summarize::Scheduler::_take(int self, Task& task) {
+    if(self >= 0) {
+        Worker& own = *_workers[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if(!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            _queued.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    // Steal the oldest task, the one most likely to spawn more work, starting with the next
+    // worker so thieves spread over the victims.
+    size_t n = _workers.size();
+    size_t first = self >= 0 ? static_cast<size_t>(self) + 1 : 0;
+    for(size_t i = 0; i < n; i++) {
+        size_t victim = (first + i) % n;
+        if(static_cast<int>(victim) == self) continue;
+        Worker& worker = *_workers[victim];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if(worker.tasks.empty()) continue;
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        _queued.fetch_sub(1, std::memory_order_relaxed);
+        if(self >= 0) _workers[self]->nStolen.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    return false;
+}
+
+void summarize::Scheduler::_run(int self, Task& task) {
+    if(self < 0) {
+        task();
+    } else {
+        Worker& worker = *_workers[self];
+        bool outermost = worker.depth++ == 0;
+        Clock::time_point start = outermost ? Clock::now() : Clock::time_point();
+        task();
+        worker.depth--;
+        if(outermost) {
+            int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+            worker.busyNanoseconds.fetch_add(ns, std::memory_order_relaxed);
+        }
+        worker.nTasks.fetch_add(1, std::memory_order_relaxed);
+    }
+    task = Task();
+    if(_externalWaiters.load() > 0) {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _taskDone.notify_all();
+    }
+}
+
+void summarize::Scheduler::_workerLoop(int self) {
+    currentScheduler = this;
+    currentWorker = self;
+    Task task;
+    while(true) {
+        if(_take(self, task)) {
+            _run(self, task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wake.wait(lock, [this]() { return _stop || _queued.load() > 0; });
+        if(_stop && _queued.load() == 0) return;
+    }
+}
+
+void summarize::Scheduler::submit(Task task) {
+    int self = _self();
+    size_t target = self >= 0 ? static_cast<size_t>(self) : _nextWorker.fetch_add(1) % _workers.size();
+    Worker& worker = *_workers[target];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.tasks.push_back(std::move(task));
+    }
+    _queued.fetch_add(1);
+    // Taking the lock orders the push before a worker's check of _queued, so it is not
+    // missed by one about to sleep.
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+    }
+    _wake.notify_one();
+}
+
+bool summarize::Scheduler::runPending() {
+    int self = _self();
+    Task task;
+    if(!_take(self, task)) return false;
+    _run(self, task);
+    return true;
+}
+
+void summarize::Scheduler::waitUntil(const std::function<bool()>& done) {
+    int self = _self();
+    if(self >= 0) {
+        SpinWait spin;
+        while(!done()) {
+            if(!runPending()) spin.wait();
+        }
+        return;
+    }
+    _externalWaiters.fetch_add(1);
+    std::unique_lock<std::mutex> lock(_sleepMutex);
+    // The timeout covers a task finishing between the check and the wait.
+    while(!done()) _taskDone.wait_for(lock, std::chrono::milliseconds(1));
+    lock.unlock();
+    _externalWaiters.fetch_sub(1);
+}
+
+std::vector<summarize::Scheduler::WorkerStats> summarize::Scheduler::getWorkerStats() const {
+    std::vector<WorkerStats> ret;
+    for(const auto& worker: _workers) {
+        WorkerStats stats;
+        stats.tasks = worker->nTasks.load(std::memory_order_relaxed);
+        stats.stolen = worker->nStolen.load(std::memory_order_relaxed);
+        stats.busySeconds = static_cast<double>(worker->busyNanoseconds.load(std::memory_order_relaxed)) / 1e9;
+        ret.push_back(stats);
+    }
+    return ret;
+}
+
+void summarize::Scheduler::print(std::ostream& out) const {
+    double seconds = std::chrono::duration<double>(Clock::now() - _start).count();
+    std::vector<WorkerStats> stats = getWorkerStats();
+    out << "Workers: " << stats.size() << " threads over " << std::fixed << std::setprecision(2)
+        << seconds * 1000 << " ms\n";
+    for(size_t i = 0; i < stats.size(); i++) {
+        out << "  worker " << i << ": busy " << std::setprecision(1)
+            << (seconds > 0 ? 100 * stats[i].busySeconds / seconds : 0) << "%, "
+            << stats[i].tasks << " tasks (" << stats[i].stolen << " stolen)\n";
+    }
+    out.unsetf(std::ios_base::floatfield);
+}
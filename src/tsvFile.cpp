@@ -3,180 +3,877 @@
 //
 
 #include <cstdio>
+#include <cstdint>
 #include <cctype>
 #include <algorithm>
+#include <cmath>
+#include <iomanip>
 
 #include <tsvFile.hpp>
+#include <scheduler.hpp>
+#include <columnParallelStats.hpp>
 
 namespace {
     //! Upper bound on the number of bytes buffered for delimiter sniffing.
     const size_t SNIFF_MAX_BYTES = 1u << 16;   // 64 KiB
     //! Number of complete records to collect for the sniff sample when available.
     const size_t SNIFF_RECORDS = 20;
+    //! Output TsvFile::extract buffers before writing it.
+    const size_t EXTRACT_BUFFER_BYTES = 1u << 20;
 
-    //! Read a leading sample from \p is into \p sample. Quote-aware so that newlines
-    //! embedded in quoted fields do not end a record early. Stops after SNIFF_RECORDS
-    //! complete records, or once past SNIFF_MAX_BYTES with at least one complete record,
-    //! or at EOF. Always reads at least the first complete record (up to EOF) so the
-    //! sample is never truncated before its first line terminator.
+    //! Read a leading sample from \p reader into \p sample, giving back the rest of the
+    //! last block read. Quote-aware so that newlines embedded in quoted fields do not end a
+    //! record early. Stops after SNIFF_RECORDS complete records, or once past
+    //! SNIFF_MAX_BYTES with at least one complete record, or at EOF. Always reads at least
+    //! the first complete record (up to EOF) so the sample is never truncated before its
+    //! first line terminator.
     //! \return true if EOF was reached (so \p sample is the entire input).
-    bool readSample(std::istream& is, std::string& sample) {
-        std::streambuf* sb = is.rdbuf();
+    bool readSample(summarize::BlockReader& reader, std::string& sample) {
         bool inQuotes = false;
+        bool afterCr = false;       // the last block ended with a \r ending a record
         size_t records = 0;
-        while(true) {
-            if(records >= SNIFF_RECORDS) return false;
-            if(sample.size() >= SNIFF_MAX_BYTES && records >= 1) return false;
-            int ci = sb->sbumpc();
-            if(ci == EOF) return true;
-            char c = static_cast<char>(ci);
-            sample += c;
-            if(c == '"') { inQuotes = !inQuotes; continue; }
-            if(!inQuotes && (c == '\n' || c == '\r')) {
-                if(c == '\r' && sb->sgetc() == '\n') { sb->sbumpc(); sample += '\n'; }
+        const char* data;
+        size_t size;
+        while(reader.next(data, size)) {
+            const char* p = data;
+            const char* end = data + size;
+            if(afterCr && *p == '\n') p++;
+            afterCr = false;
+            while(true) {
+                size_t taken = sample.size() + static_cast<size_t>(p - data);
+                if(records >= SNIFF_RECORDS || (records >= 1 && taken >= SNIFF_MAX_BYTES)) {
+                    sample.append(data, p);
+                    reader.unread(static_cast<size_t>(end - p));
+                    return false;
+                }
+                const char* limit = records >= 1 ? p + std::min<size_t>(SNIFF_MAX_BYTES - taken, end - p) : end;
+                const char* q = summarize::findAny(p, limit, '"', '\n', '\r');
+                p = q;
+                if(q == limit) {
+                    if(q == end) break;
+                    continue;
+                }
+                p++;
+                if(*q == '"') {
+                    inQuotes = !inQuotes;
+                    continue;
+                }
+                if(inQuotes) continue;
+                if(*q == '\r') {
+                    if(p == end) afterCr = true;
+                    else if(*p == '\n') p++;
+                }
                 records++;
+                if(afterCr) break;
             }
+            sample.append(data, end);
         }
+        return true;
     }
 
-    //! A std::streambuf that yields the bytes of a prefix string first, then continues
-    //! reading from an underlying streambuf. Lets a sniffed sample be re-read followed by
-    //! the remainder of a non-seekable stream (e.g. stdin).
-    class PrefixStreamBuf : public std::streambuf {
-    public:
-        PrefixStreamBuf(std::string prefix, std::streambuf* rest)
-            : _prefix(std::move(prefix)), _pos(0), _rest(rest) {}
-    protected:
-        int_type underflow() override {   // peek, no advance
-            if(_pos < _prefix.size()) return traits_type::to_int_type(_prefix[_pos]);
-            return _rest ? _rest->sgetc() : traits_type::eof();
-        }
-        int_type uflow() override {       // read and advance
-            if(_pos < _prefix.size()) return traits_type::to_int_type(_prefix[_pos++]);
-            return _rest ? _rest->sbumpc() : traits_type::eof();
+    //! Initial size of the window readTail reads from the end of a seekable input.
+    const size_t TAIL_WINDOW_BYTES = 1u << 16;   // 64 KiB
+
+    //! Offset in \p buffer, the last bytes of an input, of the first record start that can
+    //! be proven from \p buffer alone. A line terminator is a record boundary if it is
+    //! outside \p quote quotes, which (for input that ends outside quotes) is the case
+    //! exactly when an even number of quote characters follow it. Doubled quotes do not
+    //! change the parity. Without \p quoting every line terminator is a boundary.
+    //! \return std::string::npos if \p buffer holds no boundary.
+    size_t firstRecordStart(const std::string& buffer, char quote, bool quoting) {
+        size_t ret = std::string::npos;
+        bool even = true;
+        for(size_t i = buffer.size(); i-- > 0;) {
+            char c = buffer[i];
+            if(c == quote && quoting) even = !even;
+            else if(even && c == '\n') ret = i + 1;
+            else if(even && c == '\r' && (i + 1 == buffer.size() || buffer[i + 1] != '\n')) ret = i + 1;
         }
-    private:
-        std::string _prefix;
-        size_t _pos;
-        std::streambuf* _rest;
-    };
+        return ret;
+    }
+
+    //! Records are reported to the ProgressReporter in batches of this size (a power of 2).
+    const size_t PROGRESS_RECORD_BATCH = 1u << 12;
+
 }
 
-void summarize::TsvFile::_prepareInput(std::istream& is, std::string& sample) {
+void summarize::TsvFile::_prepareInput(BlockReader& reader, std::string& sample) {
     sample.clear();
-    bool complete = readSample(is, sample);
-    stripUtf8Bom(sample);
+    reader.setProgress(_progress);
+    bool complete = readSample(reader, sample);
+    _dataOffset = stripUtf8Bom(sample) ? 3 : 0;
 
     char sepDelim;
     size_t bytesToStrip;
+    char knownDelim = _sniff ? 0 : _delim;
     if(detectSepDirective(sample, sepDelim, bytesToStrip)) {
         sample.erase(0, bytesToStrip);     // never parse the directive line as data
-        if(_sniff) _delim = sepDelim;      // "sep=" sets the delimiter unless one was explicit
-    } else if(_sniff) {
-        _delim = sniffDelimiter(sample, complete, _delim);
+        _dataOffset += bytesToStrip;
+        if(_sniff) knownDelim = sepDelim;  // "sep=" sets the delimiter unless one was explicit
+    }
+    // A fixed-width layout sniffed by an earlier read holds for later reads of the input.
+    std::vector<size_t> columnStarts;
+    if(!_sniff) columnStarts.swap(_dialect.columnStarts);
+    _dialect = sniffDialect(sample, complete, _delim, knownDelim);
+    if(!columnStarts.empty()) _dialect.columnStarts.swap(columnStarts);
+    _delim = _dialect.delim;
+    if(_dialect.commentBytes) {
+        sample.erase(0, _dialect.commentBytes);
+        _dataOffset += _dialect.commentBytes;
     }
     _sniff = false;
 }
 
-bool summarize::TsvFile::_read(std::istream& is, size_t nLines, bool allLines, bool hasHeader) {
+void summarize::TsvFile::_addToStats(std::vector<ColumnStats>& stats, const std::vector<std::string>& record) {
+    if(record.size() > stats.size()) {
+        // Columns first seen in this record were missing from every earlier data row.
+        size_t rowsSoFar = stats.empty() ? 0 : stats.front().getCount();
+        size_t oldSize = stats.size();
+        stats.resize(record.size());
+        for(size_t col = oldSize; col < stats.size(); col++) stats[col].addMissing(rowsSoFar);
+    }
+    for(size_t col = 0; col < record.size(); col++) stats[col].add(record[col]);
+    for(size_t col = record.size(); col < stats.size(); col++) stats[col].addMissing();
+}
+
+size_t summarize::TsvFile::_firstRecord(const std::string& sample, std::vector<std::string>& record) const {
+    // The sample holds the first record whole (see readSample).
+    BlockReader reader;
+    reader.setSpan(sample.data(), sample.size());
+    if(_dialect.isFixedWidth()) {
+        FixedWidthParser parser(reader, _dialect.columnStarts);
+        while(parser.nextRecord(record) && record.empty()) {}
+        return parser.getPosition();
+    }
+    if(_quoting == Quoting::NONE) {
+        DialectParser<0, Quoting::NONE> parser(reader, _delim);
+        while(parser.nextRecord(record) && record.empty()) {}
+        return parser.getPosition();
+    }
+    DialectParser<0, Quoting::RFC4180> parser(reader, _delim, _dialect.quote);
+    while(parser.nextRecord(record) && record.empty()) {}
+    return parser.getPosition();
+}
+
+bool summarize::TsvFile::_resolveColumns(const std::string& sample) {
+    _keptColumns = SIZE_MAX;
+    if(_selection.empty() && !_filter.isSet() && !_groups) return true;
+    std::vector<std::string> first;
+    _firstRecord(sample, first);
+    ColumnNames names;
+    for(size_t col = 0; col < first.size(); col++) {
+        if(_hasHeader) names.push_back(first[col]);
+        else names.pushNumbered("COLUMN_", col);
+    }
+    if(!_selection.empty() && !_selection.resolve(names)) return false;
+    if(_groups) {
+        if(!_groups->resolve(names)) return false;
+        std::vector<size_t> keyFields;
+        for(size_t col: _groups->getKeyColumns())
+            keyFields.push_back(_selection.isResolved() ? _selection.add(col) : col);
+        // Statistics of every other column read.
+        std::vector<size_t> valueFields;
+        size_t width = _selection.isResolved() ? _selection.size() : names.size();
+        for(size_t field = 0; field < width; field++) {
+            if(std::find(keyFields.begin(), keyFields.end(), field) == keyFields.end()) valueFields.push_back(field);
+        }
+        _groups->setFields(keyFields, valueFields);
+    }
+    if(!_filter.isSet()) return true;
+    if(!_filter.resolve(names)) return false;
+    if(_selection.isResolved()) {
+        // Columns only the filter reads are parsed after the selected ones, and cut off
+        // once the record is tested.
+        _keptColumns = _selection.size();
+        std::vector<size_t> fields;
+        for(size_t col: _filter.getColumns()) fields.push_back(_selection.add(col));
+        _filter.setFields(fields);
+    }
+    return true;
+}
+
+bool summarize::TsvFile::_columnParallel(size_t width) const {
+    if(!_scheduler || _scheduler->getThreads() < 2 || width < WIDE_TABLE_COLUMNS) return false;
+    return !_planner || _plan.engine == ExecutionPlan::Engine::COLUMN_PARALLEL;
+}
+
+void summarize::TsvFile::_inferTypes() {
+    _dataTypes.clear();
+    for(size_t col = 0; col < _headers.size(); col++) {
+        if(col < _stats.size()) {
+            _dataTypes.push_back(_stats[col].getType());
+            continue;
+        }
+        ColumnStats preview;
+        for(size_t i = col; i < _preview.size(); i += _headers.size()) preview.add(_preview[i]);
+        _dataTypes.push_back(preview.getType());
+    }
+}
+
+bool summarize::TsvFile::_read(BlockReader& reader, size_t nLines, bool allLines, bool hasHeader) {
+    _hasHeader = hasHeader;
+    _previewStart = 0;
+    _sampler.reset(_sample ? _previewRows : 0, _sampleSeed);
+    _startDeadline();
+    // The input size, if it can be found, to extrapolate the row count of a partial read.
+    _partial.totalBytes = _timeBudget > 0 ? reader.getRemaining() : 0;
     std::string sample;
-    _prepareInput(is, sample);
-    PrefixStreamBuf inBuf(std::move(sample), is.rdbuf());
-    std::istream in(&inBuf);
+    _profile.start("sniff");
+    _prepareInput(reader, sample);
+    hasHeader = _resolveHeader(hasHeader);
+    if(!_resolveColumns(sample)) {
+        _profile.stop();
+        return false;
+    }
+    if(_planner) {
+        SampleFacts facts = describeSample(sample, _delim, _dialect.quote, _quoting == Quoting::RFC4180);
+        if(_dialect.isFixedWidth()) {
+            facts.fields = facts.records * _dialect.columnStarts.size();
+            facts.quoting = false;
+        }
+        // Skipped fields cost parsing, but no statistics.
+        if(_selection.isResolved()) facts.fields = std::min(facts.fields, facts.records * _selection.size());
+        _planner->refine(_plan, facts, _scheduler ? _scheduler->getThreads() : 1);
+    }
+    reader.setPrefix(std::move(sample));
 
     // Retain only the header (if any) plus the first _previewRows data rows. Every other
     // record is parsed into a reused scratch buffer purely to count it and measure the
     // widest record, so memory stays O(_previewRows * columns) regardless of file size.
-    const size_t retainRecords = (hasHeader ? 1 : 0) + _previewRows;
-    std::vector<std::vector<std::string> > retained;
-    std::vector<std::string> scratch;
+    std::vector<std::string> header;
+    std::vector<std::vector<std::string> > preview;
     size_t largestRow = 0;
-    CsvParser parser(in, _delim);
-    for(size_t i = 0;; i++) {
-        if(!allLines && i >= nLines) break;
-        bool keep = retained.size() < retainRecords;
-        if(keep) retained.emplace_back();
-        std::vector<std::string>& record = keep ? retained.back() : scratch;
+    _scanBase = _dataOffset;
+    _profile.start("parse");
+    // The pipeline needs every record and rows in input order: not for partial, sampled or
+    // time limited reads. A plan may rule it out for inputs too small to gain from it.
+    bool pipelined = allLines && _scheduler && _scheduler->getThreads() > 1 && !_sample && _timeBudget <= 0 &&
+                     (!_planner || _plan.engine == ExecutionPlan::Engine::PIPELINE);
+    size_t nRecords = pipelined ? _scanPipeline(reader, hasHeader, header, preview, largestRow) :
+                      _scan(reader, allLines ? SIZE_MAX : nLines, hasHeader, header, preview, largestRow);
+    _deadline = std::chrono::steady_clock::time_point::max();
+    std::string readAhead = readAheadName(reader.getReadAhead());
+    if(reader.getReadAhead() != BlockReader::ReadAhead::NONE)
+        readAhead += ", " + std::to_string(reader.getQueueDepth()) + " blocks";
+    _profile.setReadStall(reader.getStallSeconds(), readAhead);
+    if(nRecords == 0) {
+        std::cerr << "ERROR: no data in input!" << std::endl;
+        _profile.stop();
+        return false;
+    }
+    if(!allLines && !_partial.valid && nRecords > 1 && nRecords < nLines)
+        std::cerr << "WARN: Fewer rows than " << std::to_string(nLines) << std::endl;
+    _profile.setRecords(nRecords);
+
+    _profile.start("build");
+    _build(header, preview, largestRow);
+    _profile.stop();
+    return true;
+}
+
+size_t summarize::TsvFile::_scan(BlockReader& reader, size_t maxRecords, bool headerPending,
+                                 std::vector<std::string>& header,
+                                 std::vector<std::vector<std::string> >& preview, size_t& largestRow) {
+    if(_dialect.isFixedWidth()) {
+        FixedWidthParser parser(reader, _dialect.columnStarts);
+        parser.setSelection(_selected());
+        return _scanRecords(parser, maxRecords, headerPending, header, preview, largestRow);
+    }
+    switch(_delim) {
+        case '\t': return _scanDialect<'\t'>(reader, maxRecords, headerPending, header, preview, largestRow);
+        case ',': return _scanDialect<','>(reader, maxRecords, headerPending, header, preview, largestRow);
+        case ';': return _scanDialect<';'>(reader, maxRecords, headerPending, header, preview, largestRow);
+        case '|': return _scanDialect<'|'>(reader, maxRecords, headerPending, header, preview, largestRow);
+        default: return _scanDialect<0>(reader, maxRecords, headerPending, header, preview, largestRow);
+    }
+}
+
+template <char DELIM>
+size_t summarize::TsvFile::_scanDialect(BlockReader& reader, size_t maxRecords, bool headerPending,
+                                        std::vector<std::string>& header,
+                                        std::vector<std::vector<std::string> >& preview, size_t& largestRow) {
+    if(_quoting == Quoting::NONE) {
+        DialectParser<DELIM, Quoting::NONE> parser(reader, _delim);
+        parser.setSelection(_selected());
+        return _scanRecords(parser, maxRecords, headerPending, header, preview, largestRow);
+    }
+    DialectParser<DELIM, Quoting::RFC4180> parser(reader, _delim, _dialect.quote);
+    parser.setSelection(_selected());
+    return _scanRecords(parser, maxRecords, headerPending, header, preview, largestRow);
+}
+
+template <typename Parser>
+size_t summarize::TsvFile::_scanRecords(Parser& parser, size_t maxRecords, bool headerPending,
+                                        std::vector<std::string>& header,
+                                        std::vector<std::vector<std::string> >& preview, size_t& largestRow) {
+    std::vector<std::string> scratch;
+    size_t boundary = 0;      // parser position just past the last terminated record
+    size_t dataStart = 0;     // parser position of the first data row
+    _tail = TailState();
+    // Set on the first data row of a wide table (see setScheduler).
+    std::unique_ptr<ColumnParallelStats> columnStats;
+    bool firstRow = true;
+    size_t nRecords = 0;
+    for(; nRecords < maxRecords; nRecords++) {
+        size_t start = parser.getPosition();
+        bool isHeader = headerPending && nRecords == 0;
+        bool keep = !isHeader && preview.size() < _previewRows;
+        if(keep) preview.emplace_back();
+        std::vector<std::string>& record = isHeader ? header : (keep ? preview.back() : scratch);
         // Skip blank lines (records with no fields) anywhere in the input, matching the
         // behaviour of R's blank.lines.skip and pandas' skip_blank_lines.
+        // Rows the filter rejects are counted once terminated, so a resumed scan does not
+        // count them again.
         bool got;
-        while((got = parser.nextRecord(record)) && record.empty()) {}
-        if (!got) {
-            if(keep) retained.pop_back();
-            if(i == 0) {
-                std::cerr << "ERROR: no data in input!" << std::endl;
-                return false;
-            }
-            if(i > 1) {
-                if(!allLines) std::cerr << "WARN: Fewer rows than " << std::to_string(nLines) << std::endl;
-            }
+        while((got = parser.nextRecord(record)) && !_keepRecord(record, isHeader)) {
+            if(!parser.lastTerminated()) continue;
+            boundary = parser.getPosition();
+            if(!record.empty()) _nFiltered++;
+        }
+        if(!got) {
+            if(keep) preview.pop_back();
             break;
         }
 
-        _nRows++;
+        if(parser.lastTerminated()) {
+            boundary = parser.getPosition();
+        } else {
+            // A final record without a line terminator may still be being written. Keep
+            // the state before it so an incremental scan resumes at its first byte.
+            _tail.valid = true;
+            _tail.nRows = _nRows;
+            _tail.nCols = largestRow;
+            _tail.nPreviewRows = preview.size() - (keep ? 1 : 0);
+            _tail.minFields = _minFields;
+            if(columnStats) columnStats->flush();
+            _tail.stats = _stats;
+            _tail.sampler = _sampler;
+        }
+
         largestRow = std::max(largestRow, record.size());
+        if(isHeader) {
+            dataStart = parser.getPosition();
+        } else {
+            // Filtered rows are not at the offsets of their row numbers: no index.
+            if(_indexInterval && !_filter.isSet() && _nRows % _indexInterval == 0)
+                _recordIndex.push_back(_scanBase + start);
+            _nRows++;
+            _minFields = std::min(_minFields, record.size());
+            bool sampled = !keep && _sampler.takes(_nRows - 1);
+            if(firstRow && _collectStats && _columnParallel(record.size()))
+                columnStats = std::make_unique<ColumnParallelStats>(*_scheduler, _stats);
+            firstRow = false;
+            if(_groups) _groups->add(record);
+            if(_collectStats) {
+                if(!columnStats) _addToStats(_stats, record);
+                else if(keep || sampled) columnStats->add(record);
+                else columnStats->take(scratch);        // scratch is only parsed into again
+            }
+            // Algorithm L decides ahead which rows enter the sample; all others are only
+            // counted. A chosen row is swapped in, so no strings are copied.
+            if(sampled) {
+                size_t slot = _sampler.replace();
+                if(_tail.valid) {
+                    _tail.sampleSlot = slot;
+                    _tail.sampleEvicted = preview[slot];
+                }
+                std::swap(scratch, preview[slot]);
+            }
+        }
+        if(((nRecords + 1) & (PROGRESS_RECORD_BATCH - 1)) == 0) {
+            // Batch boundary: the only place the progress counters and deadline are touched.
+            if(_progress) _progress->addRecords(PROGRESS_RECORD_BATCH);
+            if(_deadline != std::chrono::steady_clock::time_point::max() &&
+               std::chrono::steady_clock::now() >= _deadline) {
+                _partial.valid = true;
+                _partial.rows = _nRows;
+                _partial.bytes = _scanBase + parser.getPosition();
+                size_t scanned = parser.getPosition() - dataStart;
+                size_t total = _partial.totalBytes - _scanBase - dataStart;
+                if(_partial.totalBytes > _partial.bytes && scanned > 0) {
+                    // Extrapolate the row count from the rows per byte seen so far.
+                    _nRows = static_cast<size_t>(static_cast<double>(_nRows) / static_cast<double>(scanned) *
+                                                 static_cast<double>(total) + 0.5);
+                    _nRowsEstimated = true;
+                }
+                nRecords++;
+                break;
+            }
+        }
+    }
+    if(columnStats) columnStats->flush();
+    if(_progress) _progress->addRecords(nRecords & (PROGRESS_RECORD_BATCH - 1));
+    _resumeOffset = _scanBase + boundary;
+    return nRecords;
+}
+
+void summarize::TsvFile::_build(const std::vector<std::string>& header,
+                                const std::vector<std::vector<std::string> >& preview, size_t largestRow) {
+    for(size_t i = _headers.size(); i < largestRow; i++) {
+        if(!_hasHeader)     // numbered as in the input, with or without a selection
+            _headers.pushNumbered("COLUMN_", i < _selection.size() ? _selection.getColumns()[i] : i);
+        else if(header.size() > i)
+            _headers.push_back(header[i]);
+        else _headers.pushNumbered("NO_NAME_COLUMN_", i);
+    }
+
+    // populate _preview with the retained data rows, padded to the full width
+    size_t nCols = _headers.size();
+    _preview.clear();
+    _preview.reserve(preview.size() * nCols);
+    for(const auto& row: preview) {
+        for(size_t col = 0; col < nCols; col++) {
+            if(row.size() > col) _preview.push_back(row[col]);
+            else _preview.emplace_back();
+        }
+    }
+
+    // A header wider than every data row leaves trailing columns with no values at all.
+    if(_collectStats && _stats.size() < _headers.size()) {
+        size_t rows = _stats.empty() ? _nRows : _stats.front().getCount();
+        size_t oldSize = _stats.size();
+        _stats.resize(_headers.size());
+        for(size_t col = oldSize; col < _stats.size(); col++) _stats[col].addMissing(rows);
+    }
+    _inferTypes();
+}
+
+void summarize::TsvFile::_rollbackTail() {
+    _nRows = _tail.nRows;
+    _minFields = _tail.minFields;
+    if(_indexInterval)
+        _recordIndex.resize(std::min(_recordIndex.size(), (_nRows + _indexInterval - 1) / _indexInterval));
+    _stats = std::move(_tail.stats);
+    _sampler = _tail.sampler;
+    size_t oldCols = _headers.size();
+    size_t nCols = std::min(oldCols, _tail.nCols);
+    size_t nPreviewRows = std::min(getNPreviewRows(), _tail.nPreviewRows);
+    if(nCols < oldCols) {
+        // Drop the columns only the unterminated record had from each preview row.
+        for(size_t row = 0; row < nPreviewRows; row++)
+            for(size_t col = 0; col < nCols; col++)
+                _preview[row * nCols + col] = std::move(_preview[row * oldCols + col]);
+    }
+    _preview.resize(nPreviewRows * nCols);
+    _headers.truncate(nCols);
+    if(_tail.sampleSlot != SIZE_MAX) {
+        // Put back the sampled row the unterminated record replaced.
+        const std::vector<std::string>& row = _tail.sampleEvicted;
+        for(size_t col = 0; col < nCols; col++)
+            _preview[_tail.sampleSlot * nCols + col] = col < row.size() ? row[col] : std::string();
+    }
+    _tail = TailState();
+}
+
+void summarize::TsvFile::_copySettings(const TsvFile& other) {
+    _delim = other._delim;
+    _sniff = other._sniff;
+    _previewRows = other._previewRows;
+    _collectStats = other._collectStats;
+    _indexInterval = other._indexInterval;
+    _sample = other._sample;
+    _sampleSeed = other._sampleSeed;
+    _timeBudget = other._timeBudget;
+    _quoting = other._quoting;
+    _detectHeader = other._detectHeader;
+    _scheduler = other._scheduler;
+    _batchBytes = other._batchBytes;
+    _planner = other._planner;
+    _plan = other._plan;
+    _selection = other._selection;
+    _filter = other._filter;
+    _groups = other._groups;
+    _progress = other._progress;
+}
+
+bool summarize::TsvFile::_resume(std::istream& is, size_t offset) {
+    if(_tail.valid) _rollbackTail();
+    BlockReader reader(is.rdbuf());
+    reader.setProgress(_progress);
+
+    // The restored preview is held in one array; scanning appends rows.
+    std::vector<std::vector<std::string> > preview(getNPreviewRows());
+    for(size_t row = 0; row < preview.size(); row++) {
+        auto first = _preview.begin() + static_cast<std::ptrdiff_t>(row * _headers.size());
+        preview[row].assign(first, first + static_cast<std::ptrdiff_t>(_headers.size()));
+    }
+    std::vector<std::string> header;
+    size_t largestRow = _headers.size();
+
+    _scanBase = offset;
+    _profile.start("parse");
+    size_t nRecords = _scan(reader, SIZE_MAX, _hasHeader && _headers.empty(), header, preview, largestRow);
+    _profile.setRecords(nRecords);
+    _profile.start("build");
+    _build(header, preview, largestRow);
+    _profile.stop();
+    return !_headers.empty();
+}
+
+bool summarize::TsvFile::read(std::istream& is, size_t nLines, bool hasHeader) {
+    BlockReader reader(is.rdbuf());
+    return _read(reader, nLines, false, hasHeader);
+}
+
+bool summarize::TsvFile::read(std::istream& is, bool hasHeader) {
+    BlockReader reader(is.rdbuf());
+    return _read(reader, 0, true, hasHeader);
+}
+
+bool summarize::TsvFile::read(BlockReader& reader, size_t nLines, bool hasHeader) {
+    return _read(reader, nLines, false, hasHeader);
+}
+
+bool summarize::TsvFile::read(BlockReader& reader, bool hasHeader) {
+    return _read(reader, 0, true, hasHeader);
+}
+
+bool summarize::TsvFile::extract(BlockReader& reader, std::ostream& out, bool hasHeader) {
+    std::string sample;
+    _prepareInput(reader, sample);
+    _resolveHeader(hasHeader);
+    if(!_resolveColumns(sample)) return false;
+    reader.setPrefix(std::move(sample));
+    if(_dialect.isFixedWidth()) {
+        FixedWidthParser parser(reader, _dialect.columnStarts);
+        parser.setSelection(_selected());
+        return _extractRecords(parser, out);
+    }
+    switch(_delim) {
+        case '\t': return _extractDialect<'\t'>(reader, out);
+        case ',': return _extractDialect<','>(reader, out);
+        case ';': return _extractDialect<';'>(reader, out);
+        case '|': return _extractDialect<'|'>(reader, out);
+        default: return _extractDialect<0>(reader, out);
+    }
+}
+
+template <char DELIM>
+bool summarize::TsvFile::_extractDialect(BlockReader& reader, std::ostream& out) {
+    if(_quoting == Quoting::NONE) {
+        DialectParser<DELIM, Quoting::NONE> parser(reader, _delim);
+        parser.setSelection(_selected());
+        return _extractRecords(parser, out);
     }
+    DialectParser<DELIM, Quoting::RFC4180> parser(reader, _delim, _dialect.quote);
+    parser.setSelection(_selected());
+    return _extractRecords(parser, out);
+}
 
-    if(hasHeader) {
-        _nRows--;
-        for(size_t i = 0; i < largestRow; i++) {
-            if(retained[0].size() > i)
-                _headers.push_back(retained[0].at(i));
-            else _headers.push_back("NO_NAME_COLUMN_" + std::to_string(i));
+template <typename Parser>
+bool summarize::TsvFile::_extractRecords(Parser& parser, std::ostream& out) {
+    bool quoting = _quoting == Quoting::RFC4180;
+    std::vector<std::string> record;
+    std::string buffer;
+    buffer.reserve(EXTRACT_BUFFER_BYTES + PARSE_BLOCK_SIZE);
+    size_t nRecords = 0;
+    while(parser.nextRecord(record)) {
+        if(!_keepRecord(record, _hasHeader && nRecords == 0)) {
+            if(!record.empty()) _nFiltered++;       // else a blank line, not a record
+            continue;
+        }
+        nRecords++;
+        for(size_t col = 0; col < record.size(); col++) {
+            if(col) buffer += _delim;
+            if(quoting) appendField(buffer, record[col], _delim, _dialect.quote);
+            else buffer += record[col];
         }
+        // A lone empty field would read back as a blank line.
+        if(quoting && record.size() == 1 && record[0].empty()) buffer.append(2, _dialect.quote);
+        buffer += '\n';
+        if(buffer.size() >= EXTRACT_BUFFER_BYTES) {
+            out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+    out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    out.flush();
+    _nRows = nRecords - (_hasHeader && nRecords > 0 ? 1 : 0);
+    if(!out) {
+        std::cerr << "ERROR: could not write the selected columns!" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool summarize::TsvFile::seekPreview(std::istream& is, size_t firstRow) {
+    _previewStart = firstRow;
+    _preview.clear();
+    if(firstRow >= _nRows) {
+        _inferTypes();
+        return false;
+    }
+
+    size_t offset = _dataOffset;
+    size_t row = 0;
+    bool headerPending = _hasHeader;
+    if(_indexInterval && !_recordIndex.empty()) {
+        size_t checkpoint = std::min(firstRow / _indexInterval, _recordIndex.size() - 1);
+        offset = _recordIndex[checkpoint];
+        row = checkpoint * _indexInterval;
+        headerPending = false;
+    }
+    is.clear();
+    if(!is.seekg(static_cast<std::streamoff>(offset))) return false;
+
+    BlockReader reader(is.rdbuf());
+    if(_dialect.isFixedWidth()) {
+        FixedWidthParser parser(reader, _dialect.columnStarts);
+        parser.setSelection(_selected());
+        _previewRecords(parser, row, firstRow, headerPending);
+    } else if(_quoting == Quoting::NONE) {
+        DialectParser<0, Quoting::NONE> parser(reader, _delim);
+        parser.setSelection(_selected());
+        _previewRecords(parser, row, firstRow, headerPending);
     } else {
-        for(size_t i = 0; i < largestRow; i++)
-            _headers.push_back("COLUMN_" + std::to_string(i));
+        DialectParser<0, Quoting::RFC4180> parser(reader, _delim, _dialect.quote);
+        parser.setSelection(_selected());
+        _previewRecords(parser, row, firstRow, headerPending);
     }
+    _inferTypes();
+    return true;
+}
 
-    // populate _headerMap
-    for(size_t i = 0; i < _headers.size(); i++) {
-        _headerMap[_headers[i]] = i;
+template <typename Parser>
+void summarize::TsvFile::_previewRecords(Parser& parser, size_t row, size_t firstRow, bool headerPending) {
+    std::vector<std::string> record;
+    size_t kept = 0;
+    while(kept < _previewRows && parser.nextRecord(record)) {
+        if(!_keepRecord(record, headerPending)) continue;        // blank lines are not rows
+        if(headerPending) {
+            headerPending = false;
+            continue;
+        }
+        if(row++ < firstRow) continue;
+        for(size_t col = 0; col < _headers.size(); col++)
+            _preview.push_back(col < record.size() ? record[col] : std::string());
+        kept++;
+    }
+}
+
+size_t summarize::TsvFile::_scanLast(BlockReader& reader, size_t n, bool headerPending,
+                                     std::vector<std::string>& header,
+                                     std::vector<std::vector<std::string> >& last, size_t& largestRow) {
+    if(_dialect.isFixedWidth()) {
+        FixedWidthParser parser(reader, _dialect.columnStarts);
+        return _scanLastRecords(parser, n, headerPending, header, last, largestRow);
     }
+    if(_quoting == Quoting::NONE) {
+        DialectParser<0, Quoting::NONE> parser(reader, _delim);
+        return _scanLastRecords(parser, n, headerPending, header, last, largestRow);
+    }
+    DialectParser<0, Quoting::RFC4180> parser(reader, _delim, _dialect.quote);
+    return _scanLastRecords(parser, n, headerPending, header, last, largestRow);
+}
 
-    // populate _data by transposing the retained data rows
-    for (size_t col = 0; col < largestRow; col++) {
-        _data.emplace_back();
-        for(size_t row = (hasHeader ? 1 : 0); row < retained.size(); row++) {
-            if (retained[row].size() > col)
-                _data[col].push_back(retained[row][col]);
-            else _data[col].emplace_back();
+template <typename Parser>
+size_t summarize::TsvFile::_scanLastRecords(Parser& parser, size_t n, bool headerPending,
+                                            std::vector<std::string>& header,
+                                            std::vector<std::vector<std::string> >& last, size_t& largestRow) {
+    std::vector<std::string> scratch;
+    last.assign(n, std::vector<std::string>());
+    size_t nRows = 0;
+    while(true) {
+        std::vector<std::string>& record = headerPending ? header : scratch;
+        bool got;
+        while((got = parser.nextRecord(record)) && record.empty()) {}
+        if(!got) break;
+        largestRow = std::max(largestRow, record.size());
+        if(headerPending) {
+            headerPending = false;
+            continue;
         }
+        _minFields = std::min(_minFields, record.size());
+        // Swap into the ring slot of the oldest row; its strings are reused next time.
+        if(n) std::swap(scratch, last[nRows % n]);
+        nRows++;
     }
+    // Unroll the ring, oldest row first.
+    if(nRows < n) last.resize(nRows);
+    else if(n) std::rotate(last.begin(), last.begin() + static_cast<long>(nRows % n), last.end());
+    return nRows;
+}
+
+bool summarize::TsvFile::readTail(std::istream& is, size_t n, bool hasHeader) {
+    _hasHeader = hasHeader;
+    _previewStart = 0;
+    _collectStats = false;
+    _nRowsEstimated = false;
+    std::streambuf* sb = is.rdbuf();
+    std::streamoff end = sb->pubseekoff(0, std::ios::end, std::ios::in);
+    bool seekable = end >= 0 && sb->pubseekpos(0, std::ios::in) == 0;
 
+    BlockReader reader(sb);
+    std::string sample;
+    _profile.start("sniff");
+    _prepareInput(reader, sample);
+    hasHeader = _resolveHeader(hasHeader);
+    std::vector<std::string> header;
+    std::vector<std::vector<std::string> > last;
+    size_t largestRow = 0;
+
+    _profile.start("parse");
+    if(!seekable) {
+        reader.setPrefix(std::move(sample));
+        _nRows = _scanLast(reader, n, hasHeader, header, last, largestRow);
+    } else {
+        // The header is always within the sample, which holds at least one whole record.
+        size_t dataStart = _dataOffset;
+        if(hasHeader) {
+            dataStart += _firstRecord(sample, header);
+            largestRow = header.size();
+        }
+        size_t size = static_cast<size_t>(end);
+        std::string window;
+        for(size_t windowSize = TAIL_WINDOW_BYTES;; windowSize *= 2) {
+            size_t start = size - dataStart > windowSize ? size - windowSize : dataStart;
+            window.resize(size - start);
+            sb->pubseekpos(static_cast<std::streamoff>(start), std::ios::in);
+            window.resize(static_cast<size_t>(sb->sgetn(&window[0], static_cast<std::streamsize>(window.size()))));
+            if(_progress) _progress->addBytes(window.size());
+            bool atStart = start == dataStart;
+            bool quoting = _quoting == Quoting::RFC4180 && !_dialect.isFixedWidth();
+            size_t anchor = atStart ? 0 : firstRecordStart(window, _dialect.quote, quoting);
+            if(anchor == std::string::npos) continue;
+
+            // Parse forward from the proven record start. Only records after it are complete.
+            size_t minFields = _minFields;
+            size_t widest = largestRow;
+            BlockReader windowReader;
+            windowReader.setPrefix(window.substr(anchor));
+            size_t nRecords = _scanLast(windowReader, n, false, header, last, widest);
+            if(nRecords < n && !atStart) {
+                _minFields = minFields;
+                continue;
+            }
+            largestRow = widest;
+            if(atStart) {
+                _nRows = nRecords;
+            } else {
+                // Extrapolate from the average record length in the window.
+                double bytesPerRow = static_cast<double>(window.size() - anchor) / static_cast<double>(nRecords);
+                _nRows = std::max(nRecords, static_cast<size_t>(static_cast<double>(size - dataStart) / bytesPerRow + 0.5));
+                _nRowsEstimated = true;
+            }
+            break;
+        }
+    }
+    _profile.setRecords(last.size());
+    if(_nRows == 0 && largestRow == 0) {
+        std::cerr << "ERROR: no data in input!" << std::endl;
+        _profile.stop();
+        return false;
+    }
+
+    _profile.start("build");
+    _previewRows = last.size();
+    _build(header, last, largestRow);
+    _previewStart = _nRows - last.size();
+    _profile.stop();
     return true;
 }
 
-bool summarize::TsvFile::read(std::istream& is, size_t nLines, bool hasHeader) {
-    return _read(is, nLines, false, hasHeader);
+bool summarize::TsvFile::readMore(std::istream& is) {
+    _profile = Profile();
+    return _resume(is, _resumeOffset);
 }
 
-bool summarize::TsvFile::read(std::istream& is, bool hasHeader) {
-    return _read(is, 0, true, hasHeader);
-}
-
-void summarize::TsvFile::printSummary() const {
-    throw std::runtime_error("Not implemented!");
-}
-
-void summarize::TsvFile::printStructure(size_t nRows) const {
-    std::cout << _nRows << " obs. of " << getNCols() << " variables" << std::endl;
-    size_t maxRowI = numDigits(_headers.size());
-    size_t maxRowLen = maxLength(_headers);
-    for(size_t i = 0; i < _headers.size(); i++) {
-        size_t indent = maxRowI - numDigits(i + 1);
-        std::cout << std::string(indent, ' ') << std::to_string(i + 1) << ") " << _headers[i]
-                  << std::string(maxRowLen - _headers.at(i).size(), ' ') + ':';
-        // TODO: add data type here!
-        // _nRows is the full row count; only getNPreviewRows() rows are retained in _data.
-        size_t printRows = std::min(nRows, getNPreviewRows());
-        for (size_t row = 0; row < printRows; row++)
-            std::cout << ' ' << _data.at(i).at(row);
+void summarize::TsvFile::_printDimensions() const {
+    std::cout << (_nRowsEstimated ? "~" : "") << _nRows << " obs. of " << getNCols() << " variables";
+    if(_approx.valid) {
+        std::cout << " (95% CI " << std::llround(_approx.nRowsLow) << " to " << std::llround(_approx.nRowsHigh)
+                  << " obs.; statistics of " << _approx.sampledRows << " rows in " << _approx.usableBlocks
+                  << " random blocks)";
+    }
+    if(_partial.valid) {
+        std::cout << " (partial: time budget reached after " << _partial.rows << " rows";
+        if(_partial.bytes > 0) {
+            std::cout << ", " << _partial.bytes;
+            if(_partial.totalBytes > 0) std::cout << " of " << _partial.totalBytes;
+            std::cout << " bytes";
+        }
+        std::cout << "; statistics cover those rows)";
+    }
+    if(_filter.isSet())
+        std::cout << " (where: " << _nRows << " of " << _nRows + _nFiltered << " rows match)";
+    if(_nRows > 0 && _minFields < getNCols())
+        std::cout << " (ragged: rows have " << _minFields << " to " << getNCols() << " fields)";
+    std::cout << std::endl;
+}
+
+bool summarize::TsvFile::printGroups() const {
+    _printDimensions();
+    return _groups && _groups->write(std::cout, _headers, _dataTypes);
+}
+
+void summarize::TsvFile::_columnPage(size_t firstColumn, size_t maxColumns, size_t& begin, size_t& end) const {
+    begin = std::min(firstColumn, _headers.size());
+    end = maxColumns == 0 ? _headers.size() : std::min(_headers.size(), begin + maxColumns);
+}
+
+void summarize::TsvFile::_printColumnName(size_t col, size_t indexWidth, size_t nameWidth) const {
+    // Padded with setw, so no string is built per column.
+    std::string_view name = _headers[col];
+    std::cout << std::setw(static_cast<int>(indexWidth)) << col + 1 << ") " << name
+              << std::setw(static_cast<int>(nameWidth - name.size())) << "" << ": "
+              << ColumnStats::typeToString(_dataTypes[col]);
+}
+
+void summarize::TsvFile::_printPageEnd(size_t begin, size_t end) const {
+    if(begin > 0 || end < _headers.size())
+        std::cout << "(columns " << begin + 1 << " to " << end << " of " << _headers.size() << ")\n";
+}
+
+void summarize::TsvFile::printSummary(size_t firstColumn, size_t maxColumns) const {
+    _printDimensions();
+    size_t begin, end;
+    _columnPage(firstColumn, maxColumns, begin, end);
+    size_t indexWidth = numDigits(end);
+    size_t nameWidth = 0;
+    for(size_t i = begin; i < end; i++) nameWidth = std::max(nameWidth, _headers[i].size());
+    for(size_t i = begin; i < end; i++) {
+        _printColumnName(i, indexWidth, nameWidth);
+        if(i >= _stats.size()) {
+            std::cout << '\n';
+            continue;
+        }
+        const ColumnStats& stats = _stats[i];
+        std::cout << ", " << stats.getMissing() << " missing";
+        if(stats.getNNumeric() > 0 && (_dataTypes[i] == TYPE::INT || _dataTypes[i] == TYPE::FLOAT)) {
+            std::cout << ", min " << stats.getMin() << ", max " << stats.getMax()
+                      << ", mean " << stats.getMean();
+            // Sampled rows: the normal approximation interval of the mean.
+            if(_approx.valid && stats.getNNumeric() > 1)
+                std::cout << " \u00b1 " << 1.96 * stats.getSd() / std::sqrt(static_cast<double>(stats.getNNumeric()));
+            if(stats.getNNumeric() > 1) std::cout << ", sd " << stats.getSd();
+        } else {
+            std::cout << ", max length " << stats.getMaxLength();
+        }
+        std::cout << '\n';
+    }
+    _printPageEnd(begin, end);
+}
+
+void summarize::TsvFile::printStructure(size_t nRows, size_t firstColumn, size_t maxColumns) const {
+    _printDimensions();
+    size_t begin, end;
+    _columnPage(firstColumn, maxColumns, begin, end);
+    size_t indexWidth = numDigits(end);
+    size_t nameWidth = 0;
+    for(size_t i = begin; i < end; i++) nameWidth = std::max(nameWidth, _headers[i].size());
+    // _nRows is the full row count; only getNPreviewRows() rows are retained in _preview.
+    size_t printRows = std::min(nRows, getNPreviewRows());
+    for(size_t i = begin; i < end; i++) {
+        _printColumnName(i, indexWidth, nameWidth);
+        if(_previewStart > 0) std::cout << " ...";
+        for(size_t row = 0; row < printRows; row++)
+            std::cout << ' ' << _preview[row * _headers.size() + i];
         std::cout << " ...\n";
     }
+    _printPageEnd(begin, end);
 }
 
-size_t summarize::maxLength(std::vector<std::string> strings) {
+size_t summarize::maxLength(const std::vector<std::string>& strings) {
     size_t ret = 0;
     for(const auto& s: strings) ret = std::max(ret, s.size());
     return ret;
@@ -194,6 +891,20 @@ char summarize::delimFromExtension(const std::string& path) {
     return '\t';
 }
 
+void summarize::appendField(std::string& out, std::string_view value, char delim, char quote) {
+    const char* end = value.data() + value.size();
+    if(findAny(value.data(), end, delim, quote, '\n') == end && value.find('\r') == std::string_view::npos) {
+        out += value;
+        return;
+    }
+    out += quote;
+    for(char c: value) {
+        if(c == quote) out += quote;
+        out += c;
+    }
+    out += quote;
+}
+
 bool summarize::hasParquetExtension(const std::string& path) {
     size_t slash = path.find_last_of("/\\");
     size_t dot = path.find_last_of('.');
@@ -243,69 +954,618 @@ bool summarize::detectSepDirective(const std::string& sample, char& delim, size_
     return true;
 }
 
+namespace {
+    //! Delimiters sniffDialect scores, in tie-break preference order. The first
+    //! N_COMMON_DELIMS are the usual ones; the rest (the ASCII ^A and unit separators of
+    //! Hive and similar exports, and symbols rarely found in values) are only chosen when
+    //! none of those is consistent, and then only if EXTRA_DELIM_CONSISTENCY is reached.
+    const char DELIM_CANDIDATES[] = {'\t', ',', ';', '|', '\x01', '\x1F', '^', '~'};
+    const size_t N_COMMON_DELIMS = 4;
+    const double EXTRA_DELIM_CONSISTENCY = 0.9;
+    //! Rows below the first record, and leading columns, whose types sniffDialect compares
+    //! with the first record to tell whether it is a header. Wider records give a vote per
+    //! column, so fewer rows are typed, down to 2, to keep within HEADER_SNIFF_VALUES.
+    const size_t HEADER_SNIFF_ROWS = 8;
+    const size_t HEADER_SNIFF_COLUMNS = 32;
+    const size_t HEADER_SNIFF_VALUES = 24;
+    //! Prefix of the comment lines sniffDialect recognizes before the first record.
+    const char COMMENT_PREFIX = '#';
+    //! Records below the comments needed to take the input as fixed-width: more than a
+    //! few, as a handful of short lines line up by chance.
+    const size_t FIXED_WIDTH_MIN_RECORDS = 4;
+
+    //! Whether \p c can be next to the quote character that opens or closes a field.
+    bool isFieldEdge(char c) {
+        unsigned char u = static_cast<unsigned char>(c);
+        return u < 0x80 && !std::isalnum(u) && c != '"' && c != '\'';
+    }
+
+    //! Choose between '"' and '\'' as the quote character of \p sample. A quote character
+    //! is counted as opening a field when it follows a field edge and as closing one when
+    //! one follows it, so apostrophes within words do not count. '\'' is chosen only if
+    //! its quoted fields (the lesser of the two counts) outnumber those of '"'.
+    char sniffQuote(const std::string& sample) {
+        size_t open[2] = {0, 0}, close[2] = {0, 0};
+        const char* begin = sample.data();
+        const char* end = begin + sample.size();
+        for(const char* p = summarize::findAny(begin, end, '"', '\'', '\''); p != end; p = summarize::findAny(p + 1, end, '"', '\'', '\'')) {
+            size_t q = *p == '\'';
+            if(p == begin || isFieldEdge(p[-1])) open[q]++;
+            if(p + 1 == end || isFieldEdge(p[1])) close[q]++;
+        }
+        size_t doubleQuoted = std::min(open[0], close[0]);
+        size_t singleQuoted = std::min(open[1], close[1]);
+        return singleQuoted >= 2 && singleQuoted > doubleQuoted ? '\'' : '"';
+    }
+
+    //! Most common nonzero value of the \p n counts \p stride apart from \p counts (the
+    //! smallest on ties), and how often it occurs, with \p freq as scratch space.
+    void modeOf(const uint32_t* counts, size_t n, size_t stride, std::vector<uint32_t>& freq,
+                uint32_t& mode, size_t& modeFreq) {
+        mode = 0;
+        modeFreq = 0;
+        uint32_t max = 0;
+        for(size_t i = 0; i < n; i++) max = std::max(max, counts[i * stride]);
+        if(max == 0) return;
+        freq.assign(max + 1, 0);
+        for(size_t i = 0; i < n; i++) freq[counts[i * stride]]++;
+        for(uint32_t v = 1; v <= max; v++) {
+            if(freq[v] > modeFreq) {
+                mode = v;
+                modeFreq = freq[v];
+            }
+        }
+    }
+
+    //! Offsets at which the columns of the fixed-width \p records start: the first is 0, and
+    //! every other follows a position that is a space (or past the end) in every record.
+    //! \return no offsets unless every record that is not blank has a value past the first
+    //! column, most of them have values on both sides of every column start, and there are
+    //! at least three columns or two spaces before some column start. A single space at the
+    //! same offset is as likely a space within one-column text ("New York", "San Jose").
+    std::vector<size_t> sniffColumnStarts(const std::vector<std::string_view>& records) {
+        std::vector<size_t> ret;
+        size_t width = 0;
+        for(std::string_view record: records) width = std::max(width, record.size());
+        std::vector<char> blank(width, 1);
+        for(std::string_view record: records) {
+            for(size_t i = 0; i < record.size(); i++) {
+                if(record[i] != ' ' && record[i] != '\r') blank[i] = 0;
+            }
+        }
+        // A column starts where a value follows a blank position; the first one at 0, even
+        // if its values are right aligned.
+        bool content = false;
+        for(size_t i = 0; i < width; i++) {
+            if(blank[i]) continue;
+            if(!content) ret.push_back(0);
+            else if(blank[i - 1]) ret.push_back(i);
+            content = true;
+        }
+        if(ret.size() < 2) return std::vector<size_t>();
+        bool wideGap = false;
+        for(size_t col = 1; col < ret.size(); col++) wideGap = wideGap || blank[ret[col] - 2];
+        if(ret.size() < 3 && !wideGap) return std::vector<size_t>();
+        // Records with values on both sides of each column start.
+        std::vector<size_t> split(ret.size(), 0);
+        size_t nonBlank = 0;
+        for(std::string_view record: records) {
+            size_t last = record.find_last_not_of(" \r");
+            if(last == std::string_view::npos) continue;
+            if(last < ret[1]) return std::vector<size_t>();
+            nonBlank++;
+            size_t first = record.find_first_not_of(" \r");
+            for(size_t col = 1; col < ret.size(); col++) split[col] += first < ret[col] && last >= ret[col];
+        }
+        for(size_t col = 1; col < ret.size(); col++) {
+            if(2 * split[col] <= nonBlank) return std::vector<size_t>();
+        }
+        return ret;
+    }
+
+    //! The first \p maxFields fields of the fixed-width \p record, whose columns start at
+    //! \p starts, with their spaces trimmed.
+    void sliceFields(std::string_view record, const std::vector<size_t>& starts, size_t maxFields,
+                     std::vector<std::string_view>& fields) {
+        fields.clear();
+        for(size_t col = 0; col < std::min(starts.size(), maxFields); col++) {
+            size_t end = col + 1 < starts.size() ? starts[col + 1] : std::string_view::npos;
+            std::string_view value = record.substr(std::min(starts[col], record.size()), end - starts[col]);
+            size_t first = value.find_first_not_of(" \r");
+            value = first == std::string_view::npos ? std::string_view() :
+                    value.substr(first, value.find_last_not_of(" \r") - first + 1);
+            fields.push_back(value);
+        }
+    }
+
+    //! How the header sniff sees a value: missing, a number or boolean, or a string.
+    enum ValueKind : char { MISSING, TYPED, UNTYPED };
+
+    ValueKind kindOf(std::string_view value) {
+        if(summarize::ColumnStats::isMissing(value)) return MISSING;
+        double number;
+        return summarize::ColumnStats::classify(value, number) != summarize::ColumnStats::STRING ? TYPED : UNTYPED;
+    }
+
+    //! The kinds of up to \p maxFields leading fields of \p record, split at \p delim outside
+    //! of \p quote quoted fields, into \p kinds. Short plain decimals, most of what the header
+    //! sniff sees, are recognized as the bytes go by; other values go through kindOf.
+    //! \return the number of fields.
+    size_t fieldKinds(std::string_view record, char delim, char quote, size_t maxFields, char* kinds) {
+        size_t n = 0;
+        const char* p = record.data();
+        const char* end = p + record.size();
+        const char* field = p;
+        bool inQuotes = false;
+        size_t digits = 0, dots = 0, others = 0;
+        auto finish = [&](const char* fieldEnd) {
+            size_t size = static_cast<size_t>(fieldEnd - field);
+            // Longer values may be out of the range of a double.
+            if(digits > 0 && dots <= 1 && others == 0 && size <= 20) {
+                kinds[n++] = TYPED;
+                return;
+            }
+            std::string_view value(field, size);
+            if(value.size() >= 2 && value.front() == quote && value.back() == quote)
+                value = value.substr(1, value.size() - 2);
+            kinds[n++] = kindOf(value);
+        };
+        for(; p != end && n < maxFields; p++) {
+            char c = *p;
+            if(c == delim && !inQuotes) {
+                finish(p);
+                field = p + 1;
+                digits = dots = others = 0;
+            }
+            else if(static_cast<unsigned char>(c - '0') <= 9) digits++;
+            else if(c == '.') dots++;
+            else {
+                others++;
+                if(c == quote) inQuotes = !inQuotes;
+            }
+        }
+        if(n < maxFields) finish(end);
+        return n;
+    }
+}
+
+summarize::Dialect summarize::sniffDialect(const std::string& sample, bool sampleComplete, char fallback, char delim) {
+    Dialect ret;
+    ret.quote = sniffQuote(sample);
+    const char quote = ret.quote;
+
+    // The common delimiters (and a forced one) are counted first; the extra ones only when
+    // none of those is consistent, so most inputs take one narrow histogram.
+    const size_t N_DELIM_CANDIDATES = sizeof(DELIM_CANDIDATES);
+    char candidates[N_DELIM_CANDIDATES + 1];
+    std::copy(DELIM_CANDIDATES, DELIM_CANDIDATES + N_DELIM_CANDIDATES, candidates);
+    size_t N = N_COMMON_DELIMS;
+    if(delim && std::find(candidates, candidates + N, delim) == candidates + N) candidates[N++] = delim;
+    // One SIMD pass over the sample counts every candidate of every record outside of
+    // quotes. The last record is complete only at EOF.
+    RecordHistogram hist;
+    hist.counts.reserve((SNIFF_RECORDS + 1) * (N_DELIM_CANDIDATES + 1));
+    hist.starts.reserve(SNIFF_RECORDS + 1);
+    hist.ends.reserve(SNIFF_RECORDS + 1);
+    histogramRecords(sample.data(), sample.size(), candidates, N, quote, sampleComplete, hist);
+    const std::vector<uint32_t>& counts = hist.counts;
+    const std::vector<size_t>& starts = hist.starts;
+    const std::vector<size_t>& ends = hist.ends;
+    const size_t nRecords = starts.size();
+
+    // Leading records that start with the comment prefix are left out of the delimiter
+    // scores; those that do not turn out to be a header are skipped as comments.
+    size_t nLeading = 0;
+    while(nLeading < nRecords && sample[starts[nLeading]] == COMMENT_PREFIX) nLeading++;
+    if(nLeading == nRecords) nLeading = 0;
+
+    // Pick the most consistent delimiter. Among equally consistent candidates prefer the
+    // one yielding more fields (higher modal count), then the order of DELIM_CANDIDATES.
+    ret.delim = fallback;
+    uint32_t delimMode = 0;
+    std::vector<uint32_t> freq;
+    double bestConsistency[2] = {-1.0, -1.0};
+    uint32_t bestMode[2] = {0, 0};
+    size_t best[2] = {N, N};
+    const size_t nScored = nRecords - nLeading;
+    auto score = [&](size_t from) {
+        for(size_t k = from; k < N; k++) {
+            uint32_t mode;
+            size_t modeFreq;
+            modeOf(counts.data() + nLeading * N + k, nScored, N, freq, mode, modeFreq);
+            double consistency = nScored == 0 ? 0 : static_cast<double>(modeFreq) / nScored;
+            if(candidates[k] == delim) {
+                ret.delim = delim;
+                ret.consistency = consistency;
+                delimMode = mode;
+            }
+            if(modeFreq == 0) continue;     // this delimiter never appears
+            size_t tier = k < N_COMMON_DELIMS ? 0 : 1;
+            if(consistency > bestConsistency[tier] || (consistency == bestConsistency[tier] && mode > bestMode[tier])) {
+                bestConsistency[tier] = consistency;
+                bestMode[tier] = mode;
+                best[tier] = k;
+            }
+        }
+    };
+    score(0);
+    if(!delim && bestConsistency[0] < 0.5) {
+        // Count the extra candidates too. The records are the same, and so are the scores
+        // of the common ones.
+        N = N_DELIM_CANDIDATES;
+        hist.counts.clear();
+        hist.starts.clear();
+        hist.ends.clear();
+        histogramRecords(sample.data(), sample.size(), candidates, N, quote, sampleComplete, hist);
+        score(N_COMMON_DELIMS);
+    }
+    bool fallenBack = false;
+    if(!delim) {
+        size_t tier = 2;
+        if(bestConsistency[0] >= 0.5) tier = 0;
+        else if(bestConsistency[1] >= EXTRA_DELIM_CONSISTENCY && nRecords - nLeading >= 2) tier = 1;
+        if(tier < 2) {
+            ret.delim = candidates[best[tier]];
+            ret.consistency = bestConsistency[tier];
+            delimMode = bestMode[tier];
+        }
+        fallenBack = tier == 2;
+    }
+
+    // The leading '#' records are comments, except that the last one is the header if it
+    // has the delimiter count of the data rows and no space after the '#' (as VCF "#CHROM").
+    size_t kDelim = static_cast<size_t>(std::find(candidates, candidates + N, ret.delim) - candidates);
+    size_t nComments = nLeading;
+    if(nLeading > 0 && kDelim < N && delimMode > 0) {
+        size_t start = starts[nLeading - 1];
+        if(counts[(nLeading - 1) * N + kDelim] == delimMode && start + 1 < sample.size() &&
+           !std::isspace(static_cast<unsigned char>(sample[start + 1])))
+            nComments--;
+    }
+    if(nComments > 0) {
+        ret.commentPrefix = COMMENT_PREFIX;
+        ret.commentBytes = starts[nComments];
+    }
+    auto record = [&](size_t r) {
+        return std::string_view(sample).substr(starts[r], ends[r] - starts[r]);
+    };
+
+    // Without a delimiter, records that line up in columns are fixed-width.
+    if(fallenBack && nRecords - nComments >= FIXED_WIDTH_MIN_RECORDS) {
+        std::vector<std::string_view> records;
+        for(size_t r = nComments; r < nRecords; r++) records.push_back(record(r));
+        ret.columnStarts = sniffColumnStarts(records);
+    }
+
+    // Header likelihood: in each column whose values below the first record are all
+    // numbers or booleans, a string in the first record votes for a header and a value of
+    // the column's type against one. Without typed columns there is no evidence and the
+    // first record is taken as a header, as before. Only a typed value in the first record
+    // can vote against it, so without one the rows below are not typed at all.
+    size_t first = nComments;
+    size_t last = std::min(nRecords, first + 1 + HEADER_SNIFF_ROWS);
+    std::vector<std::string_view> values;
+    auto kinds = [&](size_t r, size_t maxFields, char* into) {
+        if(!ret.isFixedWidth()) return fieldKinds(record(r), ret.delim, quote, maxFields, into);
+        sliceFields(record(r), ret.columnStarts, maxFields, values);
+        for(size_t col = 0; col < values.size(); col++) into[col] = kindOf(values[col]);
+        return values.size();
+    };
+    char header[HEADER_SNIFF_COLUMNS];
+    size_t nHeader = last - first >= 2 ? kinds(first, HEADER_SNIFF_COLUMNS, header) : 0;
+    if(std::find(header, header + nHeader, TYPED) != header + nHeader) {
+        size_t rows = std::clamp<size_t>(HEADER_SNIFF_VALUES / nHeader, 2, HEADER_SNIFF_ROWS);
+        last = std::min(last, first + 1 + rows);
+        char fields[HEADER_SNIFF_COLUMNS], typed[HEADER_SNIFF_COLUMNS] = {}, allTyped[HEADER_SNIFF_COLUMNS];
+        std::fill(allTyped, allTyped + nHeader, 1);
+        for(size_t r = first + 1; r < last; r++) {
+            size_t nFields = kinds(r, nHeader, fields);
+            for(size_t col = 0; col < nFields; col++) {
+                if(!allTyped[col] || fields[col] == MISSING) continue;
+                typed[col] = 1;
+                allTyped[col] = fields[col] == TYPED;
+            }
+        }
+        for(size_t col = 0; col < nHeader; col++) {
+            if(!typed[col] || !allTyped[col] || header[col] == MISSING) continue;
+            ret.headerVotes += header[col] == TYPED ? -1 : 1;
+        }
+    }
+    ret.hasHeader = ret.headerVotes >= 0;
+    return ret;
+}
+
 char summarize::sniffDelimiter(const std::string& sample, bool sampleComplete, char fallback) {
-    static const char candidates[] = {'\t', ',', ';', '|'};   // also the tie-break preference order
-    const size_t N = sizeof(candidates);
-    std::vector<std::vector<int> > recordCounts(N);
-    int cur[N] = {0};
-    bool inQuotes = false;
-    bool recordHasChars = false;
-
-    auto flushRecord = [&]() {
-        if(recordHasChars)
-            for(size_t k = 0; k < N; k++) recordCounts[k].push_back(cur[k]);
-        for(size_t k = 0; k < N; k++) cur[k] = 0;
-        recordHasChars = false;
+    return sniffDialect(sample, sampleComplete, fallback).delim;
+}
+
+// The consumed bytes of the current block count towards _base as the next one is read.
+template <char DELIM, summarize::Quoting QUOTING>
+bool summarize::DialectParser<DELIM, QUOTING>::_fill() {
+    _base += static_cast<size_t>(_end - _begin);
+    size_t size;
+    bool got = _reader.next(_begin, size);
+    _cur = _begin;
+    _end = _begin + size;
+    return got;
+}
+
+template <char DELIM, summarize::Quoting QUOTING>
+void summarize::DialectParser<DELIM, QUOTING>::_readQuoted(std::string& field) {
+    while(true) {
+        const char* p = findAny(_cur, _end, _quote, '\r', '\r');
+        field.append(_cur, p);
+        _cur = p;
+        if(_cur == _end) {
+            if(!_fill()) return;
+            continue;
+        }
+        char c = *_cur++;
+        if(_cur == _end && !_fill()) {
+            if(c == '\r') field += '\n';
+            return;
+        }
+        if(c == '\r') {
+            field += '\n';                     // embedded \r and \r\n become \n
+            if(*_cur == '\n') _cur++;
+        } else if(*_cur == _quote) {
+            field += _quote;                   // doubled "" -> literal "
+            _cur++;
+        } else {
+            return;                            // closing quote
+        }
+    }
+}
+
+template <char DELIM, summarize::Quoting QUOTING>
+void summarize::DialectParser<DELIM, QUOTING>::_skipQuoted() {
+    while(true) {
+        _cur = findAny(_cur, _end, _quote, _quote, _quote);
+        if(_cur == _end) {
+            if(!_fill()) return;
+            continue;
+        }
+        _cur++;
+        if(_cur == _end && !_fill()) return;
+        if(*_cur != _quote) return;            // closing quote
+        _cur++;                                // doubled ""
+    }
+}
+
+template <char DELIM, summarize::Quoting QUOTING>
+bool summarize::DialectParser<DELIM, QUOTING>::_skipRecord() {
+    const char delim = DELIM ? DELIM : _delim;
+    bool fieldStart = true;                    // the last byte passed is a delimiter
+    while(true) {
+        if(_cur == _end && !_fill()) return false;
+        if(QUOTING == Quoting::RFC4180 && fieldStart && *_cur == _quote) {
+            _cur++;
+            fieldStart = false;
+            _skipQuoted();
+            continue;
+        }
+        // Only a quote at the start of a field opens a quoted field, so the fields before
+        // the next quote or line terminator need not be split.
+        const char* p = QUOTING == Quoting::RFC4180 ? findAny(_cur, _end, _quote, '\n', '\r') :
+                        findAny(_cur, _end, '\n', '\r', '\r');
+        if(p != _cur) {
+            fieldStart = p[-1] == delim;
+            _cur = p;
+        }
+        if(_cur == _end || (QUOTING == Quoting::RFC4180 && fieldStart && *_cur == _quote)) continue;
+        char c = *_cur++;
+        if(QUOTING == Quoting::RFC4180 && c == _quote) {
+            fieldStart = false;                // a literal quote inside an unquoted field
+            continue;
+        }
+        if(c == '\r' && (_cur != _end || _fill()) && *_cur == '\n') _cur++;
+        return true;
+    }
+}
+
+template <char DELIM, summarize::Quoting QUOTING>
+bool summarize::DialectParser<DELIM, QUOTING>::_nextSelected(std::vector<std::string>& fields) {
+    const char delim = DELIM ? DELIM : _delim;
+    const ColumnSelection& selection = *_selection;
+    _terminated = true;
+    fields.resize(selection.size());
+    for(std::string& value: fields) value.clear();
+    // The output field of input column col, nullptr for a skipped one.
+    auto target = [&fields, &selection](size_t col) {
+        size_t slot = selection.slot(col);
+        return slot ? &fields[slot - 1] : nullptr;
     };
+    size_t col = 0;
+    std::string* field = target(col);
+    bool recordHasContent = false;
+    bool fieldStart = true;
 
-    for(size_t i = 0; i < sample.size(); i++) {
-        char c = sample[i];
-        if(c == '"') { inQuotes = !inQuotes; recordHasChars = true; continue; }
-        if(inQuotes) { recordHasChars = true; continue; }      // delimiters inside quotes don't count
-        if(c == '\n') { flushRecord(); continue; }
-        if(c == '\r') { if(i + 1 < sample.size() && sample[i + 1] == '\n') i++; flushRecord(); continue; }
-        recordHasChars = true;
-        for(size_t k = 0; k < N; k++) if(c == candidates[k]) cur[k]++;
+    while(true) {
+        if(_cur == _end && !_fill()) {
+            if(!recordHasContent) fields.clear();
+            _terminated = false;
+            return recordHasContent;
+        }
+        if(QUOTING == Quoting::RFC4180 && fieldStart && *_cur == _quote) {
+            _cur++;
+            recordHasContent = true;
+            fieldStart = false;
+            if(field) _readQuoted(*field);
+            else _skipQuoted();
+            continue;
+        }
+
+        const char* p = findAny(_cur, _end, delim, '\n', '\r');
+        if(p != _cur) {
+            if(field) field->append(_cur, p);
+            recordHasContent = true;
+            fieldStart = false;
+            _cur = p;
+        }
+        if(_cur == _end) continue;
+
+        char c = *_cur++;
+        if(c == delim) {
+            recordHasContent = true;
+            if(++col > selection.getLastColumn()) {
+                _terminated = _skipRecord();
+                return true;
+            }
+            field = target(col);
+            fieldStart = true;
+            continue;
+        }
+        if(c == '\r' && (_cur != _end || _fill()) && *_cur == '\n') _cur++;
+        if(!recordHasContent) fields.clear();
+        return true;
     }
-    if(sampleComplete) flushRecord();   // the last record is complete only at EOF
+}
 
-    // Pick the most consistent delimiter. Among equally consistent candidates prefer the
-    // one yielding more fields (higher modal count), then the preferred order above.
-    char best = fallback;
-    double bestConsistency = -1.0;
-    int bestMode = 0;
-    for(size_t k = 0; k < N; k++) {
-        const std::vector<int>& counts = recordCounts[k];
-        if(counts.empty()) continue;
-        std::map<int, int> freq;
-        for(int v : counts) if(v > 0) freq[v]++;
-        if(freq.empty()) continue;      // this delimiter never appears
-        int mode = 0, modeFreq = 0;
-        for(const auto& p : freq) if(p.second > modeFreq) { modeFreq = p.second; mode = p.first; }
-        double consistency = static_cast<double>(modeFreq) / counts.size();
-        if(consistency > bestConsistency || (consistency == bestConsistency && mode > bestMode)) {
-            bestConsistency = consistency;
-            bestMode = mode;
-            best = candidates[k];
-        }
-    }
-    return bestConsistency >= 0.5 ? best : fallback;
+// Text between delimiters is appended in runs found by findAny; quoted fields are read by
+// _readQuoted. Records match those of CsvParser::nextRecord.
+template <char DELIM, summarize::Quoting QUOTING>
+bool summarize::DialectParser<DELIM, QUOTING>::nextRecord(std::vector<std::string>& fields) {
+    if(_selection) return _nextSelected(fields);
+    const char delim = DELIM ? DELIM : _delim;
+    _terminated = true;
+    size_t nFields = 0;
+    std::string* field = &CsvParser::_field(fields, nFields);
+    bool recordHasContent = false;
+    bool fieldStart = true;
+
+    while(true) {
+        if(_cur == _end && !_fill()) {
+            if(recordHasContent) nFields++;
+            fields.resize(nFields);
+            _terminated = false;
+            return recordHasContent;
+        }
+        if(QUOTING == Quoting::RFC4180 && fieldStart && *_cur == _quote) {
+            _cur++;
+            recordHasContent = true;
+            fieldStart = false;
+            _readQuoted(*field);
+            continue;                          // any text after the closing quote is kept
+        }
+
+        // Append the run of text up to the next delimiter or line terminator.
+        const char* p = findAny(_cur, _end, delim, '\n', '\r');
+        if(p != _cur) {
+            field->append(_cur, p);
+            recordHasContent = true;
+            fieldStart = false;
+            _cur = p;
+        }
+        if(_cur == _end) continue;
+
+        char c = *_cur++;
+        if(c == delim) {
+            recordHasContent = true;
+            field = &CsvParser::_field(fields, ++nFields);
+            fieldStart = true;
+            continue;
+        }
+        if(c == '\r' && (_cur != _end || _fill()) && *_cur == '\n') _cur++;
+        if(recordHasContent) nFields++;
+        fields.resize(nFields);
+        return true;
+    }
 }
 
+bool summarize::FixedWidthParser::_fill() {
+    _base += static_cast<size_t>(_end - _begin);
+    size_t size;
+    bool got = _reader.next(_begin, size);
+    _cur = _begin;
+    _end = _begin + size;
+    return got;
+}
+
+void summarize::FixedWidthParser::_slice(const char* line, size_t length, std::vector<std::string>& fields) const {
+    while(length > 0 && line[length - 1] == ' ') length--;
+    if(length == 0) {
+        fields.clear();
+        return;
+    }
+    const size_t nCols = _starts.size();
+    size_t nFields = _selection ? _selection->size() : nCols;
+    fields.resize(nFields);
+    for(size_t i = 0; i < nFields; i++) {
+        size_t col = _selection ? _selection->getColumns()[i] : i;
+        if(col >= nCols) {
+            fields[i].clear();
+            continue;
+        }
+        size_t begin = std::min(_starts[col], length);
+        size_t end = col + 1 < nCols ? std::min(_starts[col + 1], length) : length;
+        while(begin < end && line[begin] == ' ') begin++;
+        while(end > begin && line[end - 1] == ' ') end--;
+        fields[i].assign(line + begin, end - begin);
+    }
+}
+
+bool summarize::FixedWidthParser::nextRecord(std::vector<std::string>& fields) {
+    _terminated = true;
+    if(_cur == _end && !_fill()) {
+        fields.clear();
+        _terminated = false;
+        return false;
+    }
+    const char* p = findAny(_cur, _end, '\n', '\r', '\r');
+    if(p != _end) {
+        _slice(_cur, static_cast<size_t>(p - _cur), fields);
+        _cur = p;
+    } else {
+        // The line goes on in the next blocks.
+        _line.assign(_cur, _end);
+        _cur = _end;
+        while(_fill()) {
+            p = findAny(_cur, _end, '\n', '\r', '\r');
+            _line.append(_cur, p);
+            _cur = p;
+            if(p != _end) break;
+        }
+        _slice(_line.data(), _line.size(), fields);
+        if(_cur == _end) {
+            _terminated = false;
+            return true;
+        }
+    }
+    char c = *_cur++;
+    if(c == '\r' && (_cur != _end || _fill()) && *_cur == '\n') _cur++;
+    return true;
+}
+
+// The dialects _scan dispatches to; 0 takes the delimiter at run time.
+template class summarize::DialectParser<'\t', summarize::Quoting::RFC4180>;
+template class summarize::DialectParser<'\t', summarize::Quoting::NONE>;
+template class summarize::DialectParser<',', summarize::Quoting::RFC4180>;
+template class summarize::DialectParser<',', summarize::Quoting::NONE>;
+template class summarize::DialectParser<';', summarize::Quoting::RFC4180>;
+template class summarize::DialectParser<';', summarize::Quoting::NONE>;
+template class summarize::DialectParser<'|', summarize::Quoting::RFC4180>;
+template class summarize::DialectParser<'|', summarize::Quoting::NONE>;
+template class summarize::DialectParser<0, summarize::Quoting::RFC4180>;
+template class summarize::DialectParser<0, summarize::Quoting::NONE>;
+
 /**
  \brief Read the next record from the stream into \p fields.
 
  Implements an RFC 4180 style parser. Fields may be quoted with double quotes,
  in which case the delimiter, embedded \n, \r or \r\n line endings, and doubled
  "" quotes are treated as literal field content. Unquoted \n, \r and \r\n end
- the record. \p fields is cleared before reading.
+ the record. Fields are written into the existing elements of \p fields, which
+ are cleared rather than destroyed, so passing the same vector for every record lets
+ the field strings keep their capacity and parsing reaches zero allocations per
+ record in steady state.
 
  \param fields vector to populate with the fields of the next record.
  \return true if a record was read, false at end of input.
  */
 bool summarize::CsvParser::nextRecord(std::vector<std::string>& fields) {
-    fields.clear();
-    std::string field;
+    _terminated = true;
+    size_t nFields = 0;
+    std::string* field = &_field(fields, nFields);
     bool recordHasContent = false;
     enum State { START_FIELD, UNQUOTED, QUOTED, QUOTE_IN_QUOTED } state = START_FIELD;
 
@@ -314,8 +1574,9 @@ bool summarize::CsvParser::nextRecord(std::vector<std::string>& fields) {
         if(ci == EOF) {
             // A field is in progress (or pending after a trailing delimiter) iff
             // we are past START_FIELD or the record already has content.
-            if(state != START_FIELD || recordHasContent)
-                fields.push_back(field);
+            if(state != START_FIELD || recordHasContent) nFields++;
+            fields.resize(nFields);
+            _terminated = false;
             return recordHasContent;
         }
         char c = static_cast<char>(ci);
@@ -324,29 +1585,28 @@ bool summarize::CsvParser::nextRecord(std::vector<std::string>& fields) {
         if(state == QUOTED) {
             if(c == '"') state = QUOTE_IN_QUOTED;
             else if(c == '\r') {
-                field += '\n';
+                *field += '\n';
                 if(_peek() == '\n') _get();
             }
-            else field += c;
+            else *field += c;
             continue;
         }
 
         // Just saw a '"' while inside a quoted field.
         if(state == QUOTE_IN_QUOTED) {
-            if(c == '"') { field += '"'; state = QUOTED; }       // doubled "" -> literal "
-            else if(c == _delim) { fields.push_back(field); field.clear(); state = START_FIELD; }
-            else if(c == '\n') { fields.push_back(field); return true; }
-            else if(c == '\r') { if(_peek() == '\n') _get(); fields.push_back(field); return true; }
-            else { field += c; state = UNQUOTED; }              // lenient: text after closing quote
+            if(c == '"') { *field += '"'; state = QUOTED; }      // doubled "" -> literal "
+            else if(c == _delim) { field = &_field(fields, ++nFields); state = START_FIELD; }
+            else if(c == '\n') { fields.resize(++nFields); return true; }
+            else if(c == '\r') { if(_peek() == '\n') _get(); fields.resize(++nFields); return true; }
+            else { *field += c; state = UNQUOTED; }             // lenient: text after closing quote
             continue;
         }
 
         // Unquoted context: START_FIELD or UNQUOTED.
         if(c == '"' && state == START_FIELD) { recordHasContent = true; state = QUOTED; }
-        else if(c == _delim) { recordHasContent = true; fields.push_back(field); field.clear(); state = START_FIELD; }
-        else if(c == '\n') { if(recordHasContent) fields.push_back(field); return true; }
-        else if(c == '\r') { if(_peek() == '\n') _get(); if(recordHasContent) fields.push_back(field); return true; }
-        else { recordHasContent = true; field += c; state = UNQUOTED; }
+        else if(c == _delim) { recordHasContent = true; field = &_field(fields, ++nFields); state = START_FIELD; }
+        else if(c == '\n') { if(recordHasContent) nFields++; fields.resize(nFields); return true; }
+        else if(c == '\r') { if(_peek() == '\n') _get(); if(recordHasContent) nFields++; fields.resize(nFields); return true; }
+        else { recordHasContent = true; *field += c; state = UNQUOTED; }
     }
 }
-
@@ -0,0 +1,51 @@
+//
+// Helpers shared by the test programs: writing input files and describing a read as one
+// string, so two reads of the same input can be compared with a single EXPECT_EQUAL.
+//
+
+#ifndef TESTUTILS_HPP
+#define TESTUTILS_HPP
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <columnNames.hpp>
+#include <tsvFile.hpp>
+
+//! Replace the contents of \p path with \p text.
+inline void writeFile(const std::string& path, const std::string& text) {
+    std::ofstream out(path, std::ios::binary);
+    out << text;
+}
+
+//! Append \p text to \p path.
+inline void appendFile(const std::string& path, const std::string& text) {
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    out << text;
+}
+
+inline summarize::ColumnNames makeNames(const std::vector<std::string>& names) {
+    summarize::ColumnNames ret;
+    for(const auto& name: names) ret.push_back(name);
+    return ret;
+}
+
+//! The shape, filtered row count, and per column the name, type, preview values and (if
+//! collected) count, missing values and longest value of \p f.
+inline std::string describeRead(const summarize::TsvFile& f) {
+    std::ostringstream out;
+    out << f.getNRows() << "x" << f.getNCols() << ":" << f.getNFiltered();
+    for(size_t col = 0; col < f.getNCols(); col++) {
+        out << ' ' << f.getHeaders()[col] << ':' << summarize::ColumnStats::typeToString(f.getType(col));
+        for(size_t row = 0; row < f.getNPreviewRows(); row++) out << ',' << f.getPreviewValue(col, row);
+        if(f.hasStats()) {
+            const summarize::ColumnStats& stats = f.getStats(col);
+            out << ':' << stats.getCount() << ':' << stats.getMissing() << ':' << stats.getMaxLength();
+        }
+    }
+    return out.str();
+}
+
+#endif // TESTUTILS_HPP
@@ -0,0 +1,88 @@
+//
+// Allocation budget tests. This target is always compiled with ENABLE_ALLOC_COUNTING,
+// so any change that reintroduces per record heap traffic fails here.
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <testing.hpp>
+#include <allocCounter.hpp>
+#include <tsvFile.hpp>
+
+//! A table of \p nRows rows with a header and three columns.
+static std::string makeTable(size_t nRows) {
+    std::string text = "name\tvalue\tnote\n";
+    for(size_t i = 0; i < nRows; i++)
+        text += "row_" + std::to_string(i % 10) + "\t" + std::to_string(i % 1000) + "\tsome longer text past SSO\n";
+    return text;
+}
+
+START_TEST("allocCounter.hpp")
+    START_SECTION("counting hooks")
+        EXPECT_EQUAL(summarize::alloc::enabled(), true)
+        {
+            summarize::alloc::Counts before = summarize::alloc::snapshot();
+            // Called directly: a new expression and its delete may be optimized away.
+            void* p = ::operator new(sizeof(int));
+            ::operator delete(p);
+            summarize::alloc::Counts diff = summarize::alloc::snapshot() - before;
+            EXPECT_EQUAL(diff.allocations, static_cast<size_t>(1))
+            EXPECT_EQUAL(diff.deallocations, static_cast<size_t>(1))
+            EXPECT_EQUAL(diff.bytes, sizeof(int))
+        }
+    END_SECTION
+
+    START_SECTION("CsvParser steady state allocates nothing")
+        {
+            std::istringstream ss(makeTable(1000));
+            summarize::CsvParser parser(ss, '\t');
+            std::vector<std::string> record;
+            parser.nextRecord(record);      // header
+            parser.nextRecord(record);      // first data record sizes the field buffers
+            summarize::alloc::Counts before = summarize::alloc::snapshot();
+            size_t n = 0;
+            while(parser.nextRecord(record)) n++;
+            summarize::alloc::Counts diff = summarize::alloc::snapshot() - before;
+            EXPECT_EQUAL(n, static_cast<size_t>(999))
+            EXPECT_EQUAL(diff.allocations, static_cast<size_t>(0))
+        }
+        {   // quoted fields with embedded delimiters and newlines reuse buffers too
+            std::string text;
+            for(int i = 0; i < 100; i++) text += "\"a,b\",\"multi\nline text that is long\"\n";
+            std::istringstream ss(text);
+            summarize::CsvParser parser(ss, ',');
+            std::vector<std::string> record;
+            parser.nextRecord(record);
+            summarize::alloc::Counts before = summarize::alloc::snapshot();
+            while(parser.nextRecord(record)) {}
+            EXPECT_EQUAL((summarize::alloc::snapshot() - before).allocations, static_cast<size_t>(0))
+        }
+    END_SECTION
+
+    START_SECTION("TsvFile scan allocation budget")
+        {   // the parse phase must not grow with the number of records
+            std::istringstream ss(makeTable(20000));
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.setPreviewRows(2);
+            f.read(ss, true);
+            const summarize::Profile::Phase* parse = f.getProfile().getPhase("parse");
+            EXPECT_EQUAL(parse != nullptr, true)
+            EXPECT_EQUAL(f.getProfile().getRecords(), static_cast<size_t>(20001))  // incl. header
+            EXPECT_EQUAL(parse && parse->allocs.allocations < 64, true)
+        }
+    END_SECTION
+
+    START_SECTION("maxLength does not copy")
+        {
+            std::vector<std::string> strings(100, std::string(40, 'x'));
+            summarize::alloc::Counts before = summarize::alloc::snapshot();
+            size_t len = summarize::maxLength(strings);
+            EXPECT_EQUAL((summarize::alloc::snapshot() - before).allocations, static_cast<size_t>(0))
+            EXPECT_EQUAL(len, static_cast<size_t>(40))
+        }
+    END_SECTION
+END_TEST
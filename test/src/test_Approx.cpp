@@ -0,0 +1,96 @@
+//
+// Tests for approximate mode: row count and statistics estimated from random blocks,
+// resynchronizing past quoted line breaks.
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cmath>
+
+#include <testing.hpp>
+#include <tsvFile.hpp>
+
+START_TEST("approx.cpp")
+    // 60000 rows of varying length; every fifth has a quoted field with line breaks.
+    std::string text = "id,value,note\n";
+    const size_t N_ROWS = 60000;
+    for(size_t i = 0; i < N_ROWS; i++) {
+        text += std::to_string(i) + "," + std::to_string(i % 100) + ",";
+        text += i % 5 ? std::string(i % 17, 'x') : "\"multi\nline, \"\"quoted\"\"\nnote\"";
+        text += "\n";
+    }
+
+    START_SECTION("estimates")
+        {
+            std::istringstream ss(text);
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            summarize::ApproxOptions options;
+            options.maxBlocks = 32;
+            options.blockSize = 4096;
+            EXPECT_EQUAL(f.readApprox(ss, options, true), true)
+            const summarize::ApproxInfo& info = f.getApproxInfo();
+            EXPECT_EQUAL(info.valid, true)
+            EXPECT_EQUAL(f.isNRowsExact(), false)
+            EXPECT_EQUAL(info.blocks, static_cast<size_t>(32))
+            EXPECT_EQUAL(info.bytesRead <= 32 * 4096, true)
+            EXPECT_EQUAL(info.usableBlocks > 24, true)
+            double error = std::fabs(static_cast<double>(f.getNRows()) - N_ROWS) / N_ROWS;
+            EXPECT_EQUAL(error < 0.05, true)
+            EXPECT_EQUAL(info.nRowsLow < N_ROWS && N_ROWS < info.nRowsHigh, true)
+
+            EXPECT_EQUAL(f.getNCols(), static_cast<size_t>(3))
+            EXPECT_EQUAL(f.getHeaders().at(2), std::string("note"))
+            EXPECT_EQUAL(f.getMinFields(), static_cast<size_t>(3))     // every block resynchronized correctly
+            EXPECT_EQUAL(f.getType(1), summarize::ColumnStats::INT)
+            EXPECT_EQUAL(std::fabs(f.getStats(1).getMean() - 49.5) < 3, true)
+            EXPECT_EQUAL(f.getStats(1).getCount(), info.sampledRows)
+            // Statistics are collected for the estimate only, not for later reads.
+            EXPECT_EQUAL(f.getCollectStats(), false)
+        }
+    END_SECTION
+
+    START_SECTION("fallback to a full read")
+        {   // input smaller than the blocks to read
+            std::istringstream ss(text.substr(0, text.find("\n100,") + 1));
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            f.readApprox(ss, summarize::ApproxOptions(), true);
+            EXPECT_EQUAL(f.getApproxInfo().valid, false)
+            EXPECT_EQUAL(f.isNRowsExact(), true)
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(100))
+        }
+        {   // unquoted input, whose blocks can not be parsed as RFC 4180
+            std::string unquoted = "id,note\n";
+            for(size_t i = 0; i < 20000; i++) unquoted += std::to_string(i) + ",\"x\n";
+            std::istringstream ss(unquoted);
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            f.setQuoting(summarize::Quoting::NONE);
+            summarize::ApproxOptions options;
+            options.maxBlocks = 8;
+            options.blockSize = 4096;
+            f.readApprox(ss, options, true);
+            EXPECT_EQUAL(f.getApproxInfo().valid, false)
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(20000))
+            EXPECT_EQUAL(f.getPreviewValue(1, 0), std::string("\"x"))
+        }
+        {   // a header so wide that no block fits between it and the end of the input
+            std::string wide;
+            for(size_t i = 0; i < 5000; i++) wide += (i ? ",c" : "c") + std::to_string(i);
+            wide += "\n";
+            for(size_t i = 0; i < 3; i++) wide += std::to_string(i) + ",1\n";
+            std::istringstream ss(wide);
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            summarize::ApproxOptions options;
+            options.maxBlocks = 2;
+            options.blockSize = 4096;
+            EXPECT_EQUAL(f.readApprox(ss, options, true), true)
+            EXPECT_EQUAL(f.getApproxInfo().valid, false)
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(3))
+            EXPECT_EQUAL(f.getNCols(), static_cast<size_t>(5000))
+        }
+    END_SECTION
+END_TEST
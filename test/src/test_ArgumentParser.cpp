@@ -3,6 +3,7 @@
 //
 
 #include <iostream>
+#include <cstring>
 
 #include <testing.hpp>
 #include <argparse.hpp>
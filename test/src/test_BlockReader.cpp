@@ -0,0 +1,147 @@
+//
+// Tests for block buffered input: prefixes and unread bytes come back in order, files read
+// with read(2) (and O_DIRECT where supported) match the same bytes read from a stream, read
+// ahead by io_uring or a thread returns them in order, and reads are the same at any block
+// size.
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <filesystem>
+
+#include <testing.hpp>
+#include <testUtils.hpp>
+#include <blockReader.hpp>
+#include <tsvFile.hpp>
+
+//! Every byte \p reader returns.
+static std::string readAll(summarize::BlockReader& reader) {
+    std::string ret;
+    const char* data;
+    size_t size;
+    while(reader.next(data, size)) ret.append(data, size);
+    return ret;
+}
+
+//! Rows, columns and the last preview value of \p f.
+static std::string describe(const summarize::TsvFile& f) {
+    return std::to_string(f.getNRows()) + "x" + std::to_string(f.getNCols()) + ":" +
+           f.getPreviewValue(f.getNCols() - 1, f.getNPreviewRows() - 1);
+}
+
+START_TEST("blockReader.hpp")
+    const std::string path = "test_block_reader_input.csv";
+    std::string text = "sep=;\nid;note\n";
+    for(int i = 0; i < 5000; i++)
+        text += std::to_string(i) + (i % 7 ? ";plain\r\n" : ";\"multi\nline; \"\"quoted\"\"\"\r\n");
+    writeFile(path, text);
+
+    START_SECTION("Prefix and unread bytes")
+        std::istringstream digits("0123456789");
+        summarize::BlockReader reader(digits.rdbuf(), 4);
+        const char* data;
+        size_t size;
+        EXPECT_EQUAL(reader.next(data, size), true)
+        EXPECT_EQUAL(std::string(data, size), std::string("0123"))      // the buffer is not rounded for streams
+        reader.unread(2);
+        reader.setPrefix("ab");
+        EXPECT_EQUAL(readAll(reader), std::string("ab23456789"))
+        EXPECT_EQUAL(reader.getBytesRead(), static_cast<size_t>(10))
+
+        summarize::BlockReader prefixOnly;
+        prefixOnly.setPrefix("xyz");
+        EXPECT_EQUAL(readAll(prefixOnly), std::string("xyz"))
+    END_SECTION
+
+    START_SECTION("Files")
+        for(bool direct: {false, true}) {
+            summarize::BlockReaderOptions options;
+            options.blockSize = 4096;
+            options.direct = direct;
+            summarize::BlockReader reader;
+            EXPECT_EQUAL(reader.open(path, options), true)
+            EXPECT_EQUAL(reader.getRemaining(), text.size())
+            EXPECT_EQUAL(readAll(reader), text)
+            EXPECT_EQUAL(reader.getRemaining(), static_cast<size_t>(0))
+        }
+        summarize::BlockReader missing;
+        EXPECT_EQUAL(missing.open("no_such_file.csv"), false)
+    END_SECTION
+
+    START_SECTION("Read ahead")
+        for(bool uring: {true, false}) {
+            for(size_t depth: {1, 3}) {
+                summarize::BlockReaderOptions options;
+                options.blockSize = 4096;
+                options.queueDepth = depth;
+                options.uring = uring;
+                summarize::BlockReader reader;
+                reader.open(path, options);
+                const char* data;
+                size_t size;
+                EXPECT_EQUAL(reader.next(data, size), true)
+                EXPECT_EQUAL(reader.getReadAhead() != summarize::BlockReader::ReadAhead::NONE, true)
+                if(!uring) EXPECT_EQUAL(std::string(summarize::readAheadName(reader.getReadAhead())), std::string("thread"))
+                reader.unread(size - 10);
+                EXPECT_EQUAL(text.substr(0, 10) + readAll(reader), text)
+                EXPECT_EQUAL(reader.getStallSeconds() >= 0, true)
+
+                // Destroyed with reads still queued.
+                summarize::BlockReader early;
+                early.open(path, options);
+                EXPECT_EQUAL(early.next(data, size), true)
+            }
+        }
+        std::istringstream ss(text);
+        summarize::BlockReaderOptions streamOptions;
+        streamOptions.blockSize = 1000;
+        streamOptions.queueDepth = 2;
+        summarize::BlockReader streamReader(ss.rdbuf(), streamOptions);
+        EXPECT_EQUAL(readAll(streamReader), text)
+        EXPECT_EQUAL(std::string(summarize::readAheadName(streamReader.getReadAhead())), std::string("thread"))
+    END_SECTION
+
+    START_SECTION("TsvFile reads at any block size")
+        std::istringstream textStream(text);
+        summarize::TsvFile expected;
+        expected.sniffDelim('\t');
+        expected.setPreviewRows(3);
+        expected.read(textStream, true);
+        EXPECT_EQUAL(expected.getDelim(), ';')
+        EXPECT_EQUAL(expected.getNRows(), static_cast<size_t>(5000))
+        for(int blockSize: {1, 7, 64, 4096, 1 << 20}) {
+            std::istringstream blockStream(text);
+            summarize::BlockReader streamReader(blockStream.rdbuf(), static_cast<size_t>(blockSize));
+            summarize::TsvFile fromStream;
+            fromStream.sniffDelim('\t');
+            fromStream.setPreviewRows(3);
+            EXPECT_EQUAL(fromStream.read(streamReader, true), true)
+            EXPECT_EQUAL(describe(fromStream), describe(expected))
+            EXPECT_EQUAL(fromStream.getResumeOffset(), text.size())
+
+            summarize::BlockReaderOptions options;
+            options.blockSize = static_cast<size_t>(blockSize);
+            summarize::BlockReader fileReader;
+            fileReader.open(path, options);
+            summarize::TsvFile fromFile;
+            fromFile.sniffDelim('\t');
+            fromFile.setPreviewRows(3);
+            EXPECT_EQUAL(fromFile.read(fileReader, true), true)
+            EXPECT_EQUAL(describe(fromFile), describe(expected))
+
+            options.queueDepth = 2;
+            summarize::BlockReader queuedReader;
+            queuedReader.open(path, options);
+            summarize::TsvFile queued;
+            queued.sniffDelim('\t');
+            queued.setPreviewRows(3);
+            EXPECT_EQUAL(queued.read(queuedReader, true), true)
+            EXPECT_EQUAL(describe(queued), describe(expected))
+            EXPECT_EQUAL(queued.getProfile().getStallSeconds() >= 0, true)
+        }
+    END_SECTION
+
+    std::filesystem::remove(path);
+END_TEST
@@ -0,0 +1,121 @@
+//
+// Tests for the C API of libsummarize: results from paths and buffers, defaults, errors,
+// and concurrent calls from several threads.
+//
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <fstream>
+#include <cmath>
+#include <cstdio>
+#include <unistd.h>
+
+#include <testing.hpp>
+#include <summarize.h>
+
+START_TEST("summarize.h")
+    START_SECTION("summarize_buffer")
+        {
+            std::string text = "id,name,score\n1,a,2.5\n2,b,3.5\n3,,4.5\n";
+            summarize_result* result = nullptr;
+            EXPECT_EQUAL(summarize_buffer(text.data(), text.size(), nullptr, &result), SUMMARIZE_OK)
+            EXPECT_EQUAL(summarize_n_rows(result), static_cast<size_t>(3))
+            EXPECT_EQUAL(summarize_n_rows_exact(result), 1)
+            EXPECT_EQUAL(summarize_is_partial(result), 0)
+            EXPECT_EQUAL(summarize_n_cols(result), static_cast<size_t>(3))
+            EXPECT_EQUAL(summarize_delim(result), ',')
+            EXPECT_EQUAL(std::string(summarize_header(result, 1)), std::string("name"))
+            EXPECT_EQUAL(summarize_header(result, 3) == nullptr, true)
+            EXPECT_EQUAL(summarize_column_type(result, 0), SUMMARIZE_INT)
+            EXPECT_EQUAL(summarize_column_type(result, 2), SUMMARIZE_FLOAT)
+            EXPECT_EQUAL(summarize_n_preview_rows(result), static_cast<size_t>(1))
+            EXPECT_EQUAL(std::string(summarize_preview_value(result, 1, 0)), std::string("a"))
+            EXPECT_EQUAL(summarize_preview_value(result, 1, 1) == nullptr, true)
+
+            summarize_column_stats stats;
+            EXPECT_EQUAL(summarize_get_column_stats(result, 2, &stats), SUMMARIZE_OK)
+            EXPECT_EQUAL(stats.count, static_cast<size_t>(3))
+            EXPECT_EQUAL(stats.mean, 3.5)
+            EXPECT_EQUAL(summarize_get_column_stats(result, 1, &stats), SUMMARIZE_OK)
+            EXPECT_EQUAL(stats.missing, static_cast<size_t>(1))
+            EXPECT_EQUAL(std::isnan(stats.mean), true)
+            summarize_result_free(result);
+        }
+        {   // options: no header, explicit delimiter, more preview rows, no statistics
+            std::string text = "x;1\ny;2\n";
+            summarize_options options;
+            summarize_options_init(&options);
+            options.has_header = 0;
+            options.delim = ';';
+            options.preview_rows = 5;
+            options.collect_stats = 0;
+            summarize_result* result = nullptr;
+            EXPECT_EQUAL(summarize_buffer(text.data(), text.size(), &options, &result), SUMMARIZE_OK)
+            EXPECT_EQUAL(summarize_n_rows(result), static_cast<size_t>(2))
+            EXPECT_EQUAL(summarize_n_preview_rows(result), static_cast<size_t>(2))
+            EXPECT_EQUAL(std::string(summarize_header(result, 0)), std::string("COLUMN_0"))
+            summarize_column_stats stats;
+            EXPECT_EQUAL(summarize_get_column_stats(result, 0, &stats), SUMMARIZE_ERROR_ARGUMENT)
+            summarize_result_free(result);
+        }
+        {   // options from an older caller: only the fields within struct_size are read
+            std::string text = "a\tb\n1\t2\n";
+            summarize_options options;
+            summarize_options_init(&options);
+            options.preview_rows = 0;
+            options.collect_stats = 0;
+            options.struct_size = offsetof(summarize_options, preview_rows);
+            summarize_result* result = nullptr;
+            EXPECT_EQUAL(summarize_buffer(text.data(), text.size(), &options, &result), SUMMARIZE_OK)
+            EXPECT_EQUAL(summarize_n_preview_rows(result), static_cast<size_t>(1))
+            summarize_column_stats stats;
+            EXPECT_EQUAL(summarize_get_column_stats(result, 0, &stats), SUMMARIZE_OK)
+            summarize_result_free(result);
+        }
+    END_SECTION
+
+    START_SECTION("Errors")
+        summarize_result* result = nullptr;
+        EXPECT_EQUAL(summarize_buffer("", 0, nullptr, &result), SUMMARIZE_ERROR_READ)
+        EXPECT_EQUAL(result == nullptr, true)
+        EXPECT_EQUAL(summarize_buffer(nullptr, 3, nullptr, &result), SUMMARIZE_ERROR_ARGUMENT)
+        EXPECT_EQUAL(summarize_path("/nonexistent/file.tsv", nullptr, &result), SUMMARIZE_ERROR_OPEN)
+        EXPECT_EQUAL(summarize_path(nullptr, nullptr, &result), SUMMARIZE_ERROR_ARGUMENT)
+        EXPECT_EQUAL(std::string(summarize_status_string(SUMMARIZE_ERROR_OPEN)), std::string("could not open file"))
+        EXPECT_EQUAL(summarize_api_version(), SUMMARIZE_API_VERSION)
+        EXPECT_EQUAL(summarize_n_rows(nullptr), static_cast<size_t>(0))
+    END_SECTION
+
+    START_SECTION("Concurrent summarize_path")
+        std::string path = "test_CApi_" + std::to_string(getpid()) + ".csv";
+        {
+            std::ofstream out(path);
+            out << "k,v\n";
+            for(int i = 0; i < 20000; i++) out << i << "," << (i % 10) << "\n";
+        }
+        const size_t nThreads = 8;
+        std::vector<size_t> rows(nThreads, 0);
+        std::vector<double> means(nThreads, 0);
+        std::vector<std::thread> threads;
+        for(size_t t = 0; t < nThreads; t++) {
+            threads.emplace_back([&, t]() {
+                for(int rep = 0; rep < 5; rep++) {
+                    summarize_result* result = nullptr;
+                    if(summarize_path(path.c_str(), nullptr, &result) != SUMMARIZE_OK) return;
+                    summarize_column_stats stats;
+                    summarize_get_column_stats(result, 1, &stats);
+                    rows[t] = summarize_n_rows(result);
+                    means[t] = stats.mean;
+                    summarize_result_free(result);
+                }
+            });
+        }
+        for(auto& thread: threads) thread.join();
+        for(size_t t = 0; t < nThreads; t++) {
+            EXPECT_EQUAL(rows[t], static_cast<size_t>(20000))
+            EXPECT_EQUAL(std::abs(means[t] - 4.5) < 1e-9, true)
+        }
+        std::remove(path.c_str());
+    END_SECTION
+END_TEST
@@ -0,0 +1,228 @@
+//
+// Tests for column projection: resolving --columns against the names of an input, the
+// parser skipping unselected fields (quoted ones, across block boundaries, in ragged
+// records), reads of the selected columns and writing them back out.
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <testing.hpp>
+#include <testUtils.hpp>
+#include <columnSelection.hpp>
+#include <scheduler.hpp>
+#include <tsvFile.hpp>
+
+static std::string joinColumns(const summarize::ColumnSelection& selection) {
+    std::string ret;
+    for(size_t col: selection.getColumns()) ret += (ret.empty() ? "" : ",") + std::to_string(col);
+    return ret;
+}
+
+//! Parse \p text in \p blockSize byte blocks, selecting \p selection (nullptr for all
+//! columns), and join the records.
+template <summarize::Quoting QUOTING>
+static std::string parseAll(const std::string& text, size_t blockSize, const summarize::ColumnSelection* selection) {
+    std::istringstream in(text);
+    summarize::BlockReader reader(in.rdbuf(), blockSize);
+    summarize::DialectParser<',', QUOTING> parser(reader, ',');
+    parser.setSelection(selection);
+    std::string ret;
+    std::vector<std::string> record;
+    while(parser.nextRecord(record)) {
+        if(record.empty()) continue;
+        for(size_t i = 0; i < record.size(); i++) ret += (i ? "|" : "") + record[i];
+        ret += parser.lastTerminated() ? ";" : "$";
+    }
+    return ret;
+}
+
+//! The records of parseAll without a selection, projected by hand.
+template <summarize::Quoting QUOTING>
+static std::string projectAll(const std::string& text, const summarize::ColumnSelection& selection) {
+    std::istringstream in(text);
+    summarize::DialectParser<',', QUOTING> parser(in, ',');
+    std::string ret;
+    std::vector<std::string> record;
+    while(parser.nextRecord(record)) {
+        if(record.empty()) continue;
+        for(size_t i = 0; i < selection.size(); i++) {
+            size_t col = selection.getColumns()[i];
+            ret += (i ? "|" : "") + (col < record.size() ? record[col] : std::string());
+        }
+        ret += parser.lastTerminated() ? ";" : "$";
+    }
+    return ret;
+}
+
+START_TEST("columnSelection.hpp")
+    START_SECTION("Resolving selections")
+        summarize::ColumnNames names = makeNames({"id", "a_1", "a_2", "b", "2-3", "c"});
+        summarize::ColumnSelection selection;
+        EXPECT_EQUAL(selection.empty(), true)
+        EXPECT_EQUAL(selection.parse("c,/^a_/,1,id,5-"), true)
+        EXPECT_EQUAL(selection.resolve(names), true)
+        EXPECT_EQUAL(joinColumns(selection), std::string("5,1,2,0,4"))     // duplicates read once
+        EXPECT_EQUAL(selection.slot(5), static_cast<size_t>(1))
+        EXPECT_EQUAL(selection.slot(3), static_cast<size_t>(0))
+        EXPECT_EQUAL(selection.getLastColumn(), static_cast<size_t>(5))
+
+        // A name wins over a range; a regex may hold commas.
+        EXPECT_EQUAL(selection.parse("2-3,/^a_{1,2}[12]$/"), true)
+        EXPECT_EQUAL(selection.resolve(names), true)
+        EXPECT_EQUAL(joinColumns(selection), std::string("4,1,2"))
+        EXPECT_EQUAL(selection.parse("3-4"), true)
+        EXPECT_EQUAL(selection.resolve(names), true)
+        EXPECT_EQUAL(joinColumns(selection), std::string("2,3"))
+
+        EXPECT_EQUAL(selection.parse("id,missing"), true)
+        EXPECT_EQUAL(selection.resolve(names), false)
+        EXPECT_EQUAL(selection.parse("/^z/"), true)
+        EXPECT_EQUAL(selection.resolve(names), false)
+        EXPECT_EQUAL(selection.parse("/(/"), false)
+        EXPECT_EQUAL(selection.parse("/abc"), false)
+        EXPECT_EQUAL(selection.parse("id,,b"), false)
+        EXPECT_EQUAL(selection.parse("0-2"), true)        // not a range: a name
+        EXPECT_EQUAL(selection.resolve(names), false)
+    END_SECTION
+
+    START_SECTION("Skipping fields")
+        const std::string text = "a,\"b,\"\"1\"\"\",c,d,e\r\n"
+                                 "\n"
+                                 "1,\"x\ny\",3,\"q\"\"\",5\n"
+                                 "only,\"two\n"
+                                 "\",\n"
+                                 "6,7,\"8\",9,\"1,0\",extra,\"more\nlines\"\n"
+                                 "a\"b,c,\"d\",e\"f,g\n"
+                                 "last,x,y";
+        summarize::ColumnNames header = makeNames({"a", "b", "c", "d", "e"});
+        summarize::ColumnSelection first;
+        first.parse("1,3");
+        first.resolve(header);
+        summarize::ColumnSelection reordered;
+        reordered.parse("e,b");
+        reordered.resolve(header);
+        summarize::ColumnSelection middle;
+        middle.parse("2");
+        middle.resolve(header);
+        bool same = true;
+        for(size_t blockSize = 1; blockSize <= 24; blockSize++) {
+            for(const summarize::ColumnSelection* s: {&first, &reordered, &middle}) {
+                same = same && parseAll<summarize::Quoting::RFC4180>(text, blockSize, s) ==
+                               projectAll<summarize::Quoting::RFC4180>(text, *s);
+                same = same && parseAll<summarize::Quoting::NONE>(text, blockSize, s) ==
+                               projectAll<summarize::Quoting::NONE>(text, *s);
+            }
+        }
+        EXPECT_EQUAL(same, true)
+        EXPECT_EQUAL(parseAll<summarize::Quoting::RFC4180>(text, 7, &reordered),
+                     std::string("e|b,\"1\";5|x\ny;|two\n;1,0|7;g|c;|x$"))
+        EXPECT_EQUAL(parseAll<summarize::Quoting::RFC4180>(text, 7, nullptr).find("1|x\ny|3|q\"|5;"), static_cast<size_t>(14))
+    END_SECTION
+
+    START_SECTION("Reading selected columns")
+        std::string table = "id\tname\tvalue\tnote\n";
+        for(int i = 0; i < 3000; i++)
+            table += std::to_string(i) + "\tn" + std::to_string(i % 7) + "\t" + std::to_string(i * 0.5) + "\t\"x\ty\"\n";
+        summarize::ColumnSelection tableColumns;
+        tableColumns.parse("value,/^i/");
+
+        std::istringstream serialIn(table);
+        summarize::TsvFile serial;
+        serial.sniffDelim('\t');
+        serial.setPreviewRows(3);
+        serial.setCollectStats(true);
+        serial.setSelection(tableColumns);
+        EXPECT_EQUAL(serial.read(serialIn, true), true)
+        EXPECT_EQUAL(serial.getNCols(), static_cast<size_t>(2))
+        EXPECT_EQUAL(serial.getHeaders()[0], std::string_view("value"))
+        EXPECT_EQUAL(serial.getType(0) == summarize::ColumnStats::TYPE::FLOAT, true)
+        EXPECT_EQUAL(serial.getPreviewValue(1, 2), std::string("2"))
+        EXPECT_EQUAL(serial.getNRows(), static_cast<size_t>(3000))
+
+        summarize::Scheduler scheduler(2);
+        std::istringstream pipelinedIn(table);
+        summarize::TsvFile pipelined;
+        pipelined.sniffDelim('\t');
+        pipelined.setPreviewRows(3);
+        pipelined.setCollectStats(true);
+        pipelined.setSelection(tableColumns);
+        pipelined.setScheduler(&scheduler, 4096);
+        EXPECT_EQUAL(pipelined.read(pipelinedIn, true), true)
+        EXPECT_EQUAL(pipelined.getProfile().getPipeline().empty(), false)
+        EXPECT_EQUAL(describeRead(pipelined), describeRead(serial))
+
+        // Without a header columns are numbered as in the input.
+        summarize::ColumnSelection byIndex;
+        byIndex.parse("3");
+        std::istringstream noHeaderIn(table);
+        summarize::TsvFile noHeader;
+        noHeader.sniffDelim('\t');
+        noHeader.setSelection(byIndex);
+        EXPECT_EQUAL(noHeader.read(noHeaderIn, false), true)
+        EXPECT_EQUAL(noHeader.getNCols(), static_cast<size_t>(1))
+        EXPECT_EQUAL(noHeader.getHeaders()[0], std::string_view("COLUMN_2"))
+        EXPECT_EQUAL(noHeader.getNRows(), static_cast<size_t>(3001))
+
+        std::istringstream seekIn(table);
+        summarize::TsvFile seeker;
+        seeker.sniffDelim('\t');
+        seeker.setPreviewRows(3);
+        seeker.setIndexInterval(100);
+        seeker.setSelection(tableColumns);
+        EXPECT_EQUAL(seeker.read(seekIn, true), true)
+        EXPECT_EQUAL(seeker.seekPreview(seekIn, 2500), true)
+        EXPECT_EQUAL(seeker.getPreviewValue(0, 0), std::string("1250.000000"))
+        EXPECT_EQUAL(seeker.getPreviewValue(1, 1), std::string("2501"))
+
+        summarize::ColumnSelection unknown;
+        unknown.parse("nope");
+        std::istringstream unknownIn(table);
+        summarize::TsvFile failed;
+        failed.setSelection(unknown);
+        EXPECT_EQUAL(failed.read(unknownIn, true), false)
+    END_SECTION
+
+    START_SECTION("Writing selected columns")
+        const std::string csv = "a,b,c\n1,\"x,y\",\"say \"\"hi\"\"\"\n2,,\"line\nbreak\"\n3\n";
+        summarize::ColumnSelection cut;
+        cut.parse("c,a");
+        std::istringstream cutIn(csv);
+        summarize::BlockReader cutReader(cutIn.rdbuf());
+        summarize::TsvFile cutFile;
+        cutFile.sniffDelim(',');
+        cutFile.setSelection(cut);
+        std::ostringstream cutOut;
+        EXPECT_EQUAL(cutFile.extract(cutReader, cutOut, true), true)
+        EXPECT_EQUAL(cutOut.str(), std::string("c,a\n\"say \"\"hi\"\"\",1\n\"line\nbreak\",2\n,3\n"))
+        EXPECT_EQUAL(cutFile.getNRows(), static_cast<size_t>(3))
+
+        summarize::ColumnSelection single;
+        single.parse("b");
+        std::istringstream singleIn(csv);
+        summarize::BlockReader singleReader(singleIn.rdbuf());
+        summarize::TsvFile singleFile;
+        singleFile.sniffDelim(',');
+        singleFile.setSelection(single);
+        std::ostringstream singleOut;
+        EXPECT_EQUAL(singleFile.extract(singleReader, singleOut, true), true)
+        EXPECT_EQUAL(singleOut.str(), std::string("b\n\"x,y\"\n\"\"\n\"\"\n"))
+
+        // Every column, with the output read back the same.
+        std::istringstream allIn(csv);
+        summarize::BlockReader allReader(allIn.rdbuf());
+        summarize::TsvFile allFile;
+        allFile.sniffDelim(',');
+        std::ostringstream allOut;
+        EXPECT_EQUAL(allFile.extract(allReader, allOut, true), true)
+        EXPECT_EQUAL(allOut.str(), csv)
+
+        std::string quoted;
+        summarize::appendField(quoted, "plain", ',');
+        summarize::appendField(quoted, "a\rb", ',');
+        summarize::appendField(quoted, "it's", '\t', '\'');
+        EXPECT_EQUAL(quoted, std::string("plain\"a\rb\"'it''s'"))
+    END_SECTION
+END_TEST
@@ -0,0 +1,128 @@
+//
+// Tests for streaming column statistics and type inference.
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cmath>
+
+#include <testing.hpp>
+#include <columnStats.hpp>
+#include <tsvFile.hpp>
+
+//! Round to 1e-6 so floating point results compare exactly.
+static double round6(double x) {
+    return std::round(x * 1e6) / 1e6;
+}
+
+static summarize::ColumnStats::TYPE typeOf(const std::string& value) {
+    double number;
+    return summarize::ColumnStats::classify(value, number);
+}
+
+START_TEST("columnStats.hpp")
+    START_SECTION("classify")
+        EXPECT_EQUAL(typeOf("12"), summarize::ColumnStats::INT)
+        EXPECT_EQUAL(typeOf("-12"), summarize::ColumnStats::INT)
+        EXPECT_EQUAL(typeOf("+12"), summarize::ColumnStats::INT)
+        EXPECT_EQUAL(typeOf("1.5"), summarize::ColumnStats::FLOAT)
+        EXPECT_EQUAL(typeOf("-1e5"), summarize::ColumnStats::FLOAT)
+        EXPECT_EQUAL(typeOf("TRUE"), summarize::ColumnStats::BOOL)
+        EXPECT_EQUAL(typeOf("false"), summarize::ColumnStats::BOOL)
+        EXPECT_EQUAL(typeOf("-"), summarize::ColumnStats::STRING)
+        EXPECT_EQUAL(typeOf("+-1"), summarize::ColumnStats::STRING)
+        EXPECT_EQUAL(typeOf("12abc"), summarize::ColumnStats::STRING)
+        EXPECT_EQUAL(typeOf(" 12"), summarize::ColumnStats::STRING)
+        EXPECT_EQUAL(summarize::ColumnStats::isMissing(""), true)
+        EXPECT_EQUAL(summarize::ColumnStats::isMissing("NA"), true)
+        EXPECT_EQUAL(summarize::ColumnStats::isMissing("0"), false)
+    END_SECTION
+
+    START_SECTION("accumulate")
+        {
+            summarize::ColumnStats stats;
+            for(const char* v: {"1", "2", "3", "4", "NA"}) stats.add(v);
+            EXPECT_EQUAL(stats.getType(), summarize::ColumnStats::INT)
+            EXPECT_EQUAL(stats.getCount(), static_cast<size_t>(5))
+            EXPECT_EQUAL(stats.getMissing(), static_cast<size_t>(1))
+            EXPECT_EQUAL(stats.getMin(), 1.0)
+            EXPECT_EQUAL(stats.getMax(), 4.0)
+            EXPECT_EQUAL(stats.getMean(), 2.5)
+            EXPECT_EQUAL(round6(stats.getSd()), round6(std::sqrt(5.0 / 3.0)))
+        }
+        {   // a single float promotes an int column; a single word makes it a string
+            summarize::ColumnStats stats;
+            stats.add("1");
+            stats.add("2.5");
+            EXPECT_EQUAL(stats.getType(), summarize::ColumnStats::FLOAT)
+            stats.add("x");
+            EXPECT_EQUAL(stats.getType(), summarize::ColumnStats::STRING)
+        }
+        {   // an all missing column is a string column
+            summarize::ColumnStats stats;
+            stats.addMissing(3);
+            EXPECT_EQUAL(stats.getType(), summarize::ColumnStats::STRING)
+            EXPECT_EQUAL(stats.getCount(), static_cast<size_t>(3))
+        }
+    END_SECTION
+
+    START_SECTION("merge and serialize")
+        {
+            summarize::ColumnStats all, a, b;
+            for(int i = 0; i < 10; i++) {
+                std::string v = std::to_string(i * 1.5);
+                all.add(v);
+                (i < 4 ? a : b).add(v);
+            }
+            a.merge(b);
+            EXPECT_EQUAL(a.getCount(), all.getCount())
+            EXPECT_EQUAL(a.getMin(), all.getMin())
+            EXPECT_EQUAL(a.getMax(), all.getMax())
+            EXPECT_EQUAL(round6(a.getMean()), round6(all.getMean()))
+            EXPECT_EQUAL(round6(a.getSd()), round6(all.getSd()))
+
+            summarize::ColumnStats copy;
+            EXPECT_EQUAL(copy.deserialize(all.serialize()), true)
+            EXPECT_EQUAL(copy.serialize(), all.serialize())
+            EXPECT_EQUAL(copy.getSd(), all.getSd())
+            EXPECT_EQUAL(copy.deserialize("1 2 x"), false)
+        }
+    END_SECTION
+
+    START_SECTION("TsvFile collects statistics")
+        {
+            std::istringstream ss("id\tscore\tname\n1\t2.5\ta\n2\t3.5\tbb\n3\n");
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.setCollectStats(true);
+            f.read(ss, true);
+            EXPECT_EQUAL(f.hasStats(), true)
+            EXPECT_EQUAL(f.getType(0), summarize::ColumnStats::INT)
+            EXPECT_EQUAL(f.getType(1), summarize::ColumnStats::FLOAT)
+            EXPECT_EQUAL(f.getType(2), summarize::ColumnStats::STRING)
+            EXPECT_EQUAL(f.getStats(1).getMean(), 3.0)
+            EXPECT_EQUAL(f.getStats(1).getMissing(), static_cast<size_t>(1))    // ragged last row
+            EXPECT_EQUAL(f.getStats(2).getMaxLength(), static_cast<size_t>(2))
+        }
+        {   // a column first seen in a later, wider row counts earlier rows as missing
+            std::istringstream ss("1\n2\n3\t4\n");
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.setCollectStats(true);
+            f.read(ss, false);
+            EXPECT_EQUAL(f.getStats(1).getCount(), static_cast<size_t>(3))
+            EXPECT_EQUAL(f.getStats(1).getMissing(), static_cast<size_t>(2))
+        }
+        {   // without statistics, types come from the preview rows
+            std::istringstream ss("a\tb\n1\tx\n2.5\ty\n");
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.setPreviewRows(2);
+            f.read(ss, true);
+            EXPECT_EQUAL(f.hasStats(), false)
+            EXPECT_EQUAL(f.getType(0), summarize::ColumnStats::FLOAT)
+            EXPECT_EQUAL(f.getType(1), summarize::ColumnStats::STRING)
+        }
+    END_SECTION
+END_TEST
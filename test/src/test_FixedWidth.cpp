@@ -0,0 +1,170 @@
+//
+// Tests for fixed-width input: sniffing the column offsets of a layout, slicing records by
+// them, and reads that preview, type and summarize fixed-width columns.
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <testing.hpp>
+#include <testUtils.hpp>
+#include <scheduler.hpp>
+#include <tsvFile.hpp>
+
+//! Every record of \p text, parsed by a FixedWidthParser reading blocks of \p blockSize bytes,
+//! its fields joined by '|' and the records by ';'.
+static std::string sliceRecords(const std::string& text, const std::vector<size_t>& starts, size_t blockSize,
+                                const summarize::ColumnSelection* selection = nullptr) {
+    std::istringstream in(text);
+    summarize::BlockReader reader(in.rdbuf(), blockSize);
+    summarize::FixedWidthParser parser(reader, starts);
+    parser.setSelection(selection);
+    std::vector<std::string> record;
+    std::string ret;
+    while(parser.nextRecord(record)) {
+        if(!ret.empty()) ret += ';';
+        for(size_t i = 0; i < record.size(); i++) ret += (i ? "|" : "") + record[i];
+    }
+    return ret;
+}
+
+START_TEST("tsvFile.hpp (fixed-width)")
+    START_SECTION("Sniffing column offsets")
+        const std::string stations = "ID      NAME        ELEV\n"
+                                     "US001   DENVER      1609\n"
+                                     "US002   BOSTON         43\n"
+                                     "US003   SALT LAKE   1288\n";
+        summarize::Dialect layout = summarize::sniffDialect(stations, true, '\t');
+        EXPECT_EQUAL(layout.isFixedWidth(), true)
+        EXPECT_EQUAL(layout.columnStarts.size(), static_cast<size_t>(3))
+        EXPECT_EQUAL(layout.columnStarts[1], static_cast<size_t>(8))
+        EXPECT_EQUAL(layout.columnStarts[2], static_cast<size_t>(20))
+        EXPECT_EQUAL(layout.delim, '\t')
+        EXPECT_EQUAL(layout.hasHeader, true)
+
+        // Right aligned numbers; the first column starts at 0 all the same.
+        summarize::Dialect numbers = summarize::sniffDialect("  1   2.5\n 10  12.0\n100   0.5\n  7   1.0\n", true, '\t');
+        EXPECT_EQUAL(numbers.columnStarts.size(), static_cast<size_t>(2))
+        EXPECT_EQUAL(numbers.columnStarts[1], static_cast<size_t>(5))
+        EXPECT_EQUAL(numbers.hasHeader, false)
+
+        // Comment lines are not part of the layout.
+        std::string commented = "# generated\nA  B\n1  2\n3  4\n5  6\n";
+        summarize::Dialect comments = summarize::sniffDialect(commented, true, ',');
+        EXPECT_EQUAL(comments.commentBytes, commented.find("A  B"))
+        EXPECT_EQUAL(comments.columnStarts.size(), static_cast<size_t>(2))
+
+        // Delimited input, an explicit delimiter, text in one column and too few records
+        // are not fixed-width.
+        EXPECT_EQUAL(summarize::sniffDialect("a b,c\n1 2,3\n4 5,6\n", true, '\t').isFixedWidth(), false)
+        EXPECT_EQUAL(summarize::sniffDialect("a  b\n1  2\n3  4\n", true, '\t', '\t').isFixedWidth(), false)
+        EXPECT_EQUAL(summarize::sniffDialect("a long line of text\nwith words\nall the way\n", true, '\t').isFixedWidth(), false)
+        EXPECT_EQUAL(summarize::sniffDialect("a  b\n1  2\n", true, '\t').isFixedWidth(), false)
+        EXPECT_EQUAL(summarize::sniffDialect("alpha\nbeta\ngamma\n", true, '\t').isFixedWidth(), false)
+        EXPECT_EQUAL(summarize::sniffDialect("a  b\n1  2\n3  4\n", true, '\t').isFixedWidth(), false)
+
+        // Text with spaces at the same offset in every line is not in columns: a single
+        // space, or a gap that most lines do not have values on both sides of.
+        const std::string timestamps = "2022-09-24 10:00:00\n2022-09-24 10:05:00\n2022-09-24 10:10:00\n"
+                                       "2022-09-24 10:15:00\n2022-09-24 10:20:00\n";
+        summarize::Dialect timestampLines = summarize::sniffDialect(timestamps, true, '\t');
+        EXPECT_EQUAL(timestampLines.isFixedWidth(), false)
+        EXPECT_EQUAL(timestampLines.delim, '\t')
+        EXPECT_EQUAL(summarize::sniffDialect("San Jose\nLos Angeles\nNew York\nSan Diego\n", true, '\t').isFixedWidth(), false)
+        EXPECT_EQUAL(summarize::sniffDialect("key  value\n     cont one\n     cont two\n     cont three\n", true, '\t').isFixedWidth(), false)
+    END_SECTION
+
+    START_SECTION("Slicing records")
+        const std::vector<size_t> starts = {0, 4, 9};
+        const std::string text = "ab  cde  f\r\n  x      longer than the layout\n\n     \nshort\ny";
+        const std::string expected = "ab|cde|f;x||longer than the layout;;;shor|t|;y||";
+        EXPECT_EQUAL(sliceRecords(text, starts, 1 << 16), expected)
+        // Lines split across blocks are sliced the same.
+        for(size_t blockSize: {1, 2, 3, 7})
+            EXPECT_EQUAL(sliceRecords(text, starts, blockSize), expected)
+
+        summarize::ColumnNames names;
+        for(const char* name: {"a", "b", "c"}) names.push_back(name);
+        summarize::ColumnSelection selection;
+        selection.parse("c,a");
+        selection.resolve(names);
+        EXPECT_EQUAL(sliceRecords(text, starts, 3, &selection), "f|ab;longer than the layout|x;;;|shor;|y")
+
+        std::istringstream positionIn("a  b\r\nc  d");
+        summarize::BlockReader positionReader(positionIn.rdbuf(), 5);
+        summarize::FixedWidthParser parser(positionReader, {0, 3});
+        std::vector<std::string> record;
+        EXPECT_EQUAL(parser.nextRecord(record), true)
+        EXPECT_EQUAL(parser.getPosition(), static_cast<size_t>(6))
+        EXPECT_EQUAL(parser.lastTerminated(), true)
+        EXPECT_EQUAL(parser.nextRecord(record), true)
+        EXPECT_EQUAL(parser.lastTerminated(), false)
+        EXPECT_EQUAL(parser.getPosition(), static_cast<size_t>(10))
+        EXPECT_EQUAL(parser.nextRecord(record), false)
+    END_SECTION
+
+    START_SECTION("Reading fixed-width input")
+        std::string table = "ID     CITY          TEMP   DATE\n";
+        for(int i = 0; i < 2000; i++) {
+            std::string id = std::to_string(i);
+            std::string city = i % 2 ? "NEW YORK" : "LA";
+            std::string temp = i % 10 == 9 ? "" : std::to_string(i % 40) + ".5";
+            table += id + std::string(7 - id.size(), ' ') + city + std::string(14 - city.size(), ' ') +
+                     std::string(5 - temp.size(), ' ') + temp + "  2024-01-01\n";
+        }
+
+        std::istringstream serialIn(table);
+        summarize::TsvFile serial;
+        serial.sniffDelim('\t');
+        serial.setPreviewRows(3);
+        serial.setCollectStats(true);
+        serial.setIndexInterval(100);
+        EXPECT_EQUAL(serial.read(serialIn, true), true)
+        EXPECT_EQUAL(serial.getDialect().isFixedWidth(), true)
+        EXPECT_EQUAL(serial.getNCols(), static_cast<size_t>(4))
+        EXPECT_EQUAL(serial.getNRows(), static_cast<size_t>(2000))
+        EXPECT_EQUAL(serial.getHeaders()[1], std::string("CITY"))
+        EXPECT_EQUAL(serial.getPreviewValue(1, 1), std::string("NEW YORK"))
+        EXPECT_EQUAL(serial.getType(0), summarize::ColumnStats::INT)
+        EXPECT_EQUAL(serial.getType(2), summarize::ColumnStats::FLOAT)
+        EXPECT_EQUAL(serial.getStats(2).getMissing(), static_cast<size_t>(200))
+        EXPECT_EQUAL(serial.seekPreview(serialIn, 1234), true)
+        EXPECT_EQUAL(serial.getPreviewValue(0, 0), std::string("1234"))
+        EXPECT_EQUAL(serial.getPreviewValue(2, 2), std::string("36.5"))
+
+        summarize::Scheduler scheduler(2);
+        std::istringstream firstIn(table);
+        std::istringstream pipelinedIn(table);
+        summarize::TsvFile pipelined;
+        pipelined.sniffDelim('\t');
+        pipelined.setPreviewRows(3);
+        pipelined.setCollectStats(true);
+        pipelined.setScheduler(&scheduler, 4096);
+        EXPECT_EQUAL(pipelined.read(pipelinedIn, true), true)
+        EXPECT_EQUAL(pipelined.getProfile().getPipeline().empty(), false)
+        serial.seekPreview(firstIn, 0);
+        EXPECT_EQUAL(describeRead(pipelined), describeRead(serial))
+
+        std::istringstream tailIn(table);
+        summarize::TsvFile tail;
+        tail.sniffDelim('\t');
+        EXPECT_EQUAL(tail.readTail(tailIn, 2), true)
+        EXPECT_EQUAL(tail.getNCols(), static_cast<size_t>(4))
+        EXPECT_EQUAL(tail.getPreviewValue(0, 1), std::string("1999"))
+        EXPECT_EQUAL(tail.getPreviewValue(2, 1), std::string(""))
+
+        // Extracted columns are written delimited.
+        summarize::ColumnSelection cut;
+        cut.parse("TEMP,CITY");
+        std::istringstream cutIn("ID  CITY      TEMP\n1   LA        21.5\n2   NEW YORK      \n3   BOSTON    -4\n");
+        summarize::BlockReader cutReader(cutIn.rdbuf());
+        summarize::TsvFile cutFile;
+        cutFile.sniffDelim(',');
+        cutFile.setSelection(cut);
+        std::ostringstream cutOut;
+        EXPECT_EQUAL(cutFile.extract(cutReader, cutOut, true), true)
+        EXPECT_EQUAL(cutOut.str(), std::string("TEMP,CITY\n21.5,LA\n,NEW YORK\n-4,BOSTON\n"))
+    END_SECTION
+END_TEST
@@ -0,0 +1,79 @@
+//
+// Tests for follow mode: appended bytes are parsed incrementally, a partial last record
+// is completed on a later update, and truncation starts over.
+//
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <filesystem>
+
+#include <testing.hpp>
+#include <testUtils.hpp>
+#include <follow.hpp>
+
+static void setup(const std::string&, summarize::TsvFile& file) {
+    file.setDelim('\t');
+    file.setCollectStats(true);
+}
+
+START_TEST("follow.hpp")
+    const std::string path = "test_follow_input.tsv";
+    writeFile(path, "a\tb\n1\tx\n2\ty\n");
+
+    START_SECTION("appends")
+        {
+            summarize::Follower follower(setup, true, 10, false);
+            follower.addFile(path);
+            EXPECT_EQUAL(follower.update(), true)
+            const summarize::TsvFile& file = follower.getFile(0);
+            EXPECT_EQUAL(file.getNRows(), static_cast<size_t>(2))
+            EXPECT_EQUAL(follower.update(), false)       // nothing new
+
+            appendFile(path, "3\tz\n4\t");
+            EXPECT_EQUAL(follower.update(), true)
+            EXPECT_EQUAL(file.getProfile().getRecords(), static_cast<size_t>(2))
+            EXPECT_EQUAL(file.getNRows(), static_cast<size_t>(4))
+            EXPECT_EQUAL(file.getStats(1).getMissing(), static_cast<size_t>(1))
+
+            // the partial record is replaced by its completed version
+            appendFile(path, "w\t!\n");
+            EXPECT_EQUAL(follower.update(), true)
+            EXPECT_EQUAL(file.getProfile().getRecords(), static_cast<size_t>(1))
+            EXPECT_EQUAL(file.getNRows(), static_cast<size_t>(4))
+            EXPECT_EQUAL(file.getNCols(), static_cast<size_t>(3))
+            EXPECT_EQUAL(file.getMinFields(), static_cast<size_t>(2))
+            EXPECT_EQUAL(file.getStats(1).getMissing(), static_cast<size_t>(0))
+            EXPECT_EQUAL(file.getStats(0).getMax(), 4.0)
+            EXPECT_EQUAL(file.getStats(0).getCount(), static_cast<size_t>(4))
+        }
+    END_SECTION
+
+    START_SECTION("truncation and inotify")
+        {
+            summarize::Follower follower(setup, true, 10, true);
+            follower.addFile(path);
+            follower.update();
+            EXPECT_EQUAL(follower.getFile(0).getNRows(), static_cast<size_t>(4))
+
+            writeFile(path, "a\tb\n9\tq\n");
+            EXPECT_EQUAL(follower.update(), true)
+            EXPECT_EQUAL(follower.getFile(0).getNRows(), static_cast<size_t>(1))
+            EXPECT_EQUAL(follower.getFile(0).getStats(0).getMax(), 9.0)
+        }
+        {   // a missing file is picked up once it appears
+            std::filesystem::remove(path);
+            summarize::Follower follower(setup, true, 10, false);
+            follower.addFile(path);
+            EXPECT_EQUAL(follower.update(), false)
+            writeFile(path, "a\n");
+            EXPECT_EQUAL(follower.update(), true)
+            EXPECT_EQUAL(follower.getFile(0).getNRows(), static_cast<size_t>(0))
+            appendFile(path, "1\n");
+            EXPECT_EQUAL(follower.update(), true)
+            EXPECT_EQUAL(follower.getFile(0).getNRows(), static_cast<size_t>(1))
+        }
+    END_SECTION
+
+    std::filesystem::remove(path);
+END_TEST
@@ -0,0 +1,164 @@
+//
+// Tests for --groupBy hash aggregation: the group table, spilling groups past the memory
+// limit and merging them back, and reads that group their rows serially and pipelined.
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <testing.hpp>
+#include <groupBy.hpp>
+#include <scheduler.hpp>
+#include <tsvFile.hpp>
+
+//! The lines of \p text after the first, sorted.
+static std::vector<std::string> sortedGroups(const std::string& text) {
+    std::istringstream in(text);
+    std::vector<std::string> ret;
+    std::string line;
+    std::getline(in, line);
+    while(std::getline(in, line)) ret.push_back(line);
+    std::sort(ret.begin(), ret.end());
+    return ret;
+}
+
+//! The groups of the last read of \p f, as written by GroupBy::write.
+static std::string writeGroups(const summarize::TsvFile& f, summarize::GroupBy& groups) {
+    std::vector<summarize::ColumnStats::TYPE> types;
+    for(size_t col = 0; col < f.getNCols(); col++) types.push_back(f.getType(col));
+    std::ostringstream out;
+    groups.write(out, f.getHeaders(), types);
+    return out.str();
+}
+
+START_TEST("groupBy.hpp")
+    START_SECTION("Group table")
+        summarize::GroupTable table(1);
+        const std::vector<size_t> keys = {0, 2};
+        const std::vector<size_t> values = {1};
+        table.add({"a", "1", "x"}, keys, values);
+        table.add({"a", "3", "y"}, keys, values);
+        table.add({"a", "5", "x"}, keys, values);
+        table.add({"ax", "7"}, keys, values);           // the missing key field is empty
+        table.add({"a", "NA", "x"}, keys, values);
+        EXPECT_EQUAL(table.size(), static_cast<size_t>(3))
+        EXPECT_EQUAL(table.getCount(0), static_cast<size_t>(3))
+        EXPECT_EQUAL(table.getStats(0)[0].getMean(), 3.0)
+        EXPECT_EQUAL(table.getStats(0)[0].getMissing(), static_cast<size_t>(1))
+        std::vector<std::string_view> fields;
+        summarize::GroupTable::splitKey(table.getKey(2), fields);
+        EXPECT_EQUAL(fields.size(), static_cast<size_t>(2))
+        EXPECT_EQUAL(fields[0], std::string_view("ax"))
+        EXPECT_EQUAL(fields[1], std::string_view(""))
+
+        // Keys are not confused by where their fields split.
+        summarize::GroupTable other(1);
+        other.add({"a", "10", "x"}, keys, values);
+        other.add({"a", "2", "xy"}, keys, values);
+        other.add({"ax", "2", "y"}, keys, values);
+        table.merge(other);
+        EXPECT_EQUAL(table.size(), static_cast<size_t>(5))
+        EXPECT_EQUAL(table.getCount(0), static_cast<size_t>(4))
+        EXPECT_EQUAL(table.getStats(0)[0].getMax(), 10.0)
+
+        summarize::GroupTable many(0);
+        for(int i = 0; i < 20000; i++) many.add({std::to_string(i % 5000)}, {0}, {});
+        EXPECT_EQUAL(many.size(), static_cast<size_t>(5000))
+        EXPECT_EQUAL(many.getCount(4999), static_cast<size_t>(4))
+        EXPECT_EQUAL(many.getKey(17).substr(4), std::string_view("17"))
+        many.clear();
+        EXPECT_EQUAL(many.size(), static_cast<size_t>(0))
+        many.add({"again"}, {0}, {});
+        EXPECT_EQUAL(many.getCount(0), static_cast<size_t>(1))
+    END_SECTION
+
+    START_SECTION("Spilling groups")
+        summarize::ColumnNames names;
+        names.push_back("key");
+        names.push_back("value");
+        std::vector<summarize::ColumnStats::TYPE> types = {summarize::ColumnStats::STRING, summarize::ColumnStats::INT};
+        summarize::GroupBy inMemory;
+        summarize::GroupBy spilled;
+        spilled.setMemoryLimit(16 * 1024);
+        for(summarize::GroupBy* groups: {&inMemory, &spilled}) {
+            groups->parse("key");
+            groups->resolve(names);
+            groups->setFields({0}, {1});
+            for(int i = 0; i < 30000; i++) groups->add({"k" + std::to_string(i * 7 % 3001), std::to_string(i)});
+        }
+        EXPECT_EQUAL(inMemory.getNSpills(), static_cast<size_t>(0))
+        EXPECT_EQUAL(spilled.getNSpills() > 1, true)
+        std::ostringstream inMemoryOut;
+        std::ostringstream spilledOut;
+        EXPECT_EQUAL(inMemory.write(inMemoryOut, names, types), true)
+        EXPECT_EQUAL(spilled.write(spilledOut, names, types), true)
+        EXPECT_EQUAL(inMemoryOut.str().substr(0, 26), std::string("key\tcount\tvalue_mean\nk0\t10"))
+        EXPECT_EQUAL(sortedGroups(spilledOut.str()).size(), static_cast<size_t>(3001))
+        EXPECT_EQUAL(sortedGroups(spilledOut.str()) == sortedGroups(inMemoryOut.str()), true)
+    END_SECTION
+
+    START_SECTION("Reading groups")
+        std::string input = "id\tregion\tstatus\tlatency\n";
+        double sum = 0;
+        for(int i = 0; i < 3000; i++) {
+            const char* region = i % 3 == 0 ? "eu" : (i % 3 == 1 ? "us" : "ap");
+            input += std::to_string(i) + "\t" + region + "\t" + (i % 2 ? "FAILED" : "OK") + "\t" +
+                     std::to_string(i % 100) + "\n";
+            if(i % 6 == 0) sum += i % 100;
+        }
+        std::ostringstream firstGroup;
+        firstGroup << "eu\tOK\t500\t" << 2994 / 2.0 << '\t' << sum / 500;
+
+        summarize::GroupBy serialGroups;
+        serialGroups.parse("region,status");
+        std::istringstream serialIn(input);
+        summarize::TsvFile serial;
+        serial.sniffDelim('\t');
+        serial.setGroupBy(&serialGroups);
+        EXPECT_EQUAL(serial.read(serialIn, true), true)
+        std::string serialOut = writeGroups(serial, serialGroups);
+        EXPECT_EQUAL(serialOut.substr(0, serialOut.find('\n')), std::string("region\tstatus\tcount\tid_mean\tlatency_mean"))
+        EXPECT_EQUAL(sortedGroups(serialOut).size(), static_cast<size_t>(6))
+        EXPECT_EQUAL(serialOut.find(firstGroup.str()), serialOut.find('\n') + 1)
+
+        summarize::Scheduler scheduler(2);
+        summarize::GroupBy pipelinedGroups;
+        pipelinedGroups.parse("region,status");
+        std::istringstream pipelinedIn(input);
+        summarize::TsvFile pipelined;
+        pipelined.sniffDelim('\t');
+        pipelined.setGroupBy(&pipelinedGroups);
+        pipelined.setScheduler(&scheduler, 4096);
+        EXPECT_EQUAL(pipelined.read(pipelinedIn, true), true)
+        EXPECT_EQUAL(pipelined.getProfile().getPipeline().empty(), false)
+        EXPECT_EQUAL(writeGroups(pipelined, pipelinedGroups), serialOut)
+
+        // Key columns are read even when not selected; only the filtered rows are grouped.
+        summarize::GroupBy filteredGroups;
+        filteredGroups.parse("2");
+        summarize::ColumnSelection latency;
+        latency.parse("latency");
+        summarize::RowFilter slow;
+        slow.parse("latency >= 90 AND status = OK");
+        std::istringstream filteredIn(input);
+        summarize::TsvFile filtered;
+        filtered.sniffDelim('\t');
+        filtered.setSelection(latency);
+        filtered.setFilter(slow);
+        filtered.setGroupBy(&filteredGroups);
+        EXPECT_EQUAL(filtered.read(filteredIn, true), true)
+        EXPECT_EQUAL(filtered.getNCols(), static_cast<size_t>(2))
+        EXPECT_EQUAL(writeGroups(filtered, filteredGroups),
+                     std::string("region\tcount\tlatency_mean\neu\t50\t94\nap\t50\t94\nus\t50\t94\n"))
+
+        summarize::GroupBy unknownGroups;
+        unknownGroups.parse("nope");
+        std::istringstream unknownIn(input);
+        summarize::TsvFile failedRead;
+        failedRead.setGroupBy(&unknownGroups);
+        EXPECT_EQUAL(failedRead.read(unknownIn, true), false)
+    END_SECTION
+END_TEST
@@ -0,0 +1,126 @@
+//
+// Tests for the SIMD kernels: every level the host supports must agree with the scalar
+// kernels at every alignment and length, and forcing a level must be honored.
+//
+
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <testing.hpp>
+#include <kernels.hpp>
+#include <tsvFile.hpp>
+
+namespace {
+    struct Results {
+        std::vector<size_t> found, counts, digits;
+        summarize::RecordHistogram hist;
+        bool operator == (const Results& rhs) const {
+            return found == rhs.found && counts == rhs.counts && digits == rhs.digits &&
+                   hist.counts == rhs.hist.counts && hist.starts == rhs.hist.starts && hist.ends == rhs.hist.ends;
+        }
+    };
+
+    std::string name(summarize::SimdLevel level) {
+        return summarize::simdLevelName(level);
+    }
+
+    //! Kernel results over every substring start and length of \p text up to 160 bytes.
+    Results runKernels(const std::string& text) {
+        Results ret;
+        const char* base = text.data();
+        for(size_t start = 0; start < 70; start++) {
+            for(size_t len = 0; start + len <= text.size() && len <= 160; len++) {
+                const char* p = base + start;
+                const char* end = p + len;
+                ret.found.push_back(static_cast<size_t>(summarize::findAny(p, end, '\t', '\n', '\r') - p));
+                ret.counts.push_back(summarize::countByte(p, end, ','));
+                ret.digits.push_back(summarize::digitSpan(p, end));
+                summarize::histogramRecords(p, len, "\t,", 2, '"', len % 2 == 0, ret.hist);
+            }
+        }
+        return ret;
+    }
+}
+
+START_TEST("kernels.hpp")
+    START_SECTION("Levels agree with the scalar kernels")
+        // Sparse special bytes so matches land in every lane and past the vector width,
+        // plus bytes >= 0x80, which must not be taken for digits.
+        std::mt19937 rng(7);
+        std::string text;
+        const std::string alphabet = "0123456789,abc\xC3\xA9";
+        for(int i = 0; i < 300; i++) {
+            unsigned r = rng() % 100;
+            if(r == 0) text += '\t';
+            else if(r == 1) text += '\n';
+            else if(r == 2) text += '\r';
+            else if(r == 3) text += '"';
+            else if(r < 60) text += static_cast<char>('0' + rng() % 10);
+            else text += alphabet[rng() % alphabet.size()];
+        }
+
+        EXPECT_EQUAL(name(summarize::setSimdLevel(summarize::SimdLevel::SCALAR)), std::string("scalar"))
+        Results expected = runKernels(text);
+        summarize::SimdLevel detected = summarize::detectSimdLevel();
+        std::cout << "Host supports " << summarize::simdLevelName(detected) << std::endl;
+        for(summarize::SimdLevel level: {summarize::SimdLevel::SSE42, summarize::SimdLevel::AVX2,
+                                         summarize::SimdLevel::AVX512BW}) {
+            if(level > detected) continue;
+            EXPECT_EQUAL(name(summarize::setSimdLevel(level)), name(level))
+            EXPECT_EQUAL(name(summarize::getSimdLevel()), name(level))
+            EXPECT_EQUAL(runKernels(text) == expected, true)
+        }
+    END_SECTION
+
+    START_SECTION("Record histograms")
+        summarize::setSimdLevel(summarize::SimdLevel::SCALAR);
+        std::string records = "a,b\tc\r\n\n\"x,\ny\",z\n" + std::string(100, ',') + "\nlast,";
+        summarize::RecordHistogram hist;
+        summarize::histogramRecords(records.data(), records.size(), ",\t", 2, '"', false, hist);
+        EXPECT_EQUAL(hist.starts.size(), static_cast<size_t>(3))
+        EXPECT_EQUAL(hist.counts[0], 1u)
+        EXPECT_EQUAL(hist.counts[1], 1u)
+        EXPECT_EQUAL(hist.counts[2], 1u)       // the comma between quotes is not counted
+        EXPECT_EQUAL(hist.starts[1], records.find('"'))
+        EXPECT_EQUAL(hist.ends[1], records.find("\n,"))
+        EXPECT_EQUAL(hist.counts[4], 100u)
+        hist = summarize::RecordHistogram();
+        summarize::histogramRecords(records.data(), records.size(), ",\t", 2, '"', true, hist);
+        EXPECT_EQUAL(hist.starts.size(), static_cast<size_t>(4))
+        EXPECT_EQUAL(hist.ends.back(), records.size())
+    END_SECTION
+
+    START_SECTION("Forcing levels")
+        // Levels the CPU lacks fall back to the detected one.
+        EXPECT_EQUAL(name(summarize::setSimdLevel(summarize::SimdLevel::AVX512BW)), name(summarize::detectSimdLevel()))
+        summarize::SimdLevel parsed;
+        EXPECT_EQUAL(summarize::parseSimdLevel("avx2", parsed), true)
+        EXPECT_EQUAL(name(parsed), name(summarize::SimdLevel::AVX2))
+        EXPECT_EQUAL(summarize::parseSimdLevel("sse4.2", parsed), true)
+        EXPECT_EQUAL(name(parsed), name(summarize::SimdLevel::SSE42))
+        EXPECT_EQUAL(summarize::parseSimdLevel("avx", parsed), false)
+        EXPECT_EQUAL(std::string(summarize::simdLevelName(summarize::SimdLevel::SCALAR)), std::string("scalar"))
+    END_SECTION
+
+    START_SECTION("Parsing and sniffing at each level")
+        std::string table = "name,count,note\n";
+        for(int i = 0; i < 5000; i++)
+            table += "row" + std::to_string(i) + "," + std::to_string(i * 7) + ",\"a, \"\"b\"\"\r\nc\"\n";
+        for(summarize::SimdLevel level: {summarize::SimdLevel::SCALAR, summarize::SimdLevel::SSE42,
+                                         summarize::SimdLevel::AVX2, summarize::SimdLevel::AVX512BW}) {
+            summarize::setSimdLevel(level);
+            EXPECT_EQUAL(summarize::sniffDelimiter(table.substr(0, 2000), false, '\t'), ',')
+            std::istringstream ss(table);
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            f.setCollectStats(true);
+            f.read(ss, true);
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(5000))
+            EXPECT_EQUAL(f.getType(1), summarize::ColumnStats::INT)
+            EXPECT_EQUAL(f.getPreviewValue(2, 0), std::string("a, \"b\"\nc"))
+        }
+    END_SECTION
+END_TEST
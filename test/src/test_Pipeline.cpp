@@ -0,0 +1,121 @@
+//
+// Tests for pipelined reads: a read split into batches and parsed by the tasks of several
+// workers has the same results as a serial read, whatever the batch and block sizes (so
+// batches and blocks end inside quoted fields, between \r and \n and within the final
+// record).
+//
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+
+#include <testing.hpp>
+#include <scheduler.hpp>
+#include <tsvFile.hpp>
+
+//! Everything a read found, with the means rounded.
+static std::string describe(const summarize::TsvFile& f) {
+    std::ostringstream out;
+    out << f.getNRows() << "x" << f.getNCols() << " min " << f.getMinFields() << " resume " << f.getResumeOffset();
+    for(size_t col = 0; col < f.getNCols(); col++) {
+        out << " | " << f.getHeaders()[col] << ':' << summarize::ColumnStats::typeToString(f.getType(col));
+        for(size_t row = 0; row < f.getNPreviewRows(); row++) out << ',' << f.getPreviewValue(col, row);
+        if(f.hasStats()) {
+            const summarize::ColumnStats& stats = f.getStats(col);
+            out << " n " << stats.getCount() << " na " << stats.getMissing() << " len " << stats.getMaxLength();
+            if(stats.getNNumeric() > 0)
+                out << std::setprecision(9) << " min " << stats.getMin() << " max " << stats.getMax()
+                    << " mean " << stats.getMean();
+        }
+    }
+    out << " index";
+    for(size_t offset: f.getRecordIndex()) out << ' ' << offset;
+    return out.str();
+}
+
+//! A read of \p text by \p threads workers with batches of \p batchBytes, from blocks of
+//! \p blockSize bytes.
+static std::string readWith(const std::string& text, size_t threads, size_t batchBytes, size_t blockSize,
+                            bool stats = true, bool hasHeader = true) {
+    std::istringstream in(text);
+    summarize::BlockReader reader(in.rdbuf(), blockSize);
+    summarize::Scheduler scheduler(threads);
+    summarize::TsvFile f;
+    f.sniffDelim('\t');
+    f.setPreviewRows(5);
+    f.setCollectStats(stats);
+    f.setIndexInterval(7);
+    f.setScheduler(&scheduler, batchBytes);
+    f.read(reader, hasHeader);
+    return describe(f);
+}
+
+START_TEST("pipeline.cpp")
+    std::string text = "id,name,value\r\n";
+    for(int i = 0; i < 2000; i++) {
+        text += std::to_string(i) + ",";
+        if(i % 5 == 0) text += "\"multi\r\nline, \"\"quoted\"\"\"";
+        else if(i % 11 == 0) text += "not\"quoted";
+        else text += "plain";
+        if(i % 13 != 0) text += "," + std::to_string(i * 0.5);       // ragged rows
+        text += i % 3 ? "\r\n" : "\n";
+        if(i % 17 == 0) text += "\n";                                   // blank lines
+    }
+    text += "9999,\"last\",1.5";                                        // no line terminator
+
+    START_SECTION("Same results as a serial read")
+        std::string expected = readWith(text, 1, summarize::PIPELINE_BATCH_BYTES, 1 << 16);
+        bool same = true;
+        for(size_t threads: {2, 3}) {
+            for(size_t batchBytes: {1, 100, 4096, 1 << 18}) {
+                for(size_t blockSize: {1, 7, 1 << 16}) {
+                    std::string got = readWith(text, threads, batchBytes, blockSize);
+                    if(got != expected) {
+                        std::cout << "threads " << threads << ", batch " << batchBytes << ", block " << blockSize
+                                  << ":\n  " << got << "\n  " << expected << '\n';
+                        same = false;
+                    }
+                }
+            }
+        }
+        EXPECT_EQUAL(same, true)
+        EXPECT_EQUAL(readWith(text, 3, 64, 13, false), readWith(text, 1, 64, 13, false))
+        EXPECT_EQUAL(readWith(text, 2, 64, 13, true, false), readWith(text, 1, 64, 13, true, false))
+        EXPECT_EQUAL(readWith("a\tb\n", 4, 1, 1), readWith("a\tb\n", 1, 1, 1))
+        EXPECT_EQUAL(readWith("a,b", 2, 1, 1), readWith("a,b", 1, 1, 1))
+
+        // Read by a task, which parses batches itself while it waits for the others.
+        summarize::Scheduler scheduler(2);
+        std::istringstream in(text);
+        summarize::TsvFile f;
+        f.sniffDelim('\t');
+        f.setScheduler(&scheduler, 1000);
+        summarize::TaskGroup group(scheduler);
+        group.run([&f, &in]() { f.read(in, true); });
+        group.wait();
+        EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(2001))
+        EXPECT_EQUAL(f.getProfile().getPipeline().find("2 workers") == 0, true)
+    END_SECTION
+
+    START_SECTION("Resuming after the unterminated record")
+        std::string more = "0\r\n10000,x,2\n";
+        std::istringstream full(text + more);
+        summarize::TsvFile serial;
+        serial.sniffDelim('\t');
+        serial.setCollectStats(true);
+        serial.read(full, true);
+
+        std::istringstream head(text);
+        summarize::Scheduler resumeScheduler(3);
+        summarize::TsvFile pipelined;
+        pipelined.sniffDelim('\t');
+        pipelined.setCollectStats(true);
+        pipelined.setScheduler(&resumeScheduler, 500);
+        pipelined.read(head, true);
+        EXPECT_EQUAL(pipelined.getResumeOffset(), text.rfind('\n') + 1)
+        std::istringstream rest((text + more).substr(pipelined.getResumeOffset()));
+        pipelined.readMore(rest);
+        EXPECT_EQUAL(describe(pipelined), describe(serial))
+    END_SECTION
+END_TEST
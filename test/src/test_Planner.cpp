@@ -0,0 +1,150 @@
+//
+// Tests for the execution planner: the facts probed from a file, the sample description,
+// the read ahead and engine chosen for small, large, cold and streamed inputs, and a read
+// that follows its plan.
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <filesystem>
+
+#include <testing.hpp>
+#include <testUtils.hpp>
+#include <planner.hpp>
+#include <scheduler.hpp>
+#include <tsvFile.hpp>
+
+//! A cached file of \p size bytes.
+static summarize::InputFacts fileFacts(size_t size, bool stats = true) {
+    summarize::InputFacts facts;
+    facts.path = "input.tsv";
+    facts.regularFile = true;
+    facts.size = size;
+    facts.cachedFraction = 1;
+    facts.stats = stats;
+    return facts;
+}
+
+START_TEST("planner.hpp")
+    const std::string path = "test_planner_input.tsv";
+
+    START_SECTION("Probing and describing inputs")
+        writeFile(path, std::string("\x1f\x8b\x08\x00", 4) + "rest");
+        summarize::InputFacts gzip;
+        EXPECT_EQUAL(summarize::probeInput(path, gzip), true)
+        EXPECT_EQUAL(gzip.regularFile, true)
+        EXPECT_EQUAL(gzip.size, static_cast<size_t>(8))
+        EXPECT_EQUAL(gzip.compression, std::string("gzip"))
+        EXPECT_EQUAL(gzip.cachedFraction >= 0 && gzip.cachedFraction <= 1, true)
+
+        writeFile(path, "a\tb\n1\t2\n");
+        summarize::InputFacts plain;
+        EXPECT_EQUAL(summarize::probeInput(path, plain), true)
+        EXPECT_EQUAL(plain.compression, std::string())
+        summarize::InputFacts missing;
+        EXPECT_EQUAL(summarize::probeInput("no_such_file.tsv", missing), false)
+
+        summarize::SampleFacts sample = summarize::describeSample("a,\"b\"\n1,2\n3,\"x\"", ',', '"', true);
+        EXPECT_EQUAL(sample.records, static_cast<size_t>(3))
+        EXPECT_EQUAL(sample.fields, static_cast<size_t>(6))
+        EXPECT_EQUAL(sample.quotes, static_cast<size_t>(4))
+        EXPECT_EQUAL(sample.fieldsPerRecord(), 2.0)
+        EXPECT_EQUAL(summarize::describeSample("a,\"b\"\n", ',', '"', false).quotes, static_cast<size_t>(0))
+    END_SECTION
+
+    START_SECTION("Read ahead")
+        summarize::Planner planner(4);
+        summarize::ExecutionPlan small = planner.plan(fileFacts(1000), 4);
+        EXPECT_EQUAL(small.io.queueDepth, static_cast<size_t>(0))
+        EXPECT_EQUAL(small.engine == summarize::ExecutionPlan::Engine::SERIAL, true)
+
+        summarize::ExecutionPlan cached = planner.plan(fileFacts(100u << 20), 4);
+        EXPECT_EQUAL(cached.io.queueDepth, static_cast<size_t>(2))
+        EXPECT_EQUAL(cached.io.direct, false)
+
+        summarize::InputFacts cold = fileFacts(static_cast<size_t>(1) << 50);
+        cold.cachedFraction = 0;
+        summarize::ExecutionPlan coldPlan = planner.plan(cold, 4);
+        EXPECT_EQUAL(coldPlan.io.queueDepth, static_cast<size_t>(8))
+        EXPECT_EQUAL(coldPlan.io.direct, true)
+
+        summarize::InputFacts stream;
+        summarize::ExecutionPlan streamPlan = planner.plan(stream, 4);
+        EXPECT_EQUAL(streamPlan.io.queueDepth, static_cast<size_t>(4))
+        EXPECT_EQUAL(streamPlan.io.uring, false)
+        EXPECT_EQUAL(streamPlan.engine == summarize::ExecutionPlan::Engine::PIPELINE, true)
+    END_SECTION
+
+    START_SECTION("Engine")
+        summarize::Planner enginePlanner(8);
+        summarize::ExecutionPlan large = enginePlanner.plan(fileFacts(100u << 20), 8);
+        EXPECT_EQUAL(large.engine == summarize::ExecutionPlan::Engine::PIPELINE, true)
+        EXPECT_EQUAL(large.threads > 1 && large.threads <= 8, true)
+        EXPECT_EQUAL(large.parallelSeconds < large.serialSeconds, true)
+        EXPECT_EQUAL(enginePlanner.plan(fileFacts(100u << 20), 1).engine == summarize::ExecutionPlan::Engine::SERIAL, true)
+
+        summarize::InputFacts partial = fileFacts(100u << 20);
+        partial.partial = "tail";
+        EXPECT_EQUAL(enginePlanner.plan(partial, 8).engine == summarize::ExecutionPlan::Engine::SERIAL, true)
+
+        summarize::InputFacts parquet = fileFacts(100u << 20, false);
+        parquet.parquet = true;
+        EXPECT_EQUAL(enginePlanner.plan(parquet, 8).engine == summarize::ExecutionPlan::Engine::PARQUET_METADATA, true)
+        parquet.stats = true;
+        EXPECT_EQUAL(enginePlanner.plan(parquet, 8).engine == summarize::ExecutionPlan::Engine::PARQUET_SCAN, true)
+
+        // Quotes and statistics make each byte cost more, so the same input is worth more workers.
+        summarize::ExecutionPlan plainPlan = enginePlanner.plan(fileFacts(1u << 20, false), 8);
+        summarize::ExecutionPlan quotedPlan = plainPlan;
+        std::string quoted;
+        for(int i = 0; i < 100; i++) quoted += "\"a\",\"b\"\"c\",\"d\"\n";
+        enginePlanner.refine(plainPlan, summarize::describeSample("a,b,c\n", ',', '"', true), 8);
+        enginePlanner.refine(quotedPlan, summarize::describeSample(quoted, ',', '"', true), 8);
+        EXPECT_EQUAL(quotedPlan.sampled, true)
+        EXPECT_EQUAL(quotedPlan.serialSeconds > plainPlan.serialSeconds, true)
+
+        std::ostringstream out;
+        large.print(out);
+        EXPECT_EQUAL(out.str().find("Plan for input.tsv:\n  input: file, 100.0 MiB, 100% cached\n") == 0, true)
+        EXPECT_EQUAL(out.str().find("  engine: pipeline on ") != std::string::npos, true)
+
+        // Few small files are not worth a thread; large ones or a stream are worth them all.
+        std::vector<summarize::InputFacts> smallInputs = {fileFacts(1000), fileFacts(2000)};
+        EXPECT_EQUAL(enginePlanner.planThreads(smallInputs), static_cast<size_t>(1))
+        std::vector<summarize::InputFacts> largeInputs = {fileFacts(1u << 30)};
+        EXPECT_EQUAL(enginePlanner.planThreads(largeInputs), static_cast<size_t>(8))
+        std::vector<summarize::InputFacts> streamInputs = {summarize::InputFacts()};
+        EXPECT_EQUAL(enginePlanner.planThreads(streamInputs), static_cast<size_t>(8))
+    END_SECTION
+
+    START_SECTION("Reads follow the plan")
+        std::string text = "id\tvalue\n";
+        for(int i = 0; i < 20000; i++) text += std::to_string(i) + "\t" + std::to_string(i * 0.25) + "\n";
+        summarize::Planner readPlanner(2);
+        summarize::Scheduler scheduler(2);
+
+        std::istringstream smallIn(text);
+        summarize::TsvFile serial;
+        serial.sniffDelim('\t');
+        serial.setScheduler(&scheduler);
+        serial.setPlanner(&readPlanner, readPlanner.plan(fileFacts(1000), 2));
+        EXPECT_EQUAL(serial.read(smallIn, true), true)
+        EXPECT_EQUAL(serial.getProfile().getPipeline(), std::string())
+        EXPECT_EQUAL(serial.getPlan().sampled, true)
+        EXPECT_EQUAL(serial.getNRows(), static_cast<size_t>(20000))
+
+        std::istringstream largeIn(text);
+        summarize::TsvFile pipelined;
+        pipelined.sniffDelim('\t');
+        pipelined.setScheduler(&scheduler);
+        pipelined.setPlanner(&readPlanner, readPlanner.plan(summarize::InputFacts(), 2));
+        EXPECT_EQUAL(pipelined.read(largeIn, true), true)
+        EXPECT_EQUAL(pipelined.getPlan().engine == summarize::ExecutionPlan::Engine::PIPELINE, true)
+        EXPECT_EQUAL(pipelined.getProfile().getPipeline().find("2 workers") == 0, true)
+        EXPECT_EQUAL(pipelined.getNRows(), static_cast<size_t>(20000))
+    END_SECTION
+
+    std::filesystem::remove(path);
+END_TEST
@@ -0,0 +1,64 @@
+//
+// Tests for the progress reporter: status line formatting and the byte / record
+// counters fed by TsvFile.
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include <testing.hpp>
+#include <progress.hpp>
+#include <tsvFile.hpp>
+
+static bool contains(const std::string& haystack, const std::string& needle) {
+    return haystack.find(needle) != std::string::npos;
+}
+
+START_TEST("progress.hpp")
+    START_SECTION("formatting")
+        EXPECT_EQUAL(summarize::ProgressReporter::formatBytes(512), std::string("512 B"))
+        EXPECT_EQUAL(summarize::ProgressReporter::formatBytes(1536), std::string("1.5 KiB"))
+        EXPECT_EQUAL(summarize::ProgressReporter::formatBytes(3.0 * (1u << 30)), std::string("3.0 GiB"))
+        EXPECT_EQUAL(summarize::ProgressReporter::formatDuration(5), std::string("5s"))
+        EXPECT_EQUAL(summarize::ProgressReporter::formatDuration(125), std::string("2m5s"))
+        EXPECT_EQUAL(summarize::ProgressReporter::formatDuration(3661), std::string("1h1m1s"))
+        {
+            std::string line = summarize::ProgressReporter::formatLine(50, 100, 2000, 2.0);
+            EXPECT_EQUAL(contains(line, "(50.0%)"), true)
+            EXPECT_EQUAL(contains(line, "2000 records"), true)
+            EXPECT_EQUAL(contains(line, "1.0k rec/s"), true)
+            EXPECT_EQUAL(contains(line, "ETA 2s"), true)      // half done in 2 s
+        }
+        {   // unknown total size: no percentage or ETA
+            std::string line = summarize::ProgressReporter::formatLine(50, 0, 10, 1.0);
+            EXPECT_EQUAL(contains(line, "%"), false)
+            EXPECT_EQUAL(contains(line, "ETA"), false)
+        }
+    END_SECTION
+
+    START_SECTION("TsvFile feeds the counters")
+        {
+            std::string text = "h1\th2\n";
+            for(int i = 0; i < 10000; i++) text += "a\tb\n";
+            std::istringstream ss(text);
+            std::ostringstream log;
+            summarize::ProgressReporter progress(log, summarize::ProgressReporter::LOG);
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.setProgress(&progress);
+            f.read(ss, true);
+            EXPECT_EQUAL(progress.getBytes(), text.size())
+            EXPECT_EQUAL(progress.getRecords(), static_cast<size_t>(10001))    // incl. header
+        }
+        {   // stop() prints a final log line
+            std::ostringstream log;
+            summarize::ProgressReporter progress(log, summarize::ProgressReporter::LOG);
+            progress.setTotalBytes(10);
+            progress.start();
+            progress.addBytes(10);
+            progress.stop();
+            EXPECT_EQUAL(contains(log.str(), "progress: 10 B / 10 B (100.0%)"), true)
+        }
+    END_SECTION
+END_TEST
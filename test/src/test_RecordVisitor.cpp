@@ -0,0 +1,131 @@
+//
+// Tests for the push style record visitor: it must produce the same records as CsvParser,
+// including fields cut by block boundaries, and stop when the sink asks it to.
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <testing.hpp>
+#include <recordVisitor.hpp>
+#include <tsvFile.hpp>
+
+namespace {
+    typedef std::vector<std::vector<std::string> > Records;
+
+    //! Collects the visited records, stopping after \p limit.
+    struct CollectingSink {
+        Records records;
+        size_t limit = SIZE_MAX;
+        bool lastTerminated = true;
+
+        void onRecordBegin() {
+            records.emplace_back();
+        }
+        void onField(std::string_view value) {
+            records.back().emplace_back(value);
+        }
+        bool onRecordEnd(bool terminated) {
+            lastTerminated = terminated;
+            return records.size() < limit;
+        }
+    };
+
+    //! Counts fields without keeping them.
+    struct CountingSink {
+        size_t fields = 0;
+        size_t bytes = 0;
+        void onRecordBegin() {}
+        void onField(std::string_view value) {
+            fields++;
+            bytes += value.size();
+        }
+        bool onRecordEnd(bool) {
+            return true;
+        }
+    };
+
+    Records parseAll(const std::string& text, char delim) {
+        std::istringstream ss(text);
+        summarize::CsvParser parser(ss, delim);
+        Records ret;
+        std::vector<std::string> record;
+        while(parser.nextRecord(record))
+            if(!record.empty()) ret.push_back(record);
+        return ret;
+    }
+
+    //! Visit \p text with its first \p split bytes as the prefix.
+    Records visitAll(const std::string& text, char delim, size_t split) {
+        std::istringstream ss(text.substr(split));
+        CollectingSink sink;
+        summarize::visitRecords(std::string_view(text).substr(0, split), ss.rdbuf(), delim, sink);
+        return sink.records;
+    }
+}
+
+START_TEST("recordVisitor.hpp")
+    START_SECTION("Same records as CsvParser")
+        std::vector<std::string> inputs = {
+            "a,b,c\n1,2,3\n",
+            "a,b\r\n\r\n1,\"x,y\"\r\n",
+            "\"q\"\"uote\",\"multi\nline\",\"cr\rlf\r\n\"\n",
+            "x,,\n,\n,y",
+            "\"closed\"tail,z\n\"unterminated",
+            "\n\n\nlone\n",
+            "a,b,",
+        };
+        for(const auto& text: inputs) {
+            Records expected = parseAll(text, ',');
+            // Every split point puts a block boundary inside each kind of token.
+            for(size_t split = 0; split <= text.size(); split++)
+                EXPECT_EQUAL(visitAll(text, ',', split) == expected, true)
+        }
+    END_SECTION
+
+    START_SECTION("Fields across stream blocks")
+        std::string text = "id\tnote\n";
+        for(int i = 0; i < 30000; i++)
+            text += std::to_string(i) + (i % 3 ? "\tplain text\n" : "\t\"quo\"\"ted\ttab\"\r\n");
+        Records expected = parseAll(text, '\t');
+        EXPECT_EQUAL(visitAll(text, '\t', 0) == expected, true)
+        EXPECT_EQUAL(visitAll(text, '\t', 100) == expected, true)
+
+        CountingSink counter;
+        std::istringstream in(text);
+        EXPECT_EQUAL(summarize::visitRecords("", in.rdbuf(), '\t', counter), static_cast<size_t>(30001))
+        EXPECT_EQUAL(counter.fields, static_cast<size_t>(60002))
+    END_SECTION
+
+    START_SECTION("Early stop and unterminated records")
+        {
+            std::istringstream ss("h\n1\n2\n3\n");
+            CollectingSink sink;
+            sink.limit = 2;
+            EXPECT_EQUAL(summarize::visitRecords("", ss.rdbuf(), '\t', sink), static_cast<size_t>(2))
+            EXPECT_EQUAL(sink.records.size(), static_cast<size_t>(2))
+            EXPECT_EQUAL(sink.records.back().at(0), std::string("1"))
+        }
+        {
+            std::istringstream ss("h\nlast");
+            CollectingSink sink;
+            summarize::visitRecords("", ss.rdbuf(), '\t', sink);
+            EXPECT_EQUAL(sink.lastTerminated, false)
+            EXPECT_EQUAL(sink.records.back().at(0), std::string("last"))
+        }
+    END_SECTION
+
+    START_SECTION("TsvFile::visit")
+        // The BOM is stripped and the delimiter sniffed as in read().
+        std::istringstream ss("\xEF\xBB\xBFname;value\nx;1\ny;2\n");
+        summarize::TsvFile f;
+        f.sniffDelim('\t');
+        CollectingSink sink;
+        EXPECT_EQUAL(f.visit(ss, sink), static_cast<size_t>(3))
+        EXPECT_EQUAL(f.getDelim(), ';')
+        EXPECT_EQUAL(sink.records.at(0).at(0), std::string("name"))
+        EXPECT_EQUAL(sink.records.at(2).at(1), std::string("2"))
+    END_SECTION
+END_TEST
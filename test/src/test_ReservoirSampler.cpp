@@ -0,0 +1,105 @@
+//
+// Tests for reservoir sampling: Algorithm L keeps every item with equal probability, and
+// TsvFile's sampled preview is reproducible and survives an incremental resume.
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <testing.hpp>
+#include <reservoirSampler.hpp>
+#include <tsvFile.hpp>
+
+//! The sample of \p k out of \p n items as item indices, in reservoir order.
+static std::vector<size_t> sample(size_t n, size_t k, uint64_t seed) {
+    summarize::ReservoirSampler sampler(k, seed);
+    std::vector<size_t> reservoir;
+    for(size_t i = 0; i < n; i++) {
+        if(reservoir.size() < k) reservoir.push_back(i);
+        else if(sampler.takes(i)) reservoir[sampler.replace()] = i;
+    }
+    return reservoir;
+}
+
+static std::string previewColumn(const summarize::TsvFile& f, size_t col) {
+    std::string ret;
+    for(size_t row = 0; row < f.getNPreviewRows(); row++) ret += f.getPreviewValue(col, row) + ";";
+    return ret;
+}
+
+START_TEST("reservoirSampler.hpp")
+    START_SECTION("uniform inclusion")
+        {
+            // 4000 samples of 10 out of 1000 items: each block of 100 items should hold
+            // about a tenth of the 40000 sampled items.
+            std::vector<size_t> blocks(10, 0);
+            for(uint64_t seed = 0; seed < 4000; seed++)
+                for(size_t i: sample(1000, 10, seed)) blocks[i / 100]++;
+            size_t lo = 4000 * 10 / 10 * 9 / 10, hi = 4000 * 10 / 10 * 11 / 10;
+            bool uniform = true;
+            for(size_t count: blocks) if(count < lo || count > hi) uniform = false;
+            EXPECT_EQUAL(uniform, true)
+        }
+        {   // fewer items than the reservoir: all are kept
+            EXPECT_EQUAL(sample(3, 5, 1).size(), static_cast<size_t>(3))
+            summarize::ReservoirSampler empty(0);
+            EXPECT_EQUAL(empty.takes(0), false)
+        }
+    END_SECTION
+
+    START_SECTION("TsvFile sampled preview")
+        std::string text = "id\tv\n";
+        for(int i = 0; i < 20000; i++) text += std::to_string(i) + "\tx" + std::to_string(i % 7) + "\n";
+        {
+            std::istringstream ss(text);
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.setPreviewRows(5);
+            f.setSample(true);
+            f.read(ss, true);
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(20000))
+            EXPECT_EQUAL(f.getNPreviewRows(), static_cast<size_t>(5))
+            size_t beyondHead = 0;
+            for(size_t row = 0; row < 5; row++)
+                if(std::stoi(f.getPreviewValue(0, row)) >= 5) beyondHead++;
+            EXPECT_EQUAL(beyondHead > 0, true)
+
+            std::istringstream again(text);
+            summarize::TsvFile g;
+            g.setDelim('\t');
+            g.setPreviewRows(5);
+            g.setSample(true);
+            g.read(again, true);
+            EXPECT_EQUAL(previewColumn(g, 0), previewColumn(f, 0))
+        }
+        {   // reading a prefix cut inside a record, then the rest, samples the same rows
+            std::istringstream whole(text);
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.setPreviewRows(5);
+            f.setSample(true);
+            f.read(whole, true);
+
+            // The last cut ends inside a row that is in the sample, so the partial record
+            // replaces a preview row that must be put back when it is parsed again.
+            std::string sampled = "\n" + f.getPreviewValue(0, 4) + "\t";
+            size_t inSampledRow = text.find(sampled) + sampled.size() + 1;
+            for(size_t cut: {text.size() / 3 + 1, text.size() - 2, inSampledRow}) {
+                std::istringstream prefix(text.substr(0, cut));
+                summarize::TsvFile g;
+                g.setDelim('\t');
+                g.setPreviewRows(5);
+                g.setSample(true);
+                g.read(prefix, true);
+                std::istringstream rest(text);
+                rest.seekg(static_cast<std::streamoff>(g.getResumeOffset()));
+                g.readMore(rest);
+                EXPECT_EQUAL(g.getNRows(), static_cast<size_t>(20000))
+                EXPECT_EQUAL(previewColumn(g, 0), previewColumn(f, 0))
+                EXPECT_EQUAL(previewColumn(g, 1), previewColumn(f, 1))
+            }
+        }
+    END_SECTION
+END_TEST
@@ -0,0 +1,169 @@
+//
+// Tests for --where row filters: parsing and evaluating expressions, and reads that count,
+// preview and summarize only the matching rows, serially, pipelined, with a column
+// selection and when extracting.
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <testing.hpp>
+#include <testUtils.hpp>
+#include <rowFilter.hpp>
+#include <scheduler.hpp>
+#include <tsvFile.hpp>
+
+//! Whether \p expression, resolved against the columns status, latency, host and region,
+//! matches \p record.
+static bool evaluate(const std::string& expression, const std::vector<std::string>& record) {
+    summarize::RowFilter filter;
+    if(!filter.parse(expression)) return false;
+    if(!filter.resolve(makeNames({"status", "latency", "host", "region"}))) return false;
+    return filter.matches(record);
+}
+
+START_TEST("rowFilter.hpp")
+    START_SECTION("Parsing expressions")
+        summarize::RowFilter filter;
+        EXPECT_EQUAL(filter.isSet(), false)
+        EXPECT_EQUAL(filter.parse("status = FAILED and (latency > 500 OR `host` ^= 'test')"), true)
+        EXPECT_EQUAL(filter.isSet(), true)
+        EXPECT_EQUAL(filter.getNames().size(), static_cast<size_t>(3))
+        EXPECT_EQUAL(filter.parse("NOT NOT status IS NOT NULL && !(latency BETWEEN 1 AND 2)"), true)
+        EXPECT_EQUAL(filter.parse("ORDER = 1 OR NOTE <> 'x'"), true)       // keywords are whole words
+        EXPECT_EQUAL(filter.getNames()[0], std::string("ORDER"))
+
+        EXPECT_EQUAL(filter.parse(""), false)
+        EXPECT_EQUAL(filter.isSet(), false)
+        EXPECT_EQUAL(filter.parse("status"), false)
+        EXPECT_EQUAL(filter.parse("status = 'open"), false)
+        EXPECT_EQUAL(filter.parse("(status = 1"), false)
+        EXPECT_EQUAL(filter.parse("status = 1 extra"), false)
+        EXPECT_EQUAL(filter.parse("latency BETWEEN 1 2"), false)
+        EXPECT_EQUAL(filter.parse("status IS EMPTY"), false)
+        EXPECT_EQUAL(filter.parse(std::string(100, '(') + "a = 1" + std::string(100, ')')), false)
+
+        EXPECT_EQUAL(filter.parse("status = 1 AND nope = 2"), true)
+        EXPECT_EQUAL(filter.resolve(makeNames({"status", "latency"})), false)
+    END_SECTION
+
+    START_SECTION("Evaluating expressions")
+        const std::vector<std::string> failed = {"FAILED", "750", "test-3", "NA"};
+        const std::vector<std::string> ok = {"OK", "20.5", "prod-1", "eu"};
+        EXPECT_EQUAL(evaluate("status = FAILED", failed), true)
+        EXPECT_EQUAL(evaluate("status == 'OK'", failed), false)
+        EXPECT_EQUAL(evaluate("latency > 500", failed), true)
+        EXPECT_EQUAL(evaluate("latency > 500", ok), false)
+        EXPECT_EQUAL(evaluate("latency >= 20.5 AND latency <= 20.5", ok), true)
+        EXPECT_EQUAL(evaluate("latency = 7.5e2", failed), true)             // numerically
+        EXPECT_EQUAL(evaluate("latency = '7.5e2'", failed), false)          // as a string
+        EXPECT_EQUAL(evaluate("latency != 750", failed), false)
+        EXPECT_EQUAL(evaluate("latency BETWEEN 100 AND 1000", failed), true)
+        EXPECT_EQUAL(evaluate("latency BETWEEN 100 AND 1000", ok), false)
+        EXPECT_EQUAL(evaluate("status BETWEEN A AND M", failed), true)
+        EXPECT_EQUAL(evaluate("host ^= test", failed), true)
+        EXPECT_EQUAL(evaluate("host ^= test", ok), false)
+        EXPECT_EQUAL(evaluate("host > p", ok), true)
+        EXPECT_EQUAL(evaluate("host < 5", ok), false)                       // not a number
+        EXPECT_EQUAL(evaluate("region IS NULL", failed), true)
+        EXPECT_EQUAL(evaluate("region IS NOT NULL", failed), false)
+        EXPECT_EQUAL(evaluate("region != eu", failed), false)               // missing never compares
+        EXPECT_EQUAL(evaluate("region IS NULL", {"FAILED"}), true)          // short record
+
+        // Precedence and short circuits.
+        EXPECT_EQUAL(evaluate("status = OK OR status = FAILED AND latency < 100", failed), false)
+        EXPECT_EQUAL(evaluate("status = OK OR status = FAILED AND latency < 100", ok), true)
+        EXPECT_EQUAL(evaluate("(status = OK OR status = FAILED) AND latency < 100", failed), false)
+        EXPECT_EQUAL(evaluate("NOT status = OK AND NOT (host ^= prod OR region IS NULL)", failed), false)
+        EXPECT_EQUAL(evaluate("NOT status = FAILED OR latency > 1 AND latency < 1000 AND host ^= t", failed), true)
+        EXPECT_EQUAL(evaluate("status = x OR status = y OR status = z OR status = OK", ok), true)
+        EXPECT_EQUAL(evaluate("status = OK AND latency > 1 AND latency < 10 OR region = eu", ok), true)
+    END_SECTION
+
+    START_SECTION("Reading matching rows")
+        std::string table = "id\tstatus\tlatency\n";
+        for(int i = 0; i < 3000; i++)
+            table += std::to_string(i) + "\t" + (i % 3 == 0 ? "FAILED" : "OK") + "\t" + std::to_string(i % 1000) + "\n";
+        table += "\n";
+        summarize::RowFilter slow;
+        slow.parse("status = FAILED AND latency >= 500");
+
+        std::istringstream serialIn(table);
+        summarize::TsvFile serial;
+        serial.sniffDelim('\t');
+        serial.setPreviewRows(3);
+        serial.setCollectStats(true);
+        serial.setFilter(slow);
+        EXPECT_EQUAL(serial.read(serialIn, true), true)
+        EXPECT_EQUAL(serial.getNRows(), static_cast<size_t>(500))
+        EXPECT_EQUAL(serial.getNFiltered(), static_cast<size_t>(2500))
+        EXPECT_EQUAL(serial.getPreviewValue(0, 0), std::string("501"))
+        EXPECT_EQUAL(serial.getPreviewValue(2, 2), std::string("507"))
+        EXPECT_EQUAL(serial.getStats(2).getCount(), static_cast<size_t>(500))
+
+        summarize::Scheduler scheduler(2);
+        std::istringstream pipelinedIn(table);
+        summarize::TsvFile pipelined;
+        pipelined.sniffDelim('\t');
+        pipelined.setPreviewRows(3);
+        pipelined.setCollectStats(true);
+        pipelined.setFilter(slow);
+        pipelined.setScheduler(&scheduler, 4096);
+        EXPECT_EQUAL(pipelined.read(pipelinedIn, true), true)
+        EXPECT_EQUAL(pipelined.getProfile().getPipeline().empty(), false)
+        EXPECT_EQUAL(describeRead(pipelined), describeRead(serial))
+
+        // Columns only the filter reads are tested, then dropped.
+        summarize::ColumnSelection idOnly;
+        idOnly.parse("id");
+        std::istringstream projectedIn(table);
+        summarize::TsvFile projected;
+        projected.sniffDelim('\t');
+        projected.setPreviewRows(3);
+        projected.setSelection(idOnly);
+        projected.setFilter(slow);
+        EXPECT_EQUAL(projected.read(projectedIn, true), true)
+        EXPECT_EQUAL(projected.getNCols(), static_cast<size_t>(1))
+        EXPECT_EQUAL(projected.getNRows(), static_cast<size_t>(500))
+        EXPECT_EQUAL(projected.getPreviewValue(0, 1), std::string("504"))
+
+        std::istringstream seekIn(table);
+        summarize::TsvFile seeker;
+        seeker.sniffDelim('\t');
+        seeker.setPreviewRows(2);
+        seeker.setIndexInterval(100);
+        seeker.setFilter(slow);
+        EXPECT_EQUAL(seeker.read(seekIn, true), true)
+        EXPECT_EQUAL(seeker.seekPreview(seekIn, 100), true)
+        EXPECT_EQUAL(seeker.getPreviewValue(0, 0), std::string("801"))
+        EXPECT_EQUAL(seeker.getPreviewValue(0, 1), std::string("804"))
+
+        summarize::RowFilter unknown;
+        unknown.parse("nope = 1");
+        std::istringstream unknownIn(table);
+        summarize::TsvFile failedRead;
+        failedRead.setFilter(unknown);
+        EXPECT_EQUAL(failedRead.read(unknownIn, true), false)
+    END_SECTION
+
+    START_SECTION("Writing matching rows")
+        const std::string csv = "a,b,c\n1,\"x,y\",10\n2,,20\n\n3,z,30\n";
+        summarize::RowFilter big;
+        big.parse("c > 15");
+        summarize::ColumnSelection cut;
+        cut.parse("b,a");
+        std::istringstream cutIn(csv);
+        summarize::BlockReader cutReader(cutIn.rdbuf());
+        summarize::TsvFile cutFile;
+        cutFile.sniffDelim(',');
+        cutFile.setSelection(cut);
+        cutFile.setFilter(big);
+        std::ostringstream cutOut;
+        EXPECT_EQUAL(cutFile.extract(cutReader, cutOut, true), true)
+        EXPECT_EQUAL(cutOut.str(), std::string("b,a\n,2\nz,3\n"))
+        EXPECT_EQUAL(cutFile.getNRows(), static_cast<size_t>(2))
+        EXPECT_EQUAL(cutFile.getNFiltered(), static_cast<size_t>(1))
+    END_SECTION
+END_TEST
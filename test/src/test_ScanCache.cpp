@@ -0,0 +1,289 @@
+//
+// Tests for the on-disk scan result cache.
+//
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <filesystem>
+
+#include <testing.hpp>
+#include <testUtils.hpp>
+#include <scanCache.hpp>
+
+static size_t readIncremental(summarize::ScanCache& cache, const std::string& path,
+                              summarize::TsvFile& f) {
+    f.setDelim(',');
+    f.setPreviewRows(2);
+    f.setCollectStats(true);
+    cache.read(path, f, true);
+    return f.getProfile().getRecords();
+}
+
+START_TEST("scanCache.hpp")
+    const std::string dir = "test_scan_cache";
+    const std::string path = "test_scan_cache_input.csv";
+    std::filesystem::remove_all(dir);
+    writeFile(path, "\xEF\xBB\xBF" "id,name\n1,\"a\tb\"\n2,c\n3,d\n");
+
+    START_SECTION("fingerprint")
+        {
+            summarize::FileFingerprint a, b;
+            EXPECT_EQUAL(summarize::FileFingerprint::compute(path, a), true)
+            EXPECT_EQUAL(summarize::FileFingerprint::compute(path, b), true)
+            EXPECT_EQUAL(a == b, true)
+            EXPECT_EQUAL(a.size, static_cast<uint64_t>(27))
+            EXPECT_EQUAL(summarize::FileFingerprint::compute("no_such_file.csv", a), false)
+        }
+    END_SECTION
+
+    START_SECTION("miss then hit")
+        {
+            summarize::ScanCache cache(dir);
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            f.setPreviewRows(2);
+            f.setCollectStats(true);
+            EXPECT_EQUAL(cache.read(path, f, true), true)
+            EXPECT_EQUAL(cache.lastWasHit(), false)
+            EXPECT_EQUAL(std::filesystem::exists(cache.entryPath(path)), true)
+
+            summarize::TsvFile g;
+            g.sniffDelim('\t');
+            g.setPreviewRows(2);
+            g.setCollectStats(true);
+            EXPECT_EQUAL(cache.read(path, g, true), true)
+            EXPECT_EQUAL(cache.lastWasHit(), true)
+            EXPECT_EQUAL(g.getDelim(), ',')
+            EXPECT_EQUAL(g.getDataOffset(), static_cast<size_t>(3))          // BOM
+            EXPECT_EQUAL(g.getNRows(), static_cast<size_t>(3))
+            EXPECT_EQUAL(g.getNCols(), static_cast<size_t>(2))
+            EXPECT_EQUAL(g.getHeaders().at(1), std::string("name"))
+            EXPECT_EQUAL(g.getNPreviewRows(), static_cast<size_t>(2))
+            EXPECT_EQUAL(g.getType(0), summarize::ColumnStats::INT)
+            EXPECT_EQUAL(g.getStats(0).serialize(), f.getStats(0).serialize())
+        }
+        {   // fewer preview rows than cached is a hit, more is a miss
+            summarize::ScanCache cache(dir);
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            f.setPreviewRows(1);
+            cache.read(path, f, true);
+            EXPECT_EQUAL(cache.lastWasHit(), true)
+            EXPECT_EQUAL(f.getNPreviewRows(), static_cast<size_t>(1))
+            EXPECT_EQUAL(f.hasStats(), false)
+            summarize::TsvFile g;
+            g.sniffDelim('\t');
+            g.setPreviewRows(3);
+            cache.read(path, g, true);
+            EXPECT_EQUAL(cache.lastWasHit(), false)
+        }
+        {   // different options are a different result
+            summarize::ScanCache cache(dir);
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            cache.read(path, f, false);
+            EXPECT_EQUAL(cache.lastWasHit(), false)
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(4))
+        }
+    END_SECTION
+
+    START_SECTION("invalidation")
+        {   // the file changes: the entry is ignored and replaced
+            writeFile(path, "id,name\n1,a\n2,b\n3,c\n4,d\n");
+            summarize::ScanCache cache(dir);
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            cache.read(path, f, true);
+            EXPECT_EQUAL(cache.lastWasHit(), false)
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(4))
+        }
+        {   // a truncated entry is never accepted
+            summarize::ScanCache cache(dir);
+            std::string entry = cache.entryPath(path);
+            std::ifstream in(entry);
+            std::stringstream buffer;
+            buffer << in.rdbuf();
+            in.close();
+            std::string text = buffer.str();
+            writeFile(entry, text.substr(0, text.size() - 4));
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            cache.read(path, f, true);
+            EXPECT_EQUAL(cache.lastWasHit(), false)
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(4))
+        }
+        {   // an entry from another format version is ignored
+            summarize::ScanCache cache(dir);
+            std::string entry = cache.entryPath(path);
+            std::ifstream in(entry);
+            std::stringstream buffer;
+            buffer << in.rdbuf();
+            in.close();
+            std::string text = buffer.str();
+            text.replace(0, text.find('\n'), "summarize-scan-cache 0");
+            writeFile(entry, text);
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            cache.read(path, f, true);
+            EXPECT_EQUAL(cache.lastWasHit(), false)
+        }
+    END_SECTION
+
+    START_SECTION("record index")
+        {   // the index is stored with the entry and used by seekPreview on a hit
+            std::string text = "id\n";
+            for(int i = 0; i < 50; i++) text += std::to_string(i) + "\n";
+            writeFile(path, text);
+            summarize::ScanCache cache(dir);
+            summarize::TsvFile f;
+            f.setDelim(',');
+            f.setIndexInterval(10);
+            cache.read(path, f, true);
+            summarize::TsvFile g;
+            g.setDelim(',');
+            g.setIndexInterval(10);
+            cache.read(path, g, true);
+            EXPECT_EQUAL(cache.lastWasHit(), true)
+            EXPECT_EQUAL(g.getRecordIndex() == f.getRecordIndex(), true)
+            EXPECT_EQUAL(g.getRecordIndex().size(), static_cast<size_t>(5))
+            std::ifstream in(path, std::ios::binary);
+            EXPECT_EQUAL(g.seekPreview(in, 37), true)
+            EXPECT_EQUAL(g.getPreviewValue(0, 0), std::string("37"))
+
+            summarize::TsvFile h;           // a different interval is a different result
+            h.setDelim(',');
+            h.setIndexInterval(20);
+            cache.read(path, h, true);
+            EXPECT_EQUAL(cache.lastWasHit(), false)
+        }
+    END_SECTION
+
+    START_SECTION("incremental")
+        {   // appended rows are parsed on their own and merged into the cached state
+            std::filesystem::remove_all(dir);
+            writeFile(path, "id,name\n1,a\n2,b\n");
+            summarize::ScanCache cache(dir);
+            cache.setIncremental(true);
+            summarize::TsvFile f;
+            EXPECT_EQUAL(readIncremental(cache, path, f), static_cast<size_t>(3))
+            EXPECT_EQUAL(cache.lastWasHit(), false)
+
+            appendFile(path, "3,c\n4,d\n");
+            summarize::TsvFile g;
+            EXPECT_EQUAL(readIncremental(cache, path, g), static_cast<size_t>(2))
+            EXPECT_EQUAL(cache.lastWasHit(), true)
+            EXPECT_EQUAL(cache.lastWasGrown(), true)
+            EXPECT_EQUAL(g.getNRows(), static_cast<size_t>(4))
+            EXPECT_EQUAL(g.getNPreviewRows(), static_cast<size_t>(2))
+            EXPECT_EQUAL(g.getStats(0).getMax(), 4.0)
+            EXPECT_EQUAL(g.getStats(0).getCount(), static_cast<size_t>(4))
+
+            // the grown state was stored: an unchanged file now parses nothing
+            summarize::TsvFile h;
+            EXPECT_EQUAL(readIncremental(cache, path, h), static_cast<size_t>(0))
+            EXPECT_EQUAL(cache.lastWasGrown(), false)
+            EXPECT_EQUAL(h.getNRows(), static_cast<size_t>(4))
+        }
+        {   // growth is ignored unless incremental reads are enabled
+            appendFile(path, "5,e\n");
+            summarize::ScanCache cache(dir);
+            summarize::TsvFile f;
+            EXPECT_EQUAL(readIncremental(cache, path, f), static_cast<size_t>(6))
+            EXPECT_EQUAL(cache.lastWasHit(), false)
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(5))
+        }
+        {   // a record without line terminator is parsed again once it is complete
+            writeFile(path, "id,name\n1,a\n2,b");
+            summarize::ScanCache cache(dir);
+            cache.setIncremental(true);
+            summarize::TsvFile f;
+            readIncremental(cache, path, f);
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(2))
+
+            appendFile(path, "x\n3,c\n");
+            summarize::TsvFile g;
+            EXPECT_EQUAL(readIncremental(cache, path, g), static_cast<size_t>(2))
+            EXPECT_EQUAL(cache.lastWasGrown(), true)
+            EXPECT_EQUAL(g.getNRows(), static_cast<size_t>(3))
+            EXPECT_EQUAL(g.getStats(1).getMaxLength(), static_cast<size_t>(2))   // "bx"
+            EXPECT_EQUAL(g.getStats(0).getCount(), static_cast<size_t>(3))
+        }
+        {   // a rewritten prefix is a miss
+            std::ifstream in(path);
+            std::stringstream buffer;
+            buffer << in.rdbuf();
+            in.close();
+            std::string text = buffer.str();
+            text[text.find("1,a")] = '9';
+            {   // rewrite in place to keep the inode
+                std::fstream out(path, std::ios::in | std::ios::out | std::ios::binary);
+                out << text << "4,d\n";
+            }
+            summarize::ScanCache cache(dir);
+            cache.setIncremental(true);
+            summarize::TsvFile f;
+            EXPECT_EQUAL(readIncremental(cache, path, f), static_cast<size_t>(5))
+            EXPECT_EQUAL(cache.lastWasHit(), false)
+            EXPECT_EQUAL(f.getStats(0).getMax(), 9.0)
+        }
+    END_SECTION
+
+    START_SECTION("options of a miss")
+        {   // header detection gives the same result with and without the cache
+            std::filesystem::remove_all(dir);
+            writeFile(path, "1\t2\n3\t4\n5\t6\n");
+            std::ifstream in(path);
+            summarize::TsvFile uncached;
+            uncached.sniffDelim('\t');
+            uncached.setDetectHeader(true);
+            uncached.read(in, true);
+            EXPECT_EQUAL(uncached.getNRows(), static_cast<size_t>(3))
+            summarize::ScanCache cache(dir);
+            for(bool hit: {false, true}) {
+                summarize::TsvFile f;
+                f.sniffDelim('\t');
+                f.setDetectHeader(true);
+                EXPECT_EQUAL(cache.read(path, f, true), true)
+                EXPECT_EQUAL(cache.lastWasHit(), hit)
+                EXPECT_EQUAL(f.getNRows(), uncached.getNRows())
+                EXPECT_EQUAL(f.getHasHeader(), false)
+                EXPECT_EQUAL(f.getHeaders().at(0), uncached.getHeaders().at(0))
+            }
+        }
+        {   // quoting is kept on a miss and is part of the entry
+            writeFile(path, "a\tb\n\"x\ty\n\"z\tw\n");
+            summarize::ScanCache cache(dir);
+            for(summarize::Quoting quoting: {summarize::Quoting::NONE, summarize::Quoting::NONE, summarize::Quoting::RFC4180}) {
+                summarize::TsvFile f;
+                f.setDelim('\t');
+                f.setQuoting(quoting);
+                EXPECT_EQUAL(cache.read(path, f, true), true)
+                EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(quoting == summarize::Quoting::NONE ? 2 : 1))
+            }
+        }
+        {   // a read stopped by its time budget is partial and not stored
+            std::filesystem::remove_all(dir);
+            std::string text = "id\tv\n";
+            for(int i = 0; i < 100000; i++) text += "12\t3.5\n";
+            writeFile(path, text);
+            summarize::ScanCache cache(dir);
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.setTimeBudget(1e-9);
+            EXPECT_EQUAL(cache.read(path, f, true), true)
+            EXPECT_EQUAL(f.getPartialInfo().valid, true)
+            EXPECT_EQUAL(f.getPartialInfo().rows, static_cast<size_t>(4095))
+            EXPECT_EQUAL(std::filesystem::exists(cache.entryPath(path)), false)
+            summarize::TsvFile g;
+            g.setDelim('\t');
+            cache.read(path, g, true);
+            EXPECT_EQUAL(cache.lastWasHit(), false)
+            EXPECT_EQUAL(g.isNRowsExact(), true)
+        }
+    END_SECTION
+
+    std::filesystem::remove_all(dir);
+    std::filesystem::remove(path);
+END_TEST
@@ -0,0 +1,106 @@
+//
+// Tests for the work-stealing scheduler: every task runs once, tasks may wait for tasks
+// they submit (recursively, with fewer workers than waiting tasks), idle workers steal,
+// and the per-worker counters add up.
+//
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include <testing.hpp>
+#include <scheduler.hpp>
+
+//! Sum of 1..n, split in halves by nested tasks down to ranges of \p grain.
+static size_t nestedSum(summarize::Scheduler& scheduler, size_t from, size_t to, size_t grain) {
+    if(to - from <= grain) {
+        size_t ret = 0;
+        for(size_t i = from; i < to; i++) ret += i;
+        return ret;
+    }
+    size_t mid = from + (to - from) / 2;
+    size_t left = 0;
+    summarize::TaskGroup group(scheduler);
+    group.run([&]() { left = nestedSum(scheduler, from, mid, grain); });
+    size_t right = nestedSum(scheduler, mid, to, grain);
+    group.wait();
+    return left + right;
+}
+
+static size_t totalTasks(const summarize::Scheduler& scheduler) {
+    size_t ret = 0;
+    for(const auto& stats: scheduler.getWorkerStats()) ret += stats.tasks;
+    return ret;
+}
+
+START_TEST("scheduler.hpp")
+    START_SECTION("Every task runs once")
+        summarize::Scheduler scheduler(3);
+        EXPECT_EQUAL(scheduler.getThreads(), static_cast<size_t>(3))
+        std::atomic<size_t> count(0);
+        summarize::TaskGroup group(scheduler);
+        for(int i = 0; i < 1000; i++) group.run([&count]() { count++; });
+        group.wait();
+        EXPECT_EQUAL(count.load(), static_cast<size_t>(1000))
+        EXPECT_EQUAL(totalTasks(scheduler), static_cast<size_t>(1000))
+
+        summarize::Scheduler single(0);
+        EXPECT_EQUAL(single.getThreads(), static_cast<size_t>(1))
+    END_SECTION
+
+    START_SECTION("Nested tasks")
+        for(size_t threads: {1, 2, 4}) {
+            summarize::Scheduler scheduler(threads);
+            size_t sum = 0;
+            summarize::TaskGroup outer(scheduler);
+            outer.run([&]() { sum = nestedSum(scheduler, 0, 100000, 100); });
+            outer.wait();
+            EXPECT_EQUAL(sum, static_cast<size_t>(100000) * 99999 / 2)
+        }
+    END_SECTION
+
+    START_SECTION("Idle workers steal")
+        summarize::Scheduler stealing(4);
+        std::atomic<size_t> done(0);
+        summarize::TaskGroup stealGroup(stealing);
+        // One task queues everything on its own deque; the other workers can only steal.
+        stealGroup.run([&stealing, &done]() {
+            summarize::TaskGroup inner(stealing);
+            for(int i = 0; i < 40; i++) {
+                inner.run([&done]() {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    done++;
+                });
+            }
+            inner.wait();
+        });
+        stealGroup.wait();
+        EXPECT_EQUAL(done.load(), static_cast<size_t>(40))
+        size_t stolen = 0;
+        double busy = 0;
+        for(const auto& stats: stealing.getWorkerStats()) {
+            stolen += stats.stolen;
+            busy += stats.busySeconds;
+        }
+        EXPECT_EQUAL(stolen > 0, true)
+        EXPECT_EQUAL(busy > 0.02, true)
+        EXPECT_EQUAL(totalTasks(stealing), static_cast<size_t>(41))
+
+        std::ostringstream out;
+        stealing.print(out);
+        EXPECT_EQUAL(out.str().find("Workers: 4 threads") == 0, true)
+        EXPECT_EQUAL(out.str().find("  worker 3: busy ") != std::string::npos, true)
+    END_SECTION
+
+    START_SECTION("Queued tasks run before the scheduler stops")
+        std::atomic<size_t> ran(0);
+        {
+            summarize::Scheduler scheduler(2);
+            for(int i = 0; i < 100; i++) scheduler.submit([&ran]() { ran++; });
+        }
+        EXPECT_EQUAL(ran.load(), static_cast<size_t>(100))
+    END_SECTION
+END_TEST
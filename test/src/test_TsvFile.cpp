@@ -12,9 +12,10 @@
 
 //! Parse all records from \p text using \p delim and join them as
 //! "f0|f1|f2;f0|f1" so a whole table can be compared in a single EXPECT_EQUAL.
+template <typename Parser = summarize::CsvParser>
 static std::string parseAll(const std::string& text, char delim) {
     std::istringstream ss(text);
-    summarize::CsvParser parser(ss, delim);
+    Parser parser(ss, delim);
     std::vector<std::string> record;
     std::string ret;
     bool firstRecord = true;
@@ -29,6 +30,21 @@ static std::string parseAll(const std::string& text, char delim) {
     return ret;
 }
 
+//! Records of \p text with the position and termination after each, to compare parsers.
+template <typename Parser>
+static std::string traceAll(const std::string& text, char delim) {
+    std::istringstream ss(text);
+    Parser parser(ss, delim);
+    std::vector<std::string> record;
+    std::string ret;
+    while(parser.nextRecord(record)) {
+        ret += std::to_string(record.size()) + ":";
+        for(const auto& field: record) ret += field + "|";
+        ret += "@" + std::to_string(parser.getPosition()) + (parser.lastTerminated() ? "\n" : "$\n");
+    }
+    return ret;
+}
+
 //! Number of records parsed from \p text using \p delim.
 static size_t countRecords(const std::string& text, char delim) {
     std::istringstream ss(text);
@@ -39,6 +55,16 @@ static size_t countRecords(const std::string& text, char delim) {
     return n;
 }
 
+//! Serves a string through underflow() only, so seeking fails as it does on a pipe.
+class PipeBuf : public std::streambuf {
+public:
+    explicit PipeBuf(std::string text) : _text(std::move(text)) {
+        setg(&_text[0], &_text[0], &_text[0] + _text.size());
+    }
+private:
+    std::string _text;
+};
+
 START_TEST("tsvFile.hpp")
     START_SECTION("Stand alone functions")
         EXPECT_EQUAL(summarize::numDigits(0), 1)
@@ -126,6 +152,94 @@ START_TEST("tsvFile.hpp")
         EXPECT_EQUAL(summarize::sniffDelimiter("alpha\nbeta\n", true, ','), ',')
     END_SECTION
 
+    START_SECTION("sniffDialect")
+        // Uncommon delimiters are found when none of the common ones is consistent.
+        summarize::Dialect hive = summarize::sniffDialect("a\x01" "b\x01" "c\n1\x01" "2\x01" "3\n4\x01" "5\x01" "6\n", true, '\t');
+        EXPECT_EQUAL(hive.delim, '\x01')
+        EXPECT_EQUAL(hive.consistency, 1.0)
+        EXPECT_EQUAL(summarize::sniffDialect("a^b\n1^2\n3^4\n", true, ',').delim, '^')
+        // ... but not from a single record, or inconsistently.
+        EXPECT_EQUAL(summarize::sniffDialect("a^b\n", true, ',').delim, ',')
+        EXPECT_EQUAL(summarize::sniffDialect("a^b\n1\n2^3^4\n", true, ',').delim, ',')
+
+        // Single quoted fields, whose commas must not count; apostrophes do not quote.
+        summarize::Dialect single = summarize::sniffDialect("'a,b';c\n'd,e';f\n'g,h';i\n", true, '\t');
+        EXPECT_EQUAL(single.quote, '\'')
+        EXPECT_EQUAL(single.delim, ';')
+        EXPECT_EQUAL(summarize::sniffDialect("name,note\nA,don't\nB,it's\n", true, '\t').quote, '"')
+
+        // Leading comment lines are skipped; a '#' line shaped like the rows is the header.
+        std::string commented = "# exported 2022-09-24\n# by tool, v2\nx,y\n1,2\n3,4\n";
+        summarize::Dialect comments = summarize::sniffDialect(commented, true, '\t');
+        EXPECT_EQUAL(comments.delim, ',')
+        EXPECT_EQUAL(comments.commentPrefix, '#')
+        EXPECT_EQUAL(comments.commentBytes, commented.find("x,y"))
+        std::string vcf = "##fileformat=VCFv4.2\n#CHROM\tPOS\tID\n1\t100\trs1\n1\t200\trs2\n";
+        summarize::Dialect vcfDialect = summarize::sniffDialect(vcf, true, ',');
+        EXPECT_EQUAL(vcfDialect.delim, '\t')
+        EXPECT_EQUAL(vcfDialect.commentBytes, vcf.find("#CHROM"))
+        EXPECT_EQUAL(summarize::sniffDialect("a,b\n1,2\n", true, '\t').commentBytes, static_cast<size_t>(0))
+
+        // Header likelihood from the types of the first record and the rest.
+        summarize::Dialect header = summarize::sniffDialect("id,score,name\n1,2.5,x\n2,3.5,y\n", true, '\t');
+        EXPECT_EQUAL(header.hasHeader, true)
+        EXPECT_EQUAL(header.headerVotes, 0)     // no typed value in the first record to vote against it
+        summarize::Dialect mixed = summarize::sniffDialect("id,2019,2020\n1,2.5,3\n2,3.5,4\n", true, '\t');
+        EXPECT_EQUAL(mixed.hasHeader, false)
+        EXPECT_EQUAL(mixed.headerVotes, -1)
+        summarize::Dialect noHeader = summarize::sniffDialect("0,2.5,x\n1,2.5,x\n2,3.5,y\n", true, '\t');
+        EXPECT_EQUAL(noHeader.hasHeader, false)
+        EXPECT_EQUAL(noHeader.headerVotes, -2)
+        // String columns give no evidence, so the first record stays the header.
+        EXPECT_EQUAL(summarize::sniffDialect("a,b\nc,d\ne,f\n", true, '\t').hasHeader, true)
+        EXPECT_EQUAL(summarize::sniffDialect("a,b\n", true, '\t').hasHeader, true)
+        // A forced delimiter is scored like the sniffed ones.
+        summarize::Dialect forced = summarize::sniffDialect("1:2\n3:4\n", true, '\t', ':');
+        EXPECT_EQUAL(forced.delim, ':')
+        EXPECT_EQUAL(forced.hasHeader, false)
+    END_SECTION
+
+    START_SECTION("TsvFile dialect integration")
+        {   // Comment lines are not rows; the data offset points past them.
+            std::istringstream ss("# comment\nx,y\n1,2\n3,4\n");
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            f.read(ss, true);
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(2))
+            EXPECT_EQUAL(f.getHeaders().at(0), std::string("x"))
+            EXPECT_EQUAL(f.getDataOffset(), static_cast<size_t>(10))
+        }
+        {   // Header detection only applies when asked for.
+            std::istringstream ss("1,2\n3,4\n5,6\n");
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            f.read(ss, true);
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(2))
+            EXPECT_EQUAL(f.getHasHeader(), true)
+        }
+        {
+            std::istringstream ss("1,2\n3,4\n5,6\n");
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            f.setDetectHeader(true);
+            f.read(ss, true);
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(3))
+            EXPECT_EQUAL(f.getHasHeader(), false)
+            EXPECT_EQUAL(f.getDialect().headerVotes, -2)
+        }
+        {   // Single quoted fields are parsed with their quote character.
+            std::istringstream ss("name;note\n'a;b';x\n'c''d';y\n");
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            f.setPreviewRows(2);
+            f.read(ss, true);
+            EXPECT_EQUAL(f.getDelim(), ';')
+            EXPECT_EQUAL(f.getNCols(), static_cast<size_t>(2))
+            EXPECT_EQUAL(f.getPreviewValue(0, 0), std::string("a;b"))
+            EXPECT_EQUAL(f.getPreviewValue(0, 1), std::string("c'd"))
+        }
+    END_SECTION
+
     START_SECTION("TsvFile sniffing integration")
         {   // .csv content is sniffed as comma even with a tab fallback
             std::istringstream ss("a,b,c\n1,2,3\n");
@@ -230,4 +344,200 @@ START_TEST("tsvFile.hpp")
             EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(2))
         }
     END_SECTION
+
+    START_SECTION("TsvFile record index and seekPreview")
+        {   // quoted newlines: offsets come from the parser, never from counting lines
+            std::string text = "\xEF\xBB\xBF" "id,note\n";
+            for(int i = 0; i < 100; i++)
+                text += std::to_string(i) + (i % 3 ? ",plain\n" : ",\"two\nlines\"\n");
+            std::istringstream ss(text);
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            f.setIndexInterval(8);
+            f.setPreviewRows(3);
+            f.read(ss, true);
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(100))
+            EXPECT_EQUAL(f.getRecordIndex().size(), static_cast<size_t>(13))
+            EXPECT_EQUAL(text.substr(f.getRecordIndex()[2], 3), std::string("16,"))
+
+            EXPECT_EQUAL(f.seekPreview(ss, 42), true)
+            EXPECT_EQUAL(f.getPreviewStart(), static_cast<size_t>(42))
+            EXPECT_EQUAL(f.getNPreviewRows(), static_cast<size_t>(3))
+            EXPECT_EQUAL(f.getPreviewValue(0, 0), std::string("42"))
+            EXPECT_EQUAL(f.getPreviewValue(1, 0), std::string("two\nlines"))
+            EXPECT_EQUAL(f.getPreviewValue(0, 2), std::string("44"))
+            EXPECT_EQUAL(f.seekPreview(ss, 99), true)
+            EXPECT_EQUAL(f.getNPreviewRows(), static_cast<size_t>(1))
+            EXPECT_EQUAL(f.seekPreview(ss, 100), false)
+        }
+        {   // without an index the rows are found by parsing from the first one
+            std::istringstream ss("h\n\na\nb\n\"c\nc\"\nd\n");
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.read(ss, true);
+            EXPECT_EQUAL(f.getRecordIndex().empty(), true)
+            EXPECT_EQUAL(f.seekPreview(ss, 3), true)
+            EXPECT_EQUAL(f.getNPreviewRows(), static_cast<size_t>(1))
+            EXPECT_EQUAL(f.getPreviewValue(0, 0), std::string("d"))
+        }
+    END_SECTION
+
+    START_SECTION("TsvFile readTail")
+        {   // quoted newlines and "" quotes near the end; the window must grow past 64 KiB
+            std::string text = "id,note\n";
+            for(int i = 0; i < 20000; i++)
+                text += std::to_string(i) + (i % 4 ? ",\"say \"\"hi\"\"\"\n" : ",\"a\nb,c\"\n");
+            text += "trailer,\"x\n\n\n" + std::string(70000, 'y') + "\"\n";
+            std::istringstream ss(text);
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            EXPECT_EQUAL(f.readTail(ss, 3, true), true)
+            EXPECT_EQUAL(f.getDelim(), ',')
+            EXPECT_EQUAL(f.getHeaders().at(1), std::string("note"))
+            EXPECT_EQUAL(f.getNPreviewRows(), static_cast<size_t>(3))
+            EXPECT_EQUAL(f.getPreviewValue(0, 0), std::string("19998"))
+            EXPECT_EQUAL(f.getPreviewValue(1, 1), std::string("say \"hi\""))
+            EXPECT_EQUAL(f.getPreviewValue(0, 2), std::string("trailer"))
+            EXPECT_EQUAL(f.getPreviewValue(1, 2).size(), static_cast<size_t>(70004))
+            EXPECT_EQUAL(f.isNRowsExact(), false)
+            EXPECT_EQUAL(f.getNRows() > 3, true)
+        }
+        {   // the same with single quotes, which the window must not split records inside
+            std::string text = "id,note\n";
+            for(int i = 0; i < 20000; i++) text += std::to_string(i) + (i % 4 ? ",'p'\n" : ",'a\nb'\n");
+            std::string lines;
+            for(int i = 0; i < 2000; i++) lines += std::string(100, 'y') + "\n,''z";
+            text += "trailer,'" + lines + "'\n";
+            std::istringstream ss(text);
+            summarize::TsvFile f;
+            f.sniffDelim('\t');
+            EXPECT_EQUAL(f.readTail(ss, 3, true), true)
+            EXPECT_EQUAL(f.getDialect().quote, '\'')
+            EXPECT_EQUAL(f.getPreviewValue(0, 0), std::string("19998"))
+            EXPECT_EQUAL(f.getPreviewValue(1, 1), std::string("p"))
+            EXPECT_EQUAL(f.getPreviewValue(0, 2), std::string("trailer"))
+            EXPECT_EQUAL(f.getPreviewValue(1, 2).size(), static_cast<size_t>(2000 * 104))
+            EXPECT_EQUAL(f.getMinFields(), static_cast<size_t>(2))
+        }
+        {   // a small input is read from its first row, so the count is exact
+            std::istringstream ss("h1\th2\na\t1\nb\t2\nc\t3");
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.readTail(ss, 2, true);
+            EXPECT_EQUAL(f.isNRowsExact(), true)
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(3))
+            EXPECT_EQUAL(f.getPreviewStart(), static_cast<size_t>(1))
+            EXPECT_EQUAL(f.getPreviewValue(0, 1), std::string("c"))
+            EXPECT_EQUAL(f.getType(1), summarize::ColumnStats::INT)
+        }
+        {   // a non-seekable stream is parsed in full keeping the last rows
+            std::string text = "h\n";
+            for(int i = 0; i < 1000; i++) text += std::to_string(i) + "\n";
+            PipeBuf buf(text);
+            std::istream in(&buf);
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.readTail(in, 2, true);
+            EXPECT_EQUAL(f.isNRowsExact(), true)
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(1000))
+            EXPECT_EQUAL(f.getPreviewValue(0, 0), std::string("998"))
+            EXPECT_EQUAL(f.getPreviewValue(0, 1), std::string("999"))
+        }
+        {   // more rows requested than there are
+            std::istringstream ss("h\nx\n");
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.readTail(ss, 5, true);
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(1))
+            EXPECT_EQUAL(f.getNPreviewRows(), static_cast<size_t>(1))
+        }
+    END_SECTION
+
+    START_SECTION("DialectParser")
+        typedef summarize::DialectParser<',', summarize::Quoting::RFC4180> CommaParser;
+        typedef summarize::DialectParser<0, summarize::Quoting::RFC4180> RuntimeParser;
+        typedef summarize::DialectParser<'\t', summarize::Quoting::NONE> UnquotedTabParser;
+        std::vector<std::string> inputs = {
+            "a,b,c\n1,2,3\n",
+            "a,b\r\n\r\n1,\"x,y\"\r\n",
+            "\"q\"\"uote\",\"multi\nline\",\"cr\rlf\r\n\"\n",
+            "x,,\n,\n,y",
+            "\"closed\"tail,z\n\"unterminated",
+            "\"ends in cr\r",
+            "\n\n\nlone\r",
+            "a,b,",
+        };
+        for(const auto& text: inputs) {
+            EXPECT_EQUAL(traceAll<CommaParser>(text, ','), traceAll<summarize::CsvParser>(text, ','))
+            EXPECT_EQUAL(traceAll<RuntimeParser>(text, ','), traceAll<summarize::CsvParser>(text, ','))
+        }
+        {   // records and quoted fields across the parser's blocks
+            std::string text;
+            for(int i = 0; i < 20000; i++)
+                text += std::to_string(i) + (i % 3 ? ",plain\r\n" : ",\"quo\"\"ted\r\nfield\"\r\n");
+            EXPECT_EQUAL(traceAll<CommaParser>(text, ','), traceAll<summarize::CsvParser>(text, ','))
+        }
+        // Without quoting, quote characters are data.
+        EXPECT_EQUAL(parseAll<UnquotedTabParser>("\"a\tb\"\tc\n", '\t'), std::string("\"a|b\"|c"))
+        EXPECT_EQUAL(parseAll<UnquotedTabParser>("x\t\"\ny\r\nz", '\t'), std::string("x|\";y;z"))
+
+        std::istringstream ss("h1\th2\n\"a\t\"b\n");
+        summarize::TsvFile f;
+        f.setDelim('\t');
+        f.setQuoting(summarize::Quoting::NONE);
+        f.read(ss, true);
+        EXPECT_EQUAL(f.getNCols(), static_cast<size_t>(2))
+        EXPECT_EQUAL(f.getPreviewValue(0, 0), std::string("\"a"))
+        EXPECT_EQUAL(f.getPreviewValue(1, 0), std::string("\"b"))
+
+        // Seeking and tail reads parse unquoted too.
+        std::string unquoted = "id\tnote\n";
+        for(int i = 0; i < 100; i++) unquoted += std::to_string(i) + "\t\"q" + std::to_string(i) + "\n";
+        std::istringstream seekIn(unquoted);
+        summarize::TsvFile seeker;
+        seeker.setDelim('\t');
+        seeker.setQuoting(summarize::Quoting::NONE);
+        seeker.setIndexInterval(10);
+        seeker.read(seekIn, true);
+        EXPECT_EQUAL(seeker.seekPreview(seekIn, 35), true)
+        EXPECT_EQUAL(seeker.getPreviewValue(0, 0), std::string("35"))
+        EXPECT_EQUAL(seeker.getPreviewValue(1, 0), std::string("\"q35"))
+        std::istringstream tailIn(unquoted);
+        summarize::TsvFile tail;
+        tail.setDelim('\t');
+        tail.setQuoting(summarize::Quoting::NONE);
+        EXPECT_EQUAL(tail.readTail(tailIn, 2, true), true)
+        EXPECT_EQUAL(tail.getNRows(), static_cast<size_t>(100))
+        EXPECT_EQUAL(tail.getNCols(), static_cast<size_t>(2))
+        EXPECT_EQUAL(tail.getPreviewValue(1, 1), std::string("\"q99"))
+    END_SECTION
+
+    START_SECTION("TsvFile time budget")
+        std::string text = "id\tv\n";
+        for(int i = 0; i < 100000; i++) text += "12\t3.5\n";
+        {   // an expired budget stops at the first batch boundary and extrapolates the count
+            std::istringstream ss(text);
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.setTimeBudget(1e-9);
+            EXPECT_EQUAL(f.read(ss, true), true)
+            const summarize::PartialInfo& partial = f.getPartialInfo();
+            EXPECT_EQUAL(partial.valid, true)
+            EXPECT_EQUAL(partial.rows, static_cast<size_t>(4095))
+            EXPECT_EQUAL(partial.bytes, static_cast<size_t>(5 + 4095 * 7))
+            EXPECT_EQUAL(partial.totalBytes, text.size())
+            EXPECT_EQUAL(f.isNRowsExact(), false)
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(100000))
+            EXPECT_EQUAL(f.getType(1), summarize::ColumnStats::FLOAT)
+        }
+        {   // without a budget the same input is read in full
+            std::istringstream ss(text);
+            summarize::TsvFile f;
+            f.setDelim('\t');
+            f.read(ss, true);
+            EXPECT_EQUAL(f.getPartialInfo().valid, false)
+            EXPECT_EQUAL(f.isNRowsExact(), true)
+            EXPECT_EQUAL(f.getNRows(), static_cast<size_t>(100000))
+        }
+    END_SECTION
 END_TEST
@@ -0,0 +1,184 @@
+//
+// Tests for wide tables: column names packed in chunks and found through the hash index,
+// statistics updated column parallel matching a serial update, reads of tables with
+// thousands of columns, and printing a page of columns.
+//
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+
+#include <testing.hpp>
+#include <columnNames.hpp>
+#include <columnParallelStats.hpp>
+#include <scheduler.hpp>
+#include <planner.hpp>
+#include <tsvFile.hpp>
+
+//! Statistics of every column, with the means rounded.
+static std::string describeStats(const std::vector<summarize::ColumnStats>& stats) {
+    std::ostringstream out;
+    for(const auto& column: stats) {
+        out << column.getCount() << '/' << column.getMissing() << '/' << column.getMaxLength() << '/'
+            << summarize::ColumnStats::typeToString(column.getType());
+        if(column.getNNumeric() > 0) out << '/' << std::setprecision(9) << column.getMean();
+        out << ' ';
+    }
+    return out.str();
+}
+
+//! Everything a read of a wide table found.
+static std::string describeWide(const summarize::TsvFile& f) {
+    std::ostringstream out;
+    out << f.getNRows() << "x" << f.getNCols() << " min " << f.getMinFields();
+    for(size_t col = 0; col < f.getNCols(); col++) {
+        out << ' ' << f.getHeaders()[col] << ':' << summarize::ColumnStats::typeToString(f.getType(col));
+        for(size_t row = 0; row < f.getNPreviewRows(); row++) out << ',' << f.getPreviewValue(col, row);
+        if(f.hasStats()) out << ':' << f.getStats(col).getMissing() << ':' << f.getStats(col).getMaxLength();
+    }
+    return out.str();
+}
+
+static std::string capturePage(const summarize::TsvFile& f, bool summary, size_t first, size_t max) {
+    std::ostringstream oss;
+    std::streambuf* old = std::cout.rdbuf(oss.rdbuf());
+    if(summary) f.printSummary(first, max);
+    else f.printStructure(1, first, max);
+    std::cout.rdbuf(old);
+    return oss.str();
+}
+
+START_TEST("columnNames.hpp")
+    START_SECTION("Column names")
+        summarize::ColumnNames names;
+        names.push_back("id");
+        names.push_back("value");
+        names.push_back("id");
+        names.pushNumbered("COLUMN_", 12);
+        EXPECT_EQUAL(names.size(), static_cast<size_t>(4))
+        EXPECT_EQUAL(names[3], std::string_view("COLUMN_12"))
+        EXPECT_EQUAL(names[3].data()[names[3].size()], '\0')
+        EXPECT_EQUAL(names.find("id"), static_cast<size_t>(0))             // the first of duplicates
+        EXPECT_EQUAL(names.find("COLUMN_12"), static_cast<size_t>(3))
+        EXPECT_EQUAL(names.find("missing"), summarize::ColumnNames::npos)
+        EXPECT_EQUAL(names.getMaxLength(), static_cast<size_t>(9))
+
+        summarize::ColumnNames copy = names;
+        names.truncate(2);
+        EXPECT_EQUAL(names.find("COLUMN_12"), summarize::ColumnNames::npos)
+        EXPECT_EQUAL(names.getMaxLength(), static_cast<size_t>(5))
+        EXPECT_EQUAL(copy.find("COLUMN_12"), static_cast<size_t>(3))
+        EXPECT_EQUAL(copy[1], std::string_view("value"))
+
+        // Many columns: every one is found, for little memory each.
+        summarize::ColumnNames wide;
+        for(size_t i = 0; i < 200000; i++) wide.pushNumbered("feature_", i);
+        wide.push_back(std::string(100000, 'x'));       // longer than a chunk
+        bool found = true;
+        for(size_t i = 0; i < 200000; i += 7) found = found && wide.find("feature_" + std::to_string(i)) == i;
+        EXPECT_EQUAL(found, true)
+        EXPECT_EQUAL(wide.find(std::string(100000, 'x')), static_cast<size_t>(200000))
+        EXPECT_EQUAL(wide.getMemoryBytes() < 200000 * 64 + 100000 + 65536, true)
+    END_SECTION
+
+    START_SECTION("Column parallel statistics")
+        // Ragged records of growing width, so columns appear part way through a batch.
+        std::vector<std::vector<std::string> > records;
+        for(size_t r = 0; r < 300; r++) {
+            std::vector<std::string> record;
+            size_t width = 2000 + (r * 37) % 1500;
+            for(size_t col = 0; col < width; col++)
+                record.push_back((col + r) % 11 == 0 ? "" : (col % 3 ? std::to_string(col * r) : "s" + std::to_string(r)));
+            records.push_back(record);
+        }
+        std::vector<summarize::ColumnStats> serial;
+        for(const auto& record: records) {
+            if(record.size() > serial.size()) {
+                size_t rows = serial.empty() ? 0 : serial.front().getCount();
+                size_t oldSize = serial.size();
+                serial.resize(record.size());
+                for(size_t col = oldSize; col < serial.size(); col++) serial[col].addMissing(rows);
+            }
+            for(size_t col = 0; col < serial.size(); col++) {
+                if(col < record.size()) serial[col].add(record[col]);
+                else serial[col].addMissing();
+            }
+        }
+
+        summarize::Scheduler scheduler(3);
+        std::vector<summarize::ColumnStats> parallel;
+        {
+            summarize::ColumnParallelStats columnStats(scheduler, parallel);
+            for(size_t r = 0; r < records.size(); r++) {
+                std::vector<std::string> record = records[r];
+                if(r % 2) columnStats.add(record);
+                else columnStats.take(record);
+            }
+        }
+        EXPECT_EQUAL(describeStats(parallel), describeStats(serial))
+    END_SECTION
+
+    START_SECTION("Wide tables")
+        std::string text;
+        for(size_t col = 0; col < 3000; col++) text += (col ? "\t" : "") + std::string("f") + std::to_string(col);
+        text += '\n';
+        for(size_t r = 0; r < 40; r++) {
+            size_t width = r == 7 ? 2500 : 3000;
+            for(size_t col = 0; col < width; col++)
+                text += (col ? "\t" : "") + (col % 5 ? std::to_string(r * col) : "x" + std::to_string(r));
+            text += '\n';
+        }
+
+        std::istringstream serialIn(text);
+        summarize::TsvFile serialFile;
+        serialFile.sniffDelim('\t');
+        serialFile.setPreviewRows(2);
+        serialFile.setCollectStats(true);
+        EXPECT_EQUAL(serialFile.read(serialIn, true), true)
+        EXPECT_EQUAL(serialFile.getNCols(), static_cast<size_t>(3000))
+        EXPECT_EQUAL(serialFile.getColumnIndex("f2999"), static_cast<size_t>(2999))
+
+        summarize::Scheduler wideScheduler(2);
+        summarize::Planner planner(2);
+        summarize::InputFacts facts;
+        facts.stats = true;
+        std::istringstream parallelIn(text);
+        summarize::TsvFile parallelFile;
+        parallelFile.sniffDelim('\t');
+        parallelFile.setPreviewRows(2);
+        parallelFile.setCollectStats(true);
+        parallelFile.setScheduler(&wideScheduler);
+        parallelFile.setPlanner(&planner, planner.plan(facts, 2));
+        EXPECT_EQUAL(parallelFile.read(parallelIn, true), true)
+        EXPECT_EQUAL(parallelFile.getPlan().engine == summarize::ExecutionPlan::Engine::COLUMN_PARALLEL, true)
+        EXPECT_EQUAL(parallelFile.getProfile().getPipeline(), std::string())
+        EXPECT_EQUAL(describeWide(parallelFile), describeWide(serialFile))
+
+        // Without headers the names are made up.
+        std::istringstream noHeaderIn(text);
+        summarize::TsvFile noHeader;
+        noHeader.sniffDelim('\t');
+        EXPECT_EQUAL(noHeader.read(noHeaderIn, false), true)
+        EXPECT_EQUAL(noHeader.getHeaders()[2999], std::string_view("COLUMN_2999"))
+        EXPECT_EQUAL(noHeader.getNRows(), static_cast<size_t>(41))
+    END_SECTION
+
+    START_SECTION("Pages of columns")
+        std::istringstream pageIn("a\tbb\tccc\tdddd\n1\t2\tx\t4\n");
+        summarize::TsvFile page;
+        page.sniffDelim('\t');
+        page.setCollectStats(true);
+        EXPECT_EQUAL(page.read(pageIn, true), true)
+        EXPECT_EQUAL(capturePage(page, false, 1, 2),
+                     "1 obs. of 4 variables\n2) bb : int 2 ...\n3) ccc: str x ...\n(columns 2 to 3 of 4)\n")
+        std::string all = capturePage(page, false, 0, 0);
+        EXPECT_EQUAL(all.find("4) dddd: int 4 ...\n") != std::string::npos, true)
+        EXPECT_EQUAL(all.find("(columns"), std::string::npos)
+        std::string summary = capturePage(page, true, 3, 10);
+        EXPECT_EQUAL(summary.find("4) dddd: int, 0 missing") != std::string::npos, true)
+        EXPECT_EQUAL(summary.find("(columns 4 to 4 of 4)") != std::string::npos, true)
+        EXPECT_EQUAL(capturePage(page, true, 10, 10), "1 obs. of 4 variables\n(columns 5 to 4 of 4)\n")
+    END_SECTION
+END_TEST